@@ -0,0 +1,83 @@
+/*
+ * Glue Code for the asm optimized version of the AES Cipher Algorithm
+ *
+ * Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <crypto/aes.h>
+#include <asm/aes.h>
+
+asmlinkage void aes_arm_encrypt(const u32 *rk, int rounds, const u8 *in,
+				u8 *out);
+asmlinkage void aes_arm_decrypt(const u32 *rk, int rounds, const u8 *in,
+				u8 *out);
+
+static inline int aes_rounds(struct crypto_aes_ctx *ctx)
+{
+	return 6 + ctx->key_length / 4;
+}
+
+void crypto_aes_encrypt_arm(struct crypto_aes_ctx *ctx, u8 *dst, const u8 *src)
+{
+	aes_arm_encrypt(ctx->key_enc, aes_rounds(ctx), src, dst);
+}
+EXPORT_SYMBOL_GPL(crypto_aes_encrypt_arm);
+
+void crypto_aes_decrypt_arm(struct crypto_aes_ctx *ctx, u8 *dst, const u8 *src)
+{
+	aes_arm_decrypt(ctx->key_dec, aes_rounds(ctx), src, dst);
+}
+EXPORT_SYMBOL_GPL(crypto_aes_decrypt_arm);
+
+static void aes_encrypt(struct crypto_tfm *tfm, u8 *dst, const u8 *src)
+{
+	crypto_aes_encrypt_arm(crypto_tfm_ctx(tfm), dst, src);
+}
+
+static void aes_decrypt(struct crypto_tfm *tfm, u8 *dst, const u8 *src)
+{
+	crypto_aes_decrypt_arm(crypto_tfm_ctx(tfm), dst, src);
+}
+
+static struct crypto_alg aes_alg = {
+	.cra_name		= "aes",
+	.cra_driver_name	= "aes-asm",
+	.cra_priority		= 200,
+	.cra_flags		= CRYPTO_ALG_TYPE_CIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aes_alg.cra_list),
+	.cra_u	= {
+		.cipher	= {
+			.cia_min_keysize	= AES_MIN_KEY_SIZE,
+			.cia_max_keysize	= AES_MAX_KEY_SIZE,
+			.cia_setkey		= crypto_aes_set_key,
+			.cia_encrypt		= aes_encrypt,
+			.cia_decrypt		= aes_decrypt
+		}
+	}
+};
+
+static int __init aes_init(void)
+{
+	return crypto_register_alg(&aes_alg);
+}
+
+static void __exit aes_fini(void)
+{
+	crypto_unregister_alg(&aes_alg);
+}
+
+module_init(aes_init);
+module_exit(aes_fini);
+
+MODULE_DESCRIPTION("Rijndael (AES) Cipher Algorithm, asm optimized");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("aes");
+MODULE_ALIAS("aes-asm");
@@ -0,0 +1,549 @@
+/*
+ * Glue code for the bit-sliced NEON AES: ECB, CBC, CTR and XTS
+ *
+ * Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * aesbs_encrypt8() and aesbs_decrypt8() work on eight blocks at a time,
+ * so only the modes that can keep eight blocks in flight use them: ECB,
+ * CBC decryption, CTR and XTS. Short runs, CBC encryption and requests
+ * made in interrupt context, where the NEON registers may not be used,
+ * go block by block through the ARM code instead. So do all requests
+ * made before the VFP support has probed for NEON, such as the self
+ * tests when this is built in.
+ */
+
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/crypto.h>
+#include <crypto/algapi.h>
+#include <crypto/aes.h>
+#include <crypto/b128ops.h>
+#include <crypto/gf128mul.h>
+#include <asm/aes.h>
+#include <asm/neon.h>
+
+#define AESBS_BLOCKS		8
+#define AESBS_BYTES		(AESBS_BLOCKS * AES_BLOCK_SIZE)
+
+/* one 16 byte mask per bit of the state, for each of up to 15 round keys */
+#define AESBS_KEY_BYTES		(AES_MAX_KEYLENGTH_U32 / 4 * AESBS_BYTES)
+
+asmlinkage void aesbs_encrypt8(u8 *out, const u8 *in, const u8 *rk,
+			       int rounds);
+asmlinkage void aesbs_decrypt8(u8 *out, const u8 *in, const u8 *rk,
+			       int rounds);
+
+struct aesbs_ctx {
+	struct crypto_aes_ctx	aes;
+	int			rounds;
+	u8			enc[AESBS_KEY_BYTES];
+	u8			dec[AESBS_KEY_BYTES];
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx	key;
+	struct crypto_aes_ctx	tweak;
+};
+
+static inline int aesbs_usable(unsigned int nbytes)
+{
+	return nbytes >= AESBS_BYTES && cpu_has_neon() &&
+		!in_interrupt() && !irqs_disabled();
+}
+
+/*
+ * out = a ^ b, for writing results inside kernel_neon_begin() sections,
+ * where a memcpy() of a whole run would be one the NEON memcpy() could
+ * take. out may be a or b.
+ */
+static void aesbs_xor(u8 *out, const u8 *a, const u8 *b, unsigned int len)
+{
+	if (!(((unsigned long)out | (unsigned long)a | (unsigned long)b) & 3))
+		for (; len >= 4; len -= 4, out += 4, a += 4, b += 4)
+			*(u32 *)out = *(const u32 *)a ^ *(const u32 *)b;
+	for (; len; len--)
+		*out++ = *a++ ^ *b++;
+}
+
+/*
+ * Spread each round key over eight masks, one per bit, in the byte order
+ * the NEON code keeps the state in: that of the blocks for the first and
+ * last round keys, transposed for the others. The S-box constant 0x63 is
+ * folded into the keys that follow a SubBytes, which for the equivalent
+ * inverse cipher are all but the last.
+ */
+static void aesbs_convert_key(u8 *out, const u32 *rk, int rounds, int dec)
+{
+	int i, r, bit;
+
+	for (r = 0; r <= rounds; r++, rk += 4) {
+		u8 fold = (dec ? r < rounds : r > 0) ? 0x63 : 0;
+
+		for (bit = 7; bit >= 0; bit--)
+			for (i = 0; i < 16; i++) {
+				int n = (r == 0 || r == rounds) ? i :
+					(i >> 2) + 4 * (i & 3);
+				u8 b = (u8)(rk[n >> 2] >> (8 * (n & 3))) ^ fold;
+
+				*out++ = (b >> bit) & 1 ? 0xff : 0;
+			}
+	}
+}
+
+static int aesbs_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			 unsigned int key_len)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	err = crypto_aes_expand_key(&ctx->aes, in_key, key_len);
+	if (err) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return err;
+	}
+
+	ctx->rounds = 6 + key_len / 4;
+	aesbs_convert_key(ctx->enc, ctx->aes.key_enc, ctx->rounds, 0);
+	aesbs_convert_key(ctx->dec, ctx->aes.key_dec, ctx->rounds, 1);
+	return 0;
+}
+
+static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	if (key_len % 2) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	err = crypto_aes_expand_key(&ctx->tweak, in_key + key_len / 2,
+				    key_len / 2);
+	if (err) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return err;
+	}
+
+	return aesbs_set_key(tfm, in_key, key_len / 2);
+}
+
+static int aesbs_ecb_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, int enc)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (aesbs_usable(nbytes)) {
+			kernel_neon_begin();
+			do {
+				if (enc)
+					aesbs_encrypt8(d, s, ctx->enc,
+						       ctx->rounds);
+				else
+					aesbs_decrypt8(d, s, ctx->dec,
+						       ctx->rounds);
+				s += AESBS_BYTES;
+				d += AESBS_BYTES;
+				nbytes -= AESBS_BYTES;
+			} while (nbytes >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			if (enc)
+				crypto_aes_encrypt_arm(&ctx->aes, d, s);
+			else
+				crypto_aes_decrypt_arm(&ctx->aes, d, s);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_ecb_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_ecb_crypt(desc, dst, src, nbytes, 1);
+}
+
+static int aesbs_ecb_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_ecb_crypt(desc, dst, src, nbytes, 0);
+}
+
+/* Each block depends on the one before it: always the ARM code */
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+		u8 *iv = walk.iv;
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			crypto_xor(iv, s, AES_BLOCK_SIZE);
+			crypto_aes_encrypt_arm(&ctx->aes, d, iv);
+			memcpy(iv, d, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+/*
+ * The plaintext is decrypted into a buffer before it is stored, as the
+ * ciphertext it is chained with may be the same memory.
+ */
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u8 buf[AESBS_BYTES] __attribute__ ((aligned(8)));
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+		u8 *iv = walk.iv;
+
+		if (aesbs_usable(nbytes)) {
+			kernel_neon_begin();
+			do {
+				aesbs_decrypt8(buf, s, ctx->dec, ctx->rounds);
+				aesbs_xor(buf, buf, iv, AES_BLOCK_SIZE);
+				memcpy(iv, s + AESBS_BYTES - AES_BLOCK_SIZE,
+				       AES_BLOCK_SIZE);
+				/*
+				 * Last block first: in place, each block
+				 * overwrites the ciphertext the next one
+				 * needed.
+				 */
+				for (i = AESBS_BLOCKS - 1; i > 0; i--)
+					aesbs_xor(d + i * AES_BLOCK_SIZE,
+						  buf + i * AES_BLOCK_SIZE,
+						  s + (i - 1) * AES_BLOCK_SIZE,
+						  AES_BLOCK_SIZE);
+				memcpy(d, buf, AES_BLOCK_SIZE);
+				s += AESBS_BYTES;
+				d += AESBS_BYTES;
+				nbytes -= AESBS_BYTES;
+			} while (nbytes >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			crypto_aes_decrypt_arm(&ctx->aes, buf, s);
+			crypto_xor(buf, iv, AES_BLOCK_SIZE);
+			memcpy(iv, s, AES_BLOCK_SIZE);
+			memcpy(d, buf, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_ctr_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u8 buf[AESBS_BYTES] __attribute__ ((aligned(8)));
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+		u8 *ctrblk = walk.iv;
+
+		if (aesbs_usable(nbytes)) {
+			kernel_neon_begin();
+			do {
+				for (i = 0; i < AESBS_BLOCKS; i++) {
+					memcpy(buf + i * AES_BLOCK_SIZE,
+					       ctrblk, AES_BLOCK_SIZE);
+					crypto_inc(ctrblk, AES_BLOCK_SIZE);
+				}
+				aesbs_encrypt8(buf, buf, ctx->enc,
+					       ctx->rounds);
+				aesbs_xor(d, buf, s, AESBS_BYTES);
+				s += AESBS_BYTES;
+				d += AESBS_BYTES;
+				nbytes -= AESBS_BYTES;
+			} while (nbytes >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			crypto_aes_encrypt_arm(&ctx->aes, buf, ctrblk);
+			crypto_inc(ctrblk, AES_BLOCK_SIZE);
+			crypto_xor(buf, s, AES_BLOCK_SIZE);
+			memcpy(d, buf, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	/* a partial last block, as in crypto_ctr_crypt_final() */
+	if (walk.nbytes) {
+		crypto_aes_encrypt_arm(&ctx->aes, buf, walk.iv);
+		crypto_xor(buf, walk.src.virt.addr, nbytes);
+		memcpy(walk.dst.virt.addr, buf, nbytes);
+		crypto_inc(walk.iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	return err;
+}
+
+/*
+ * The tweak of the first block is the IV encrypted with the second key,
+ * and each next one is the last multiplied by x in GF(2^128).
+ */
+static int aesbs_xts_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, int enc)
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	be128 buf[AESBS_BLOCKS], tw[AESBS_BLOCKS], t;
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+	if (!walk.nbytes)
+		return err;
+
+	crypto_aes_encrypt_arm(&ctx->tweak, (u8 *)&t, walk.iv);
+
+	while ((nbytes = walk.nbytes)) {
+		be128 *s = (be128 *)walk.src.virt.addr;
+		be128 *d = (be128 *)walk.dst.virt.addr;
+
+		if (aesbs_usable(nbytes)) {
+			kernel_neon_begin();
+			do {
+				for (i = 0; i < AESBS_BLOCKS; i++) {
+					tw[i] = t;
+					be128_xor(&buf[i], &s[i], &t);
+					gf128mul_x_ble(&t, &t);
+				}
+				if (enc)
+					aesbs_encrypt8((u8 *)buf, (u8 *)buf,
+						       ctx->key.enc,
+						       ctx->key.rounds);
+				else
+					aesbs_decrypt8((u8 *)buf, (u8 *)buf,
+						       ctx->key.dec,
+						       ctx->key.rounds);
+				for (i = 0; i < AESBS_BLOCKS; i++)
+					be128_xor(&d[i], &buf[i], &tw[i]);
+				s += AESBS_BLOCKS;
+				d += AESBS_BLOCKS;
+				nbytes -= AESBS_BYTES;
+			} while (nbytes >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			be128_xor(buf, s, &t);
+			if (enc)
+				crypto_aes_encrypt_arm(&ctx->key.aes,
+						       (u8 *)buf, (u8 *)buf);
+			else
+				crypto_aes_decrypt_arm(&ctx->key.aes,
+						       (u8 *)buf, (u8 *)buf);
+			be128_xor(d, buf, &t);
+			gf128mul_x_ble(&t, &t);
+			s++;
+			d++;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, 1);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, 0);
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "ecb(aes)",
+	.cra_driver_name	= "ecb-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[0].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_ecb_encrypt,
+			.decrypt	= aesbs_ecb_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[1].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[2].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_ctr_crypt,
+			.decrypt	= aesbs_ctr_crypt,
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[3].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_set_key,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	int i, err;
+
+	for (i = 0; i < ARRAY_SIZE(aesbs_algs); i++) {
+		err = crypto_register_alg(&aesbs_algs[i]);
+		if (err)
+			goto unregister;
+	}
+	return 0;
+
+unregister:
+	while (--i >= 0)
+		crypto_unregister_alg(&aesbs_algs[i]);
+	return err;
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(aesbs_algs) - 1; i >= 0; i--)
+		crypto_unregister_alg(&aesbs_algs[i]);
+}
+
+module_init(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit-sliced AES for NEON: ECB, CBC, CTR and XTS");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ecb(aes)");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
+MODULE_ALIAS("xts(aes)");
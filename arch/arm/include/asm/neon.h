@@ -0,0 +1,46 @@
+/*
+ *  linux/arch/arm/include/asm/neon.h
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Kernel code may use the NEON registers between kernel_neon_begin() and
+ * kernel_neon_end(), outside interrupt context only. Preemption is
+ * disabled in between, so the section must not sleep, and code that
+ * touches user memory in it must do so with page faults disabled.
+ * cpu_has_neon() is only true once the VFP support has found NEON, late
+ * in boot.
+ *
+ * The sections do not nest: code that may be called from one, such as
+ * memcpy(), must check kernel_neon_in_use() and do without NEON if set.
+ */
+#ifdef CONFIG_NEON
+DECLARE_PER_CPU(int, kernel_neon_busy);
+
+extern void kernel_neon_begin(void);
+extern void kernel_neon_end(void);
+
+/*
+ * Only set while this CPU is in a section, with preemption disabled, so
+ * it may be read with preemption enabled.
+ */
+static inline int kernel_neon_in_use(void)
+{
+	return per_cpu(kernel_neon_busy, raw_smp_processor_id());
+}
+#endif
+
+#endif /* __ASM_ARM_NEON_H */
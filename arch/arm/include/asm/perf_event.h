@@ -0,0 +1,31 @@
+/*
+ *  linux/arch/arm/include/asm/perf_event.h
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __ARM_PERF_EVENT_H__
+#define __ARM_PERF_EVENT_H__
+
+/*
+ * ARM has no way to raise a self interrupt for the pending work, so the
+ * counter overflow handler runs perf_event_do_pending() itself on the way
+ * out and everything else is picked up from the timer tick.
+ */
+static inline void
+set_perf_event_pending(void)
+{
+}
+
+/*
+ * The index in the mmap()ed control page is only informational, user
+ * space cannot read the counters itself.
+ */
+#define PERF_EVENT_INDEX_OFFSET	1
+
+#endif /* __ARM_PERF_EVENT_H__ */
@@ -50,6 +50,8 @@ extern void __aeabi_ulcmp(void);
 extern void fpundefinstr(void);
 extern void fp_enter(void);
 
+extern void crc32_neon_fold(void);
+
 /*
  * This has a special calling convention; it doesn't
  * modify any of the usual registers, except for LR.
@@ -188,3 +190,7 @@ EXPORT_SYMBOL(_find_next_bit_be);
 EXPORT_SYMBOL(mcount);
 EXPORT_SYMBOL(__gnu_mcount_nc);
 #endif
+
+#ifdef CONFIG_CRC32_NEON
+EXPORT_SYMBOL_GPL(crc32_neon_fold);
+#endif
@@ -0,0 +1,1059 @@
+/*
+ *  linux/arch/arm/kernel/perf_event.c
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ *  ARMv7 Cortex-A8 counter access is based on the oprofile driver,
+ *  Copyright 2008 Jean Pihet <jpihet@mvista.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The ARMv7 performance monitors have a cycle counter and, on the
+ * Cortex-A8, four event counters. All of them are 32 bits wide and raise
+ * one interrupt on overflow, which is used both to sample and to fold
+ * the hardware counts into the 64 bit event counts before they wrap.
+ *
+ * The counters cannot be restricted to user or kernel mode, so events
+ * excluding either are refused.
+ */
+#define pr_fmt(fmt) "hw perfevents: " fmt
+
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/perf_event.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#include <asm/cputype.h>
+#include <asm/irq.h>
+#include <asm/irq_regs.h>
+#include <asm/pmu.h>
+#include <asm/stacktrace.h>
+#include <asm/system.h>
+#include <asm/traps.h>
+
+/*
+ * Counter 0 is the cycle counter, counters 1 to 4 are the event counters
+ * CNT0 to CNT3, the same numbering oprofile uses.
+ */
+#define ARMV7_CYCLE_COUNTER	0
+#define ARMV7_COUNTER0		1
+#define ARMV7_MAX_COUNTERS	5
+
+/* the counters are 32 bits, never let one start closer than that to 0 */
+#define ARMV7_MAX_PERIOD	((1LLU << 32) - 1)
+
+/*
+ * PMNC: control register
+ */
+#define ARMV7_PMNC_E		(1 << 0)	/* enable all counters */
+#define ARMV7_PMNC_P		(1 << 1)	/* reset the event counters */
+#define ARMV7_PMNC_C		(1 << 2)	/* reset the cycle counter */
+#define ARMV7_PMNC_D		(1 << 3)	/* CCNT counts every 64th cycle */
+#define ARMV7_PMNC_N_SHIFT	11		/* number of event counters */
+#define ARMV7_PMNC_N_MASK	0x1f
+#define ARMV7_PMNC_MASK		0x3f		/* writable bits */
+
+/*
+ * CNTENS/CNTENC, INTENS/INTENC and FLAG share one layout: bit 31 is the
+ * cycle counter, bits 0 to 3 the event counters.
+ */
+#define ARMV7_CCNT_BIT		(1 << 31)
+#define ARMV7_CNT_MASK		0x8000000f
+
+#define ARMV7_EVTSEL_MASK	0xff
+
+/*
+ * Cortex-A8 event numbers, from the Technical Reference Manual. Events
+ * up to 0x12 are defined by the architecture, the rest are A8 specific.
+ */
+enum armv7_a8_perf_types {
+	ARMV7_PERFCTR_PMNC_SW_INCR		= 0x00,
+	ARMV7_PERFCTR_IFETCH_MISS		= 0x01,
+	ARMV7_PERFCTR_ITLB_MISS			= 0x02,
+	ARMV7_PERFCTR_DCACHE_REFILL		= 0x03,
+	ARMV7_PERFCTR_DCACHE_ACCESS		= 0x04,
+	ARMV7_PERFCTR_DTLB_REFILL		= 0x05,
+	ARMV7_PERFCTR_DREAD			= 0x06,
+	ARMV7_PERFCTR_DWRITE			= 0x07,
+	ARMV7_PERFCTR_INSTR_EXECUTED		= 0x08,
+	ARMV7_PERFCTR_EXC_TAKEN			= 0x09,
+	ARMV7_PERFCTR_EXC_EXECUTED		= 0x0A,
+	ARMV7_PERFCTR_CID_WRITE			= 0x0B,
+	ARMV7_PERFCTR_PC_WRITE			= 0x0C,
+	ARMV7_PERFCTR_PC_IMM_BRANCH		= 0x0D,
+	ARMV7_PERFCTR_PC_PROC_RETURN		= 0x0E,
+	ARMV7_PERFCTR_UNALIGNED_ACCESS		= 0x0F,
+	ARMV7_PERFCTR_PC_BRANCH_MIS_PRED	= 0x10,
+	ARMV7_PERFCTR_CLOCK_CYCLES		= 0x11,
+	ARMV7_PERFCTR_PC_BRANCH_PRED		= 0x12,
+
+	ARMV7_PERFCTR_WRITE_BUFFER_FULL		= 0x40,
+	ARMV7_PERFCTR_L2_STORE_MERGED		= 0x41,
+	ARMV7_PERFCTR_L2_STORE_BUFF		= 0x42,
+	ARMV7_PERFCTR_L2_ACCESS			= 0x43,
+	ARMV7_PERFCTR_L2_CACH_MISS		= 0x44,
+	ARMV7_PERFCTR_AXI_READ_CYCLES		= 0x45,
+	ARMV7_PERFCTR_AXI_WRITE_CYCLES		= 0x46,
+	ARMV7_PERFCTR_MEMORY_REPLAY		= 0x47,
+	ARMV7_PERFCTR_UNALIGNED_ACCESS_REPLAY	= 0x48,
+	ARMV7_PERFCTR_L1_DATA_MISS		= 0x49,
+	ARMV7_PERFCTR_L1_INST_MISS		= 0x4A,
+	ARMV7_PERFCTR_L1_DATA_COLORING		= 0x4B,
+	ARMV7_PERFCTR_L1_NEON_DATA		= 0x4C,
+	ARMV7_PERFCTR_L1_NEON_CACH_DATA		= 0x4D,
+	ARMV7_PERFCTR_L2_NEON			= 0x4E,
+	ARMV7_PERFCTR_L2_NEON_HIT		= 0x4F,
+	ARMV7_PERFCTR_L1_INST			= 0x50,
+	ARMV7_PERFCTR_PC_RETURN_MIS_PRED	= 0x51,
+	ARMV7_PERFCTR_PC_BRANCH_FAILED		= 0x52,
+	ARMV7_PERFCTR_PC_BRANCH_TAKEN		= 0x53,
+	ARMV7_PERFCTR_PC_BRANCH_EXECUTED	= 0x54,
+	ARMV7_PERFCTR_OP_EXECUTED		= 0x55,
+	ARMV7_PERFCTR_CYCLES_INST_STALL		= 0x56,
+	ARMV7_PERFCTR_CYCLES_INST		= 0x57,
+	ARMV7_PERFCTR_CYCLES_NEON_DATA_STALL	= 0x58,
+	ARMV7_PERFCTR_CYCLES_NEON_INST_STALL	= 0x59,
+	ARMV7_PERFCTR_NEON_CYCLES		= 0x5A,
+
+	ARMV7_PERFCTR_PMU0_EVENTS		= 0x70,
+	ARMV7_PERFCTR_PMU1_EVENTS		= 0x71,
+	ARMV7_PERFCTR_PMU_EVENTS		= 0x72,
+
+	/* not an event number: selects the cycle counter */
+	ARMV7_PERFCTR_CPU_CYCLES		= 0xFF,
+};
+
+#define HW_OP_UNSUPPORTED		0xFFFF
+#define CACHE_OP_UNSUPPORTED		0xFFFF
+
+static const unsigned armv7_a8_perf_map[PERF_COUNT_HW_MAX] = {
+	[PERF_COUNT_HW_CPU_CYCLES]	    = ARMV7_PERFCTR_CPU_CYCLES,
+	[PERF_COUNT_HW_INSTRUCTIONS]	    = ARMV7_PERFCTR_INSTR_EXECUTED,
+	[PERF_COUNT_HW_CACHE_REFERENCES]    = ARMV7_PERFCTR_DCACHE_ACCESS,
+	[PERF_COUNT_HW_CACHE_MISSES]	    = ARMV7_PERFCTR_DCACHE_REFILL,
+	[PERF_COUNT_HW_BRANCH_INSTRUCTIONS] = ARMV7_PERFCTR_PC_WRITE,
+	[PERF_COUNT_HW_BRANCH_MISSES]	    = ARMV7_PERFCTR_PC_BRANCH_MIS_PRED,
+	[PERF_COUNT_HW_BUS_CYCLES]	    = HW_OP_UNSUPPORTED,
+};
+
+#define C(_x) \
+	PERF_COUNT_HW_CACHE_##_x
+
+/*
+ * The A8 counts cache accesses and misses without telling reads from
+ * writes, so both get the same event.
+ */
+static const unsigned armv7_a8_perf_cache_map[PERF_COUNT_HW_CACHE_MAX]
+					     [PERF_COUNT_HW_CACHE_OP_MAX]
+					     [PERF_COUNT_HW_CACHE_RESULT_MAX] = {
+	[C(L1D)] = {
+		[C(OP_READ)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_DCACHE_ACCESS,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_DCACHE_REFILL,
+		},
+		[C(OP_WRITE)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_DCACHE_ACCESS,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_DCACHE_REFILL,
+		},
+		[C(OP_PREFETCH)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = CACHE_OP_UNSUPPORTED,
+		},
+	},
+	[C(L1I)] = {
+		[C(OP_READ)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_L1_INST,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_L1_INST_MISS,
+		},
+		[C(OP_WRITE)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_L1_INST,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_L1_INST_MISS,
+		},
+		[C(OP_PREFETCH)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = CACHE_OP_UNSUPPORTED,
+		},
+	},
+	[C(LL)] = {
+		[C(OP_READ)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_L2_ACCESS,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_L2_CACH_MISS,
+		},
+		[C(OP_WRITE)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_L2_ACCESS,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_L2_CACH_MISS,
+		},
+		[C(OP_PREFETCH)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = CACHE_OP_UNSUPPORTED,
+		},
+	},
+	[C(DTLB)] = {
+		[C(OP_READ)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_DTLB_REFILL,
+		},
+		[C(OP_WRITE)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_DTLB_REFILL,
+		},
+		[C(OP_PREFETCH)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = CACHE_OP_UNSUPPORTED,
+		},
+	},
+	[C(ITLB)] = {
+		[C(OP_READ)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_ITLB_MISS,
+		},
+		[C(OP_WRITE)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_ITLB_MISS,
+		},
+		[C(OP_PREFETCH)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = CACHE_OP_UNSUPPORTED,
+		},
+	},
+	[C(BPU)] = {
+		[C(OP_READ)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_PC_WRITE,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_PC_BRANCH_MIS_PRED,
+		},
+		[C(OP_WRITE)] = {
+			[C(RESULT_ACCESS)]  = ARMV7_PERFCTR_PC_WRITE,
+			[C(RESULT_MISS)]    = ARMV7_PERFCTR_PC_BRANCH_MIS_PRED,
+		},
+		[C(OP_PREFETCH)] = {
+			[C(RESULT_ACCESS)]  = CACHE_OP_UNSUPPORTED,
+			[C(RESULT_MISS)]    = CACHE_OP_UNSUPPORTED,
+		},
+	},
+};
+
+struct cpu_hw_events {
+	/* the events scheduled on each counter */
+	struct perf_event	*events[ARMV7_MAX_COUNTERS];
+
+	/* counters handed out to events */
+	unsigned long		used_mask[BITS_TO_LONGS(ARMV7_MAX_COUNTERS)];
+
+	/* counters that are counting and may interrupt */
+	unsigned long		active_mask[BITS_TO_LONGS(ARMV7_MAX_COUNTERS)];
+};
+static DEFINE_PER_CPU(struct cpu_hw_events, cpu_hw_events);
+
+/* counters the CPU has, including the cycle counter; 0 without a PMU */
+static int armv7_num_counters;
+
+static const struct pmu_irqs *pmu_irqs;
+
+/* events holding the counters, the PMU is reserved while it is non-zero */
+static atomic_t active_events = ATOMIC_INIT(0);
+static DEFINE_MUTEX(pmu_reserve_mutex);
+
+/* serialises counter selection against the overflow handler */
+static DEFINE_SPINLOCK(pmu_lock);
+
+static const struct pmu pmu;
+
+static inline u32 armv7_pmnc_read(void)
+{
+	u32 val;
+
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r" (val));
+	return val;
+}
+
+static inline void armv7_pmnc_write(u32 val)
+{
+	val &= ARMV7_PMNC_MASK;
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" : : "r" (val));
+}
+
+static inline u32 armv7_counter_bit(int idx)
+{
+	return idx == ARMV7_CYCLE_COUNTER ? ARMV7_CCNT_BIT :
+		1 << (idx - ARMV7_COUNTER0);
+}
+
+static inline void armv7_select_counter(int idx)
+{
+	u32 val = idx - ARMV7_COUNTER0;
+
+	asm volatile("mcr p15, 0, %0, c9, c12, 5" : : "r" (val));
+	isb();
+}
+
+static inline u32 armv7pmu_read_counter(int idx)
+{
+	u32 val;
+
+	if (idx == ARMV7_CYCLE_COUNTER) {
+		asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r" (val));
+	} else {
+		armv7_select_counter(idx);
+		asm volatile("mrc p15, 0, %0, c9, c13, 2" : "=r" (val));
+	}
+
+	return val;
+}
+
+static inline void armv7pmu_write_counter(int idx, u32 val)
+{
+	if (idx == ARMV7_CYCLE_COUNTER) {
+		asm volatile("mcr p15, 0, %0, c9, c13, 0" : : "r" (val));
+	} else {
+		armv7_select_counter(idx);
+		asm volatile("mcr p15, 0, %0, c9, c13, 2" : : "r" (val));
+	}
+}
+
+static inline void armv7pmu_write_evtsel(int idx, u32 val)
+{
+	armv7_select_counter(idx);
+	val &= ARMV7_EVTSEL_MASK;
+	asm volatile("mcr p15, 0, %0, c9, c13, 1" : : "r" (val));
+}
+
+static inline void armv7pmu_enable_counter(int idx)
+{
+	u32 val = armv7_counter_bit(idx);
+
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" : : "r" (val));
+}
+
+static inline void armv7pmu_disable_counter(int idx)
+{
+	u32 val = armv7_counter_bit(idx);
+
+	asm volatile("mcr p15, 0, %0, c9, c12, 2" : : "r" (val));
+}
+
+static inline void armv7pmu_enable_intens(int idx)
+{
+	u32 val = armv7_counter_bit(idx);
+
+	asm volatile("mcr p15, 0, %0, c9, c14, 1" : : "r" (val));
+}
+
+static inline void armv7pmu_disable_intens(int idx)
+{
+	u32 val = armv7_counter_bit(idx);
+
+	asm volatile("mcr p15, 0, %0, c9, c14, 2" : : "r" (val));
+}
+
+static inline u32 armv7pmu_getreset_flags(void)
+{
+	u32 val;
+
+	asm volatile("mrc p15, 0, %0, c9, c12, 3" : "=r" (val));
+
+	/* write back to clear the flags we are about to handle */
+	val &= ARMV7_CNT_MASK;
+	asm volatile("mcr p15, 0, %0, c9, c12, 3" : : "r" (val));
+
+	return val;
+}
+
+static void armv7pmu_enable_event(struct hw_perf_event *hwc, int idx)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pmu_lock, flags);
+
+	/*
+	 * Stop the counter while it is set up, so it does not count the
+	 * old event in the meantime.
+	 */
+	armv7pmu_disable_counter(idx);
+	if (idx != ARMV7_CYCLE_COUNTER)
+		armv7pmu_write_evtsel(idx, hwc->config_base);
+	armv7pmu_enable_intens(idx);
+	armv7pmu_enable_counter(idx);
+
+	spin_unlock_irqrestore(&pmu_lock, flags);
+}
+
+static void armv7pmu_disable_event(struct hw_perf_event *hwc, int idx)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pmu_lock, flags);
+	armv7pmu_disable_counter(idx);
+	armv7pmu_disable_intens(idx);
+	spin_unlock_irqrestore(&pmu_lock, flags);
+}
+
+static int armv7pmu_get_event_idx(struct cpu_hw_events *cpuc,
+				  struct hw_perf_event *hwc)
+{
+	int idx;
+
+	/* the cycle counter counts nothing else */
+	if (hwc->config_base == ARMV7_PERFCTR_CPU_CYCLES) {
+		if (test_and_set_bit(ARMV7_CYCLE_COUNTER, cpuc->used_mask))
+			return -EAGAIN;
+		return ARMV7_CYCLE_COUNTER;
+	}
+
+	for (idx = ARMV7_COUNTER0; idx < armv7_num_counters; idx++)
+		if (!test_and_set_bit(idx, cpuc->used_mask))
+			return idx;
+
+	return -EAGAIN;
+}
+
+/*
+ * Set the counter up to overflow after the rest of the sample period.
+ * Returns 1 when a new period was started, i.e. a sample is due.
+ */
+static int armpmu_event_set_period(struct perf_event *event,
+				   struct hw_perf_event *hwc, int idx)
+{
+	s64 left = atomic64_read(&hwc->period_left);
+	s64 period = hwc->sample_period;
+	int ret = 0;
+
+	if (unlikely(left <= -period)) {
+		left = period;
+		atomic64_set(&hwc->period_left, left);
+		hwc->last_period = period;
+		ret = 1;
+	}
+
+	if (unlikely(left <= 0)) {
+		left += period;
+		atomic64_set(&hwc->period_left, left);
+		hwc->last_period = period;
+		ret = 1;
+	}
+
+	if (left > (s64)ARMV7_MAX_PERIOD)
+		left = ARMV7_MAX_PERIOD;
+
+	atomic64_set(&hwc->prev_count, (u64)-left);
+
+	armv7pmu_write_counter(idx, (u64)(-left) & 0xffffffff);
+
+	perf_event_update_userpage(event);
+
+	return ret;
+}
+
+/* fold what the counter counted since the last update into the event */
+static u64 armpmu_event_update(struct perf_event *event,
+			       struct hw_perf_event *hwc, int idx)
+{
+	u64 prev_raw_count, new_raw_count, delta;
+
+again:
+	prev_raw_count = atomic64_read(&hwc->prev_count);
+	new_raw_count = armv7pmu_read_counter(idx);
+
+	if (atomic64_cmpxchg(&hwc->prev_count, prev_raw_count,
+			     new_raw_count) != prev_raw_count)
+		goto again;
+
+	delta = (new_raw_count - prev_raw_count) & 0xffffffff;
+
+	atomic64_add(delta, &event->count);
+	atomic64_sub(delta, &hwc->period_left);
+
+	return new_raw_count;
+}
+
+static int armpmu_enable(struct perf_event *event)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	struct hw_perf_event *hwc = &event->hw;
+	int idx;
+
+	idx = armv7pmu_get_event_idx(cpuc, hwc);
+	if (idx < 0)
+		return idx;
+
+	/* the counter may have been left running by its previous user */
+	armv7pmu_disable_event(hwc, idx);
+	cpuc->events[idx] = event;
+	set_bit(idx, cpuc->active_mask);
+
+	hwc->idx = idx;
+	armpmu_event_set_period(event, hwc, idx);
+	armv7pmu_enable_event(hwc, idx);
+
+	perf_event_update_userpage(event);
+
+	return 0;
+}
+
+static void armpmu_disable(struct perf_event *event)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	struct hw_perf_event *hwc = &event->hw;
+	int idx = hwc->idx;
+
+	WARN_ON(idx < 0);
+
+	clear_bit(idx, cpuc->active_mask);
+	armv7pmu_disable_event(hwc, idx);
+
+	armpmu_event_update(event, hwc, idx);
+	cpuc->events[idx] = NULL;
+	clear_bit(idx, cpuc->used_mask);
+
+	perf_event_update_userpage(event);
+}
+
+static void armpmu_read(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	/* don't read disabled counters */
+	if (hwc->idx < 0)
+		return;
+
+	armpmu_event_update(event, hwc, hwc->idx);
+}
+
+static void armpmu_unthrottle(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	/*
+	 * The counter kept counting while the event was throttled, so
+	 * start the period again or it overflows right away.
+	 */
+	armpmu_event_set_period(event, hwc, hwc->idx);
+	armv7pmu_enable_event(hwc, hwc->idx);
+}
+
+static const struct pmu pmu = {
+	.enable		= armpmu_enable,
+	.disable	= armpmu_disable,
+	.unthrottle	= armpmu_unthrottle,
+	.read		= armpmu_read,
+};
+
+static irqreturn_t armv7pmu_handle_irq(int irq_num, void *dev)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	struct perf_sample_data data;
+	struct pt_regs *regs;
+	u32 pmnc;
+	int idx;
+
+	pmnc = armv7pmu_getreset_flags();
+	if (!pmnc)
+		return IRQ_NONE;
+
+	regs = get_irq_regs();
+
+	data.addr = 0;
+
+	for (idx = 0; idx < armv7_num_counters; idx++) {
+		struct perf_event *event = cpuc->events[idx];
+		struct hw_perf_event *hwc;
+
+		if (!test_bit(idx, cpuc->active_mask))
+			continue;
+
+		if (!(pmnc & armv7_counter_bit(idx)))
+			continue;
+
+		hwc = &event->hw;
+		armpmu_event_update(event, hwc, idx);
+		data.period = event->hw.last_period;
+		if (!armpmu_event_set_period(event, hwc, idx))
+			continue;
+
+		if (perf_event_overflow(event, 0, &data, regs))
+			armv7pmu_disable_event(hwc, idx);
+	}
+
+	/*
+	 * Handle the pending perf events now: there is no way to raise a
+	 * separate interrupt for them.
+	 */
+	perf_event_do_pending();
+
+	return IRQ_HANDLED;
+}
+
+void
+hw_perf_enable(void)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+
+	/* the counters may belong to oprofile */
+	if (!atomic_read(&active_events))
+		return;
+
+	if (cpuc->active_mask[0])
+		armv7_pmnc_write(armv7_pmnc_read() | ARMV7_PMNC_E);
+}
+
+void
+hw_perf_disable(void)
+{
+	if (!atomic_read(&active_events))
+		return;
+
+	armv7_pmnc_write(armv7_pmnc_read() & ~ARMV7_PMNC_E);
+}
+
+static int
+armpmu_reserve_hardware(void)
+{
+	int i, err;
+
+	pmu_irqs = reserve_pmu();
+	if (IS_ERR(pmu_irqs)) {
+		pr_warning("unable to reserve pmu\n");
+		return PTR_ERR(pmu_irqs);
+	}
+
+	/* without the overflow interrupt the counts would wrap */
+	if (pmu_irqs->num_irqs < 1) {
+		pr_err("no irqs for PMUs defined\n");
+		release_pmu(pmu_irqs);
+		pmu_irqs = NULL;
+		return -ENODEV;
+	}
+
+	for (i = 0; i < pmu_irqs->num_irqs; ++i) {
+		err = request_irq(pmu_irqs->irqs[i], armv7pmu_handle_irq,
+				  IRQF_DISABLED, "armpmu", NULL);
+		if (err) {
+			pr_warning("unable to request IRQ%d for ARM perf "
+				   "counters\n", pmu_irqs->irqs[i]);
+			break;
+		}
+	}
+
+	if (err) {
+		while (--i >= 0)
+			free_irq(pmu_irqs->irqs[i], NULL);
+		release_pmu(pmu_irqs);
+		pmu_irqs = NULL;
+		return err;
+	}
+
+	/* start from a clean slate: counters stopped and reset */
+	armv7_pmnc_write(ARMV7_PMNC_P | ARMV7_PMNC_C);
+	for (i = 0; i < armv7_num_counters; i++) {
+		armv7pmu_disable_counter(i);
+		armv7pmu_disable_intens(i);
+	}
+	armv7pmu_getreset_flags();
+
+	return 0;
+}
+
+static void
+armpmu_release_hardware(void)
+{
+	int i;
+
+	armv7_pmnc_write(armv7_pmnc_read() & ~ARMV7_PMNC_E);
+
+	for (i = pmu_irqs->num_irqs - 1; i >= 0; --i)
+		free_irq(pmu_irqs->irqs[i], NULL);
+
+	release_pmu(pmu_irqs);
+	pmu_irqs = NULL;
+}
+
+static void
+hw_perf_event_destroy(struct perf_event *event)
+{
+	if (atomic_dec_and_mutex_lock(&active_events, &pmu_reserve_mutex)) {
+		armpmu_release_hardware();
+		mutex_unlock(&pmu_reserve_mutex);
+	}
+}
+
+static int
+armpmu_map_cache_event(u64 config)
+{
+	unsigned int cache_type, cache_op, cache_result, ret;
+
+	cache_type = (config >>  0) & 0xff;
+	if (cache_type >= PERF_COUNT_HW_CACHE_MAX)
+		return -EINVAL;
+
+	cache_op = (config >>  8) & 0xff;
+	if (cache_op >= PERF_COUNT_HW_CACHE_OP_MAX)
+		return -EINVAL;
+
+	cache_result = (config >> 16) & 0xff;
+	if (cache_result >= PERF_COUNT_HW_CACHE_RESULT_MAX)
+		return -EINVAL;
+
+	ret = armv7_a8_perf_cache_map[cache_type][cache_op][cache_result];
+
+	if (ret == CACHE_OP_UNSUPPORTED)
+		return -ENOENT;
+
+	return ret;
+}
+
+static int
+armpmu_map_event(u64 config)
+{
+	int mapping;
+
+	if (config >= PERF_COUNT_HW_MAX)
+		return -EINVAL;
+
+	mapping = armv7_a8_perf_map[config];
+	return mapping == HW_OP_UNSUPPORTED ? -ENOENT : mapping;
+}
+
+static int
+validate_event(struct cpu_hw_events *cpuc, struct perf_event *event)
+{
+	if (is_software_event(event))
+		return 1;
+
+	return armv7pmu_get_event_idx(cpuc, &event->hw) >= 0;
+}
+
+/* check that the whole group can be on the counters at the same time */
+static int
+validate_group(struct perf_event *event)
+{
+	struct perf_event *sibling, *leader = event->group_leader;
+	struct cpu_hw_events fake_pmu;
+
+	memset(&fake_pmu, 0, sizeof(fake_pmu));
+
+	if (!validate_event(&fake_pmu, leader))
+		return -ENOSPC;
+
+	list_for_each_entry(sibling, &leader->sibling_list, group_entry) {
+		if (!validate_event(&fake_pmu, sibling))
+			return -ENOSPC;
+	}
+
+	if (!validate_event(&fake_pmu, event))
+		return -ENOSPC;
+
+	return 0;
+}
+
+static int
+__hw_perf_event_init(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	int mapping, err;
+
+	/* decode the generic type into an ARM event identifier */
+	if (PERF_TYPE_HARDWARE == event->attr.type) {
+		mapping = armpmu_map_event(event->attr.config);
+	} else if (PERF_TYPE_HW_CACHE == event->attr.type) {
+		mapping = armpmu_map_cache_event(event->attr.config);
+	} else if (PERF_TYPE_RAW == event->attr.type) {
+		mapping = event->attr.config & ARMV7_EVTSEL_MASK;
+	} else {
+		pr_debug("event type %x not supported\n", event->attr.type);
+		return -EOPNOTSUPP;
+	}
+
+	if (mapping < 0) {
+		pr_debug("event %x:%llx not supported\n", event->attr.type,
+			 event->attr.config);
+		return mapping;
+	}
+
+	/*
+	 * The counters count in every mode. There is no hypervisor to
+	 * exclude, so exclude_hv means nothing and is ignored.
+	 */
+	if (event->attr.exclude_user || event->attr.exclude_kernel) {
+		pr_debug("ARM performance counters do not support "
+			 "mode exclusion\n");
+		return -EPERM;
+	}
+
+	/* scheduling picks the counter */
+	hwc->idx = -1;
+	hwc->config_base = mapping;
+	hwc->config = 0;
+	hwc->event_base = 0;
+
+	if (!hwc->sample_period) {
+		hwc->sample_period  = ARMV7_MAX_PERIOD;
+		hwc->last_period    = hwc->sample_period;
+		atomic64_set(&hwc->period_left, hwc->sample_period);
+	}
+
+	err = 0;
+	if (event->group_leader != event) {
+		err = validate_group(event);
+		if (err)
+			return -EINVAL;
+	}
+
+	return err;
+}
+
+const struct pmu *
+hw_perf_event_init(struct perf_event *event)
+{
+	int err = 0;
+
+	/* no PMU, or none we know: software events only */
+	if (!armv7_num_counters)
+		return ERR_PTR(-ENODEV);
+
+	event->destroy = hw_perf_event_destroy;
+
+	if (!atomic_inc_not_zero(&active_events)) {
+		mutex_lock(&pmu_reserve_mutex);
+		if (atomic_read(&active_events) == 0)
+			err = armpmu_reserve_hardware();
+
+		if (!err)
+			atomic_inc(&active_events);
+		mutex_unlock(&pmu_reserve_mutex);
+	}
+
+	if (err)
+		return ERR_PTR(err);
+
+	err = __hw_perf_event_init(event);
+	if (err)
+		hw_perf_event_destroy(event);
+
+	return err ? ERR_PTR(err) : &pmu;
+}
+
+/*
+ * QEMU reports a Cortex-A8 but does not model its performance monitors,
+ * so the first access to them is an undefined instruction. Catch it
+ * instead of oopsing and stay with software events.
+ */
+static int __initdata pmu_undefined;
+
+static int __init armv7pmu_undef(struct pt_regs *regs, unsigned int instr)
+{
+	pmu_undefined = 1;
+	regs->ARM_pc += 4;
+	return 0;
+}
+
+static struct undef_hook armv7pmu_undef_hook __initdata = {
+	.instr_mask	= 0x0fff0fff,
+	.instr_val	= 0x0e190f1c,	/* mrc p15, 0, rX, c9, c12, 0 */
+	.cpsr_mask	= MODE_MASK | PSR_T_BIT,
+	.cpsr_val	= SVC_MODE,
+	.fn		= armv7pmu_undef,
+};
+
+static int __init
+armv7pmu_probe(void)
+{
+	u32 pmnc = 0;
+
+	register_undef_hook(&armv7pmu_undef_hook);
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmnc) : : "memory");
+	unregister_undef_hook(&armv7pmu_undef_hook);
+
+	if (pmu_undefined)
+		return 0;
+
+	/* the event counters, plus the cycle counter */
+	return min(((pmnc >> ARMV7_PMNC_N_SHIFT) & ARMV7_PMNC_N_MASK) + 1,
+		   (u32)ARMV7_MAX_COUNTERS);
+}
+
+static int __init
+init_hw_perf_events(void)
+{
+	unsigned long cpuid = read_cpuid_id();
+	unsigned long implementor = (cpuid & 0xFF000000) >> 24;
+	unsigned long part_number = (cpuid & 0xFFF0);
+
+	/* ARM Ltd Cortex-A8 */
+	if (implementor != 0x41 || part_number != 0xC080) {
+		pr_info("no hardware support available\n");
+		return 0;
+	}
+
+	armv7_num_counters = armv7pmu_probe();
+	if (!armv7_num_counters) {
+		pr_info("Cortex-A8 performance monitors not accessible, "
+			"using software events only\n");
+		return 0;
+	}
+
+	pr_info("enabled with ARMv7 Cortex-A8 PMU driver, "
+		"%d counters available\n", armv7_num_counters);
+
+	return 0;
+}
+arch_initcall(init_hw_perf_events);
+
+/*
+ * Callchain handling code.
+ */
+static inline void
+callchain_store(struct perf_callchain_entry *entry,
+		u64 ip)
+{
+	if (entry->nr < PERF_MAX_STACK_DEPTH)
+		entry->ip[entry->nr++] = ip;
+}
+
+/*
+ * The registers we're interested in are at the end of the variable
+ * length saved register structure. The fp points at the end of this
+ * structure so the address of this struct is:
+ * (struct frame_tail *)(xxx->fp)-1
+ *
+ * This code has been adapted from the ARM OProfile support.
+ */
+struct frame_tail {
+	struct frame_tail   *fp;
+	unsigned long	    sp;
+	unsigned long	    lr;
+} __attribute__((packed));
+
+/*
+ * Get the return address for a single stackframe and return a pointer to the
+ * next frame tail.
+ */
+static struct frame_tail *
+user_backtrace(struct frame_tail *tail,
+	       struct perf_callchain_entry *entry)
+{
+	struct frame_tail buftail;
+	unsigned long n;
+
+	/* Also check accessibility of one struct frame_tail beyond */
+	if (!access_ok(VERIFY_READ, tail, sizeof(buftail)))
+		return NULL;
+
+	pagefault_disable();
+	n = __copy_from_user_inatomic(&buftail, tail, sizeof(buftail));
+	pagefault_enable();
+	if (n)
+		return NULL;
+
+	callchain_store(entry, buftail.lr);
+
+	/*
+	 * Frame pointers should strictly progress back up the stack
+	 * (towards higher addresses).
+	 */
+	if (tail >= buftail.fp)
+		return NULL;
+
+	return buftail.fp - 1;
+}
+
+static void
+perf_callchain_user(struct pt_regs *regs,
+		    struct perf_callchain_entry *entry)
+{
+	struct frame_tail *tail;
+
+	callchain_store(entry, PERF_CONTEXT_USER);
+	callchain_store(entry, regs->ARM_pc);
+
+	tail = (struct frame_tail *)regs->ARM_fp - 1;
+
+	while (tail && !((unsigned long)tail & 0x3) &&
+	       entry->nr < PERF_MAX_STACK_DEPTH)
+		tail = user_backtrace(tail, entry);
+}
+
+/*
+ * Gets called by walk_stackframe() for every stackframe. This will be called
+ * whist unwinding the stackframe and is like a subroutine return so we use
+ * the PC.
+ */
+static int
+callchain_trace(struct stackframe *fr,
+		void *data)
+{
+	struct perf_callchain_entry *entry = data;
+
+	callchain_store(entry, fr->pc);
+	return entry->nr >= PERF_MAX_STACK_DEPTH;
+}
+
+/*
+ * walk_stackframe() follows the unwind tables with CONFIG_ARM_UNWIND and
+ * the frame pointers otherwise.
+ */
+static void
+perf_callchain_kernel(struct pt_regs *regs,
+		      struct perf_callchain_entry *entry)
+{
+	struct stackframe fr;
+
+	callchain_store(entry, PERF_CONTEXT_KERNEL);
+	fr.fp = regs->ARM_fp;
+	fr.sp = regs->ARM_sp;
+	fr.lr = regs->ARM_lr;
+	fr.pc = regs->ARM_pc;
+	walk_stackframe(&fr, callchain_trace, entry);
+}
+
+static void
+perf_do_callchain(struct pt_regs *regs,
+		  struct perf_callchain_entry *entry)
+{
+	int is_user;
+
+	if (!regs)
+		return;
+
+	is_user = user_mode(regs);
+
+	if (!current || !current->pid)
+		return;
+
+	if (is_user && current->state != TASK_RUNNING)
+		return;
+
+	if (!is_user)
+		perf_callchain_kernel(regs, entry);
+
+	if (current->mm)
+		perf_callchain_user(task_pt_regs(current), entry);
+}
+
+/*
+ * A software event in task context can be interrupted by a counter
+ * overflow that records a callchain too, so each gets its own buffer.
+ */
+static DEFINE_PER_CPU(struct perf_callchain_entry, pmc_irq_entry);
+static DEFINE_PER_CPU(struct perf_callchain_entry, pmc_task_entry);
+
+struct perf_callchain_entry *
+perf_callchain(struct pt_regs *regs)
+{
+	struct perf_callchain_entry *entry;
+
+	if (in_irq())
+		entry = &__get_cpu_var(pmc_irq_entry);
+	else
+		entry = &__get_cpu_var(pmc_task_entry);
+
+	entry->nr = 0;
+
+	perf_do_callchain(regs, entry);
+
+	return entry;
+}
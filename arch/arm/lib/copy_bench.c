@@ -0,0 +1,395 @@
+/*
+ *  linux/arch/arm/lib/copy_bench.c
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loading the module checks memcpy(), copy_from_user() and
+ * copy_to_user() over a range of sizes and alignments, including a user
+ * copy running into an unmapped page, and then times them and
+ * copy_page():
+ *
+ *   insmod copy_bench.ko max_size=1048576 megabytes=32
+ *   rmmod copy_bench
+ *
+ * Each line gives the size, the offsets of the destination and the
+ * source from a cache line boundary, and the bandwidth in MB/s. Sizes
+ * above the L2 cache show the memory bandwidth. With CONFIG_NEON_COPY,
+ * echo 0 > /sys/module/memcpy_neon/parameters/enable before loading the
+ * module times the ARM routines instead.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+static unsigned int max_size = 1 << 20;
+module_param(max_size, uint, S_IRUGO);
+MODULE_PARM_DESC(max_size, "Largest copy timed, in bytes");
+
+static unsigned int megabytes = 32;
+module_param(megabytes, uint, S_IRUGO);
+MODULE_PARM_DESC(megabytes, "Data moved for each size and alignment");
+
+/* cache line offsets of the destination and the source */
+static const unsigned int offsets[][2] = {
+	{ 0, 0 }, { 0, 4 }, { 4, 0 }, { 0, 1 }, { 1, 0 }, { 3, 13 },
+};
+
+/* sizes checked: around the block and alignment sizes of the routines */
+static const unsigned int check_sizes[] = {
+	0, 1, 3, 15, 31, 32, 63, 64, 65, 127, 128, 129, 255, 256, 1000,
+	1023, 1024, 1025, 1088, 2047, 4096, 4163, 8192 + 7,
+};
+
+#define BENCH_SLACK	64	/* room for the offsets and the guard bytes */
+#define CHECK_SIZE	16384	/* buffer needed by the self-test */
+#define GUARD		0x5a
+
+enum copy_op {
+	OP_MEMCPY,
+	OP_FROM_USER,
+	OP_TO_USER,
+};
+
+static const char * const op_names[] = {
+	[OP_MEMCPY]	= "memcpy",
+	[OP_FROM_USER]	= "copy_from_user",
+	[OP_TO_USER]	= "copy_to_user",
+};
+
+struct bench_bufs {
+	u8 *src;
+	u8 *dst;
+	u8 __user *user;
+	unsigned long len;
+};
+
+static void fill(u8 *p, unsigned long n, unsigned int seed)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		p[i] = (u8)(seed + i * 7 + (i >> 8));
+}
+
+static int check_bytes(const u8 *p, const u8 *expect, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		if (p[i] != expect[i])
+			return -EIO;
+	return 0;
+}
+
+static int check_guard(const u8 *p, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		if (p[i] != GUARD)
+			return -EIO;
+	return 0;
+}
+
+/* compare user memory with expect, without using the routines tested */
+static int check_user(const u8 __user *p, const u8 *expect, unsigned long n)
+{
+	unsigned long i;
+	u8 c;
+
+	for (i = 0; i < n; i++) {
+		if (get_user(c, p + i))
+			return -EFAULT;
+		if (c != expect[i])
+			return -EIO;
+	}
+	return 0;
+}
+
+static int clear_user_guard(u8 __user *p, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		if (put_user(GUARD, p + i))
+			return -EFAULT;
+	return 0;
+}
+
+static int check_one(struct bench_bufs *b, enum copy_op op,
+		     unsigned int size, unsigned int doff, unsigned int soff)
+{
+	u8 *dst = b->dst + doff + 16;
+	u8 *src = b->src + soff;
+	unsigned long left;
+
+	fill(b->src, size + soff + 16, size + soff);
+
+	if (op == OP_TO_USER) {
+		u8 __user *udst = b->user + doff + 16;
+
+		if (clear_user_guard(b->user, size + doff + 32))
+			return -EFAULT;
+		left = copy_to_user(udst, src, size);
+		if (left)
+			return -EFAULT;
+		if (check_user(udst, src, size))
+			return -EIO;
+		memset(b->dst, GUARD, 16);
+		if (check_user(udst - 16, b->dst, 16) ||
+		    check_user(udst + size, b->dst, 16))
+			return -EIO;
+		return 0;
+	}
+
+	memset(b->dst, GUARD, size + doff + 32);
+
+	if (op == OP_FROM_USER) {
+		u8 __user *usrc = b->user + soff;
+		unsigned long i;
+
+		for (i = 0; i < size; i++)
+			if (put_user(src[i], usrc + i))
+				return -EFAULT;
+		left = copy_from_user(dst, usrc, size);
+		if (left)
+			return -EFAULT;
+	} else {
+		memcpy(dst, src, size);
+	}
+
+	if (check_bytes(dst, src, size) || check_guard(dst - 16, 16) ||
+	    check_guard(dst + size, 16))
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * A user copy running into an unmapped page must stop there, report the
+ * bytes it did not copy and, from user space, clear the rest of the
+ * kernel buffer.
+ */
+static int check_fault(struct bench_bufs *b)
+{
+	u8 __user *hole = b->user + b->len - PAGE_SIZE;
+	unsigned long size = 3 * 1024, before = 1000, left;
+	int ret;
+
+	down_write(&current->mm->mmap_sem);
+	ret = do_munmap(current->mm, (unsigned long)hole, PAGE_SIZE);
+	up_write(&current->mm->mmap_sem);
+	if (ret)
+		return ret;
+
+	fill(b->src, size, 1);
+	memset(b->dst, GUARD, size);
+	left = copy_to_user(hole - before, b->src, size);
+	if (left != size - before)
+		return -EIO;
+	if (check_user(hole - before, b->src, before))
+		return -EIO;
+
+	left = copy_from_user(b->dst, hole - before, size);
+	if (left != size - before)
+		return -EIO;
+	if (check_bytes(b->dst, b->src, before))
+		return -EIO;
+	memset(b->src, 0, size);
+	if (check_bytes(b->dst + before, b->src, size - before))
+		return -EIO;
+
+	return 0;
+}
+
+static int copy_selftest(struct bench_bufs *b)
+{
+	enum copy_op op;
+	unsigned int i, doff, soff, size;
+	int ret;
+
+	for (op = OP_MEMCPY; op <= OP_TO_USER; op++) {
+		for (i = 0; i < ARRAY_SIZE(check_sizes); i++) {
+			size = check_sizes[i];
+			for (doff = 0; doff < 16; doff++) {
+				for (soff = 0; soff < 16; soff++) {
+					/* user copies are slow to check */
+					if (op != OP_MEMCPY &&
+					    soff != ((doff * 5) & 15))
+						continue;
+
+					ret = check_one(b, op, size, doff,
+							soff);
+					if (ret) {
+						printk(KERN_ERR "copy_bench: "
+						       "%s of %u bytes, "
+						       "+%u/+%u failed\n",
+						       op_names[op], size,
+						       doff, soff);
+						return ret;
+					}
+				}
+			}
+		}
+	}
+
+	ret = check_fault(b);
+	if (ret)
+		printk(KERN_ERR "copy_bench: user copy across an unmapped "
+		       "page failed\n");
+
+	return ret;
+}
+
+static void bench_report(const char *name, unsigned int size,
+			 unsigned int doff, unsigned int soff, u64 bytes,
+			 ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	/* bytes per microsecond are MB/s */
+	printk(KERN_INFO "copy_bench: %-14s %8u +%-2u/+%-2u %6llu MB/s\n",
+	       name, size, doff, soff, div_u64(bytes, max_t(s64, us, 1)));
+}
+
+static void bench_op(struct bench_bufs *b, enum copy_op op,
+		     unsigned int size, unsigned int doff, unsigned int soff)
+{
+	unsigned long loops = div_u64((u64)megabytes << 20, size) ?: 1;
+	unsigned long i, left = 0;
+	ktime_t start;
+
+	start = ktime_get();
+	switch (op) {
+	case OP_MEMCPY:
+		for (i = 0; i < loops; i++)
+			memcpy(b->dst + doff, b->src + soff, size);
+		break;
+	case OP_FROM_USER:
+		for (i = 0; i < loops; i++)
+			left |= copy_from_user(b->dst + doff, b->user + soff,
+					       size);
+		break;
+	case OP_TO_USER:
+		for (i = 0; i < loops; i++)
+			left |= copy_to_user(b->user + doff, b->src + soff,
+					     size);
+		break;
+	}
+	bench_report(op_names[op], size, doff, soff, (u64)loops * size,
+		     start);
+
+	if (left)
+		printk(KERN_ERR "copy_bench: %s faulted\n", op_names[op]);
+
+	cond_resched();
+}
+
+static void bench_copy_page(struct bench_bufs *b)
+{
+	unsigned long pages = b->len / PAGE_SIZE - 1;
+	unsigned long loops = ((unsigned long)megabytes << 20) / PAGE_SIZE;
+	unsigned long i;
+	ktime_t start;
+
+	/* the same page over and over: cache bandwidth */
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		copy_page(b->dst, b->src);
+	bench_report("copy_page", PAGE_SIZE, 0, 0, (u64)loops * PAGE_SIZE,
+		     start);
+
+	/* walking the buffers, as when breaking copy on write */
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		copy_page(b->dst + (i % pages) * PAGE_SIZE,
+			  b->src + (i % pages) * PAGE_SIZE);
+	bench_report("copy_page", b->len - PAGE_SIZE, 0, 0,
+		     (u64)loops * PAGE_SIZE, start);
+}
+
+static void copy_bench(struct bench_bufs *b)
+{
+	enum copy_op op;
+	unsigned int size, i;
+
+	for (op = OP_MEMCPY; op <= OP_TO_USER; op++)
+		for (size = 64; size <= max_size; size *= 4)
+			for (i = 0; i < ARRAY_SIZE(offsets); i++)
+				bench_op(b, op, size, offsets[i][0],
+					 offsets[i][1]);
+
+	bench_copy_page(b);
+}
+
+static int __init copy_bench_init(void)
+{
+	struct bench_bufs b;
+	unsigned long addr;
+	int ret = -ENOMEM;
+
+	if (max_size < PAGE_SIZE || !megabytes)
+		return -EINVAL;
+
+	/* whole pages, so the last one can be unmapped for check_fault() */
+	b.len = PAGE_ALIGN(max_t(unsigned int, max_size, CHECK_SIZE) +
+			   BENCH_SLACK) + PAGE_SIZE;
+
+	b.src = vmalloc(b.len);
+	b.dst = vmalloc(b.len);
+	if (!b.src || !b.dst)
+		goto free_bufs;
+	memset(b.src, 0, b.len);
+	memset(b.dst, 0, b.len);
+
+	/* insmod's address space stands in for a user buffer */
+	down_write(&current->mm->mmap_sem);
+	addr = do_mmap(NULL, 0, b.len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, 0);
+	up_write(&current->mm->mmap_sem);
+	if (IS_ERR_VALUE(addr)) {
+		ret = addr;
+		goto free_bufs;
+	}
+	b.user = (u8 __user *)addr;
+
+	if (clear_user(b.user, b.len)) {
+		ret = -EFAULT;
+		goto unmap;
+	}
+
+	ret = copy_selftest(&b);
+	if (ret == 0) {
+		printk(KERN_INFO "copy_bench: self-test passed\n");
+		copy_bench(&b);
+	}
+
+unmap:
+	down_write(&current->mm->mmap_sem);
+	do_munmap(current->mm, addr, b.len);
+	up_write(&current->mm->mmap_sem);
+free_bufs:
+	vfree(b.dst);
+	vfree(b.src);
+	return ret;
+}
+
+static void __exit copy_bench_exit(void)
+{
+}
+
+module_init(copy_bench_init);
+module_exit(copy_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Memory copy self-test and bandwidth benchmark");
@@ -0,0 +1,157 @@
+/*
+ *  linux/arch/arm/lib/memcpy_neon.c
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * memcpy(), copy_page(), __copy_from_user() and __copy_to_user() for
+ * CPUs with NEON. Large copies move the bulk of the data 64 bytes at a
+ * time through the NEON registers, preloading well ahead, which on the
+ * Cortex-A8 is faster than the LDM/STM loops. Small copies, copies on a
+ * CPU without NEON and copies from interrupt context or from inside
+ * another kernel_neon_begin() section, where the NEON registers may not
+ * be used, go to the ARM routines these override.
+ *
+ * memcpy_neon.enable=0 on the command line, or in
+ * /sys/module/memcpy_neon/parameters at run time, goes back to the ARM
+ * routines for everything, and memcpy_neon.min_size sets the smallest
+ * copy done with NEON.
+ */
+#include <linux/hardirq.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/uaccess.h>
+
+#include <asm/neon.h>
+#include <asm/page.h>
+
+extern void *__memcpy_arm(void *to, const void *from, size_t n);
+extern void __copy_page_arm(void *to, const void *from);
+extern unsigned long __copy_neon(void *to, const void *from, unsigned long n);
+
+static int enable = 1;
+module_param(enable, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(enable, "Use NEON for large copies");
+
+/*
+ * Saving the VFP state of its owner, and that thread trapping to reload
+ * it, costs about as much as copying a kilobyte.
+ */
+static unsigned int min_size = 1024;
+module_param(min_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(min_size, "Smallest copy done with NEON");
+
+/* NEON copies whole blocks, and stores to 16 byte aligned addresses */
+#define NEON_BLOCK	64
+#define NEON_ALIGN	16
+
+static inline int neon_copy_usable(unsigned long n)
+{
+	return n >= min_size && n >= 2 * NEON_BLOCK && enable &&
+		cpu_has_neon() && !in_interrupt() && !irqs_disabled() &&
+		!kernel_neon_in_use();
+}
+
+/* bytes to copy before the target is aligned for the NEON stores */
+static inline unsigned long neon_head(const void *to)
+{
+	return -(unsigned long)to & (NEON_ALIGN - 1);
+}
+
+void *memcpy(void *to, const void *from, size_t n)
+{
+	unsigned long head, bulk;
+
+	if (!neon_copy_usable(n))
+		return __memcpy_arm(to, from, n);
+
+	head = neon_head(to);
+	if (head)
+		__memcpy_arm(to, from, head);
+
+	bulk = (n - head) & ~(NEON_BLOCK - 1);
+
+	kernel_neon_begin();
+	__copy_neon(to + head, from + head, bulk);
+	kernel_neon_end();
+
+	head += bulk;
+	if (n > head)
+		__memcpy_arm(to + head, from + head, n - head);
+
+	return to;
+}
+
+void copy_page(void *to, const void *from)
+{
+	if (!neon_copy_usable(PAGE_SIZE)) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_neon(to, from, PAGE_SIZE);
+	kernel_neon_end();
+}
+
+/*
+ * Copy whole blocks to or from user space and return how many bytes
+ * were copied. Page faults cannot be handled with preemption disabled,
+ * so a fault ends the copy early and the caller finishes with the ARM
+ * routine, which faults the page in.
+ */
+static unsigned long neon_copy_user(void *to, const void *from,
+				    unsigned long n)
+{
+	unsigned long left;
+
+	n &= ~(NEON_BLOCK - 1);
+
+	kernel_neon_begin();
+	pagefault_disable();
+	left = __copy_neon(to, from, n);
+	pagefault_enable();
+	kernel_neon_end();
+
+	return n - left;
+}
+
+unsigned long
+__copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+	unsigned long done;
+
+	if (!neon_copy_usable(n))
+		return __copy_from_user_std(to, from, n);
+
+	/* on a fault the ARM routine also clears the rest of the buffer */
+	done = neon_head(to);
+	if (done && __copy_from_user_std(to, from, done))
+		return __copy_from_user_std(to, from, n);
+
+	done += neon_copy_user(to + done, (const void __force *)from + done,
+			       n - done);
+
+	return __copy_from_user_std(to + done, from + done, n - done);
+}
+
+unsigned long
+__copy_to_user(void __user *to, const void *from, unsigned long n)
+{
+	unsigned long done;
+
+	if (!neon_copy_usable(n))
+		return __copy_to_user_std(to, from, n);
+
+	done = neon_head((void __force *)to);
+	if (done && __copy_to_user_std(to, from, done))
+		return __copy_to_user_std(to, from, n);
+
+	done += neon_copy_user((void __force *)to + done, from + done,
+			       n - done);
+
+	return __copy_to_user_std(to + done, from + done, n - done);
+}
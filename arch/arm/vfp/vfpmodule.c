@@ -15,6 +15,9 @@
 #include <linux/sched.h>
 #include <linux/init.h>
 
+#include <linux/hardirq.h>
+
+#include <asm/neon.h>
 #include <asm/thread_notify.h>
 #include <asm/vfp.h>
 
@@ -442,6 +445,55 @@ out:
 }
 #endif
 
+#ifdef CONFIG_NEON
+/*
+ * Kernel-side NEON support functions. The kernel only uses NEON outside
+ * interrupt context and with preemption disabled, so its register
+ * contents never have to be preserved: the state of the thread owning
+ * the VFP is saved and the VFP left disabled again, which makes the
+ * owner reload it on its next VFP instruction. Sections do not nest,
+ * as the inner kernel_neon_end() would disable the VFP under the outer.
+ */
+DEFINE_PER_CPU(int, kernel_neon_busy);
+EXPORT_PER_CPU_SYMBOL_GPL(kernel_neon_busy);
+
+void kernel_neon_begin(void)
+{
+	unsigned int cpu;
+	u32 fpexc;
+
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+	BUG_ON(per_cpu(kernel_neon_busy, cpu));
+	per_cpu(kernel_neon_busy, cpu) = 1;
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	/*
+	 * Save the state of the last VFP user on this CPU, which under UP
+	 * need not be current.
+	 */
+	if (last_VFP_context[cpu]) {
+		vfp_save_state(last_VFP_context[cpu], fpexc);
+#ifdef CONFIG_SMP
+		last_VFP_context[cpu]->hard.cpu = cpu;
+#endif
+		last_VFP_context[cpu] = NULL;
+	}
+}
+EXPORT_SYMBOL_GPL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	/* disable the VFP again, so its next user traps and reloads it */
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	__get_cpu_var(kernel_neon_busy) = 0;
+	put_cpu();
+}
+EXPORT_SYMBOL_GPL(kernel_neon_end);
+#endif
+
 #include <linux/smp.h>
 
 /*
@@ -2862,16 +2862,16 @@ static struct cipher_testvec cast6_dec_tv_template[] = {
 /*
  * AES test vectors.
  */
-#define AES_ENC_TEST_VECTORS 3
-#define AES_DEC_TEST_VECTORS 3
-#define AES_CBC_ENC_TEST_VECTORS 4
-#define AES_CBC_DEC_TEST_VECTORS 4
+#define AES_ENC_TEST_VECTORS 4
+#define AES_DEC_TEST_VECTORS 4
+#define AES_CBC_ENC_TEST_VECTORS 5
+#define AES_CBC_DEC_TEST_VECTORS 5
 #define AES_LRW_ENC_TEST_VECTORS 8
 #define AES_LRW_DEC_TEST_VECTORS 8
 #define AES_XTS_ENC_TEST_VECTORS 4
 #define AES_XTS_DEC_TEST_VECTORS 4
-#define AES_CTR_ENC_TEST_VECTORS 3
-#define AES_CTR_DEC_TEST_VECTORS 3
+#define AES_CTR_ENC_TEST_VECTORS 4
+#define AES_CTR_DEC_TEST_VECTORS 4
 #define AES_CTR_3686_ENC_TEST_VECTORS 7
 #define AES_CTR_3686_DEC_TEST_VECTORS 6
 #define AES_GCM_ENC_TEST_VECTORS 9
@@ -2915,7 +2915,57 @@ static struct cipher_testvec aes_enc_tv_template[] = {
 		.result	= "\x8e\xa2\xb7\xca\x51\x67\x45\xbf"
 			  "\xea\xfc\x49\x90\x4b\x49\x60\x89",
 		.rlen	= 16,
-	},
+	}, { /* Ten blocks, split across pages, generated with OpenSSL */
+		.key	= "\xa0\xa7\xae\xb5\xbc\xc3\xca\xd1"
+			  "\xd8\xdf\xe6\xed\xf4\xfb\x02\x09"
+			  "\x10\x17\x1e\x25\x2c\x33\x3a\x41"
+			  "\x48\x4f\x56\x5d\x64\x6b\x72\x79",
+		.klen	= 32,
+		.input	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x42\x61\x7c\x9b\xb6\xd5\xf0\x0f"
+			  "\x29\x4a\x67\x80\x9d\xbe\xdb\xf4"
+			  "\x10\x33\x4e\x69\x84\xa7\xc2\xdd"
+			  "\xff\x1c\x31\x56\x6b\x88\xad\xc2"
+			  "\xe6\x05\x18\x3f\x52\x71\x94\xab"
+			  "\xcd\xee\x03\x24\x39\x5a\x7f\x90"
+			  "\xb4\xd7\xea\x0d\x20\x43\x66\x79"
+			  "\x93\xb0\xdd\xfa\x07\x24\x41\x6e"
+			  "\x8a\xa9\xb4\xd3\xfe\x1d\x38\x47"
+			  "\x61\x82\xaf\xc8\xd5\xf6\x13\x3c"
+			  "\x58\x7b\x86\xa1\xcc\xef\x0a\x15"
+			  "\x37\x54\x79\x9e\xa3\xc0\xe5\x0a"
+			  "\x2e\x4d\x50\x77\x9a\xb9\xdc\xe3"
+			  "\x05\x26\x4b\x6c\x71\x92\xb7\xd8"
+			  "\xfc\x1f\x22\x45\x68\x8b\xae\xb1"
+			  "\xcb\xe8\x05\x22\x5f\x7c\x99\xb6"
+			  "\xd2\xf1\xec\x0b\x26\x45\x60\x9f"
+			  "\xb9\xda\xf7\x10\x0d\x2e\x4b\x64"
+			  "\x80\xa3\xde\xf9\x14\x37\x52\x4d",
+		.ilen	= 160,
+		.result	= "\x76\xfe\x56\x58\xe9\x65\xba\xd7"
+			  "\xf8\xbc\xcb\xa1\x58\x33\x8a\xa4"
+			  "\x3e\xed\x50\x5f\x73\xb8\xdf\xbd"
+			  "\x54\x08\x2b\x3b\xbe\x53\xc3\x72"
+			  "\xd8\x15\x72\xdc\xaf\x65\x6c\x2c"
+			  "\x94\x50\x38\xc5\x91\x63\x14\x8e"
+			  "\xcc\x01\xf2\x19\xe4\x53\x84\xc4"
+			  "\x2c\x21\x7b\x8f\xf6\x13\x0d\x8c"
+			  "\x1a\xb7\x84\x7a\xe8\x6f\x8c\x99"
+			  "\x7e\x8a\x14\x82\x68\x0c\xd9\xd0"
+			  "\xb4\x8e\x55\xfe\xcc\xfb\x33\x95"
+			  "\xab\xf4\x45\xce\xc7\x89\x45\x2b"
+			  "\xd6\x22\xab\x9f\x72\x42\xc4\x6a"
+			  "\xc8\x69\xcb\x10\x4f\xfb\xcc\xbb"
+			  "\xb3\x2f\x1e\x3b\xaa\x7a\xe4\x88"
+			  "\x40\x99\xfe\xb1\x9e\x3e\x10\xc5"
+			  "\x11\x35\xb1\xec\x2e\x51\xe5\x35"
+			  "\x07\xec\x5c\x2c\xaf\xbe\xe8\x55"
+			  "\x47\x41\x6e\x79\x90\x07\x2f\x38"
+			  "\xfe\x27\x6d\xc1\x3a\xf4\xf2\x77",
+		.rlen	= 160,
+		.np	= 3,
+		.tap	= { 80, 48, 32 },
+	}
 };
 
 static struct cipher_testvec aes_dec_tv_template[] = {
@@ -2952,7 +3002,57 @@ static struct cipher_testvec aes_dec_tv_template[] = {
 		.result	= "\x00\x11\x22\x33\x44\x55\x66\x77"
 			  "\x88\x99\xaa\xbb\xcc\xdd\xee\xff",
 		.rlen	= 16,
-	},
+	}, { /* Ten blocks, split across pages, generated with OpenSSL */
+		.key	= "\xa0\xa7\xae\xb5\xbc\xc3\xca\xd1"
+			  "\xd8\xdf\xe6\xed\xf4\xfb\x02\x09"
+			  "\x10\x17\x1e\x25\x2c\x33\x3a\x41"
+			  "\x48\x4f\x56\x5d\x64\x6b\x72\x79",
+		.klen	= 32,
+		.input	= "\x76\xfe\x56\x58\xe9\x65\xba\xd7"
+			  "\xf8\xbc\xcb\xa1\x58\x33\x8a\xa4"
+			  "\x3e\xed\x50\x5f\x73\xb8\xdf\xbd"
+			  "\x54\x08\x2b\x3b\xbe\x53\xc3\x72"
+			  "\xd8\x15\x72\xdc\xaf\x65\x6c\x2c"
+			  "\x94\x50\x38\xc5\x91\x63\x14\x8e"
+			  "\xcc\x01\xf2\x19\xe4\x53\x84\xc4"
+			  "\x2c\x21\x7b\x8f\xf6\x13\x0d\x8c"
+			  "\x1a\xb7\x84\x7a\xe8\x6f\x8c\x99"
+			  "\x7e\x8a\x14\x82\x68\x0c\xd9\xd0"
+			  "\xb4\x8e\x55\xfe\xcc\xfb\x33\x95"
+			  "\xab\xf4\x45\xce\xc7\x89\x45\x2b"
+			  "\xd6\x22\xab\x9f\x72\x42\xc4\x6a"
+			  "\xc8\x69\xcb\x10\x4f\xfb\xcc\xbb"
+			  "\xb3\x2f\x1e\x3b\xaa\x7a\xe4\x88"
+			  "\x40\x99\xfe\xb1\x9e\x3e\x10\xc5"
+			  "\x11\x35\xb1\xec\x2e\x51\xe5\x35"
+			  "\x07\xec\x5c\x2c\xaf\xbe\xe8\x55"
+			  "\x47\x41\x6e\x79\x90\x07\x2f\x38"
+			  "\xfe\x27\x6d\xc1\x3a\xf4\xf2\x77",
+		.ilen	= 160,
+		.result	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x42\x61\x7c\x9b\xb6\xd5\xf0\x0f"
+			  "\x29\x4a\x67\x80\x9d\xbe\xdb\xf4"
+			  "\x10\x33\x4e\x69\x84\xa7\xc2\xdd"
+			  "\xff\x1c\x31\x56\x6b\x88\xad\xc2"
+			  "\xe6\x05\x18\x3f\x52\x71\x94\xab"
+			  "\xcd\xee\x03\x24\x39\x5a\x7f\x90"
+			  "\xb4\xd7\xea\x0d\x20\x43\x66\x79"
+			  "\x93\xb0\xdd\xfa\x07\x24\x41\x6e"
+			  "\x8a\xa9\xb4\xd3\xfe\x1d\x38\x47"
+			  "\x61\x82\xaf\xc8\xd5\xf6\x13\x3c"
+			  "\x58\x7b\x86\xa1\xcc\xef\x0a\x15"
+			  "\x37\x54\x79\x9e\xa3\xc0\xe5\x0a"
+			  "\x2e\x4d\x50\x77\x9a\xb9\xdc\xe3"
+			  "\x05\x26\x4b\x6c\x71\x92\xb7\xd8"
+			  "\xfc\x1f\x22\x45\x68\x8b\xae\xb1"
+			  "\xcb\xe8\x05\x22\x5f\x7c\x99\xb6"
+			  "\xd2\xf1\xec\x0b\x26\x45\x60\x9f"
+			  "\xb9\xda\xf7\x10\x0d\x2e\x4b\x64"
+			  "\x80\xa3\xde\xf9\x14\x37\x52\x4d",
+		.rlen	= 160,
+		.np	= 3,
+		.tap	= { 80, 48, 32 },
+	}
 };
 
 static struct cipher_testvec aes_cbc_enc_tv_template[] = {
@@ -3034,7 +3134,57 @@ static struct cipher_testvec aes_cbc_enc_tv_template[] = {
 			  "\xb2\xeb\x05\xe2\xc3\x9b\xe9\xfc"
 			  "\xda\x6c\x19\x07\x8c\x6a\x9d\x1b",
 		.rlen	= 64,
-	},
+	}, { /* Ten blocks, split across pages, generated with OpenSSL */
+		.key	= "\xa0\xa7\xae\xb5\xbc\xc3\xca\xd1"
+			  "\xd8\xdf\xe6\xed\xf4\xfb\x02\x09",
+		.klen	= 16,
+		.iv	= "\x30\x31\x32\x33\x34\x35\x36\x37"
+			  "\x38\x39\x3a\x3b\x3c\x3d\x3e\x3f",
+		.input	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x42\x61\x7c\x9b\xb6\xd5\xf0\x0f"
+			  "\x29\x4a\x67\x80\x9d\xbe\xdb\xf4"
+			  "\x10\x33\x4e\x69\x84\xa7\xc2\xdd"
+			  "\xff\x1c\x31\x56\x6b\x88\xad\xc2"
+			  "\xe6\x05\x18\x3f\x52\x71\x94\xab"
+			  "\xcd\xee\x03\x24\x39\x5a\x7f\x90"
+			  "\xb4\xd7\xea\x0d\x20\x43\x66\x79"
+			  "\x93\xb0\xdd\xfa\x07\x24\x41\x6e"
+			  "\x8a\xa9\xb4\xd3\xfe\x1d\x38\x47"
+			  "\x61\x82\xaf\xc8\xd5\xf6\x13\x3c"
+			  "\x58\x7b\x86\xa1\xcc\xef\x0a\x15"
+			  "\x37\x54\x79\x9e\xa3\xc0\xe5\x0a"
+			  "\x2e\x4d\x50\x77\x9a\xb9\xdc\xe3"
+			  "\x05\x26\x4b\x6c\x71\x92\xb7\xd8"
+			  "\xfc\x1f\x22\x45\x68\x8b\xae\xb1"
+			  "\xcb\xe8\x05\x22\x5f\x7c\x99\xb6"
+			  "\xd2\xf1\xec\x0b\x26\x45\x60\x9f"
+			  "\xb9\xda\xf7\x10\x0d\x2e\x4b\x64"
+			  "\x80\xa3\xde\xf9\x14\x37\x52\x4d",
+		.ilen	= 160,
+		.result	= "\x81\x2b\x55\x53\x7c\xbb\xbc\x3a"
+			  "\xe2\x04\xa8\x12\xbe\x5e\xd2\xb5"
+			  "\x91\x58\x61\x1f\xde\xb1\x01\xea"
+			  "\x63\x05\x0d\xfd\x21\x00\x29\x86"
+			  "\x9c\x11\xe3\x02\x4f\x49\x69\xf2"
+			  "\x70\x0c\xa8\xcb\x5e\xd5\x9a\x30"
+			  "\xfc\x1a\x22\x87\x99\x07\xb9\x87"
+			  "\xdc\xdc\xff\xbe\x4c\xa5\xb6\x3a"
+			  "\x7e\xc5\xdf\xdc\x12\xd0\x20\xf8"
+			  "\x36\x93\xb7\x99\x6d\xa4\x5b\x2a"
+			  "\xe7\x2e\x6a\x64\xfa\x27\xe7\x47"
+			  "\xcb\x1d\xea\x82\x83\x18\x8d\xd1"
+			  "\x29\xb9\x5b\xa1\x4e\xef\xfb\xba"
+			  "\x1c\xaa\x6b\x09\x53\x8b\xe8\x0b"
+			  "\xb3\x47\x26\x9f\x8b\x93\xf1\x2e"
+			  "\xee\x39\x19\x5c\xd7\xa3\xf5\xc2"
+			  "\xf7\x3d\xa5\x3b\x81\x1b\x61\x48"
+			  "\x07\xec\x68\x41\x90\x54\x24\xbf"
+			  "\xcd\x06\x43\x48\x5e\x0d\x85\xb8"
+			  "\x44\x23\xfa\xfc\x3d\xab\x32\x37",
+		.rlen	= 160,
+		.np	= 3,
+		.tap	= { 80, 48, 32 },
+	}
 };
 
 static struct cipher_testvec aes_cbc_dec_tv_template[] = {
@@ -3116,7 +3266,57 @@ static struct cipher_testvec aes_cbc_dec_tv_template[] = {
 			  "\xf6\x9f\x24\x45\xdf\x4f\x9b\x17"
 			  "\xad\x2b\x41\x7b\xe6\x6c\x37\x10",
 		.rlen	= 64,
-	},
+	}, { /* Ten blocks, split across pages, generated with OpenSSL */
+		.key	= "\xa0\xa7\xae\xb5\xbc\xc3\xca\xd1"
+			  "\xd8\xdf\xe6\xed\xf4\xfb\x02\x09",
+		.klen	= 16,
+		.iv	= "\x30\x31\x32\x33\x34\x35\x36\x37"
+			  "\x38\x39\x3a\x3b\x3c\x3d\x3e\x3f",
+		.input	= "\x81\x2b\x55\x53\x7c\xbb\xbc\x3a"
+			  "\xe2\x04\xa8\x12\xbe\x5e\xd2\xb5"
+			  "\x91\x58\x61\x1f\xde\xb1\x01\xea"
+			  "\x63\x05\x0d\xfd\x21\x00\x29\x86"
+			  "\x9c\x11\xe3\x02\x4f\x49\x69\xf2"
+			  "\x70\x0c\xa8\xcb\x5e\xd5\x9a\x30"
+			  "\xfc\x1a\x22\x87\x99\x07\xb9\x87"
+			  "\xdc\xdc\xff\xbe\x4c\xa5\xb6\x3a"
+			  "\x7e\xc5\xdf\xdc\x12\xd0\x20\xf8"
+			  "\x36\x93\xb7\x99\x6d\xa4\x5b\x2a"
+			  "\xe7\x2e\x6a\x64\xfa\x27\xe7\x47"
+			  "\xcb\x1d\xea\x82\x83\x18\x8d\xd1"
+			  "\x29\xb9\x5b\xa1\x4e\xef\xfb\xba"
+			  "\x1c\xaa\x6b\x09\x53\x8b\xe8\x0b"
+			  "\xb3\x47\x26\x9f\x8b\x93\xf1\x2e"
+			  "\xee\x39\x19\x5c\xd7\xa3\xf5\xc2"
+			  "\xf7\x3d\xa5\x3b\x81\x1b\x61\x48"
+			  "\x07\xec\x68\x41\x90\x54\x24\xbf"
+			  "\xcd\x06\x43\x48\x5e\x0d\x85\xb8"
+			  "\x44\x23\xfa\xfc\x3d\xab\x32\x37",
+		.ilen	= 160,
+		.result	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x42\x61\x7c\x9b\xb6\xd5\xf0\x0f"
+			  "\x29\x4a\x67\x80\x9d\xbe\xdb\xf4"
+			  "\x10\x33\x4e\x69\x84\xa7\xc2\xdd"
+			  "\xff\x1c\x31\x56\x6b\x88\xad\xc2"
+			  "\xe6\x05\x18\x3f\x52\x71\x94\xab"
+			  "\xcd\xee\x03\x24\x39\x5a\x7f\x90"
+			  "\xb4\xd7\xea\x0d\x20\x43\x66\x79"
+			  "\x93\xb0\xdd\xfa\x07\x24\x41\x6e"
+			  "\x8a\xa9\xb4\xd3\xfe\x1d\x38\x47"
+			  "\x61\x82\xaf\xc8\xd5\xf6\x13\x3c"
+			  "\x58\x7b\x86\xa1\xcc\xef\x0a\x15"
+			  "\x37\x54\x79\x9e\xa3\xc0\xe5\x0a"
+			  "\x2e\x4d\x50\x77\x9a\xb9\xdc\xe3"
+			  "\x05\x26\x4b\x6c\x71\x92\xb7\xd8"
+			  "\xfc\x1f\x22\x45\x68\x8b\xae\xb1"
+			  "\xcb\xe8\x05\x22\x5f\x7c\x99\xb6"
+			  "\xd2\xf1\xec\x0b\x26\x45\x60\x9f"
+			  "\xb9\xda\xf7\x10\x0d\x2e\x4b\x64"
+			  "\x80\xa3\xde\xf9\x14\x37\x52\x4d",
+		.rlen	= 160,
+		.np	= 3,
+		.tap	= { 80, 48, 32 },
+	}
 };
 
 static struct cipher_testvec aes_lrw_enc_tv_template[] = {
@@ -4091,6 +4291,57 @@ static struct cipher_testvec aes_ctr_enc_tv_template[] = {
 			  "\xdf\xc9\xc5\x8d\xb6\x7a\xad\xa6"
 			  "\x13\xc2\xdd\x08\x45\x79\x41\xa6",
 		.rlen	= 64,
+	}, { /* Partial last block and counter carry, generated with OpenSSL */
+		.key	= "\xa0\xa7\xae\xb5\xbc\xc3\xca\xd1"
+			  "\xd8\xdf\xe6\xed\xf4\xfb\x02\x09"
+			  "\x10\x17\x1e\x25\x2c\x33\x3a\x41",
+		.klen	= 24,
+		.iv	= "\x30\x31\x32\x33\x34\x35\x36\x37"
+			  "\xff\xff\xff\xff\xff\xff\xff\xfc",
+		.input	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x42\x61\x7c\x9b\xb6\xd5\xf0\x0f"
+			  "\x29\x4a\x67\x80\x9d\xbe\xdb\xf4"
+			  "\x10\x33\x4e\x69\x84\xa7\xc2\xdd"
+			  "\xff\x1c\x31\x56\x6b\x88\xad\xc2"
+			  "\xe6\x05\x18\x3f\x52\x71\x94\xab"
+			  "\xcd\xee\x03\x24\x39\x5a\x7f\x90"
+			  "\xb4\xd7\xea\x0d\x20\x43\x66\x79"
+			  "\x93\xb0\xdd\xfa\x07\x24\x41\x6e"
+			  "\x8a\xa9\xb4\xd3\xfe\x1d\x38\x47"
+			  "\x61\x82\xaf\xc8\xd5\xf6\x13\x3c"
+			  "\x58\x7b\x86\xa1\xcc\xef\x0a\x15"
+			  "\x37\x54\x79\x9e\xa3\xc0\xe5\x0a"
+			  "\x2e\x4d\x50\x77\x9a\xb9\xdc\xe3"
+			  "\x05\x26\x4b\x6c\x71\x92\xb7\xd8"
+			  "\xfc\x1f\x22\x45\x68\x8b\xae\xb1"
+			  "\xcb\xe8\x05\x22\x5f\x7c\x99\xb6"
+			  "\xd2\xf1\xec\x0b\x26\x45\x60\x9f"
+			  "\xb9\xda\xf7\x10\x0d\x2e\x4b\x64"
+			  "\x80\xa3\xde\xf9\x14",
+		.ilen	= 157,
+		.result	= "\x62\x4c\x53\xea\xb3\x6d\xb6\x5c"
+			  "\xbd\x40\x7a\x54\xb6\x61\x88\x5c"
+			  "\x69\x5b\x3d\x4d\xe1\x89\xdc\xf3"
+			  "\xb9\x1d\x7f\x7a\x17\xa2\xbc\x2e"
+			  "\xda\x5f\x50\xfc\xfa\x18\x6b\x24"
+			  "\x5e\xd5\x64\x41\x41\x4c\x85\x64"
+			  "\x1c\xef\x1d\x44\x70\x2b\xe8\x03"
+			  "\x02\xf6\x61\xea\xf2\xf8\x68\xe1"
+			  "\x92\x09\xb3\x6d\xf6\x8b\xd7\x0c"
+			  "\x67\xfb\xe7\x9d\xaf\x32\xfa\x25"
+			  "\x7a\xbc\xf7\x59\x3e\xe7\x1c\x87"
+			  "\x28\x7f\xa7\x33\x00\x05\x07\x71"
+			  "\xc5\x39\x92\x9a\xd9\x42\x1a\x87"
+			  "\xa4\xc6\x86\xba\x1b\x4c\x25\x42"
+			  "\x0c\x86\xfa\xbc\x2b\x70\xcf\x9d"
+			  "\x35\xc3\x2b\x1e\xc3\x03\x2a\x77"
+			  "\x43\x51\x50\x7e\x98\x79\x8e\x43"
+			  "\x02\x0e\x96\xa3\x91\x2d\x94\x45"
+			  "\x53\x42\x25\xfd\xe9\x1c\xf1\xdb"
+			  "\xb9\xb5\x9d\xd7\x8b",
+		.rlen	= 157,
+		.np	= 3,
+		.tap	= { 67, 58, 32 },
 	}
 };
 
@@ -4170,6 +4421,57 @@ static struct cipher_testvec aes_ctr_dec_tv_template[] = {
 			  "\xf6\x9f\x24\x45\xdf\x4f\x9b\x17"
 			  "\xad\x2b\x41\x7b\xe6\x6c\x37\x10",
 		.rlen	= 64,
+	}, { /* Partial last block and counter carry, generated with OpenSSL */
+		.key	= "\xa0\xa7\xae\xb5\xbc\xc3\xca\xd1"
+			  "\xd8\xdf\xe6\xed\xf4\xfb\x02\x09"
+			  "\x10\x17\x1e\x25\x2c\x33\x3a\x41",
+		.klen	= 24,
+		.iv	= "\x30\x31\x32\x33\x34\x35\x36\x37"
+			  "\xff\xff\xff\xff\xff\xff\xff\xfc",
+		.input	= "\x62\x4c\x53\xea\xb3\x6d\xb6\x5c"
+			  "\xbd\x40\x7a\x54\xb6\x61\x88\x5c"
+			  "\x69\x5b\x3d\x4d\xe1\x89\xdc\xf3"
+			  "\xb9\x1d\x7f\x7a\x17\xa2\xbc\x2e"
+			  "\xda\x5f\x50\xfc\xfa\x18\x6b\x24"
+			  "\x5e\xd5\x64\x41\x41\x4c\x85\x64"
+			  "\x1c\xef\x1d\x44\x70\x2b\xe8\x03"
+			  "\x02\xf6\x61\xea\xf2\xf8\x68\xe1"
+			  "\x92\x09\xb3\x6d\xf6\x8b\xd7\x0c"
+			  "\x67\xfb\xe7\x9d\xaf\x32\xfa\x25"
+			  "\x7a\xbc\xf7\x59\x3e\xe7\x1c\x87"
+			  "\x28\x7f\xa7\x33\x00\x05\x07\x71"
+			  "\xc5\x39\x92\x9a\xd9\x42\x1a\x87"
+			  "\xa4\xc6\x86\xba\x1b\x4c\x25\x42"
+			  "\x0c\x86\xfa\xbc\x2b\x70\xcf\x9d"
+			  "\x35\xc3\x2b\x1e\xc3\x03\x2a\x77"
+			  "\x43\x51\x50\x7e\x98\x79\x8e\x43"
+			  "\x02\x0e\x96\xa3\x91\x2d\x94\x45"
+			  "\x53\x42\x25\xfd\xe9\x1c\xf1\xdb"
+			  "\xb9\xb5\x9d\xd7\x8b",
+		.ilen	= 157,
+		.result	= "\x5b\x78\x95\xb2\xcf\xec\x09\x26"
+			  "\x42\x61\x7c\x9b\xb6\xd5\xf0\x0f"
+			  "\x29\x4a\x67\x80\x9d\xbe\xdb\xf4"
+			  "\x10\x33\x4e\x69\x84\xa7\xc2\xdd"
+			  "\xff\x1c\x31\x56\x6b\x88\xad\xc2"
+			  "\xe6\x05\x18\x3f\x52\x71\x94\xab"
+			  "\xcd\xee\x03\x24\x39\x5a\x7f\x90"
+			  "\xb4\xd7\xea\x0d\x20\x43\x66\x79"
+			  "\x93\xb0\xdd\xfa\x07\x24\x41\x6e"
+			  "\x8a\xa9\xb4\xd3\xfe\x1d\x38\x47"
+			  "\x61\x82\xaf\xc8\xd5\xf6\x13\x3c"
+			  "\x58\x7b\x86\xa1\xcc\xef\x0a\x15"
+			  "\x37\x54\x79\x9e\xa3\xc0\xe5\x0a"
+			  "\x2e\x4d\x50\x77\x9a\xb9\xdc\xe3"
+			  "\x05\x26\x4b\x6c\x71\x92\xb7\xd8"
+			  "\xfc\x1f\x22\x45\x68\x8b\xae\xb1"
+			  "\xcb\xe8\x05\x22\x5f\x7c\x99\xb6"
+			  "\xd2\xf1\xec\x0b\x26\x45\x60\x9f"
+			  "\xb9\xda\xf7\x10\x0d\x2e\x4b\x64"
+			  "\x80\xa3\xde\xf9\x14",
+		.rlen	= 157,
+		.np	= 3,
+		.tap	= { 67, 58, 32 },
 	}
 };
 
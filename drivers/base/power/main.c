@@ -18,6 +18,7 @@
  */
 
 #include <linux/device.h>
+#include <linux/async.h>
 #include <linux/kallsyms.h>
 #include <linux/mutex.h>
 #include <linux/pm.h>
@@ -26,6 +27,7 @@
 #include <linux/rwsem.h>
 #include <linux/interrupt.h>
 #include <linux/timer.h>
+#include <linux/sched.h>
 
 #include "../base.h"
 #include "power.h"
@@ -43,9 +45,18 @@
 LIST_HEAD(dpm_list);
 
 static DEFINE_MUTEX(dpm_list_mtx);
+static pm_message_t pm_transition;
 
-static void dpm_drv_timeout(unsigned long data);
-static DEFINE_TIMER(dpm_drv_wd, dpm_drv_timeout, 0, 0);
+/*
+ * Set by an asynchronous suspend callback that fails, so the remaining
+ * devices are left alone.  Cleared at the start of every pass.
+ */
+static int async_error;
+
+struct dpm_drv_wd_data {
+	struct device *dev;
+	struct task_struct *tsk;
+};
 
 /*
  * Set once the preparation of devices for a PM transition has started, reset
@@ -60,6 +71,8 @@ static bool transition_started;
 void device_pm_init(struct device *dev)
 {
 	dev->power.status = DPM_ON;
+	init_completion(&dev->power.completion);
+	complete_all(&dev->power.completion);
 	pm_runtime_init(dev);
 }
 
@@ -328,6 +341,64 @@ static void pm_dev_err(struct device *dev, pm_message_t state, char *info,
 		kobject_name(&dev->kobj), pm_verb(state.event), info, error);
 }
 
+static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
+{
+	s64 usecs = ktime_to_us(ktime_sub(ktime_get(), starttime));
+
+	if (usecs == 0)
+		usecs = 1;
+	pr_info("PM: %s%s of devices complete after %lld.%03lld msecs\n",
+		info ? info : "", pm_verb(state.event),
+		div_s64(usecs, USEC_PER_MSEC), usecs % USEC_PER_MSEC);
+}
+
+/*
+ * dpm_dev_time - Log how long the callbacks for one device took, with
+ * printk timestamps this gives a timeline of the whole transition.
+ */
+static void dpm_dev_time(struct device *dev, ktime_t starttime,
+			 pm_message_t state, char *info, int error)
+{
+	if (!pm_print_times_enabled)
+		return;
+	pr_info("PM: %s%s of %s (%s) returned %d after %lld usecs, pid %d\n",
+		info, pm_verb(state.event), dev_name(dev),
+		dev->driver ? dev->driver->name : "no driver", error,
+		ktime_to_us(ktime_sub(ktime_get(), starttime)),
+		task_pid_nr(current));
+}
+
+static bool is_async(struct device *dev)
+{
+	return dev->power.async_suspend && pm_async_enabled
+		&& !pm_trace_is_enabled();
+}
+
+/**
+ * dpm_wait - Wait for a PM operation to complete.
+ * @dev: Device to wait for.
+ * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ */
+static void dpm_wait(struct device *dev, bool async)
+{
+	if (!dev)
+		return;
+
+	if (async || is_async(dev))
+		wait_for_completion(&dev->power.completion);
+}
+
+static int dpm_wait_fn(struct device *dev, void *async_ptr)
+{
+	dpm_wait(dev, *((bool *)async_ptr));
+	return 0;
+}
+
+static void dpm_wait_for_children(struct device *dev, bool async)
+{
+	device_for_each_child(dev, &async, dpm_wait_fn);
+}
+
 /*------------------------- Resume routines -------------------------*/
 
 /**
@@ -340,6 +411,7 @@ static void pm_dev_err(struct device *dev, pm_message_t state, char *info,
  */
 static int device_resume_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -351,6 +423,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 	if (dev->bus->pm) {
 		pm_dev_dbg(dev, state, "EARLY ");
 		error = pm_noirq_op(dev, dev->bus->pm, state);
+		dpm_dev_time(dev, starttime, state, "early ", error);
 	}
  End:
 	TRACE_RESUME(error);
@@ -367,6 +440,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 void dpm_resume_noirq(pm_message_t state)
 {
 	struct device *dev;
+	ktime_t starttime = ktime_get();
 
 	mutex_lock(&dpm_list_mtx);
 	transition_started = false;
@@ -380,6 +454,7 @@ void dpm_resume_noirq(pm_message_t state)
 				pm_dev_err(dev, state, " early", error);
 		}
 	mutex_unlock(&dpm_list_mtx);
+	dpm_show_time(starttime, state, "early ");
 	resume_device_irqs();
 }
 EXPORT_SYMBOL_GPL(dpm_resume_noirq);
@@ -388,16 +463,22 @@ EXPORT_SYMBOL_GPL(dpm_resume_noirq);
  * device_resume - Execute "resume" callbacks for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being resumed asynchronously.
  */
-static int device_resume(struct device *dev, pm_message_t state)
+static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
+	dpm_wait(dev->parent, async);
 	down(&dev->sem);
 
+	starttime = ktime_get();
+	dev->power.status = DPM_RESUMING;
+
 	if (dev->bus) {
 		if (dev->bus->pm) {
 			pm_dev_dbg(dev, state, "");
@@ -429,12 +510,25 @@ static int device_resume(struct device *dev, pm_message_t state)
 		}
 	}
  End:
+	dpm_dev_time(dev, starttime, state, async ? "async " : "", error);
 	up(&dev->sem);
+	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
 	return error;
 }
 
+static void async_resume(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = device_resume(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async", error);
+	put_device(dev);
+}
+
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -446,32 +540,49 @@ static int device_resume(struct device *dev, pm_message_t state)
  */
 static void dpm_drv_timeout(unsigned long data)
 {
-	struct device *dev = (struct device *) data;
+	struct dpm_drv_wd_data *wd_data = (void *)data;
+	struct device *dev = wd_data->dev;
+	struct task_struct *tsk = wd_data->tsk;
 
 	printk(KERN_EMERG "**** DPM device timeout: %s (%s)\n", dev_name(dev),
 	       (dev->driver ? dev->driver->name : "no driver"));
+
+	printk(KERN_EMERG "dpm suspend stack:\n");
+	show_stack(tsk, NULL);
+
 	BUG();
 }
 
 /**
  *	dpm_drv_wdset - Sets up driver suspend/resume watchdog timer.
+ *	@timer: watchdog timer, on the stack of the task suspending @dev.
+ *	@wd_data: filled in for the timeout handler.
  *	@dev: struct device which we're guarding.
  *
+ *	Devices can be suspended from several async threads at once, so each
+ *	one is guarded by its own timer.
  */
-static void dpm_drv_wdset(struct device *dev)
+static void dpm_drv_wdset(struct timer_list *timer,
+			  struct dpm_drv_wd_data *wd_data, struct device *dev)
 {
-	dpm_drv_wd.data = (unsigned long) dev;
-	mod_timer(&dpm_drv_wd, jiffies + (HZ * 10));
+	wd_data->dev = dev;
+	wd_data->tsk = current;
+
+	init_timer_on_stack(timer);
+	timer->function = dpm_drv_timeout;
+	timer->data = (unsigned long)wd_data;
+	mod_timer(timer, jiffies + (HZ * 10));
 }
 
 /**
  *	dpm_drv_wdclr - clears driver suspend/resume watchdog timer.
- *	@dev: struct device which we're no longer guarding.
+ *	@timer: watchdog timer set up by dpm_drv_wdset().
  *
  */
-static void dpm_drv_wdclr(struct device *dev)
+static void dpm_drv_wdclr(struct timer_list *timer)
 {
-	del_timer_sync(&dpm_drv_wd);
+	del_timer_sync(timer);
+	destroy_timer_on_stack(timer);
 }
 
 /**
@@ -484,20 +595,38 @@ static void dpm_drv_wdclr(struct device *dev)
 static void dpm_resume(pm_message_t state)
 {
 	struct list_head list;
+	struct device *dev;
+	ktime_t starttime = ktime_get();
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+
+	/*
+	 * Start the asynchronous resumes first, they wait for their parents
+	 * while the synchronous ones run in list order below.
+	 */
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		if (dev->power.status < DPM_OFF)
+			continue;
+
+		INIT_COMPLETION(dev->power.completion);
+		if (is_async(dev)) {
+			get_device(dev);
+			async_schedule(async_resume, dev);
+		}
+	}
+
 	while (!list_empty(&dpm_list)) {
-		struct device *dev = to_device(dpm_list.next);
+		dev = to_device(dpm_list.next);
 
 		get_device(dev);
-		if (dev->power.status >= DPM_OFF) {
+		if (dev->power.status >= DPM_OFF && !is_async(dev)) {
 			int error;
 
-			dev->power.status = DPM_RESUMING;
 			mutex_unlock(&dpm_list_mtx);
 
-			error = device_resume(dev, state);
+			error = device_resume(dev, state, false);
 
 			mutex_lock(&dpm_list_mtx);
 			if (error)
@@ -512,6 +641,8 @@ static void dpm_resume(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
+	dpm_show_time(starttime, state, NULL);
 }
 
 /**
@@ -625,6 +756,7 @@ static pm_message_t resume_event(pm_message_t sleep_state)
  */
 static int device_suspend_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	if (!dev->bus)
@@ -633,6 +765,7 @@ static int device_suspend_noirq(struct device *dev, pm_message_t state)
 	if (dev->bus->pm) {
 		pm_dev_dbg(dev, state, "LATE ");
 		error = pm_noirq_op(dev, dev->bus->pm, state);
+		dpm_dev_time(dev, starttime, state, "late ", error);
 	}
 	return error;
 }
@@ -647,6 +780,7 @@ static int device_suspend_noirq(struct device *dev, pm_message_t state)
 int dpm_suspend_noirq(pm_message_t state)
 {
 	struct device *dev;
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	suspend_device_irqs();
@@ -662,21 +796,34 @@ int dpm_suspend_noirq(pm_message_t state)
 	mutex_unlock(&dpm_list_mtx);
 	if (error)
 		dpm_resume_noirq(resume_event(state));
+	else
+		dpm_show_time(starttime, state, "late ");
 	return error;
 }
 EXPORT_SYMBOL_GPL(dpm_suspend_noirq);
 
 /**
- * device_suspend - Execute "suspend" callbacks for given device.
+ * __device_suspend - Execute "suspend" callbacks for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being suspended asynchronously.
  */
-static int device_suspend(struct device *dev, pm_message_t state)
+static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 {
+	struct timer_list timer;
+	struct dpm_drv_wd_data wd_data;
+	ktime_t starttime;
 	int error = 0;
 
+	dpm_wait_for_children(dev, async);
 	down(&dev->sem);
 
+	starttime = ktime_get();
+	if (async_error)
+		goto Unlock;
+
+	dpm_drv_wdset(&timer, &wd_data, dev);
+
 	if (dev->class) {
 		if (dev->class->pm) {
 			pm_dev_dbg(dev, state, "class ");
@@ -709,12 +856,46 @@ static int device_suspend(struct device *dev, pm_message_t state)
 			suspend_report_result(dev->bus->suspend, error);
 		}
 	}
+
+	if (!error)
+		dev->power.status = DPM_OFF;
  End:
+	dpm_drv_wdclr(&timer);
+	dpm_dev_time(dev, starttime, state, async ? "async " : "", error);
+ Unlock:
 	up(&dev->sem);
+	complete_all(&dev->power.completion);
 
 	return error;
 }
 
+static void async_suspend(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = __device_suspend(dev, pm_transition, true);
+	if (error) {
+		pm_dev_err(dev, pm_transition, " async", error);
+		async_error = error;
+	}
+
+	put_device(dev);
+}
+
+static int device_suspend(struct device *dev)
+{
+	INIT_COMPLETION(dev->power.completion);
+
+	if (is_async(dev)) {
+		get_device(dev);
+		async_schedule(async_suspend, dev);
+		return 0;
+	}
+
+	return __device_suspend(dev, pm_transition, false);
+}
+
 /**
  * dpm_suspend - Execute "suspend" callbacks for all non-sysdev devices.
  * @state: PM transition of the system being carried out.
@@ -722,19 +903,20 @@ static int device_suspend(struct device *dev, pm_message_t state)
 static int dpm_suspend(pm_message_t state)
 {
 	struct list_head list;
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+	async_error = 0;
 	while (!list_empty(&dpm_list)) {
 		struct device *dev = to_device(dpm_list.prev);
 
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
-		dpm_drv_wdset(dev);
-		error = device_suspend(dev, state);
-		dpm_drv_wdclr(dev);
+		error = device_suspend(dev);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
@@ -742,13 +924,19 @@ static int dpm_suspend(pm_message_t state)
 			put_device(dev);
 			break;
 		}
-		dev->power.status = DPM_OFF;
 		if (!list_empty(&dev->power.entry))
 			list_move(&dev->power.entry, &list);
 		put_device(dev);
+		if (async_error)
+			break;
 	}
 	list_splice(&list, dpm_list.prev);
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
+	if (!error)
+		error = async_error;
+	if (!error)
+		dpm_show_time(starttime, state, NULL);
 	return error;
 }
 
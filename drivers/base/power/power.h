@@ -17,6 +17,8 @@ static inline void pm_runtime_remove(struct device *dev) {}
  */
 
 extern struct list_head dpm_list;	/* The active device list */
+extern int pm_async_enabled;	/* /sys/power/pm_async */
+extern int pm_print_times_enabled;	/* /sys/power/pm_print_times */
 
 static inline struct device *to_device(struct list_head *entry)
 {
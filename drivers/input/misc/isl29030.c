@@ -960,6 +960,7 @@ static int ld_isl29030_probe(struct i2c_client *client,
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	isl->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
+	isl->early_suspend.async = true;
 	isl->early_suspend.suspend = isl29030_early_suspend;
 	isl->early_suspend.resume = isl29030_late_resume;
 	register_early_suspend(&isl->early_suspend);
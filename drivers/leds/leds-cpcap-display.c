@@ -35,7 +35,7 @@ struct display_led {
 	struct cpcap_device *cpcap;
 	struct led_classdev cpcap_display_dev;
 	struct workqueue_struct *working_queue;
-	struct delayed_work dwork;
+	struct cpcap_adc_periodic als_poll;
 	struct work_struct work;
 	struct early_suspend suspend;
 	struct cpcap_leds *leds;
@@ -175,23 +175,12 @@ static void cpcap_display_led_queue_set(struct work_struct *work)
 	return;
 }
 
-static void cpcap_display_led_read_a2d(struct display_led *d_led)
+static void cpcap_display_led_report_als(struct display_led *d_led,
+					 struct cpcap_adc_request *request)
 {
-	int err;
-	struct cpcap_adc_request request;
-	struct cpcap_device *cpcap = d_led->cpcap;
 	unsigned int  light_value = 0, lux_value = 0;
 
-	request.format = CPCAP_ADC_FORMAT_RAW;
-	request.timing = CPCAP_ADC_TIMING_IMM;
-	request.type = CPCAP_ADC_TYPE_BANK_1;
-
-	err = cpcap_adc_sync_read(cpcap, &request);
-	if (err < 0) {
-		pr_err("%s: A2D read error %d\n", __func__, err);
-		return;
-	}
-	light_value = request.result[CPCAP_ADC_TSY1_AD14];
+	light_value = request->result[CPCAP_ADC_TSY1_AD14];
 
 	if (light_value < d_led->leds->als_data.als_min)
 		lux_value = d_led->leds->als_data.lux_min;
@@ -209,6 +198,24 @@ static void cpcap_display_led_read_a2d(struct display_led *d_led)
 	input_sync(d_led->idev);
 }
 
+static void cpcap_display_led_read_a2d(struct display_led *d_led)
+{
+	int err;
+	struct cpcap_adc_request request;
+	struct cpcap_device *cpcap = d_led->cpcap;
+
+	request.format = CPCAP_ADC_FORMAT_RAW;
+	request.timing = CPCAP_ADC_TIMING_IMM;
+	request.type = CPCAP_ADC_TYPE_BANK_1;
+
+	err = cpcap_adc_sync_read(cpcap, &request);
+	if (err < 0) {
+		pr_err("%s: A2D read error %d\n", __func__, err);
+		return;
+	}
+	cpcap_display_led_report_als(d_led, &request);
+}
+
 static void cpcap_display_led_work(struct work_struct *work)
 {
 	struct display_led *d_led =
@@ -220,18 +227,20 @@ static void cpcap_display_led_work(struct work_struct *work)
 
 }
 
-static void cpcap_display_led_dwork(struct work_struct *work)
+/* Called by the CPCAP ADC driver every poll_intvl in automatic mode */
+static void cpcap_display_led_als_sample(struct cpcap_device *cpcap,
+					 struct cpcap_adc_periodic *p)
 {
 	struct display_led *d_led =
-	  container_of((struct delayed_work *)work, struct display_led, dwork);
-
-	cpcap_display_led_read_a2d(d_led);
+	  container_of(p, struct display_led, als_poll);
 
-	queue_delayed_work(d_led->working_queue, &d_led->dwork,
-			      msecs_to_jiffies(d_led->leds->display_led.
-					       poll_intvl));
+	if (p->req.status < 0) {
+		pr_err("%s: A2D read error %d\n", __func__, p->req.status);
+		return;
+	}
+	cpcap_display_led_report_als(d_led, &p->req);
 	if (cpcap_als_debug)
-		pr_info("%s: Delayed Workqueue\n", __func__);
+		pr_info("%s: Periodic sample\n", __func__);
 
 }
 
@@ -323,10 +332,8 @@ static int cpcap_display_led_suspend(struct platform_device *pdev,
 	if (d_led->last_brightness != LED_OFF)
 		cpcap_display_led_process_set(&d_led->cpcap_display_dev,
 						LED_OFF);
-	if (d_led->mode == AUTOMATIC) {
-		cancel_delayed_work(&d_led->dwork);
-		cancel_delayed_work_sync(&d_led->dwork);
-	}
+	if (d_led->mode == AUTOMATIC)
+		cpcap_adc_periodic_stop(d_led->cpcap, &d_led->als_poll);
 
 	if ((d_led->regulator) && (d_led->regulator_state)) {
 		regulator_disable(d_led->regulator);
@@ -342,11 +349,8 @@ static int cpcap_display_led_resume(struct platform_device *pdev)
 	if (cpcap_als_debug)
 		pr_info("%s : Resuming...\n", __func__);
 
-	if (d_led->mode == AUTOMATIC) {
-		queue_delayed_work(d_led->working_queue, &d_led->dwork,
-			      msecs_to_jiffies(d_led->leds->display_led.
-					       poll_intvl));
-	}
+	if (d_led->mode == AUTOMATIC)
+		cpcap_adc_periodic_start(d_led->cpcap, &d_led->als_poll);
 
 	if ((d_led->regulator) && (d_led->regulator_state == 0)) {
 		regulator_enable(d_led->regulator);
@@ -401,13 +405,10 @@ static ssize_t cpcap_display_led_als_store(struct device *dev,
 
 	if (mode == AUTOMATIC) {
 		d_led->mode = AUTOMATIC;
-		queue_delayed_work(d_led->working_queue, &d_led->dwork,
-			      msecs_to_jiffies(d_led->leds->display_led.
-					       poll_intvl));
+		cpcap_adc_periodic_start(d_led->cpcap, &d_led->als_poll);
 	} else {
 		d_led->mode = MANUAL;
-		cancel_delayed_work(&d_led->dwork);
-		cancel_delayed_work_sync(&d_led->dwork);
+		cpcap_adc_periodic_stop(d_led->cpcap, &d_led->als_poll);
 	}
 
 	return d_led->mode;
@@ -535,10 +536,15 @@ static int cpcap_display_led_probe(struct platform_device *pdev)
 #endif
 	queue_work(d_led->working_queue, &d_led->work);
 
-	INIT_DELAYED_WORK(&d_led->dwork, cpcap_display_led_dwork);
-	queue_delayed_work(d_led->working_queue, &d_led->dwork,
-			      msecs_to_jiffies(d_led->leds->display_led.
-					       poll_intvl));
+	d_led->als_poll.format = CPCAP_ADC_FORMAT_RAW;
+	d_led->als_poll.timing = CPCAP_ADC_TIMING_IMM;
+	d_led->als_poll.type = CPCAP_ADC_TYPE_BANK_1;
+	d_led->als_poll.period_ms = d_led->leds->display_led.poll_intvl;
+	d_led->als_poll.max_age_ms = d_led->als_poll.period_ms / 2;
+	/* the backlight must follow the light while the cpu idles */
+	d_led->als_poll.deferrable = 0;
+	d_led->als_poll.callback = cpcap_display_led_als_sample;
+	cpcap_adc_periodic_start(d_led->cpcap, &d_led->als_poll);
 	mutex_init(&d_led->sreq_lock);
 
 	d_led->bright_delay = HZ / 15;
@@ -573,8 +579,7 @@ static int cpcap_display_led_remove(struct platform_device *pdev)
 	if (d_led->regulator)
 		regulator_put(d_led->regulator);
 
-	cancel_delayed_work(&d_led->dwork);
-	cancel_delayed_work_sync(&d_led->dwork);
+	cpcap_adc_periodic_stop(d_led->cpcap, &d_led->als_poll);
 
 	cancel_delayed_work(&d_led->bright_dwork);
 	cancel_delayed_work_sync(&d_led->bright_dwork);
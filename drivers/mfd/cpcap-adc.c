@@ -21,7 +21,11 @@
 #include <linux/device.h>
 #include <linux/platform_device.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/seq_file.h>
 #include <linux/sched.h>
+#include <linux/wait.h>
 
 #include <linux/spi/cpcap.h>
 #include <linux/spi/cpcap-regbits.h>
@@ -32,15 +36,55 @@
 #define MAX_TEMP_LVL 27
 #define FOUR_POINT_TWO_ADC 801
 
+#define ADC_NUM_TYPES	(CPCAP_ADC_TYPE_BATT_PI + 1)
+#define ADC_NUM_TIMINGS	(CPCAP_ADC_TIMING_OUT + 1)
+
+/* ADCAL1, ADCAL2 and ADCD0 to ADCD7, as read after a conversion */
+#define ADC_NUM_RAW	10
+
+static unsigned int coalesce_ms = 5;
+module_param(coalesce_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(coalesce_ms, "How long after a conversion started "
+		 "a request for the same bank may still share it");
+
+struct adc_sample {
+	unsigned short raw[ADC_NUM_RAW];
+	unsigned long stamp;
+	int valid;
+};
+
 struct cpcap_adc {
 	struct cpcap_device *cpcap;
 
 	/* Private stuff */
+	/*
+	 * Each slot holds the requests sharing one conversion, chained
+	 * through their next pointers. The one at queue_head is running.
+	 */
 	struct cpcap_adc_request *queue[MAX_ADC_FIFO_DEPTH];
 	int queue_head;
 	int queue_tail;
+	unsigned long started;
 	struct mutex queue_mutex;
 	struct delayed_work work;
+
+	/* last conversion of each kind, for requests that accept an old one */
+	struct adc_sample samples[ADC_NUM_TYPES][ADC_NUM_TIMINGS];
+
+	/* requests answered from samples, waiting for their callbacks */
+	struct cpcap_adc_request *done;
+	struct work_struct done_work;
+
+	struct list_head periodic;
+	struct mutex periodic_mutex;
+	wait_queue_head_t periodic_wait;
+	struct delayed_work periodic_work;	/* for the timely clients */
+	struct delayed_work periodic_idle_work;	/* for the deferrable ones */
+
+	unsigned long conversions;
+	unsigned long coalesced;
+	unsigned long cache_hits;
+	struct dentry *dentry;
 };
 
 struct phasing_tbl {
@@ -316,25 +360,76 @@ static void trigger_next_adc_job_if_any(struct cpcap_device *cpcap)
 		mutex_unlock(&adc->queue_mutex);
 		return;
 	}
+	adc->started = jiffies;
+	adc->conversions++;
 	mutex_unlock(&adc->queue_mutex);
 
 	adc_setup(cpcap, adc->queue[head]);
 }
 
+static void adc_process(struct cpcap_adc_request *req,
+			const unsigned short *raw);
+
+/*
+ * A request that can take a recent enough conversion of its kind gets
+ * it straight away, and 1 is returned without calling the callback.
+ * Otherwise it joins a queued conversion of the same kind, or the
+ * running one if that only just started, and only then gets a
+ * conversion of its own.
+ */
 static int
-adc_enqueue_request(struct cpcap_device *cpcap, struct cpcap_adc_request *req)
+adc_enqueue_request(struct cpcap_device *cpcap, struct cpcap_adc_request *req,
+		    unsigned int max_age_ms)
 {
 	struct cpcap_adc *adc = cpcap->adcdata;
+	struct adc_sample *sample;
+	struct cpcap_adc_request *first;
 	int head;
 	int tail;
 	int running;
+	int i;
+
+	if (req->type >= ADC_NUM_TYPES || req->timing >= ADC_NUM_TIMINGS)
+		return -EINVAL;
+
+	req->next = NULL;
 
 	mutex_lock(&adc->queue_mutex);
 
+	sample = &adc->samples[req->type][req->timing];
+	if (max_age_ms && sample->valid &&
+	    time_before_eq(jiffies,
+			   sample->stamp + msecs_to_jiffies(max_age_ms))) {
+		adc_process(req, sample->raw);
+		req->status = 0;
+		adc->cache_hits++;
+		mutex_unlock(&adc->queue_mutex);
+		return 1;
+	}
+
 	head = adc->queue_head;
 	tail = adc->queue_tail;
 	running = (head != tail);
 
+	for (i = head; i != tail; i = (i + 1) & (MAX_ADC_FIFO_DEPTH - 1)) {
+		first = adc->queue[i];
+		if (!first || first->type != req->type ||
+		    first->timing != req->timing)
+			continue;
+
+		if (i == head && req->timing == CPCAP_ADC_TIMING_IMM &&
+		    time_after(jiffies, adc->started +
+			       msecs_to_jiffies(coalesce_ms)))
+			continue;
+
+		while (first->next)
+			first = first->next;
+		first->next = req;
+		adc->coalesced++;
+		mutex_unlock(&adc->queue_mutex);
+		return 0;
+	}
+
 	if (adc->queue[tail]) {
 		mutex_unlock(&adc->queue_mutex);
 		return -EBUSY;
@@ -351,6 +446,54 @@ adc_enqueue_request(struct cpcap_device *cpcap, struct cpcap_adc_request *req)
 	return 0;
 }
 
+static void adc_complete(struct cpcap_device *cpcap,
+			 struct cpcap_adc_request *req, int status)
+{
+	struct cpcap_adc_request *next;
+
+	/* a callback may reuse its request, so step past it first */
+	while (req) {
+		next = req->next;
+		req->status = status;
+		req->callback(cpcap, req->callback_param);
+		req = next;
+	}
+}
+
+/*
+ * Callers of the async interface may hold locks their callback takes,
+ * so answers from the cache are called back from a work item.
+ */
+static void adc_defer_done(struct cpcap_adc *adc,
+			   struct cpcap_adc_request *req)
+{
+	mutex_lock(&adc->queue_mutex);
+	req->next = adc->done;
+	adc->done = req;
+	mutex_unlock(&adc->queue_mutex);
+
+	schedule_work(&adc->done_work);
+}
+
+static void adc_done_work(struct work_struct *work)
+{
+	struct cpcap_adc *adc = container_of(work, struct cpcap_adc,
+					     done_work);
+	struct cpcap_adc_request *req;
+	struct cpcap_adc_request *next;
+
+	mutex_lock(&adc->queue_mutex);
+	req = adc->done;
+	adc->done = NULL;
+	mutex_unlock(&adc->queue_mutex);
+
+	while (req) {
+		next = req->next;
+		req->callback(adc->cpcap, req->callback_param);
+		req = next;
+	}
+}
+
 static void
 cpcap_adc_sync_read_callback(struct cpcap_device *cpcap, void *param)
 {
@@ -359,30 +502,172 @@ cpcap_adc_sync_read_callback(struct cpcap_device *cpcap, void *param)
 	complete(&req->completion);
 }
 
-int cpcap_adc_sync_read(struct cpcap_device *cpcap,
-			struct cpcap_adc_request *request)
+int cpcap_adc_sync_read_cached(struct cpcap_device *cpcap,
+			       struct cpcap_adc_request *request,
+			       unsigned int max_age_ms)
 {
 	int ret;
 
 	request->callback = cpcap_adc_sync_read_callback;
 	request->callback_param = request;
 	init_completion(&request->completion);
-	ret = adc_enqueue_request(cpcap, request);
-	if (ret)
+	ret = adc_enqueue_request(cpcap, request, max_age_ms);
+	if (ret < 0)
 		return ret;
-	wait_for_completion(&request->completion);
+	if (ret == 0)
+		wait_for_completion(&request->completion);
 
 	return 0;
 }
+EXPORT_SYMBOL_GPL(cpcap_adc_sync_read_cached);
+
+int cpcap_adc_sync_read(struct cpcap_device *cpcap,
+			struct cpcap_adc_request *request)
+{
+	return cpcap_adc_sync_read_cached(cpcap, request, 0);
+}
 EXPORT_SYMBOL_GPL(cpcap_adc_sync_read);
 
+int cpcap_adc_async_read_cached(struct cpcap_device *cpcap,
+				struct cpcap_adc_request *request,
+				unsigned int max_age_ms)
+{
+	int ret;
+
+	ret = adc_enqueue_request(cpcap, request, max_age_ms);
+	if (ret > 0) {
+		adc_defer_done(cpcap->adcdata, request);
+		ret = 0;
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpcap_adc_async_read_cached);
+
 int cpcap_adc_async_read(struct cpcap_device *cpcap,
 			 struct cpcap_adc_request *request)
 {
-	return adc_enqueue_request(cpcap, request);
+	return cpcap_adc_async_read_cached(cpcap, request, 0);
 }
 EXPORT_SYMBOL_GPL(cpcap_adc_async_read);
 
+/*
+ * Periodic sampling. Clients that fall due within an eighth of their
+ * period of each other are sampled together, sharing conversions of the
+ * same kind. A work item runs for the timely clients, such as the light
+ * sensor that drives the display backlight, and a deferrable one for
+ * the clients marked deferrable, so that they do not wake an idle
+ * system by themselves. Each work item arms itself for its own clients
+ * only, and samples any client that is due.
+ */
+static void adc_periodic_callback(struct cpcap_device *cpcap, void *param)
+{
+	struct cpcap_adc_periodic *p = param;
+	struct cpcap_adc *adc = cpcap->adcdata;
+
+	p->callback(cpcap, p);
+
+	mutex_lock(&adc->periodic_mutex);
+	p->busy = 0;
+	mutex_unlock(&adc->periodic_mutex);
+	wake_up(&adc->periodic_wait);
+}
+
+static void adc_periodic_scan(struct cpcap_adc *adc, int deferrable)
+{
+	struct delayed_work *work = deferrable ? &adc->periodic_idle_work :
+						 &adc->periodic_work;
+	struct cpcap_adc_periodic *p;
+	int clients = 0;
+	unsigned long now = jiffies;
+	unsigned long wake = now + MAX_JIFFY_OFFSET;
+	unsigned long slack;
+
+	mutex_lock(&adc->periodic_mutex);
+
+	list_for_each_entry(p, &adc->periodic, list) {
+		slack = msecs_to_jiffies(p->period_ms / 8);
+		if (!p->busy && time_after_eq(now + slack, p->next)) {
+			p->next = now + msecs_to_jiffies(p->period_ms);
+			p->req.format = p->format;
+			p->req.timing = p->timing;
+			p->req.type = p->type;
+			p->req.callback = adc_periodic_callback;
+			p->req.callback_param = p;
+			p->busy = !cpcap_adc_async_read_cached(adc->cpcap,
+							       &p->req,
+							       p->max_age_ms);
+		}
+		if (!p->deferrable != !deferrable)
+			continue;
+		clients++;
+		if (time_before(p->next, wake))
+			wake = p->next;
+	}
+
+	if (clients)
+		schedule_delayed_work(work,
+				      time_after(wake, now) ? wake - now : 1);
+
+	mutex_unlock(&adc->periodic_mutex);
+}
+
+static void adc_periodic_work(struct work_struct *work)
+{
+	adc_periodic_scan(container_of(work, struct cpcap_adc,
+				       periodic_work.work), 0);
+}
+
+static void adc_periodic_idle_work(struct work_struct *work)
+{
+	adc_periodic_scan(container_of(work, struct cpcap_adc,
+				       periodic_idle_work.work), 1);
+}
+
+int cpcap_adc_periodic_start(struct cpcap_device *cpcap,
+			     struct cpcap_adc_periodic *p)
+{
+	struct cpcap_adc *adc = cpcap->adcdata;
+	struct delayed_work *work;
+
+	if (!p->period_ms || !p->callback ||
+	    p->type >= ADC_NUM_TYPES || p->timing >= ADC_NUM_TIMINGS)
+		return -EINVAL;
+
+	mutex_lock(&adc->periodic_mutex);
+	if (!p->active) {
+		p->active = 1;
+		p->next = jiffies + msecs_to_jiffies(p->period_ms);
+		list_add_tail(&p->list, &adc->periodic);
+	}
+	mutex_unlock(&adc->periodic_mutex);
+
+	/* recompute when to run, in case this client is the first due */
+	work = p->deferrable ? &adc->periodic_idle_work : &adc->periodic_work;
+	cancel_delayed_work(work);
+	schedule_delayed_work(work, 0);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpcap_adc_periodic_start);
+
+/* Stop sampling for p and wait for a conversion it has in flight. */
+void cpcap_adc_periodic_stop(struct cpcap_device *cpcap,
+			     struct cpcap_adc_periodic *p)
+{
+	struct cpcap_adc *adc = cpcap->adcdata;
+
+	mutex_lock(&adc->periodic_mutex);
+	if (p->active) {
+		p->active = 0;
+		list_del(&p->list);
+	}
+	mutex_unlock(&adc->periodic_mutex);
+
+	wait_event(adc->periodic_wait, !p->busy);
+}
+EXPORT_SYMBOL_GPL(cpcap_adc_periodic_stop);
+
 void cpcap_adc_phase(struct cpcap_device *cpcap, struct cpcap_adc_phase *phase)
 {
 	bank0_phasing[CPCAP_ADC_BATTI_ADC].offset = phase->offset_batti;
@@ -489,28 +774,32 @@ static void adc_raw(struct cpcap_adc_request *req, int index)
 	}
 }
 
-static void adc_result(struct cpcap_device *cpcap,
-		       struct cpcap_adc_request *req)
+static void adc_read_raw(struct cpcap_device *cpcap, unsigned short *raw)
 {
-	int i;
-	int j;
-	unsigned short cal_data;
+	static const enum cpcap_reg regs[ADC_NUM_RAW] = {
+		CPCAP_REG_ADCAL1, CPCAP_REG_ADCAL2,
+		CPCAP_REG_ADCD0, CPCAP_REG_ADCD1, CPCAP_REG_ADCD2,
+		CPCAP_REG_ADCD3, CPCAP_REG_ADCD4, CPCAP_REG_ADCD5,
+		CPCAP_REG_ADCD6, CPCAP_REG_ADCD7,
+	};
 
-	cal_data = 0;
-	cpcap_regacc_read(cpcap, CPCAP_REG_ADCAL1, &cal_data);
-	bank0_conversion[CPCAP_ADC_CHG_ISENSE].cal_offset =
-		((short)cal_data * -1) + 512;
+	/* calibration and all eight results in one SPI message */
+	memset(raw, 0, ADC_NUM_RAW * sizeof(*raw));
+	cpcap_regacc_read_multi(cpcap, regs, raw, ADC_NUM_RAW);
 
-	cal_data = 0;
-	cpcap_regacc_read(cpcap, CPCAP_REG_ADCAL2, &cal_data);
+	bank0_conversion[CPCAP_ADC_CHG_ISENSE].cal_offset =
+		((short)raw[0] * -1) + 512;
 	bank0_conversion[CPCAP_ADC_BATTI_ADC].cal_offset =
-		((short)cal_data * -1) + 512;
+		((short)raw[1] * -1) + 512;
+}
 
+static void adc_process(struct cpcap_adc_request *req,
+			const unsigned short *raw)
+{
+	int j;
 
-	for (i = CPCAP_REG_ADCD0; i <= CPCAP_REG_ADCD7; i++) {
-		j = i - CPCAP_REG_ADCD0;
-		cpcap_regacc_read(cpcap, i, (unsigned short *)&req->result[j]);
-		req->result[j] &= 0x3FF;
+	for (j = 0; j < CPCAP_ADC_BANK0_NUM; j++) {
+		req->result[j] = raw[2 + j] & 0x3FF;
 
 		switch (req->format) {
 		case CPCAP_ADC_FORMAT_PHASED:
@@ -537,6 +826,9 @@ static void cpcap_adc_irq(enum cpcap_irqs irq, void *data)
 	struct cpcap_adc *adc = data;
 	struct cpcap_device *cpcap = adc->cpcap;
 	struct cpcap_adc_request *req;
+	struct cpcap_adc_request *next;
+	struct adc_sample *sample;
+	unsigned short raw[ADC_NUM_RAW];
 	int head;
 
 	cancel_delayed_work_sync(&adc->work);
@@ -560,13 +852,20 @@ static void cpcap_adc_irq(enum cpcap_irqs irq, void *data)
 
 	mutex_unlock(&adc->queue_mutex);
 
-	adc_result(cpcap, req);
+	adc_read_raw(cpcap, raw);
 
 	trigger_next_adc_job_if_any(cpcap);
 
-	req->status = 0;
+	mutex_lock(&adc->queue_mutex);
+	sample = &adc->samples[req->type][req->timing];
+	memcpy(sample->raw, raw, sizeof(raw));
+	sample->stamp = jiffies;
+	sample->valid = 1;
+	for (next = req; next; next = next->next)
+		adc_process(next, raw);
+	mutex_unlock(&adc->queue_mutex);
 
-	req->callback(cpcap, req->callback_param);
+	adc_complete(cpcap, req, 0);
 }
 
 static void cpcap_adc_cancel(struct work_struct *work)
@@ -597,13 +896,44 @@ static void cpcap_adc_cancel(struct work_struct *work)
 
 	mutex_unlock(&adc->queue_mutex);
 
-	req->status = -ETIMEDOUT;
-
-	req->callback(adc->cpcap, req->callback_param);
+	adc_complete(adc->cpcap, req, -ETIMEDOUT);
 
 	trigger_next_adc_job_if_any(adc->cpcap);
 }
 
+static int cpcap_adc_stats_show(struct seq_file *s, void *unused)
+{
+	struct cpcap_adc *adc = s->private;
+	struct cpcap_adc_periodic *p;
+
+	mutex_lock(&adc->queue_mutex);
+	seq_printf(s, "conversions: %lu\n", adc->conversions);
+	seq_printf(s, "coalesced: %lu\n", adc->coalesced);
+	seq_printf(s, "cache_hits: %lu\n", adc->cache_hits);
+	mutex_unlock(&adc->queue_mutex);
+
+	mutex_lock(&adc->periodic_mutex);
+	list_for_each_entry(p, &adc->periodic, list)
+		seq_printf(s, "periodic: %pf type %d every %u ms%s\n",
+			   p->callback, p->type, p->period_ms,
+			   p->deferrable ? " deferrable" : "");
+	mutex_unlock(&adc->periodic_mutex);
+
+	return 0;
+}
+
+static int cpcap_adc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpcap_adc_stats_show, inode->i_private);
+}
+
+static const struct file_operations cpcap_adc_stats_fops = {
+	.open = cpcap_adc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __devinit cpcap_adc_probe(struct platform_device *pdev)
 {
 	struct cpcap_adc *adc;
@@ -639,6 +969,16 @@ static int __devinit cpcap_adc_probe(struct platform_device *pdev)
 		((short)cal_data * -1) + 512;
 
 	INIT_DELAYED_WORK(&adc->work, cpcap_adc_cancel);
+	INIT_WORK(&adc->done_work, adc_done_work);
+	INIT_LIST_HEAD(&adc->periodic);
+	mutex_init(&adc->periodic_mutex);
+	init_waitqueue_head(&adc->periodic_wait);
+	INIT_DELAYED_WORK(&adc->periodic_work, adc_periodic_work);
+	INIT_DELAYED_WORK_DEFERRABLE(&adc->periodic_idle_work,
+				     adc_periodic_idle_work);
+
+	adc->dentry = debugfs_create_file("cpcap_adc", S_IRUGO, NULL, adc,
+					  &cpcap_adc_stats_fops);
 
 	cpcap_irq_register(adc->cpcap, CPCAP_IRQ_ADCDONE,
 			   cpcap_adc_irq, adc);
@@ -654,6 +994,10 @@ static int __devexit cpcap_adc_remove(struct platform_device *pdev)
 	int head;
 
 	cancel_delayed_work_sync(&adc->work);
+	cancel_delayed_work_sync(&adc->periodic_work);
+	cancel_delayed_work_sync(&adc->periodic_idle_work);
+	flush_scheduled_work();
+	debugfs_remove(adc->dentry);
 
 	cpcap_irq_free(adc->cpcap, CPCAP_IRQ_ADCDONE);
 
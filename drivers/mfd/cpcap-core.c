@@ -41,6 +41,7 @@ static int ioctl(struct inode *inode,
 		 struct file *file, unsigned int cmd, unsigned long arg);
 static int __devinit cpcap_probe(struct spi_device *spi);
 static int __devexit cpcap_remove(struct spi_device *spi);
+static int cpcap_suspend(struct spi_device *spi, pm_message_t mesg);
 
 const static struct file_operations cpcap_fops = {
 	.owner = THIS_MODULE,
@@ -61,6 +62,7 @@ static struct spi_driver cpcap_driver = {
 		   },
 	.probe = cpcap_probe,
 	.remove = __devexit_p(cpcap_remove),
+	.suspend = cpcap_suspend,
 };
 
 static struct platform_device cpcap_adc_device = {
@@ -121,6 +123,8 @@ static int cpcap_reboot(struct notifier_block *this, unsigned long code,
 	unsigned short value;
 	unsigned short counter = 0;
 
+	cpcap_regacc_flush(misc_cpcap);
+
 	/* Disable the USB transceiver */
 	ret = cpcap_regacc_write(misc_cpcap, CPCAP_REG_USBC2, 0,
 				 CPCAP_BIT_USBXCVREN);
@@ -454,6 +458,7 @@ static int __devinit cpcap_probe(struct spi_device *spi)
 free_cpcap_irq:
 	cpcap_irq_shutdown(cpcap);
 free_mem:
+	cpcap_regacc_exit(cpcap);
 	kfree(cpcap);
 	return retval;
 }
@@ -483,10 +488,21 @@ static int __devexit cpcap_remove(struct spi_device *spi)
 
 	misc_deregister(&cpcap_dev);
 	cpcap_irq_shutdown(cpcap);
+	cpcap_regacc_exit(cpcap);
 	kfree(cpcap);
 	return 0;
 }
 
+static int cpcap_suspend(struct spi_device *spi, pm_message_t mesg)
+{
+	struct cpcap_device *cpcap = spi_get_drvdata(spi);
+
+	/* queued register writes must not wait for the resume */
+	cpcap_regacc_flush(cpcap);
+
+	return 0;
+}
+
 
 static int test_ioctl(unsigned int cmd, unsigned long arg)
 {
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Loading the module sets up a CPCAP without an SPI device, so its
+ * registers are simulated in memory, checks that reads, writes, batches
+ * and queued writes leave the simulated chip in the right state, and
+ * then times a few access patterns the drivers use:
+ *
+ *   insmod cpcap-regacc-bench.ko iterations=10000
+ *   rmmod cpcap-regacc-bench
+ *
+ * Each line gives the time per operation and the SPI messages and
+ * register frames it needed. cpcap.regcache=0 shows the same patterns
+ * without the register cache, and cpcap.sim_msg_us and sim_frame_us set
+ * what a message and a frame cost.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spi/cpcap.h>
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, S_IRUGO);
+MODULE_PARM_DESC(iterations, "Operations timed per pattern");
+
+static const enum cpcap_reg adc_regs[] = {
+	CPCAP_REG_ADCD0, CPCAP_REG_ADCD1, CPCAP_REG_ADCD2, CPCAP_REG_ADCD3,
+	CPCAP_REG_ADCD4, CPCAP_REG_ADCD5, CPCAP_REG_ADCD6, CPCAP_REG_ADCD7,
+};
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printk(KERN_ERR "cpcap_regacc_bench: line %d: "	\
+			       "%s failed\n", __LINE__, #cond);		\
+			return -EIO;					\
+		}							\
+	} while (0)
+
+static int regacc_selftest(struct cpcap_device *cpcap)
+{
+	static const struct cpcap_regacc ops[] = {
+		{ CPCAP_REG_ADCC2, 0x0001, 0x0001 },
+		{ CPCAP_REG_ADCC2, 0x0002, 0x0002 },
+		{ CPCAP_REG_GREENC, 0x0011, 0x03FF },
+		{ CPCAP_REG_GREENC, 0x0100, 0x0300 },
+	};
+	unsigned short values[ARRAY_SIZE(adc_regs)];
+	unsigned short value;
+	int i;
+
+	/* plain and read-modify-write */
+	CHECK(cpcap_regacc_write(cpcap, CPCAP_REG_REDC, 0x0155, 0x03FF) == 0);
+	CHECK(cpcap_regacc_write(cpcap, CPCAP_REG_REDC, 0x0002, 0x0003) == 0);
+	CHECK(cpcap_regacc_read(cpcap, CPCAP_REG_REDC, &value) == 0);
+	CHECK(value == 0x0156);
+	CHECK(cpcap_regacc_sim_peek(cpcap, CPCAP_REG_REDC, &value) == 0);
+	CHECK(value == 0x0156);
+
+	/* constant bits stay untouched */
+	CHECK(cpcap_regacc_write(cpcap, CPCAP_REG_REDC, 0, 0xFC00) == -EINVAL);
+
+	/* the chip changes volatile registers behind the cache */
+	CHECK(cpcap_regacc_sim_poke(cpcap, CPCAP_REG_ADCD0, 0x0123) == 0);
+	CHECK(cpcap_regacc_read(cpcap, CPCAP_REG_ADCD0, &value) == 0);
+	CHECK(value == 0x0123);
+	CHECK(cpcap_regacc_sim_poke(cpcap, CPCAP_REG_ADCD0, 0x0124) == 0);
+	CHECK(cpcap_regacc_read(cpcap, CPCAP_REG_ADCD0, &value) == 0);
+	CHECK(value == 0x0124);
+
+	/* batches */
+	for (i = 0; i < ARRAY_SIZE(adc_regs); i++)
+		CHECK(cpcap_regacc_sim_poke(cpcap, adc_regs[i],
+					    0x0200 + i) == 0);
+	CHECK(cpcap_regacc_read_multi(cpcap, adc_regs, values,
+				      ARRAY_SIZE(adc_regs)) == 0);
+	for (i = 0; i < ARRAY_SIZE(adc_regs); i++)
+		CHECK(values[i] == 0x0200 + i);
+
+	CHECK(cpcap_regacc_write_multi(cpcap, ops, ARRAY_SIZE(ops)) == 0);
+	CHECK(cpcap_regacc_sim_peek(cpcap, CPCAP_REG_ADCC2, &value) == 0);
+	CHECK(value == 0x0003);
+	CHECK(cpcap_regacc_sim_peek(cpcap, CPCAP_REG_GREENC, &value) == 0);
+	CHECK(value == 0x0111);
+
+	/* queued writes are merged and visible before they reach the chip */
+	CHECK(cpcap_regacc_write_async(cpcap, CPCAP_REG_BLUEC, 0x0001,
+				       0x03FF) == 0);
+	CHECK(cpcap_regacc_write_async(cpcap, CPCAP_REG_BLUEC, 0x0030,
+				       0x00F0) == 0);
+	CHECK(cpcap_regacc_read(cpcap, CPCAP_REG_BLUEC, &value) == 0);
+	CHECK(value == 0x0031);
+	CHECK(cpcap_regacc_flush(cpcap) == 0);
+	CHECK(cpcap_regacc_sim_peek(cpcap, CPCAP_REG_BLUEC, &value) == 0);
+	CHECK(value == 0x0031);
+
+	/* a synchronous write takes a queued one along */
+	CHECK(cpcap_regacc_write_async(cpcap, CPCAP_REG_BLUEC, 0x0200,
+				       0x0200) == 0);
+	CHECK(cpcap_regacc_write(cpcap, CPCAP_REG_BLUEC, 0x0000,
+				 0x0001) == 0);
+	CHECK(cpcap_regacc_sim_peek(cpcap, CPCAP_REG_BLUEC, &value) == 0);
+	CHECK(value == 0x0230);
+
+	return 0;
+}
+
+static void regacc_report(struct cpcap_device *cpcap, const char *name,
+			  ktime_t start, struct cpcap_regacc_stats *before)
+{
+	struct cpcap_regacc_stats after;
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	cpcap_regacc_get_stats(cpcap, &after);
+
+	printk(KERN_INFO "cpcap_regacc_bench: %-24s %6lld ns/op, "
+	       "%lu messages, %lu frames\n", name,
+	       div_s64(us * 1000, iterations),
+	       after.messages - before->messages,
+	       after.frames - before->frames);
+
+	*before = after;
+}
+
+static void regacc_bench(struct cpcap_device *cpcap)
+{
+	struct cpcap_regacc_stats stats;
+	unsigned short values[ARRAY_SIZE(adc_regs)];
+	unsigned short value;
+	ktime_t start;
+	unsigned int i;
+	int j;
+
+	cpcap_regacc_get_stats(cpcap, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		cpcap_regacc_read(cpcap, CPCAP_REG_INTM1, &value);
+	regacc_report(cpcap, "read, cached", start, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		cpcap_regacc_read(cpcap, CPCAP_REG_INTS1, &value);
+	regacc_report(cpcap, "read, volatile", start, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		cpcap_regacc_write(cpcap, CPCAP_REG_INTM1, i & 1 ? 0x0001 : 0,
+				   0x0001);
+	regacc_report(cpcap, "mask bit, cached", start, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		cpcap_regacc_write(cpcap, CPCAP_REG_ADCC2, i & 1 ? 0x0001 : 0,
+				   0x0001);
+	regacc_report(cpcap, "mask bit, volatile", start, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < ARRAY_SIZE(adc_regs); j++)
+			cpcap_regacc_read(cpcap, adc_regs[j], &values[j]);
+	regacc_report(cpcap, "adc results, one by one", start, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		cpcap_regacc_read_multi(cpcap, adc_regs, values,
+					ARRAY_SIZE(adc_regs));
+	regacc_report(cpcap, "adc results, batched", start, &stats);
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++)
+		cpcap_regacc_write_async(cpcap, CPCAP_REG_KLC, i & 0x7FFF,
+					 0x7FFF);
+	cpcap_regacc_flush(cpcap);
+	regacc_report(cpcap, "led level, queued", start, &stats);
+}
+
+static int __init cpcap_regacc_bench_init(void)
+{
+	struct cpcap_device *cpcap;
+	int retval;
+
+	if (!iterations)
+		return -EINVAL;
+
+	cpcap = kzalloc(sizeof(*cpcap), GFP_KERNEL);
+	if (!cpcap)
+		return -ENOMEM;
+
+	retval = cpcap_regacc_init(cpcap);
+	if (retval)
+		goto free_mem;
+
+	retval = regacc_selftest(cpcap);
+	if (retval == 0) {
+		printk(KERN_INFO "cpcap_regacc_bench: self-test passed\n");
+		regacc_bench(cpcap);
+	}
+
+	cpcap_regacc_exit(cpcap);
+free_mem:
+	kfree(cpcap);
+	return retval;
+}
+
+static void __exit cpcap_regacc_bench_exit(void)
+{
+}
+
+module_init(cpcap_regacc_bench_init);
+module_exit(cpcap_regacc_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CPCAP register access self-test and benchmark");
@@ -16,15 +16,60 @@
  * 02111-1307, USA
  */
 
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
 #include <linux/device.h>
+#include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 #include <linux/spi/spi.h>
 #include <linux/spi/cpcap.h>
 #include <linux/spi/cpcap-regbits.h>
 
 #define IS_CPCAP(reg) ((reg) >= CPCAP_REG_START && (reg) <= CPCAP_REG_END)
 
-static DEFINE_MUTEX(reg_access);
+/* Registers moved per SPI message, each in its own chip select frame. */
+#define CPCAP_REGACC_BATCH	16
+
+/* How long asynchronous writes wait for more writes to merge with. */
+#define CPCAP_REGACC_FLUSH_DELAY	(HZ / 50)
+
+static int regcache = 1;
+module_param(regcache, bool, S_IRUGO);
+MODULE_PARM_DESC(regcache, "Cache the registers only software changes");
+
+#ifdef CONFIG_MFD_CPCAP_SIM
+static unsigned int sim_msg_us = 20;
+module_param(sim_msg_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(sim_msg_us, "Simulated cost of one SPI message");
+
+static unsigned int sim_frame_us = 2;
+module_param(sim_frame_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(sim_frame_us, "Simulated cost of one register frame");
+
+#define CPCAP_SIM_NUM_ADDR	1184
+#endif
+
+struct cpcap_regacc_data {
+	struct mutex lock;
+	struct cpcap_device *cpcap;
+	unsigned short cache[CPCAP_NUM_REG_CPCAP];
+	DECLARE_BITMAP(valid, CPCAP_NUM_REG_CPCAP);
+	DECLARE_BITMAP(dirty, CPCAP_NUM_REG_CPCAP);
+	struct delayed_work flush_work;
+	struct cpcap_regacc_stats stats;
+	struct dentry *dentry;
+#ifdef CONFIG_MFD_CPCAP_SIM
+	unsigned short *sim_regs;
+#endif
+	struct spi_message msg;
+	struct spi_transfer xfer[CPCAP_REGACC_BATCH];
+	/* DMA buffer, keep it last and on its own cache lines */
+	u32 frame[CPCAP_REGACC_BATCH] ____cacheline_aligned;
+};
 
 /*
  * This table contains information about a single register in the power IC.
@@ -252,80 +297,363 @@ static const struct {
 	[CPCAP_REG_LMACE]     = {1183, 0xFFF8, 0xFFFF},
 };
 
-static int cpcap_spi_access(struct spi_device *spi, u8 *buf,
-			    size_t len)
+/*
+ * Registers the chip changes by itself: interrupt sense bits, macro and
+ * stop watch status, time of day, ADC and coulomb counter results, USB
+ * detection, one wire transfers and GPIO inputs. The BP writes the RF
+ * and SIM supplies over its own SPI port. All of these are always read
+ * from the chip. Registers with an rbw_mask of 0 are written without
+ * reading them, and are not cached either.
+ */
+static int cpcap_reg_volatile(enum cpcap_reg reg)
 {
-	struct spi_message m;
-	struct spi_transfer t = {
-		.tx_buf = buf,
-		.len = len,
-		.rx_buf = buf,
-		.bits_per_word = 32,
-	};
+	if (register_info_tbl[reg].rbw_mask == 0)
+		return 1;
+
+	switch (reg) {
+	case CPCAP_REG_INTS1 ... CPCAP_REG_INTS4:
+	case CPCAP_REG_MI2:
+	case CPCAP_REG_PF:
+	case CPCAP_REG_SW1:
+	case CPCAP_REG_SW2:
+	case CPCAP_REG_TOD1:
+	case CPCAP_REG_TOD2:
+	case CPCAP_REG_DAY:
+	case CPCAP_REG_VRF1C ... CPCAP_REG_VRFREFC:
+	case CPCAP_REG_VSIMC:
+	case CPCAP_REG_CCS1 ... CPCAP_REG_CCI:
+	case CPCAP_REG_ADCC2 ... CPCAP_REG_ADCAL2:
+	case CPCAP_REG_UIS ... CPCAP_REG_USBD:
+	case CPCAP_REG_GPIO0 ... CPCAP_REG_GPIO6:
+	case CPCAP_REG_OW1C ... CPCAP_REG_OW1I:
+	case CPCAP_REG_OW1:
+	case CPCAP_REG_OW2C ... CPCAP_REG_OW2I:
+	case CPCAP_REG_OW2:
+	case CPCAP_REG_OW3C ... CPCAP_REG_OW3I:
+	case CPCAP_REG_OW3:
+	case CPCAP_REG_LGPIN:
+	case CPCAP_REG_LGDET:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static inline int cpcap_reg_cached(enum cpcap_reg reg)
+{
+	return regcache && !cpcap_reg_volatile(reg);
+}
+
+/*
+ * Bits outside rbw_mask may read back differently from what was written,
+ * so only registers that are read back whole are read from the cache.
+ * The others still take their read-before-write bits from it.
+ */
+static inline int cpcap_reg_cache_readable(enum cpcap_reg reg)
+{
+	return cpcap_reg_cached(reg) &&
+		register_info_tbl[reg].rbw_mask == 0xFFFF;
+}
+
+static inline u32 cpcap_frame(unsigned short address, unsigned short data,
+			      int write)
+{
+	return (write ? 0x80000000 : 0) |
+		(((address >> 6) & 0xFF) << 24) |
+		(((address << 2) & 0xFF) << 16) |
+		data;
+}
+
+#ifdef CONFIG_MFD_CPCAP_SIM
+/*
+ * Decode the frames the way the chip does and run them against an
+ * in-memory register file, taking about as long as the SPI bus would.
+ */
+static int cpcap_sim_xfer(struct cpcap_regacc_data *d, int n)
+{
+	unsigned short address;
+	u32 frame;
+	int i;
+
+	udelay(sim_msg_us + n * sim_frame_us);
+
+	for (i = 0; i < n; i++) {
+		frame = d->frame[i];
+		address = (((frame >> 24) & 0x7F) << 6) | ((frame >> 18) & 0x3F);
+		if (address >= CPCAP_SIM_NUM_ADDR)
+			return -EIO;
+
+		if (frame & 0x80000000)
+			d->sim_regs[address] = frame & 0xFFFF;
+		d->frame[i] = d->sim_regs[address];
+	}
+
+	return 0;
+}
+#endif
+
+/*
+ * Send the first n frames in one message. Every register needs its own
+ * chip select cycle, so cs_change separates the transfers.
+ */
+static int cpcap_regacc_xfer(struct cpcap_regacc_data *d, int n)
+{
+	struct spi_device *spi = d->cpcap->spi;
+	struct spi_transfer *t;
+	int i;
+
+	d->stats.messages++;
+	d->stats.frames += n;
+
+#ifdef CONFIG_MFD_CPCAP_SIM
+	if (d->sim_regs)
+		return cpcap_sim_xfer(d, n);
+#endif
+	if (spi == NULL)
+		return -ENOTTY;
+
+	spi_message_init(&d->msg);
+	for (i = 0; i < n; i++) {
+		t = &d->xfer[i];
+		memset(t, 0, sizeof(*t));
+		t->tx_buf = &d->frame[i];
+		t->rx_buf = &d->frame[i];
+		t->len = 4;
+		t->bits_per_word = 32;
+		t->cs_change = i < n - 1;
+		spi_message_add_tail(t, &d->msg);
+	}
+
+	return spi_sync(spi, &d->msg);
+}
+
+static void cpcap_regacc_fill(struct cpcap_regacc_data *d,
+			      enum cpcap_reg reg, unsigned short value)
+{
+	if (!cpcap_reg_cached(reg) || test_bit(reg, d->dirty))
+		return;
+
+	d->cache[reg] = value;
+	set_bit(reg, d->valid);
+}
 
-	spi_message_init(&m);
-	spi_message_add_tail(&t, &m);
-	return spi_sync(spi, &m);
+/*
+ * Read n (at most CPCAP_REGACC_BATCH) registers. The ones the cache
+ * cannot supply are read in a single message. Called with d->lock held.
+ */
+static int cpcap_regacc_read_batch(struct cpcap_regacc_data *d,
+				   const enum cpcap_reg *regs,
+				   unsigned short *values, int n)
+{
+	int slot[CPCAP_REGACC_BATCH];
+	enum cpcap_reg reg;
+	int i;
+	int m = 0;
+	int retval;
+
+	for (i = 0; i < n; i++) {
+		reg = regs[i];
+		d->stats.reads++;
+
+		if (cpcap_reg_cache_readable(reg) && test_bit(reg, d->valid)) {
+			values[i] = d->cache[reg];
+			d->stats.read_hits++;
+			continue;
+		}
+
+		d->frame[m] = cpcap_frame(register_info_tbl[reg].address, 0, 0);
+		slot[m++] = i;
+	}
+
+	if (m == 0)
+		return 0;
+
+	retval = cpcap_regacc_xfer(d, m);
+	if (retval != 0)
+		return retval;
+
+	for (i = 0; i < m; i++) {
+		values[slot[i]] = d->frame[i] & 0xFFFF;
+		cpcap_regacc_fill(d, regs[slot[i]], values[slot[i]]);
+	}
+
+	return 0;
 }
 
-static int cpcap_config_for_read(struct spi_device *spi, unsigned short reg,
-				 unsigned short *data)
+/*
+ * Write n (at most CPCAP_REGACC_BATCH) registers in order. The
+ * read-before-write values the cache does not hold are read first, all
+ * in one message, and then all the writes go out in another. A register
+ * that is not cached must not need reading twice in one batch.
+ * Called with d->lock held.
+ */
+static int cpcap_regacc_write_batch(struct cpcap_regacc_data *d,
+				    const struct cpcap_regacc *ops, int n)
 {
-	int status = -ENOTTY;
-	u32 buf32;  /* force buf to be 32bit aligned */
-	u8 *buf = (u8 *) &buf32;
+	unsigned short old_value[CPCAP_REGACC_BATCH];
+	int slot[CPCAP_REGACC_BATCH];
+	enum cpcap_reg reg;
+	unsigned short value;
+	int i;
+	int m = 0;
+	int retval;
+
+	for (i = 0; i < n; i++) {
+		reg = ops[i].reg;
+		old_value[i] = 0;
+
+		if (register_info_tbl[reg].rbw_mask == 0)
+			continue;
+
+		if (cpcap_reg_cached(reg) && test_bit(reg, d->valid)) {
+			d->stats.rbw_hits++;
+			continue;
+		}
+
+		d->frame[m] = cpcap_frame(register_info_tbl[reg].address, 0, 0);
+		slot[m++] = i;
+	}
+
+	if (m != 0) {
+		retval = cpcap_regacc_xfer(d, m);
+		if (retval != 0)
+			return retval;
+
+		for (i = 0; i < m; i++) {
+			old_value[slot[i]] = d->frame[i] & 0xFFFF;
+			cpcap_regacc_fill(d, ops[slot[i]].reg,
+					  old_value[slot[i]]);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		reg = ops[i].reg;
 
-	if (spi != NULL) {
-		buf[3] = (reg >> 6) & 0x000000FF;
-		buf[2] = (reg << 2) & 0x000000FF;
-		buf[1] = 0;
-		buf[0] = 0;
+		/* an earlier write in this batch may have changed it */
+		if (cpcap_reg_cached(reg) && test_bit(reg, d->valid))
+			old_value[i] = d->cache[reg];
 
-		status = cpcap_spi_access(spi, buf, 4);
+		old_value[i] &= register_info_tbl[reg].rbw_mask;
+		old_value[i] &= ~ops[i].mask;
+		value = (ops[i].value & ops[i].mask) | old_value[i];
+
+		d->frame[i] = cpcap_frame(register_info_tbl[reg].address,
+					  value, 1);
+		if (cpcap_reg_cached(reg)) {
+			d->cache[reg] = value;
+			set_bit(reg, d->valid);
+		}
+		clear_bit(reg, d->dirty);
+		d->stats.writes++;
+	}
 
-		if (status == 0)
-			*data = buf[0] | (buf[1] << 8);
+	retval = cpcap_regacc_xfer(d, n);
+	if (retval != 0) {
+		/* nobody knows what the chip holds now */
+		for (i = 0; i < n; i++)
+			clear_bit(ops[i].reg, d->valid);
 	}
 
-	return status;
+	return retval;
+}
+
+/* Split ops into batches that cpcap_regacc_write_batch() can take. */
+static int cpcap_regacc_write_locked(struct cpcap_regacc_data *d,
+				     const struct cpcap_regacc *ops, int n)
+{
+	enum cpcap_reg reg;
+	int retval;
+	int c;
+	int i;
+
+	while (n > 0) {
+		for (c = 1; c < n && c < CPCAP_REGACC_BATCH; c++) {
+			reg = ops[c].reg;
+			if (cpcap_reg_cached(reg) ||
+			    register_info_tbl[reg].rbw_mask == 0)
+				continue;
+			for (i = 0; i < c; i++)
+				if (ops[i].reg == reg)
+					break;
+			if (i < c)
+				break;
+		}
+
+		retval = cpcap_regacc_write_batch(d, ops, c);
+		if (retval != 0)
+			return retval;
+
+		ops += c;
+		n -= c;
+	}
+
+	return 0;
 }
 
-static int cpcap_config_for_write(struct spi_device *spi, unsigned short reg,
-				  unsigned short data)
+static int cpcap_regacc_flush_locked(struct cpcap_regacc_data *d)
 {
-	int status = -ENOTTY;
-	u32 buf32;  /* force buf to be 32bit aligned */
-	u8 *buf = (u8 *) &buf32;
+	struct cpcap_regacc ops[CPCAP_REGACC_BATCH];
+	int retval = 0;
+	int reg;
+	int n = 0;
+
+	for_each_bit(reg, d->dirty, CPCAP_NUM_REG_CPCAP) {
+		ops[n].reg = reg;
+		ops[n].value = d->cache[reg];
+		ops[n].mask = ~register_info_tbl[reg].constant_mask;
+		if (++n == CPCAP_REGACC_BATCH) {
+			retval = cpcap_regacc_write_batch(d, ops, n);
+			if (retval != 0)
+				break;
+			n = 0;
+		}
+	}
 
-	if (spi != NULL) {
-		buf[3] = ((reg >> 6) & 0x000000FF) | 0x80;
-		buf[2] = (reg << 2) & 0x000000FF;
-		buf[1] = (data >> 8) & 0x000000FF;
-		buf[0] = data & 0x000000FF;
+	if (n != 0 && retval == 0)
+		retval = cpcap_regacc_write_batch(d, ops, n);
 
-		status = cpcap_spi_access(spi, buf, 4);
+	if (retval != 0) {
+		printk(KERN_ERR "cpcap: lost queued register writes: %d\n",
+		       retval);
+		bitmap_zero(d->dirty, CPCAP_NUM_REG_CPCAP);
 	}
 
-	return status;
+	return retval;
+}
+
+static void cpcap_regacc_flush_work(struct work_struct *work)
+{
+	struct cpcap_regacc_data *d =
+		container_of(work, struct cpcap_regacc_data, flush_work.work);
+
+	mutex_lock(&d->lock);
+	cpcap_regacc_flush_locked(d);
+	mutex_unlock(&d->lock);
+}
+
+static int cpcap_regacc_valid_op(enum cpcap_reg reg, unsigned short mask)
+{
+	return IS_CPCAP(reg) &&
+		(mask & register_info_tbl[reg].constant_mask) == 0;
 }
 
 int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
 		      unsigned short *value_ptr)
 {
 	int retval = -EINVAL;
-	struct spi_device *spi = cpcap->spi;
+	struct cpcap_regacc_data *d = cpcap->regacc;
 
 	if (IS_CPCAP(reg) && (value_ptr != 0)) {
-		mutex_lock(&reg_access);
+		mutex_lock(&d->lock);
 
-		retval = cpcap_config_for_read(spi, register_info_tbl
-				      [reg].address, value_ptr);
+		retval = cpcap_regacc_read_batch(d, &reg, value_ptr, 1);
 
-		mutex_unlock(&reg_access);
+		mutex_unlock(&d->lock);
 	}
 
 	return retval;
 }
+EXPORT_SYMBOL_GPL(cpcap_regacc_read);
 
 int cpcap_regacc_write(struct cpcap_device *cpcap,
 		       enum cpcap_reg reg,
@@ -333,59 +661,301 @@ int cpcap_regacc_write(struct cpcap_device *cpcap,
 		       unsigned short mask)
 {
 	int retval = -EINVAL;
-	unsigned short old_value = 0;
-	struct cpcap_platform_data *data;
-	struct spi_device *spi = cpcap->spi;
+	struct cpcap_regacc_data *d = cpcap->regacc;
+	struct cpcap_regacc op = {
+		.reg = reg,
+		.value = value,
+		.mask = mask,
+	};
 
-	data = (struct cpcap_platform_data *)spi->controller_data;
+	if (cpcap_regacc_valid_op(reg, mask)) {
+		mutex_lock(&d->lock);
 
-	if (IS_CPCAP(reg) &&
-	    (mask & register_info_tbl[reg].constant_mask) == 0) {
-		mutex_lock(&reg_access);
+		retval = cpcap_regacc_write_batch(d, &op, 1);
 
-		value &= mask;
+		mutex_unlock(&d->lock);
+	}
 
-		if ((register_info_tbl[reg].rbw_mask) != 0) {
-			retval = cpcap_config_for_read(spi, register_info_tbl
-						       [reg].address,
-						       &old_value);
-			if (retval != 0)
-				goto error;
-		}
+	return retval;
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_write);
 
-		old_value &= register_info_tbl[reg].rbw_mask;
-		old_value &= ~mask;
-		value |= old_value;
-		retval = cpcap_config_for_write(spi,
-						register_info_tbl[reg].address,
-						value);
-error:
-		mutex_unlock(&reg_access);
+int cpcap_regacc_read_multi(struct cpcap_device *cpcap,
+			    const enum cpcap_reg *regs,
+			    unsigned short *values, int n)
+{
+	int retval = 0;
+	struct cpcap_regacc_data *d = cpcap->regacc;
+	int c;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (!IS_CPCAP(regs[i]))
+			return -EINVAL;
+
+	mutex_lock(&d->lock);
+
+	for (i = 0; i < n && retval == 0; i += c) {
+		c = min(n - i, CPCAP_REGACC_BATCH);
+		retval = cpcap_regacc_read_batch(d, &regs[i], &values[i], c);
 	}
 
+	mutex_unlock(&d->lock);
+
 	return retval;
 }
+EXPORT_SYMBOL_GPL(cpcap_regacc_read_multi);
 
-int cpcap_regacc_init(struct cpcap_device *cpcap)
+int cpcap_regacc_write_multi(struct cpcap_device *cpcap,
+			     const struct cpcap_regacc *ops, int n)
+{
+	int retval;
+	struct cpcap_regacc_data *d = cpcap->regacc;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (!cpcap_regacc_valid_op(ops[i].reg, ops[i].mask))
+			return -EINVAL;
+
+	mutex_lock(&d->lock);
+	retval = cpcap_regacc_write_locked(d, ops, n);
+	mutex_unlock(&d->lock);
+
+	return retval;
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_write_multi);
+
+/*
+ * Update the cached copy now and write the register to the chip a little
+ * later, together with whatever else is queued by then. Writes to the
+ * same register in between are merged, so this is only for settings
+ * where the intermediate values do not matter and a few milliseconds
+ * of delay are fine. Registers that are not cached are written at once.
+ */
+int cpcap_regacc_write_async(struct cpcap_device *cpcap,
+			     enum cpcap_reg reg,
+			     unsigned short value,
+			     unsigned short mask)
 {
-	unsigned short i;
-	unsigned short mask;
 	int retval = 0;
+	struct cpcap_regacc_data *d = cpcap->regacc;
+	unsigned short old_value;
+
+	if (!cpcap_regacc_valid_op(reg, mask))
+		return -EINVAL;
+
+	if (!cpcap_reg_cache_readable(reg))
+		return cpcap_regacc_write(cpcap, reg, value, mask);
+
+	mutex_lock(&d->lock);
+
+	if (!test_bit(reg, d->valid))
+		retval = cpcap_regacc_read_batch(d, &reg, &old_value, 1);
+
+	if (retval == 0) {
+		old_value = d->cache[reg] & ~mask;
+		d->cache[reg] = (value & mask) | old_value;
+
+		if (test_and_set_bit(reg, d->dirty))
+			d->stats.async_merged++;
+		d->stats.async_writes++;
+	}
+
+	mutex_unlock(&d->lock);
+
+	if (retval == 0)
+		schedule_delayed_work(&d->flush_work,
+				      CPCAP_REGACC_FLUSH_DELAY);
+
+	return retval;
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_write_async);
+
+/* Write out everything cpcap_regacc_write_async() has queued. */
+int cpcap_regacc_flush(struct cpcap_device *cpcap)
+{
+	int retval;
+	struct cpcap_regacc_data *d = cpcap->regacc;
+
+	cancel_delayed_work(&d->flush_work);
+
+	mutex_lock(&d->lock);
+	retval = cpcap_regacc_flush_locked(d);
+	mutex_unlock(&d->lock);
+
+	return retval;
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_flush);
+
+void cpcap_regacc_get_stats(struct cpcap_device *cpcap,
+			    struct cpcap_regacc_stats *stats)
+{
+	struct cpcap_regacc_data *d = cpcap->regacc;
+
+	mutex_lock(&d->lock);
+	*stats = d->stats;
+	mutex_unlock(&d->lock);
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_get_stats);
+
+#ifdef CONFIG_MFD_CPCAP_SIM
+/*
+ * Look at or change the simulated chip behind the cache, the way the
+ * hardware would change a volatile register.
+ */
+int cpcap_regacc_sim_peek(struct cpcap_device *cpcap, enum cpcap_reg reg,
+			  unsigned short *value_ptr)
+{
+	struct cpcap_regacc_data *d = cpcap->regacc;
+
+	if (!IS_CPCAP(reg) || d->sim_regs == NULL)
+		return -EINVAL;
+
+	mutex_lock(&d->lock);
+	*value_ptr = d->sim_regs[register_info_tbl[reg].address];
+	mutex_unlock(&d->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_sim_peek);
+
+int cpcap_regacc_sim_poke(struct cpcap_device *cpcap, enum cpcap_reg reg,
+			  unsigned short value)
+{
+	struct cpcap_regacc_data *d = cpcap->regacc;
+
+	if (!IS_CPCAP(reg) || d->sim_regs == NULL)
+		return -EINVAL;
+
+	mutex_lock(&d->lock);
+	d->sim_regs[register_info_tbl[reg].address] = value;
+	mutex_unlock(&d->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_sim_poke);
+#endif
+
+static int cpcap_regacc_stats_show(struct seq_file *s, void *unused)
+{
+	struct cpcap_regacc_data *d = s->private;
+	struct cpcap_regacc_stats stats;
+
+	cpcap_regacc_get_stats(d->cpcap, &stats);
+
+	seq_printf(s, "reads: %lu\n", stats.reads);
+	seq_printf(s, "read_hits: %lu\n", stats.read_hits);
+	seq_printf(s, "writes: %lu\n", stats.writes);
+	seq_printf(s, "rbw_hits: %lu\n", stats.rbw_hits);
+	seq_printf(s, "async_writes: %lu\n", stats.async_writes);
+	seq_printf(s, "async_merged: %lu\n", stats.async_merged);
+	seq_printf(s, "messages: %lu\n", stats.messages);
+	seq_printf(s, "frames: %lu\n", stats.frames);
+
+	return 0;
+}
+
+static int cpcap_regacc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpcap_regacc_stats_show, inode->i_private);
+}
+
+static const struct file_operations cpcap_regacc_stats_fops = {
+	.open = cpcap_regacc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Without an SPI device (and with CONFIG_MFD_CPCAP_SIM) the registers
+ * live in memory, so the code above can be exercised without a CPCAP.
+ */
+int cpcap_regacc_init(struct cpcap_device *cpcap)
+{
+	struct cpcap_regacc ops[CPCAP_REGACC_BATCH];
+	struct cpcap_regacc_data *d;
 	struct cpcap_platform_data *data;
 	struct spi_device *spi = cpcap->spi;
+	enum cpcap_reg reg;
+	int retval = 0;
+	int n = 0;
+	int i;
+
+	d = kzalloc(sizeof(*d), GFP_KERNEL);
+	if (d == NULL)
+		return -ENOMEM;
+
+	mutex_init(&d->lock);
+	INIT_DELAYED_WORK(&d->flush_work, cpcap_regacc_flush_work);
+	d->cpcap = cpcap;
+	cpcap->regacc = d;
+
+#ifdef CONFIG_MFD_CPCAP_SIM
+	if (spi == NULL) {
+		d->sim_regs = kzalloc(CPCAP_SIM_NUM_ADDR * sizeof(*d->sim_regs),
+				      GFP_KERNEL);
+		if (d->sim_regs == NULL) {
+			retval = -ENOMEM;
+			goto error;
+		}
+		return 0;
+	}
+#endif
 
 	data = (struct cpcap_platform_data *)spi->controller_data;
 
-	for (i = 0; i < data->init_len; i++) {
-		mask = 0xFFFF;
-		mask &= ~(register_info_tbl[data->init[i].reg].constant_mask);
-
-		retval = cpcap_regacc_write(cpcap, data->init[i].reg,
-					    data->init[i].data,
-					    mask);
-		if (retval)
+	/* the whole table goes out in two messages per batch */
+	mutex_lock(&d->lock);
+	for (i = 0; i < data->init_len && retval == 0; i++) {
+		reg = data->init[i].reg;
+		if (!IS_CPCAP(reg)) {
+			retval = -EINVAL;
 			break;
+		}
+
+		ops[n].reg = reg;
+		ops[n].value = data->init[i].data;
+		ops[n].mask = ~register_info_tbl[reg].constant_mask;
+		if (++n == CPCAP_REGACC_BATCH || i == data->init_len - 1) {
+			retval = cpcap_regacc_write_locked(d, ops, n);
+			n = 0;
+		}
 	}
+	mutex_unlock(&d->lock);
+
+	if (retval != 0)
+		goto error;
+
+	d->dentry = debugfs_create_file("cpcap_regacc", S_IRUGO, NULL, d,
+					&cpcap_regacc_stats_fops);
 
+	return 0;
+
+error:
+	cpcap->regacc = NULL;
+	kfree(d);
 	return retval;
 }
+EXPORT_SYMBOL_GPL(cpcap_regacc_init);
+
+void cpcap_regacc_exit(struct cpcap_device *cpcap)
+{
+	struct cpcap_regacc_data *d = cpcap->regacc;
+
+	if (d == NULL)
+		return;
+
+	cancel_delayed_work_sync(&d->flush_work);
+	mutex_lock(&d->lock);
+	cpcap_regacc_flush_locked(d);
+	mutex_unlock(&d->lock);
+
+	debugfs_remove(d->dentry);
+#ifdef CONFIG_MFD_CPCAP_SIM
+	kfree(d->sim_regs);
+#endif
+	cpcap->regacc = NULL;
+	kfree(d);
+}
+EXPORT_SYMBOL_GPL(cpcap_regacc_exit);
@@ -991,6 +991,7 @@ static int kxtf9_probe(struct i2c_client *client,
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	tf9->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
+	tf9->early_suspend.async = true;
 	tf9->early_suspend.suspend = kxtf9_early_suspend;
 	tf9->early_suspend.resume = kxtf9_late_resume;
 	register_early_suspend(&tf9->early_suspend);
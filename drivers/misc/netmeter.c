@@ -20,149 +20,172 @@
 #include <linux/uaccess.h>
 #include <linux/sysfs.h>
 #include <linux/miscdevice.h>
-#include <linux/skbuff.h>
 #include <linux/netdevice.h>
-#include <linux/netfilter.h>
-#include <linux/netfilter_ipv4.h>
-#include <linux/ip.h>
+#include <linux/rtnetlink.h>
 #include <linux/string.h>
+#include <linux/moduleparam.h>
 
 #define DEVICE_NAME	"netmeter"
 
+/* Byte counters exported through sysfs */
+enum {
+	NETMETER_CDMA_IN,
+	NETMETER_CDMA_OUT,
+	NETMETER_GSM_IN,
+	NETMETER_GSM_OUT,
+	NETMETER_NR_COUNTERS,
+};
+
+/* Interfaces we meter, matched by name when they register */
+enum {
+	NETMETER_LINK_GSM,
+	NETMETER_LINK_CDMA,
+	NETMETER_NR_LINKS,
+};
+
+/*
+ * A metered interface, and its byte counters when we last added them up.
+ * The device counts every packet it sends and receives, forwarded ones
+ * included, so nothing is done per packet here.
+ */
+struct netmeter_link {
+	struct net_device *dev;
+	unsigned long rx_bytes;
+	unsigned long tx_bytes;
+};
+
+/* Everything below is protected by RTNL, as the netdevice notifier is */
 struct netmeter_data {
 	struct miscdevice *device;
 	int started;
-	unsigned long long cdma_in;
-	unsigned long long cdma_out;
-	unsigned long long gsm_in;
-	unsigned long long gsm_out;
-	struct nf_hook_ops nfho_in;
-	struct nf_hook_ops nfho_out;
-	struct nf_hook_ops nfho_forward;
+	u64 bytes[NETMETER_NR_COUNTERS];
+	struct netmeter_link links[NETMETER_NR_LINKS];
+	struct notifier_block netdev_nb;
 };
 
 struct netmeter_data *g_dev;
 static char *gsm_devname = "rmnet0";
 static char *cdma_devname = "ppp0";
+/* No longer used: forwarded traffic is in the device counters of ppp0 */
 static char *cdma_dun_devname = "ppp1";
 static char *wifi_devname = "tiwlan0";
 
-static spinlock_t spin_cdma_in;
-static spinlock_t spin_cdma_out;
-static spinlock_t spin_gsm_in;
-static spinlock_t spin_gsm_out;
-
-static void set_cdma_in(unsigned long long , bool);
-static void set_cdma_out(unsigned long long , bool);
-static void set_gsm_in(unsigned long long , bool);
-static void set_gsm_out(unsigned long long , bool);
+module_param(gsm_devname, charp, S_IRUGO);
+module_param(cdma_devname, charp, S_IRUGO);
+module_param(cdma_dun_devname, charp, S_IRUGO);
+module_param(wifi_devname, charp, S_IRUGO);
 
-/*=========================================================================*/
-static unsigned int netmeter_nf_hook_in(unsigned int hooknum,
-			struct sk_buff *skb,
-			const struct net_device *in,
-			const struct net_device *out,
-			int (*okfn)(struct sk_buff *))
-{
-	if (0 == strncmp(gsm_devname, in->name, sizeof(gsm_devname)))
-		set_gsm_in((unsigned long long)(skb->len), false);
-	else if (0 == strncmp(cdma_devname, in->name, sizeof(cdma_devname)))
-		set_cdma_in((unsigned long long)(skb->len), false);
-	return NF_ACCEPT;
-}
+static char **netmeter_link_names[NETMETER_NR_LINKS] = {
+	[NETMETER_LINK_GSM]		= &gsm_devname,
+	[NETMETER_LINK_CDMA]		= &cdma_devname,
+};
 
-static unsigned int netmeter_nf_hook_out(unsigned int hooknum,
-			struct sk_buff *skb,
-			const struct net_device *in,
-			const struct net_device *out,
-			int (*okfn)(struct sk_buff *))
-{
-	if (0 == strncmp(gsm_devname, out->name, sizeof(gsm_devname)))
-		set_gsm_out((unsigned long long)(skb->len), false);
-	else if (0 == strncmp(cdma_devname, out->name, sizeof(cdma_devname)))
-		set_cdma_out((unsigned long long)(skb->len), false);
-	return NF_ACCEPT;
-}
+static const int netmeter_link_counters[NETMETER_NR_LINKS][2] = {
+	[NETMETER_LINK_GSM]	= { NETMETER_GSM_IN, NETMETER_GSM_OUT },
+	[NETMETER_LINK_CDMA]	= { NETMETER_CDMA_IN, NETMETER_CDMA_OUT },
+};
 
-static unsigned int netmeter_nf_hook_forward(unsigned int hooknum,
-			struct sk_buff *skb,
-			const struct net_device *in,
-			const struct net_device *out,
-			int (*okfn)(struct sk_buff *))
+/*
+ * Add what the link's device has counted since the last sample, if we
+ * are started, and take a new sample. The device counters are unsigned
+ * long, so on 32 bit they must be sampled before they wrap, every 4 GiB.
+ */
+static void netmeter_sample(int link)
 {
-	if ((0 == strncmp(cdma_devname, in->name, sizeof(cdma_devname))) &&
-		((0 == strncmp(cdma_dun_devname, out->name,
-			sizeof(cdma_dun_devname))) ||
-		(0 == strncmp(wifi_devname, out->name,
-			sizeof(wifi_devname)))))
-
-		set_cdma_in((unsigned long long)(skb->len), false);
-
-	else if (((0 == strncmp(cdma_dun_devname, in->name,
-		sizeof(cdma_dun_devname))) ||
-		(0 == strncmp(wifi_devname, in->name, sizeof(wifi_devname)))) &&
-		(0 == strncmp(cdma_devname, out->name, sizeof(cdma_devname))))
+	struct netmeter_link *l = &g_dev->links[link];
+	const struct net_device_stats *stats;
 
-		set_cdma_out((unsigned long long)(skb->len), false);
+	ASSERT_RTNL();
+	if (l->dev == NULL)
+		return;
 
-	return NF_ACCEPT;
+	stats = dev_get_stats(l->dev);
+	if (g_dev->started) {
+		g_dev->bytes[netmeter_link_counters[link][0]] +=
+			stats->rx_bytes - l->rx_bytes;
+		g_dev->bytes[netmeter_link_counters[link][1]] +=
+			stats->tx_bytes - l->tx_bytes;
+	}
+	l->rx_bytes = stats->rx_bytes;
+	l->tx_bytes = stats->tx_bytes;
 }
 
-static void set_cdma_in(unsigned long long data, bool reset_data)
+static void netmeter_sample_all(void)
 {
-	spin_lock(&spin_cdma_in);
-	if (reset_data)
-		g_dev->cdma_in = data;
-	else
-		g_dev->cdma_in += data;
-	spin_unlock(&spin_cdma_in);
+	int i;
 
+	for (i = 0; i < NETMETER_NR_LINKS; i++)
+		netmeter_sample(i);
 }
 
-static void set_gsm_in(unsigned long long data, bool reset_data)
+/* Consistent view of all counters */
+static void netmeter_snapshot(u64 *bytes)
 {
-	spin_lock(&spin_gsm_in);
-	if (reset_data)
-		g_dev->gsm_in = data;
-	else
-		g_dev->gsm_in += data;
-	spin_unlock(&spin_gsm_in);
-
+	rtnl_lock();
+	netmeter_sample_all();
+	memcpy(bytes, g_dev->bytes, sizeof(g_dev->bytes));
+	rtnl_unlock();
 }
-static void set_cdma_out(unsigned long long data, bool reset_data)
+
+static u64 get_counter(int counter)
 {
-	spin_lock(&spin_cdma_out);
-	if (reset_data)
-		g_dev->cdma_out = data;
-	else
-		g_dev->cdma_out += data;
-	spin_unlock(&spin_cdma_out);
+	u64 bytes[NETMETER_NR_COUNTERS];
+
+	netmeter_snapshot(bytes);
+	return bytes[counter];
 }
 
-static void set_gsm_out(unsigned long long data, bool reset_data)
+static void set_counter(int counter, u64 value)
 {
-	spin_lock(&spin_gsm_out);
-	if (reset_data)
-		g_dev->gsm_out = data;
-	else
-		g_dev->gsm_out += data;
-	spin_unlock(&spin_gsm_out);
+	rtnl_lock();
+	netmeter_sample_all();
+	g_dev->bytes[counter] = value;
+	rtnl_unlock();
 }
 
+/*=========================================================================*/
 
-static int update_nf_hooks(void)
+/*
+ * Classify interfaces once, when they appear or are renamed. A device
+ * that goes away, or is renamed away, has its last bytes added first.
+ * Runs under RTNL.
+ */
+static int netmeter_netdev_event(struct notifier_block *nb,
+			unsigned long event, void *ptr)
 {
-	if (g_dev->started) {
-		nf_register_hook(&(g_dev->nfho_in));
-		nf_register_hook(&(g_dev->nfho_out));
-		nf_register_hook(&(g_dev->nfho_forward));
-	} else {
-		nf_unregister_hook(&(g_dev->nfho_in));
-		nf_unregister_hook(&(g_dev->nfho_out));
-		nf_unregister_hook(&(g_dev->nfho_forward));
+	struct net_device *dev = ptr;
+	const struct net_device_stats *stats;
+	struct netmeter_link *l;
+	int i;
+
+	for (i = 0; i < NETMETER_NR_LINKS; i++) {
+		l = &g_dev->links[i];
+
+		switch (event) {
+		case NETDEV_REGISTER:
+		case NETDEV_CHANGENAME:
+			if (!strcmp(dev->name, *netmeter_link_names[i])) {
+				if (l->dev != dev) {
+					netmeter_sample(i);
+					l->dev = dev;
+					/* counts only from here on */
+					stats = dev_get_stats(dev);
+					l->rx_bytes = stats->rx_bytes;
+					l->tx_bytes = stats->tx_bytes;
+				}
+				break;
+			}
+			/* fall through, the device may have left the name */
+		case NETDEV_UNREGISTER:
+			if (l->dev == dev) {
+				netmeter_sample(i);
+				l->dev = NULL;
+			}
+			break;
+		}
 	}
 
-	return 0;
+	return NOTIFY_DONE;
 }
 
 /*==========================================================================*/
@@ -185,12 +208,11 @@ static ssize_t store_start(struct device *dev,
 	if (r < 0 || (start != 0 && start != 1))
 		return -EINVAL;
 
-	if (g_dev->started != start) {
-		g_dev->started = start;
-		r = update_nf_hooks();
-	}
-	if (r)
-		return r;
+	/* what was counted while stopped is not added when restarting */
+	rtnl_lock();
+	netmeter_sample_all();
+	g_dev->started = start;
+	rtnl_unlock();
 
 	return count;
 }
@@ -200,7 +222,7 @@ static ssize_t store_start(struct device *dev,
 static ssize_t show_cdma_in(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	return snprintf(buf, PAGE_SIZE, "%llu\n", g_dev->cdma_in);
+	return snprintf(buf, PAGE_SIZE, "%llu\n", get_counter(NETMETER_CDMA_IN));
 }
 
 static ssize_t store_cdma_in(struct device *dev,
@@ -213,7 +235,7 @@ static ssize_t store_cdma_in(struct device *dev,
 	r = strict_strtoul(buf, 10, &cdma_in);
 	if (r < 0)
 		return -EINVAL;
-	set_cdma_in((unsigned long long)cdma_in, true);
+	set_counter(NETMETER_CDMA_IN, cdma_in);
 	return count;
 }
 
@@ -221,7 +243,7 @@ static ssize_t store_cdma_in(struct device *dev,
 static ssize_t show_cdma_out(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	return snprintf(buf, PAGE_SIZE, "%llu\n", g_dev->cdma_out);
+	return snprintf(buf, PAGE_SIZE, "%llu\n", get_counter(NETMETER_CDMA_OUT));
 }
 
 static ssize_t store_cdma_out(struct device *dev,
@@ -234,7 +256,7 @@ static ssize_t store_cdma_out(struct device *dev,
 	r = strict_strtoul(buf, 10, &cdma_out);
 	if (r < 0)
 		return -EINVAL;
-	set_cdma_out((unsigned long long)cdma_out, true);
+	set_counter(NETMETER_CDMA_OUT, cdma_out);
 	return count;
 }
 
@@ -242,7 +264,7 @@ static ssize_t store_cdma_out(struct device *dev,
 static ssize_t show_gsm_in(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	return snprintf(buf, PAGE_SIZE, "%llu\n", g_dev->gsm_in);
+	return snprintf(buf, PAGE_SIZE, "%llu\n", get_counter(NETMETER_GSM_IN));
 }
 
 static ssize_t store_gsm_in(struct device *dev,
@@ -255,14 +277,14 @@ static ssize_t store_gsm_in(struct device *dev,
 	r = strict_strtoul(buf, 10, &gsm_in);
 	if (r < 0)
 		return -EINVAL;
-	set_gsm_in((unsigned long long)gsm_in, true);
+	set_counter(NETMETER_GSM_IN, gsm_in);
 	return count;
 }
 
 static ssize_t show_gsm_out(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	return snprintf(buf, PAGE_SIZE, "%llu\n", g_dev->gsm_out);
+	return snprintf(buf, PAGE_SIZE, "%llu\n", get_counter(NETMETER_GSM_OUT));
 }
 
 static ssize_t store_gsm_out(struct device *dev,
@@ -275,17 +297,31 @@ static ssize_t store_gsm_out(struct device *dev,
 	r = strict_strtoul(buf, 10, &gsm_out);
 	if (r < 0)
 		return -EINVAL;
-	set_gsm_out((unsigned long long)gsm_out, true);
+	set_counter(NETMETER_GSM_OUT, gsm_out);
 	return count;
 }
 
 
+/* All counters from one snapshot, for readers that need them to agree */
+static ssize_t show_stats(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	u64 bytes[NETMETER_NR_COUNTERS];
+
+	netmeter_snapshot(bytes);
+
+	return snprintf(buf, PAGE_SIZE, "%llu %llu %llu %llu\n",
+			bytes[NETMETER_CDMA_IN], bytes[NETMETER_CDMA_OUT],
+			bytes[NETMETER_GSM_IN], bytes[NETMETER_GSM_OUT]);
+}
+
 static struct device_attribute netmeter_attrs[] = {
 	__ATTR(start, S_IRUGO | S_IWUGO, show_start, store_start),
 	__ATTR(cdma_in, S_IRUGO | S_IWUGO, show_cdma_in, store_cdma_in),
 	__ATTR(cdma_out, S_IRUGO | S_IWUGO, show_cdma_out, store_cdma_out),
 	__ATTR(gsm_in, S_IRUGO | S_IWUGO, show_gsm_in, store_gsm_in),
 	__ATTR(gsm_out, S_IRUGO | S_IWUGO, show_gsm_out, store_gsm_out),
+	__ATTR(stats, S_IRUGO, show_stats, NULL),
 };
 
 int netmeter_create_sysfs(void)
@@ -383,28 +419,12 @@ static int __init netmeter_init(void)
 	}
 	g_dev->device = &netmeter_misc_device;
 
-	g_dev->nfho_in.hook = netmeter_nf_hook_in;
-	g_dev->nfho_in.pf = PF_INET;
-	g_dev->nfho_in.hooknum = NF_INET_LOCAL_IN;
-	g_dev->nfho_in.priority = NF_IP_PRI_FIRST;
-
-	g_dev->nfho_out.hook = netmeter_nf_hook_out;
-	g_dev->nfho_out.pf = PF_INET;
-	g_dev->nfho_out.hooknum = NF_INET_LOCAL_OUT;
-	g_dev->nfho_out.priority = NF_IP_PRI_FIRST;
-
-	g_dev->nfho_forward.hook = netmeter_nf_hook_forward;
-	g_dev->nfho_forward.pf = PF_INET;
-	g_dev->nfho_forward.hooknum = NF_INET_FORWARD;
-	g_dev->nfho_forward.priority = NF_IP_PRI_FIRST;
-
 	g_dev->started = 1;
 
-	spin_lock_init(&spin_cdma_in);
-	spin_lock_init(&spin_cdma_out);
-	spin_lock_init(&spin_gsm_in);
-	spin_lock_init(&spin_gsm_out);
-	update_nf_hooks();
+	/* replays NETDEV_REGISTER for interfaces that already exist */
+	g_dev->netdev_nb.notifier_call = netmeter_netdev_event;
+	register_netdevice_notifier(&g_dev->netdev_nb);
+
 	rc = netmeter_create_sysfs();
 	if (rc)
 		printk(KERN_ERR "netmeter: create sysfs failed");
@@ -422,10 +442,7 @@ static void __exit netmeter_exit(void)
 {
 	printk(KERN_DEBUG "netmeter_exit\n");
 
-	if (g_dev->started) {
-		nf_unregister_hook(&(g_dev->nfho_in));
-		nf_unregister_hook(&(g_dev->nfho_out));
-	}
+	unregister_netdevice_notifier(&g_dev->netdev_nb);
 
 	netmeter_remove_sysfs();
 	misc_deregister(&netmeter_misc_device);
@@ -480,6 +480,8 @@ int32 InformMUX(void *type, void *param)
 /*
  * CommBuffReleased is called when a commbuff is freed somewhere
  * on the system. This function then handles any credit adjustments.
+ * It may run in any context, so it only accumulates the credit under
+ * credit_lock and leaves delivering it to ProcessSendQueues.
  *
  * Params:
  * channel -- the channel the commbuff belongs to
@@ -490,28 +492,21 @@ void CommBuffReleased(int32 channel, int32 size, void *param)
 {
 	MUX *mux;
 	CHANNELCREDIT *credit;
+	unsigned long flags;
 	int32 replenish_send_limit;
 	int32 replenish_byte_limit;
 	int32 buffers_used;
+	int32 ready;
 
 	DEBUG("CommBuffReleased(%lu, %lu, %p)\n", channel, size, param);
 	DBGFC("CommBuffReleased(%lu, %lu, %p)\n", channel, size, param);
 
 	mux = (MUX *) param;
 
-	enter_write_criticalsection(&mux->lock);
-
-	buffers_used = size / mux->local_rcv_buffer_size;
-
-	if (size % mux->local_rcv_buffer_size)
-		buffers_used++;
+	buffers_used = DIV_ROUND_UP(size, mux->local_rcv_buffer_size);
 
 	credit = &mux->channelcredit[channel];
 
-	credit->replenished_byte_credit +=
-	    (size - sizeof(DATA_PACKET_HDR));
-	credit->replenished_send_credit += buffers_used;
-
 	replenish_send_limit =
 	    credit->max_host_send_credit /
 	    MUX_SENDCREDIT_SEND_LIMIT_DIVISOR;
@@ -519,22 +514,58 @@ void CommBuffReleased(int32 channel, int32 size, void *param)
 	    credit->max_host_byte_credit /
 	    MUX_BYTECREDIT_SEND_LIMIT_DIVISOR;
 
-	if (credit->replenished_send_credit >= replenish_send_limit ||
-	    credit->replenished_byte_credit >= replenish_byte_limit) {
-		DBGFC("Sending Credit: %d, %d, %d", channel,
-		      credit->replenished_byte_credit,
-		      credit->replenished_send_credit);
+	spin_lock_irqsave(&mux->credit_lock, flags);
 
-		AdjustCredit(host_end(COMMAND),
-			     (int8) channel,
-			     credit->replenished_byte_credit,
-			     credit->replenished_send_credit, mux);
+	credit->replenished_byte_credit +=
+	    (size - sizeof(DATA_PACKET_HDR));
+	credit->replenished_send_credit += buffers_used;
+
+	ready = (credit->replenished_send_credit >= replenish_send_limit ||
+		 credit->replenished_byte_credit >= replenish_byte_limit);
+	if (ready)
+		credit->pending = 1;
+
+	spin_unlock_irqrestore(&mux->credit_lock, flags);
+
+	if (ready)
+		task_schedule(&mux->send_task);
+}
 
+/*
+ * DeliverCredit sends the credit CommBuffReleased marked as pending.
+ * It is called from the send task with the mux lock held.
+ *
+ * Params:
+ * mux -- the mux object
+ */
+static void DeliverCredit(MUX *mux)
+{
+	CHANNELCREDIT *credit;
+	unsigned long flags;
+	int32 bytecredit;
+	int32 sendcredit;
+	int32 channel;
+
+	for (channel = 0; channel < mux->maxchannels; channel++) {
+		credit = &mux->channelcredit[channel];
+
+		if (!credit->pending)
+			continue;
+
+		spin_lock_irqsave(&mux->credit_lock, flags);
+		bytecredit = credit->replenished_byte_credit;
+		sendcredit = credit->replenished_send_credit;
 		credit->replenished_byte_credit = 0;
 		credit->replenished_send_credit = 0;
-	}
+		credit->pending = 0;
+		spin_unlock_irqrestore(&mux->credit_lock, flags);
 
-	exit_write_criticalsection(&mux->lock);
+		DBGFC("Sending Credit: %d, %d, %d", channel,
+		      bytecredit, sendcredit);
+
+		AdjustCredit(host_end(COMMAND), (int8) channel,
+			     bytecredit, sendcredit, mux);
+	}
 }
 
 /*
@@ -592,6 +623,9 @@ void ProcessSendQueues(struct work_struct *work)
 	enter_write_criticalsection(&mux->lock);
 	holding_lock = 1;
 
+	/* return the credit for data our interfaces have consumed */
+	DeliverCredit(mux);
+
 	/* while there is queued data that we can't ignore, keep trying */
 	/* to send unless the Link Driver tells us to go away           */
 	while (mux->total_queued_amount > ignore_amount) {
@@ -790,6 +824,7 @@ void ProcessSendQueues(struct work_struct *work)
 void ProcessReceiveQueues(struct work_struct *work)
 {
 	INTERFACEINFORM inform_data;
+	INTERFACEINFORM done_data;
 	CHANNEL **channels;
 	MUX *mux;
 	CHANNEL *recv_channel;
@@ -798,6 +833,7 @@ void ProcessReceiveQueues(struct work_struct *work)
 	int32 channel;
 	int32 result;
 	int32 length;
+	int32 delivered;
 
 	DEBUG("ProcessReceiveQueues(%p)\n", work);
 
@@ -805,6 +841,8 @@ void ProcessReceiveQueues(struct work_struct *work)
 
 	channels = mux->channels;
 	inform_data.source = mux;
+	done_data.source = mux;
+	done_data.inform_type = INFORM_INTERFACE_RECEIVEDONE;
 	queue = &mux->receive_queue;
 
 	disable_task(&mux->receive_task);
@@ -827,6 +865,7 @@ void ProcessReceiveQueues(struct work_struct *work)
 			inform_data.inform_type =
 			    recv_channel->connected_interface->param;
 			queue = &recv_channel->receive_queue;
+			delivered = 0;
 
 			while (queue_length(queue)) {
 				commbuff = dequeue_commbuff(queue);
@@ -858,6 +897,18 @@ void ProcessReceiveQueues(struct work_struct *work)
 
 					break;
 				}
+
+				delivered++;
+			}
+
+			/* let the interface hand over a batch at once */
+			if (delivered) {
+				done_data.data = (void *) channel;
+				LIBRARY_INFORM(&done_data,
+					       recv_channel->
+					       connected_interface->
+					       interface_index,
+					       mux->interface_lib);
 			}
 		}
 	}
@@ -1351,6 +1402,7 @@ int32 CreateMUX(int32 maxchannels,
 	initialize_task(&newmux->shutdown_task, &ShutdownMUX);
 
 	initialize_criticalsection_lock(&newmux->lock);
+	spin_lock_init(&newmux->credit_lock);
 
 	disable_task(&newmux->send_task);
 
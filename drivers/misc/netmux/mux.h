@@ -119,6 +119,7 @@
 #define INFORM_INTERFACE_CHANNELSIGNAL  7
 #define INFORM_INTERFACE_DATA           8
 #define INFORM_INTERFACE_PREPSEND       9
+#define INFORM_INTERFACE_RECEIVEDONE    10
 
 
 /*
@@ -197,6 +198,7 @@ typedef struct CHANNEL {
  * replenished_byte_credit is the number of bytes of credit
  * 	to eventually deliver
  * replenished_send_credit is the amount of send credit to eventually deliver
+ * pending is set once the replenished credit is due to be delivered
  */
 typedef struct CHANNELCREDIT {
 	int32 initialized;
@@ -207,6 +209,7 @@ typedef struct CHANNELCREDIT {
 	int32 client_send_credit;
 	int32 replenished_byte_credit;
 	int32 replenished_send_credit;
+	int32 pending;
 } CHANNELCREDIT;
 
 /*
@@ -232,6 +235,8 @@ typedef struct CHANNELCREDIT {
  * 	shuts down the mux
  * partial_receive defines the MUX receiving state
  * lock synchronizes the mux
+ * credit_lock protects the replenished credit, which is updated
+ * 	whenever a received commbuff is freed
  */
 typedef struct MUX {
 	CHANNEL **channels;
@@ -259,6 +264,7 @@ typedef struct MUX {
 	PARTIAL_RECEIVE partial_receive;
 
 	CRITICALSECTION lock;
+	spinlock_t credit_lock;
 } MUX;
 
 
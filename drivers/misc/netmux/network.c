@@ -53,8 +53,12 @@
 #include <linux/wakelock.h>
 #include <linux/ip.h>
 
+#define NETWORK_NAPI_WEIGHT 64
+
 extern struct wake_lock netmux_send_wakelock;
 
+static void NetworkStopReceive(NETWORKDEVICE *);
+
 /*
  * NetworkInform is called by the mux (and sometimes the
  * config interface) to inform the interface that something
@@ -82,6 +86,10 @@ extern struct wake_lock netmux_send_wakelock;
  * channel has successfuly delivered data. The network interface
  * uses this information push any more data into the mux.
  *
+ * Sixth, it waits for a receive done message, which signifies that
+ * the mux has queued a batch of received data on the channel. The
+ * network interface then schedules its poll to deliver the batch.
+ *
  * Params:
  * param1 -- a custom pointer, in this case an INTERFACEINFORM struct
  * param2 -- a custom pointer, in this case a NETWORKINTERFACE struct
@@ -145,10 +153,17 @@ int32 NetworkInform(void *param1, void *param2)
 
 			init_waitqueue_head(&netdev->event_wait);
 			initialize_commbuff_queue(&netdev->process_queue);
+			skb_queue_head_init(&netdev->rx_queue);
+
+			netif_napi_add(netdev->netdevice, &netdev->napi,
+				       NetworkPoll, NETWORK_NAPI_WEIGHT);
+			napi_enable(&netdev->napi);
+			netdev->napi_enabled = 1;
 
 			result = register_netdev(netdev->netdevice);
 			if (result) {
 				netdev->state = NETWORK_STATE_DEFAULT;
+				NetworkStopReceive(netdev);
 				destroy_commbuff_queue(&netdev->
 						       process_queue);
 
@@ -175,6 +190,8 @@ int32 NetworkInform(void *param1, void *param2)
 					NetworkClose(network->
 						     netdevs[channel].
 						     netdevice);
+					NetworkStopReceive(&network->
+							   netdevs[channel]);
 
 					unregister_netdev(network->
 							  netdevs[channel].
@@ -322,6 +339,28 @@ int32 NetworkInform(void *param1, void *param2)
 		}
 		break;
 
+	case INFORM_INTERFACE_RECEIVEDONE:
+		{
+			channel = (int32) informdata->data;
+
+			if (channel > network->channel_max
+			    || channel < network->channel_min)
+				return DEBUGERROR(ERROR_INVALIDPARAMETER);
+
+			netdev =
+			    &network->netdevs[channel -
+					      network->channel_min];
+
+			/* the poll runs as soon as bottom halves
+			 * are enabled again
+			 */
+			local_bh_disable();
+			if (netdev->napi_enabled)
+				napi_schedule(&netdev->napi);
+			local_bh_enable();
+		}
+		break;
+
 	default:
 		break;
 	}
@@ -332,8 +371,8 @@ int32 NetworkInform(void *param1, void *param2)
 /*
  * NetworkReceive is called when a buffer is available for
  * delivery to an application. The network interface will
- * simply forward the buffer onto the tcp/ip stack and
- * let it do the remainder of the work.
+ * queue the buffer for its napi poll, which forwards it onto
+ * the tcp/ip stack once the mux has finished the batch.
  *
  * Params:
  * commbuff -- a pointer to the received data
@@ -379,11 +418,76 @@ int32 NetworkReceive(COMMBUFF *commbuff, void *param)
 	 * the destructor on us.
 	 */
 	detag_commbuff(commbuff);
-	netif_rx(commbuff);
+
+	if (!netint->netdevs[channel - netint->channel_min].napi_enabled) {
+		free_commbuff(commbuff);
+		return DEBUGERROR(ERROR_NONE);
+	}
+
+	skb_queue_tail(&netint->netdevs[channel - netint->channel_min].
+		       rx_queue, commbuff);
 
 	return DEBUGERROR(ERROR_NONE);
 }
 
+/*
+ * NetworkPoll is the napi poll of a network device. It hands
+ * the buffers NetworkReceive queued to the tcp/ip stack, up to
+ * budget of them per call. They go through GRO, so the segments
+ * of a TCP stream in one batch reach the stack (and are acked)
+ * as one.
+ *
+ * Params:
+ * napi -- the napi context of the network device
+ * budget -- the most buffers to deliver
+ */
+int NetworkPoll(struct napi_struct *napi, int budget)
+{
+	NETWORKDEVICE *device;
+	COMMBUFF *commbuff;
+	int work = 0;
+
+	device = container_of(napi, NETWORKDEVICE, napi);
+
+	while (work < budget) {
+		commbuff = skb_dequeue(&device->rx_queue);
+		if (!commbuff)
+			break;
+
+		napi_gro_receive(napi, commbuff);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+
+		/* a batch queued while we were finishing would otherwise
+		 * wait for the next receive done message
+		 */
+		if (!skb_queue_empty(&device->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
+/*
+ * NetworkStopReceive disables the napi poll of a network device
+ * and drops whatever it had not delivered yet.
+ *
+ * Params:
+ * device -- the network device
+ */
+static void NetworkStopReceive(NETWORKDEVICE *device)
+{
+	if (!device->napi_enabled)
+		return;
+
+	device->napi_enabled = 0;
+	napi_disable(&device->napi);
+	skb_queue_purge(&device->rx_queue);
+}
+
 /*
  * CreateNetworkInterface will create an interface object to be used by
  * a NetMUX. This object will keep track of all settings required to
@@ -470,6 +574,7 @@ int32 DestroyNetworkInterface(NETWORKINTERFACE *netint)
 	for (channel = 0; channel < channel_count; channel++) {
 		if (netint->netdevs[channel].state) {
 			NetworkClose(netint->netdevs[channel].netdevice);
+			NetworkStopReceive(&netint->netdevs[channel]);
 
 			destroy_commbuff_queue(&netint->netdevs[channel].
 					       process_queue);
@@ -511,12 +616,15 @@ void NetworkInit(struct net_device *netdev)
 	DEBUG("NetworkInit(0x%p)\n", netdev);
 
 	netdev->hard_header_len = 0;
+	/* room for the mux data header, so sends need not copy */
+	netdev->needed_headroom = sizeof(DATA_PACKET_HDR);
 	netdev->addr_len = 0;
 	netdev->mtu = 1500;
 	netdev->tx_queue_len = 1000;	/* determine appropriate value */
 	netdev->netdev_ops = &netmux_netdev_ops;
 	netdev->flags = IFF_NOARP;
 	netdev->type = ARPHRD_NONE;
+	netdev->features |= NETIF_F_GRO;
 }
 
 /*
@@ -634,13 +742,20 @@ int NetworkTransmit(COMMBUFF *commbuff, struct net_device *netdev)
 
 	DEBUG("NetworkTransmit(0x%p, 0x%p)\n", commbuff, netdev);
 
+	priv_netdev = netdev_priv(netdev);
+	device = *priv_netdev;
+
+	/* the mux pushes its data header in front of the packet */
+	if (skb_cow_head(commbuff, sizeof(DATA_PACKET_HDR))) {
+		device->stats.tx_dropped++;
+		dev_kfree_skb(commbuff);
+		return 0;
+	}
+
 	/* Acquire NM_send wakelock */
 	DEBUG("Acquire netmux_send_wakelock\n");
 	wake_lock(&netmux_send_wakelock);
 
-	priv_netdev = netdev_priv(netdev);
-	device = *priv_netdev;
-
 	device->stats.tx_bytes += length;
 	device->stats.tx_packets++;
 
@@ -86,6 +86,9 @@
  * 	 space available in the mux channel queue
  * event_wait defines a structure that network devices can sleep on
  * process_queue holds a list of commbuffs to be transmitted
+ * rx_queue holds received commbuffs until the napi poll delivers them
+ * napi is the poll context that hands received data to the stack
+ * napi_enabled records whether napi is enabled
  * netdevice points to the registered network device
  */
 typedef struct NETWORKDEVICE {
@@ -103,6 +106,9 @@ typedef struct NETWORKDEVICE {
 	struct net_device_stats stats;
 	wait_queue_head_t event_wait;
 	COMMBUFFQUEUE process_queue;
+	COMMBUFFQUEUE rx_queue;
+	struct napi_struct napi;
+	int32 napi_enabled;
 	struct net_device *netdevice;
 } NETWORKDEVICE;
 
@@ -144,6 +150,7 @@ void NetworkInit(struct net_device *);
 int NetworkOpen(struct net_device *);
 int NetworkClose(struct net_device *);
 int NetworkTransmit(COMMBUFF *, struct net_device *);
+int NetworkPoll(struct napi_struct *, int);
 struct net_device_stats *NetworkStats(struct net_device *);
 
 
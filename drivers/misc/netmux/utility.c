@@ -52,40 +52,18 @@
 #include <linux/delay.h>
 
 
-#define COMMBUFF_TAG_INDEX_COUNT         4
-#define GET_COMMBUFF_TAG_INDEX(commbuff)  \
-		(((int32)(commbuff)>>5)&(COMMBUFF_TAG_INDEX_COUNT-1))
-
 #define LOG_COMMAND_ALL_WORK 49
 #define LOG_COMMAND_BUFFER 50
 #define LOG_COMMAND_FUNCTION 51
 
-typedef struct LOCALTASK {
-	TASKDATA releasetask;
-	void *released_tagged_commbuffs;
-} LOCALTASK;
-
-static COMMBUFFTAG *commbuff_tags[COMMBUFF_TAG_INDEX_COUNT] = { 0 };
-
-static COMMBUFFTAG *released_tagged_commbuffs = 0;
-
-static LOCALTASK tagged_commbuff_release_task;
-
-void ProcessReleasedCommBuffs(struct work_struct *);
-
 extern char *NetmuxLogState;
 
 void initialize_utilities(void)
 {
-	tagged_commbuff_release_task.released_tagged_commbuffs =
-	    (void *) (&released_tagged_commbuffs);
-	initialize_task(&tagged_commbuff_release_task.releasetask,
-			&ProcessReleasedCommBuffs);
 }
 
 void shutdown_utilities(void)
 {
-	destroy_task(&tagged_commbuff_release_task.releasetask);
 }
 
 /*
@@ -120,67 +98,21 @@ void *alloc_mem(int32 size)
 	return ret;
 }
 
-void ProcessReleasedCommBuffs(struct work_struct *work)
-{
-	INTERRUPT_STATE state;
-	COMMBUFFTAG *taginfo;
-	COMMBUFFTAG *freetag;
-	LOCALTASK *localtask;
-
-	disable_interrupts(state);
-
-	/* grab a local copy of released_tagged_commbuffs */
-	/* and clear the global list                      */
-	localtask = container_of(work, LOCALTASK, releasetask.work);
-	taginfo = *((COMMBUFFTAG **) localtask->released_tagged_commbuffs);
-	*((COMMBUFFTAG **) localtask->released_tagged_commbuffs) = NULL;
-
-	enable_interrupts(state);
-
-	/* then process the local list */
-	while (taginfo) {
-		taginfo->CommBuffRelease(taginfo->channel,
-					 taginfo->size, taginfo->param);
-
-		freetag = taginfo;
-		taginfo = taginfo->next_tag;
-
-		free_mem(freetag);
-	}
-}
-
+/*
+ * FreeCommBuffData is the destructor of a tagged commbuff. The tag lives
+ * in the commbuff's control block, so the release callback runs right
+ * here in whatever context freed the buffer and must not sleep.
+ */
 void FreeCommBuffData(COMMBUFF *commbuff)
 {
-	INTERRUPT_STATE state;
-	COMMBUFFTAG **tags;
-	COMMBUFFTAG *freetag;
-	int32 index;
-
-	index = GET_COMMBUFF_TAG_INDEX(commbuff);
-	tags = &commbuff_tags[index];
-
-	disable_interrupts(state);
-
-	while (*tags) {
-		if ((*tags)->commbuff == commbuff) {
-			freetag = *tags;
-			*tags = freetag->next_tag;
-
-			freetag->next_tag = released_tagged_commbuffs;
-			released_tagged_commbuffs = freetag;
+	COMMBUFFTAG *tag = commbuff_tag(commbuff);
+	void (*release) (int32, int32, void *);
 
-			enable_interrupts(state);
-
-			task_schedule(&tagged_commbuff_release_task.
-				      releasetask);
-
-			return;
-		}
-
-		tags = &(*tags)->next_tag;
-	}
+	release = tag->CommBuffRelease;
+	tag->CommBuffRelease = NULL;
 
-	enable_interrupts(state);
+	if (release)
+		release(tag->channel, tag->size, tag->param);
 }
 
 /*
@@ -297,35 +229,24 @@ COMMBUFF *commbuff_merge(COMMBUFF *focus, COMMBUFF *source)
 void tag_commbuff(COMMBUFF *commbuff, int32 channel, void *param,
 		  void (*release) (int32, int32, void*))
 {
-	INTERRUPT_STATE state;
-	COMMBUFFTAG *newtag;
-	int32 index;
+	COMMBUFFTAG *tag = commbuff_tag(commbuff);
 
-	index = GET_COMMBUFF_TAG_INDEX(commbuff);
+	BUILD_BUG_ON(sizeof(COMMBUFFTAG) > sizeof(commbuff->cb));
 
-	newtag = (COMMBUFFTAG *) int_alloc_mem(sizeof(COMMBUFFTAG));
-
-	newtag->channel = channel;
-	newtag->commbuff = commbuff;
-	newtag->param = param;
-	newtag->size = commbuff_length(commbuff);
-	newtag->CommBuffRelease = release;
+	tag->channel = channel;
+	tag->param = param;
+	tag->size = commbuff_length(commbuff);
+	tag->CommBuffRelease = release;
 
 	commbuff->destructor = &FreeCommBuffData;
-
-	disable_interrupts(state);
-
-	newtag->next_tag = commbuff_tags[index];
-	commbuff_tags[index] = newtag;
-
-	enable_interrupts(state);
 }
 
 void detag_commbuff(COMMBUFF *commbuff)
 {
-	FreeCommBuffData(commbuff);
-
-	commbuff->destructor = 0;
+	if (commbuff->destructor == &FreeCommBuffData) {
+		FreeCommBuffData(commbuff);
+		commbuff->destructor = 0;
+	}
 }
 
 void queue_commbuff(COMMBUFF *commbuff, COMMBUFFQUEUE *queue)
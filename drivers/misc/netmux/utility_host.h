@@ -104,18 +104,20 @@ void *alloc_mem(int32 size);
  */
 typedef struct sk_buff COMMBUFF;
 
+/*
+ * A tagged COMMBUFF carries its release information in the skb control
+ * block, so tagging costs no allocation and no lookup on free.
+ */
 typedef struct COMMBUFFTAG {
-	COMMBUFF *commbuff;
-
 	int32 channel;
 	int32 size;
 	void *param;
 
 	void (*CommBuffRelease) (int32, int32, void *);
-
-	struct COMMBUFFTAG *next_tag;
 } COMMBUFFTAG;
 
+#define commbuff_tag(ptr)                    ((COMMBUFFTAG *)(ptr)->cb)
+
 /*
  * The following declare routines for manipulating data inside a COMMBUFF
  */
@@ -0,0 +1,218 @@
+/*
+ * netmux_fake_linkdriver.c - NetMUX link driver backed by a misc device
+ *
+ * Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Instead of the IPC channel to the BP, the NetMUX is connected to
+ * /dev/netmux_fakelink. Every read() returns one buffer the NetMUX sent
+ * over the link and every write() hands one buffer to the NetMUX as if
+ * the BP had sent it, the same way /dev/net/tun moves packets.
+ *
+ * A user space program playing the BP end of the NetMUX protocol can
+ * then bring up the rmnet interfaces and move data through them, for
+ * instance by bridging a channel to a tun device, so the data path can
+ * be measured without a modem. Only one link driver can register with
+ * the NetMUX, so this one is built instead of the IPC link driver.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/skbuff.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/uaccess.h>
+
+#include "ldprotocol.h"
+
+#define FAKELINK_NAME		"netmux_fakelink"
+#define FAKELINK_MAX_RCV_SIZ	1552
+
+static unsigned int queue_len = 64;
+module_param(queue_len, uint, S_IRUGO);
+MODULE_PARM_DESC(queue_len, "Buffers held for the reader before the NetMUX "
+		 "is deferred");
+
+static struct INTERFACELINK iflink;
+static struct INTERFACEMUX ifmux;
+
+static struct sk_buff_head send_queue;
+static DECLARE_WAIT_QUEUE_HEAD(read_wait);
+static DEFINE_SPINLOCK(fakelink_lock);
+static int mux_deferred;
+
+/*
+ * FakeLinkSend is called by the NetMUX to send data. The buffer waits on
+ * send_queue for the reader; once queue_len buffers are waiting the
+ * NetMUX is deferred until the reader has drained three quarters of them.
+ */
+static unsigned long FakeLinkSend(void *param)
+{
+	struct sk_buff *skb = param;
+
+	spin_lock_bh(&fakelink_lock);
+
+	if (skb_queue_len(&send_queue) >= queue_len) {
+		mux_deferred = 1;
+		spin_unlock_bh(&fakelink_lock);
+		return LDP_ERROR_RECOVERABLE;
+	}
+
+	/* the NetMUX drops its reference once we accept the buffer */
+	__skb_queue_tail(&send_queue, skb_get(skb));
+
+	spin_unlock_bh(&fakelink_lock);
+
+	wake_up_interruptible(&read_wait);
+
+	return LDP_ERROR_NONE;
+}
+
+static unsigned long FakeLinkInform(void *param1, void *param2)
+{
+	return LDP_ERROR_NONE;
+}
+
+static ssize_t fakelink_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct sk_buff *skb;
+	int recovered = 0;
+	ssize_t ret;
+
+	for (;;) {
+		spin_lock_bh(&fakelink_lock);
+		skb = __skb_dequeue(&send_queue);
+		if (skb && mux_deferred &&
+		    skb_queue_len(&send_queue) <= queue_len / 4) {
+			mux_deferred = 0;
+			recovered = 1;
+		}
+		spin_unlock_bh(&fakelink_lock);
+
+		if (skb)
+			break;
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(read_wait,
+					       !skb_queue_empty(&send_queue));
+		if (ret)
+			return ret;
+	}
+
+	if (recovered)
+		ifmux.MUXInform((void *) LDP_INFORM_RECOVERED, ifmux.id);
+
+	/* like tun, a short read truncates the buffer */
+	ret = min_t(size_t, count, skb->len);
+	if (copy_to_user(buf, skb->data, ret))
+		ret = -EFAULT;
+
+	kfree_skb(skb);
+
+	return ret;
+}
+
+static ssize_t fakelink_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct sk_buff *skb;
+
+	if (!count || count > FAKELINK_MAX_RCV_SIZ)
+		return -EINVAL;
+
+	skb = alloc_skb(count, GFP_KERNEL);
+	if (!skb)
+		return -ENOMEM;
+
+	if (copy_from_user(skb_put(skb, count), buf, count)) {
+		kfree_skb(skb);
+		return -EFAULT;
+	}
+
+	ifmux.MUXReceive((void *) skb, ifmux.id);
+
+	/* note that this only drops our reference */
+	kfree_skb(skb);
+
+	return count;
+}
+
+static unsigned int fakelink_poll(struct file *file, poll_table *wait)
+{
+	unsigned int mask = POLLOUT | POLLWRNORM;
+
+	poll_wait(file, &read_wait, wait);
+
+	if (!skb_queue_empty(&send_queue))
+		mask |= POLLIN | POLLRDNORM;
+
+	return mask;
+}
+
+static const struct file_operations fakelink_fops = {
+	.owner = THIS_MODULE,
+	.read = fakelink_read,
+	.write = fakelink_write,
+	.poll = fakelink_poll,
+};
+
+static struct miscdevice fakelink_device = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = FAKELINK_NAME,
+	.fops = &fakelink_fops,
+};
+
+static int __init fakelink_init(void)
+{
+	unsigned long result;
+	int ret;
+
+	if (!queue_len)
+		return -EINVAL;
+
+	skb_queue_head_init(&send_queue);
+
+	iflink.LinkSend = &FakeLinkSend;
+	iflink.LinkInform = &FakeLinkInform;
+	iflink.localMaxRcvSize = FAKELINK_MAX_RCV_SIZ;
+	iflink.remoteMaxRcvSize = FAKELINK_MAX_RCV_SIZ;
+
+	result = RegisterMUXLink(&iflink, &ifmux);
+	if (result != LDP_ERROR_NONE) {
+		printk(KERN_ERR FAKELINK_NAME
+		       ": failed to register with NetMUX: %lu\n", result);
+		return -ENODEV;
+	}
+
+	ret = misc_register(&fakelink_device);
+	if (ret) {
+		UnregisterMUXLink(ifmux.id);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void __exit fakelink_exit(void)
+{
+	misc_deregister(&fakelink_device);
+	UnregisterMUXLink(ifmux.id);
+	skb_queue_purge(&send_queue);
+}
+
+module_init(fakelink_init);
+module_exit(fakelink_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("NetMUX link driver backed by a misc device");
@@ -23,12 +23,19 @@
 #include <linux/android_pmem.h>
 #include <linux/mempolicy.h>
 #include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
+#include <linux/bitmap.h>
+#include <asm/tlbflush.h>
 #include <asm/io.h>
 #include <asm/uaccess.h>
 #include <asm/cacheflush.h>
 
 #define PMEM_MAX_DEVICES 10
 #define PMEM_MAX_ORDER 128
+/* number of buddy free lists, orders above this can't be addressed by an
+ * int index anyway */
+#define PMEM_NUM_ORDERS 31
 #define PMEM_MIN_ALLOC PAGE_SIZE
 
 #define PMEM_DEBUG 1
@@ -74,6 +81,13 @@ struct pmem_data {
 	struct list_head region_list;
 	/* a linked list of data so we can access them for debugging */
 	struct list_head list;
+	/* one bit per page of the allocation that may hold dirty cache lines
+	 * written through a cached mapping, NULL if not tracked */
+	unsigned long *dirty;
+	/* cached master mapping whose pte dirty bits record cpu writes */
+	struct vm_area_struct *track_vma;
+	/* set once another file has connected to this one, only ever set */
+	int shared;
 #if PMEM_DEBUG
 	int ref;
 #endif
@@ -89,6 +103,13 @@ struct pmem_region_node {
 	struct list_head list;
 };
 
+/* accumulated latency of one kind of pmem operation */
+struct pmem_op_stats {
+	unsigned long count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 #define PMEM_DEBUG_MSGS 0
 #if PMEM_DEBUG_MSGS
 #define DLOG(fmt,args...) \
@@ -116,6 +137,10 @@ struct pmem_info {
 	/* the bitmap for the region indicating which entries are allocated
 	 * and which are free */
 	struct pmem_bits *bitmap;
+	/* buddy free lists, one per order, linking the first entry of each
+	 * free block through free_links[index] */
+	struct list_head free_list[PMEM_NUM_ORDERS];
+	struct list_head *free_links;
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
 	/* indicates maps of this region should be cached, if a mix of
@@ -145,6 +170,13 @@ struct pmem_info {
 	 */
 	struct rw_semaphore bitmap_sem;
 
+	/* timing of allocations, mmaps and remaps, protected by
+	 * stats_lock */
+	spinlock_t stats_lock;
+	struct pmem_op_stats alloc_stats;
+	struct pmem_op_stats map_stats;
+	struct pmem_op_stats remap_stats;
+
 	long (*ioctl)(struct file *, unsigned int, unsigned long);
 	int (*release)(struct inode *, struct file *);
 };
@@ -168,6 +200,7 @@ static int id_count;
 #define PMEM_IS_PAGE_ALIGNED(addr) (!((addr) & (~PAGE_MASK)))
 #define PMEM_IS_SUBMAP(data) ((data->flags & PMEM_FLAGS_SUBMAP) && \
 	(!(data->flags & PMEM_FLAGS_UNSUBMAP)))
+#define PMEM_LINK_INDEX(id, link) ((int)((link) - pmem[id].free_links))
 
 static int pmem_release(struct inode *, struct file *);
 static int pmem_mmap(struct file *, struct vm_area_struct *);
@@ -232,6 +265,29 @@ static int is_master_owner(struct file *file)
 	return ret;
 }
 
+static void pmem_free_list_add(int id, int index)
+{
+	list_add(&pmem[id].free_links[index],
+		 &pmem[id].free_list[PMEM_ORDER(id, index)]);
+}
+
+static void pmem_free_list_del(int id, int index)
+{
+	list_del(&pmem[id].free_links[index]);
+}
+
+static void pmem_account(int id, struct pmem_op_stats *stats, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&pmem[id].stats_lock);
+	stats->count++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	spin_unlock(&pmem[id].stats_lock);
+}
+
 static int pmem_free(int id, int index)
 {
 	/* caller should hold the write lock on pmem_sem! */
@@ -245,20 +301,23 @@ static int pmem_free(int id, int index)
 	/* clean up the bitmap, merging any buddies */
 	pmem[id].bitmap[curr].allocated = 0;
 	/* find a slots buddy Buddy# = Slot# ^ (1 << order)
-	 * if the buddy is also free merge them
-	 * repeat until the buddy is not free or end of the bitmap is reached
+	 * if the buddy is also free merge them, taking the buddy off its
+	 * free list, repeat until the buddy is not free or end of the bitmap
+	 * is reached
 	 */
-	do {
+	for (;;) {
 		buddy = PMEM_BUDDY_INDEX(id, curr);
-		if (PMEM_IS_FREE(id, buddy) &&
+		if (buddy < pmem[id].num_entries && PMEM_IS_FREE(id, buddy) &&
 				PMEM_ORDER(id, buddy) == PMEM_ORDER(id, curr)) {
+			pmem_free_list_del(id, buddy);
 			PMEM_ORDER(id, buddy)++;
 			PMEM_ORDER(id, curr)++;
 			curr = min(buddy, curr);
 		} else {
 			break;
 		}
-	} while (curr < pmem[id].num_entries);
+	}
+	pmem_free_list_add(id, curr);
 
 	return 0;
 }
@@ -311,6 +370,7 @@ static int pmem_release(struct inode *inode, struct file *file)
 		}
 
 	file->private_data = NULL;
+	kfree(data->dirty);
 
 	list_for_each_safe(elt, elt2, &data->region_list) {
 		region_node = list_entry(elt, struct pmem_region_node, list);
@@ -349,6 +409,9 @@ static int pmem_open(struct inode *inode, struct file *file)
 	data->vma = NULL;
 	data->pid = 0;
 	data->master_file = NULL;
+	data->dirty = NULL;
+	data->track_vma = NULL;
+	data->shared = 0;
 #if PMEM_DEBUG
 	data->ref = 0;
 #endif
@@ -380,10 +443,9 @@ static int pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	/* return the corresponding pdata[] entry */
-	int curr = 0;
-	int end = pmem[id].num_entries;
-	int best_fit = -1;
+	int best_fit;
 	unsigned long order = pmem_order(len);
+	unsigned long curr;
 
 	if (pmem[id].no_allocator) {
 		DLOG("no allocator");
@@ -393,39 +455,29 @@ static int pmem_allocate(int id, unsigned long len)
 		return len;
 	}
 
-	if (order > PMEM_MAX_ORDER)
+	if (order >= PMEM_NUM_ORDERS)
 		return -1;
 	DLOG("order %lx\n", order);
 
-	/* look through the bitmap:
-	 * 	if you find a free slot of the correct order use it
-	 * 	otherwise, use the best fit (smallest with size > order) slot
+	/* take a free block of the correct order if there is one,
+	 * otherwise the best fit (smallest with size > order) block
 	 */
-	while (curr < end) {
-		if (PMEM_IS_FREE(id, curr)) {
-			if (PMEM_ORDER(id, curr) == (unsigned char)order) {
-				/* set the not free bit and clear others */
-				best_fit = curr;
-				break;
-			}
-			if (PMEM_ORDER(id, curr) > (unsigned char)order &&
-			    (best_fit < 0 ||
-			     PMEM_ORDER(id, curr) < PMEM_ORDER(id, best_fit)))
-				best_fit = curr;
-		}
-		curr = PMEM_NEXT_INDEX(id, curr);
-	}
+	for (curr = order; curr < PMEM_NUM_ORDERS; curr++)
+		if (!list_empty(&pmem[id].free_list[curr]))
+			break;
 
-	/* if best_fit < 0, there are no suitable slots,
-	 * return an error
-	 */
-	if (best_fit < 0) {
+	/* if there are no suitable blocks, return an error */
+	if (curr == PMEM_NUM_ORDERS) {
 		printk("pmem: no space left to allocate!\n");
 		return -1;
 	}
 
+	best_fit = PMEM_LINK_INDEX(id, pmem[id].free_list[curr].next);
+	pmem_free_list_del(id, best_fit);
+
 	/* now partition the best fit:
-	 * 	split the slot into 2 buddies of order - 1
+	 * 	split the slot into 2 buddies of order - 1, the upper one
+	 * 	goes back on the free list
 	 * 	repeat until the slot is of the correct order
 	 */
 	while (PMEM_ORDER(id, best_fit) > (unsigned char)order) {
@@ -433,11 +485,23 @@ static int pmem_allocate(int id, unsigned long len)
 		PMEM_ORDER(id, best_fit) -= 1;
 		buddy = PMEM_BUDDY_INDEX(id, best_fit);
 		PMEM_ORDER(id, buddy) = PMEM_ORDER(id, best_fit);
+		pmem_free_list_add(id, buddy);
 	}
 	pmem[id].bitmap[best_fit].allocated = 1;
 	return best_fit;
 }
 
+static int pmem_allocate_timed(int id, unsigned long len)
+{
+	/* caller should hold the write lock on pmem_sem! */
+	ktime_t start = ktime_get();
+	int index;
+
+	index = pmem_allocate(id, len);
+	pmem_account(id, &pmem[id].alloc_stats, start);
+	return index;
+}
+
 static pgprot_t phys_mem_access_prot(struct file *file, pgprot_t vma_prot)
 {
 	int id = get_id(file);
@@ -474,18 +538,158 @@ static unsigned long pmem_len(int id, struct pmem_data *data)
 		return PMEM_LEN(id, data->index);
 }
 
+static int pmem_garbage_pte(pte_t *pte, pgtable_t token, unsigned long addr,
+			    void *data)
+{
+	struct vm_area_struct *vma = data;
+	int id = get_id(vma->vm_file);
+
+	if (!pte_none(*pte))
+		return -EBUSY;
+	set_pte_at(vma->vm_mm, addr, pte,
+		   pte_mkspecial(pfn_pte(pmem[id].garbage_pfn,
+					 vma->vm_page_prot)));
+	return 0;
+}
+
+static unsigned long pmem_npages(int id, struct pmem_data *data)
+{
+	return pmem_len(id, data) >> PAGE_SHIFT;
+}
+
+static int pmem_is_cached(int id, struct file *file)
+{
+	return pmem[id].cached && !(file->f_flags & O_SYNC);
+}
+
+/* the dirty state is kept per file, but an allocation connected to other
+ * files is also written through their mappings, where this file's state
+ * can't see it. Such allocations are cleaned whole */
+static int pmem_is_shared(struct pmem_data *data)
+{
+	return (data->flags & PMEM_FLAGS_CONNECTED) || data->shared;
+}
+
+static int pmem_dirty_tracked(struct pmem_data *data)
+{
+	return data->dirty && !pmem_is_shared(data);
+}
+
+/* start tracking dirty pages of an allocation, everything is considered
+ * dirty to begin with since earlier users may have left lines behind,
+ * hold the data->sem write lock */
+static int pmem_track_dirty(int id, struct pmem_data *data)
+{
+	unsigned long npages = pmem_npages(id, data);
+
+	if (data->dirty)
+		return 0;
+	data->dirty = kmalloc(BITS_TO_LONGS(npages) * sizeof(long),
+			      GFP_KERNEL);
+	if (!data->dirty)
+		return -ENOMEM;
+	bitmap_fill(data->dirty, npages);
+	return 0;
+}
+
+/* move the pte dirty bits of the tracked mapping into data->dirty and
+ * write protect the ptes again, so the next cpu store faults and marks
+ * the page dirty. The caller holds mmap_sem of the vma's mm and the
+ * data->sem write lock */
+static void pmem_harvest_dirty(int id, struct pmem_data *data,
+			       struct vm_area_struct *vma)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long npages = min(pmem_npages(id, data),
+				   (vma->vm_end - vma->vm_start) >> PAGE_SHIFT);
+	unsigned long addr = vma->vm_start;
+	unsigned long end = addr + (npages << PAGE_SHIFT);
+	unsigned long next;
+	spinlock_t *ptl;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+	int cleaned = 0;
+
+	for (; addr < end; addr = next) {
+		next = pmd_addr_end(addr, end);
+		pgd = pgd_offset(mm, addr);
+		if (pgd_none(*pgd) || pgd_bad(*pgd))
+			continue;
+		pud = pud_offset(pgd, addr);
+		if (pud_none(*pud) || pud_bad(*pud))
+			continue;
+		pmd = pmd_offset(pud, addr);
+		if (pmd_none(*pmd) || pmd_bad(*pmd))
+			continue;
+		pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+		for (; addr < next; addr += PAGE_SIZE, pte++) {
+			if (!pte_present(*pte) || !pte_dirty(*pte))
+				continue;
+			set_bit((addr - vma->vm_start) >> PAGE_SHIFT,
+				data->dirty);
+			set_pte_at(mm, addr, pte, pte_mkclean(*pte));
+			cleaned = 1;
+		}
+		pte_unmap_unlock(pte - 1, ptl);
+	}
+	if (cleaned)
+		flush_tlb_range(vma, vma->vm_start, end);
+}
+
+/* take the locks needed to look at the dirty state of a file: the mmap_sem
+ * of the tracked mapping (if any) and then data->sem for writing, and fold
+ * the pte dirty bits into data->dirty. Returns the mm to pass to
+ * pmem_unlock_dirty */
+static struct mm_struct *pmem_lock_dirty(int id, struct pmem_data *data)
+{
+	struct mm_struct *mm = NULL;
+
+	down_read(&data->sem);
+	/* vma_close needs data->sem, so the vma and its mm stay around */
+	if (data->track_vma) {
+		mm = data->track_vma->vm_mm;
+		if (!atomic_inc_not_zero(&mm->mm_users))
+			mm = NULL;
+	}
+	up_read(&data->sem);
+
+	if (mm)
+		down_read(&mm->mmap_sem);
+	down_write(&data->sem);
+
+	if (data->track_vma) {
+		if (data->track_vma->vm_mm == mm)
+			pmem_harvest_dirty(id, data, data->track_vma);
+		else
+			/* mapping is being torn down, can't trust the ptes */
+			bitmap_fill(data->dirty, pmem_npages(id, data));
+	}
+	return mm;
+}
+
+static void pmem_unlock_dirty(struct pmem_data *data, struct mm_struct *mm)
+{
+	up_write(&data->sem);
+	if (mm) {
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+}
+
 static int pmem_map_garbage(int id, struct vm_area_struct *vma,
 			    struct pmem_data *data, unsigned long offset,
 			    unsigned long len)
 {
-	int i, garbage_pages = len >> PAGE_SHIFT;
-
 	vma->vm_flags |= VM_IO | VM_RESERVED | VM_PFNMAP | VM_SHARED | VM_WRITE;
-	for (i = 0; i < garbage_pages; i++) {
-		if (vm_insert_pfn(vma, vma->vm_start + offset + (i * PAGE_SIZE),
-		    pmem[id].garbage_pfn))
-			return -EAGAIN;
-	}
+	if (!len)
+		return 0;
+	/* fill the whole range in one page table walk instead of a
+	 * vm_insert_pfn per page */
+	if (apply_to_page_range(vma->vm_mm, vma->vm_start + offset, len,
+				pmem_garbage_pte, vma))
+		return -EAGAIN;
 	return 0;
 }
 
@@ -532,6 +736,67 @@ static int pmem_remap_pfn_range(int id, struct vm_area_struct *vma,
 	return pmem_map_pfn_range(id, vma, data, offset, len);
 }
 
+static int pmem_region_cmp(const void *a, const void *b)
+{
+	const struct pmem_region *ra = a, *rb = b;
+
+	if (ra->offset < rb->offset)
+		return -1;
+	return ra->offset > rb->offset;
+}
+
+/* map a freshly created submap vma: the regions on the file's region list
+ * are sorted and merged into contiguous runs which are each mapped with a
+ * single io_remap_pfn_range, and the holes between them get the garbage
+ * page, so no range is mapped twice */
+static int pmem_map_regions(int id, struct vm_area_struct *vma,
+			    struct pmem_data *data)
+{
+	unsigned long vma_size = vma->vm_end - vma->vm_start;
+	unsigned long cursor = 0, start, end;
+	struct pmem_region_node *region_node;
+	struct pmem_region *runs;
+	int i, n = 0, ret = 0;
+
+	list_for_each_entry(region_node, &data->region_list, list)
+		n++;
+	if (!n)
+		return pmem_map_garbage(id, vma, data, 0, vma_size);
+
+	runs = kmalloc(n * sizeof(struct pmem_region), GFP_KERNEL);
+	if (!runs)
+		return -ENOMEM;
+	i = 0;
+	list_for_each_entry(region_node, &data->region_list, list)
+		runs[i++] = region_node->region;
+	sort(runs, n, sizeof(struct pmem_region), pmem_region_cmp, NULL);
+
+	for (i = 0; i < n && cursor < vma_size; i++) {
+		start = max(runs[i].offset, cursor);
+		end = min(runs[i].offset + runs[i].len, vma_size);
+		/* extend the run over any overlapping or adjacent regions */
+		while (i + 1 < n && runs[i + 1].offset <= end) {
+			i++;
+			end = max(end, min(runs[i].offset + runs[i].len,
+					   vma_size));
+		}
+		if (end <= start)
+			continue;
+		DLOG("mapping run: %lx %lx\n", start, end - start);
+		ret = pmem_map_garbage(id, vma, data, cursor, start - cursor);
+		if (!ret)
+			ret = pmem_map_pfn_range(id, vma, data, start,
+						 end - start);
+		if (ret)
+			goto out;
+		cursor = end;
+	}
+	ret = pmem_map_garbage(id, vma, data, cursor, vma_size - cursor);
+out:
+	kfree(runs);
+	return ret;
+}
+
 static void pmem_vma_open(struct vm_area_struct *vma)
 {
 	struct file *file = vma->vm_file;
@@ -560,6 +825,12 @@ static void pmem_vma_close(struct vm_area_struct *vma)
 		return;
 	}
 	down_write(&data->sem);
+	if (data->track_vma == vma) {
+		/* the ptes are gone and with them the record of which pages
+		 * were written */
+		data->track_vma = NULL;
+		bitmap_fill(data->dirty, pmem_npages(get_id(file), data));
+	}
 	if (data->vma == vma) {
 		data->vma = NULL;
 		if ((data->flags & PMEM_FLAGS_CONNECTED) &&
@@ -581,6 +852,7 @@ static int pmem_mmap(struct file *file, struct vm_area_struct *vma)
 	int index;
 	unsigned long vma_size =  vma->vm_end - vma->vm_start;
 	int ret = 0, id = get_id(file);
+	ktime_t start = ktime_get();
 
 	if (vma->vm_pgoff || !PMEM_IS_PAGE_ALIGNED(vma_size)) {
 #if PMEM_DEBUG
@@ -607,7 +879,7 @@ static int pmem_mmap(struct file *file, struct vm_area_struct *vma)
 	/* if file->private_data == unalloced, alloc*/
 	if (data && data->index == -1) {
 		down_write(&pmem[id].bitmap_sem);
-		index = pmem_allocate(id, vma->vm_end - vma->vm_start);
+		index = pmem_allocate_timed(id, vma->vm_end - vma->vm_start);
 		up_write(&pmem[id].bitmap_sem);
 		data->index = index;
 	}
@@ -632,26 +904,11 @@ static int pmem_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_page_prot = phys_mem_access_prot(file, vma->vm_page_prot);
 
 	if (data->flags & PMEM_FLAGS_CONNECTED) {
-		struct pmem_region_node *region_node;
-		struct list_head *elt;
-		if (pmem_map_garbage(id, vma, data, 0, vma_size)) {
+		if (pmem_map_regions(id, vma, data)) {
 			printk("pmem: mmap failed in kernel!\n");
 			ret = -EAGAIN;
 			goto error;
 		}
-		list_for_each(elt, &data->region_list) {
-			region_node = list_entry(elt, struct pmem_region_node,
-						 list);
-			DLOG("remapping file: %p %lx %lx\n", file,
-				region_node->region.offset,
-				region_node->region.len);
-			if (pmem_remap_pfn_range(id, vma, data,
-						 region_node->region.offset,
-						 region_node->region.len)) {
-				ret = -EAGAIN;
-				goto error;
-			}
-		}
 		data->flags |= PMEM_FLAGS_SUBMAP;
 		get_task_struct(current->group_leader);
 		data->task = current->group_leader;
@@ -669,8 +926,13 @@ static int pmem_mmap(struct file *file, struct vm_area_struct *vma)
 		}
 		data->flags |= PMEM_FLAGS_MASTERMAP;
 		data->pid = current->pid;
+		/* cpu writes through a cached mapping are tracked in the pte
+		 * dirty bits so that only written pages need cleaning */
+		if (pmem_is_cached(id, file) && !pmem_track_dirty(id, data))
+			data->track_vma = vma;
 	}
 	vma->vm_ops = &vm_ops;
+	pmem_account(id, &pmem[id].map_stats, start);
 error:
 	up_write(&data->sem);
 	return ret;
@@ -800,9 +1062,15 @@ void flush_pmem_file(struct file *file, unsigned long offset, unsigned long len)
 
 	down_read(&data->sem);
 	vaddr = pmem_start_vaddr(id, data);
-	/* if this isn't a submmapped file, flush the whole thing */
+	/* if this isn't a submmapped file, flush the requested range, or the
+	 * whole thing if no range is given */
 	if (unlikely(!(data->flags & PMEM_FLAGS_CONNECTED))) {
-		dmac_flush_range(vaddr, vaddr + pmem_len(id, data));
+		if (len && offset < pmem_len(id, data)) {
+			len = min(len, pmem_len(id, data) - offset);
+			dmac_flush_range(vaddr + offset, vaddr + offset + len);
+		} else {
+			dmac_flush_range(vaddr, vaddr + pmem_len(id, data));
+		}
 		goto end;
 	}
 	/* otherwise, flush the region of the file we are drawing */
@@ -821,6 +1089,139 @@ end:
 	up_read(&data->sem);
 }
 
+/* clip a range to the allocation, a zero length means all of it */
+static int pmem_clip_range(int id, struct pmem_data *data,
+			   unsigned long *offset, unsigned long *len)
+{
+	unsigned long size = pmem_len(id, data);
+
+	if (!*len) {
+		*offset = 0;
+		*len = size;
+	}
+	if (*offset >= size)
+		return -EINVAL;
+	*len = min(*len, size - *offset);
+	return 0;
+}
+
+/* clean the dirty pages of a range out of the cpu caches, hold the
+ * data->sem write lock */
+static void pmem_clean_dirty(int id, struct pmem_data *data,
+			     unsigned long offset, unsigned long len)
+{
+	unsigned char *vaddr = pmem_start_vaddr(id, data);
+	unsigned long first = offset >> PAGE_SHIFT;
+	unsigned long last = DIV_ROUND_UP(offset + len, PAGE_SIZE);
+	unsigned long i, j;
+
+	if (!pmem_dirty_tracked(data)) {
+		dmac_clean_range(vaddr + offset, vaddr + offset + len);
+		return;
+	}
+
+	for (i = find_next_bit(data->dirty, last, first); i < last;
+	     i = find_next_bit(data->dirty, last, j)) {
+		j = find_next_zero_bit(data->dirty, last, i);
+		dmac_clean_range(vaddr + max(i << PAGE_SHIFT, offset),
+				 vaddr + min(j << PAGE_SHIFT, offset + len));
+		/* only whole pages inside the range are clean now */
+		for (; i < j; i++)
+			if ((i << PAGE_SHIFT) >= offset &&
+			    ((i + 1) << PAGE_SHIFT) <= offset + len)
+				__clear_bit(i, data->dirty);
+	}
+}
+
+/* write back whatever the cpu wrote to part of an allocation, before
+ * handing it to a device that reads it. Only pages written since the
+ * last clean are touched when the writes can be tracked */
+int clean_pmem_file(struct file *file, unsigned long offset,
+		    unsigned long len)
+{
+	struct pmem_data *data;
+	struct mm_struct *mm;
+	int id, ret;
+
+	if (!is_pmem_file(file) || !has_allocation(file))
+		return -EINVAL;
+
+	id = get_id(file);
+	data = (struct pmem_data *)file->private_data;
+	if (!pmem_is_cached(id, file))
+		return 0;
+
+	mm = pmem_lock_dirty(id, data);
+	ret = pmem_clip_range(id, data, &offset, &len);
+	if (!ret)
+		pmem_clean_dirty(id, data, offset, len);
+	pmem_unlock_dirty(data, mm);
+	return ret;
+}
+
+/* drop cached lines of part of an allocation before the cpu reads what a
+ * device wrote there. Reads can't be tracked so the whole range is
+ * invalidated, pages the cpu wrote are cleaned first so no data is lost */
+int inv_pmem_file(struct file *file, unsigned long offset, unsigned long len)
+{
+	struct pmem_data *data;
+	struct mm_struct *mm;
+	unsigned char *vaddr;
+	int id, ret;
+
+	if (!is_pmem_file(file) || !has_allocation(file))
+		return -EINVAL;
+
+	id = get_id(file);
+	data = (struct pmem_data *)file->private_data;
+	if (!pmem_is_cached(id, file))
+		return 0;
+
+	mm = pmem_lock_dirty(id, data);
+	ret = pmem_clip_range(id, data, &offset, &len);
+	if (!ret) {
+		if (data->dirty || pmem_is_shared(data))
+			pmem_clean_dirty(id, data, offset, len);
+		vaddr = pmem_start_vaddr(id, data);
+		dmac_inv_range(vaddr + offset, vaddr + offset + len);
+	}
+	pmem_unlock_dirty(data, mm);
+	return ret;
+}
+
+/* record cpu writes the pte tracking can't see, e.g. through the kernel
+ * mapping. Nothing is recorded for a shared allocation, which is always
+ * cleaned whole */
+static int pmem_mark_dirty(struct file *file, unsigned long offset,
+			   unsigned long len)
+{
+	struct pmem_data *data = (struct pmem_data *)file->private_data;
+	int id = get_id(file);
+	unsigned long i, last;
+	int ret;
+
+	if (!has_allocation(file))
+		return -EINVAL;
+	if (!pmem_is_cached(id, file))
+		return 0;
+
+	down_write(&data->sem);
+	ret = pmem_clip_range(id, data, &offset, &len);
+	if (!ret && pmem_is_shared(data)) {
+		up_write(&data->sem);
+		return 0;
+	}
+	if (!ret)
+		ret = pmem_track_dirty(id, data);
+	if (!ret) {
+		last = DIV_ROUND_UP(offset + len, PAGE_SIZE);
+		for (i = offset >> PAGE_SHIFT; i < last; i++)
+			__set_bit(i, data->dirty);
+	}
+	up_write(&data->sem);
+	return ret;
+}
+
 static int pmem_connect(unsigned long connect, struct file *file)
 {
 	struct pmem_data *data = (struct pmem_data *)file->private_data;
@@ -855,6 +1256,9 @@ static int pmem_connect(unsigned long connect, struct file *file)
 	data->flags |= PMEM_FLAGS_CONNECTED;
 	data->master_fd = connect;
 	data->master_file = src_file;
+	/* from now on the source is written through our mappings too, see
+	 * pmem_is_shared. A plain store: it only ever goes from 0 to 1 */
+	src_data->shared = 1;
 
 err_bad_file:
 	fput_light(src_file, put_needed);
@@ -930,6 +1334,7 @@ int pmem_remap(struct pmem_region *region, struct file *file,
 	struct list_head *elt, *elt2;
 	int id = get_id(file);
 	struct pmem_data *data = (struct pmem_data *)file->private_data;
+	ktime_t start = ktime_get();
 
 	/* pmem region must be aligned on a page boundry */
 	if (unlikely(!PMEM_IS_PAGE_ALIGNED(region->offset) ||
@@ -1017,6 +1422,7 @@ int pmem_remap(struct pmem_region *region, struct file *file,
 
 err:
 	pmem_unlock_data_and_mm(data, mm);
+	pmem_account(id, &pmem[id].remap_stats, start);
 	return ret;
 }
 
@@ -1035,17 +1441,19 @@ static void pmem_revoke(struct file *file, struct pmem_data *data)
 	 * needs to be done */
 	if (ret)
 		return;
-	/* unmap everything */
+	/* unmap everything with a single zap of the whole vma */
 	/* delete the regions and region list nothing is mapped any more */
-	if (data->vma)
+	if (data->vma) {
+		if (!list_empty(&data->region_list))
+			pmem_unmap_pfn_range(id, data->vma, data, 0,
+					     data->vma->vm_end -
+					     data->vma->vm_start);
 		list_for_each_safe(elt, elt2, &data->region_list) {
 			region_node = list_entry(elt, struct pmem_region_node,
 						 list);
-			pmem_unmap_pfn_range(id, data->vma, data,
-					     region_node->region.offset,
-					     region_node->region.len);
 			list_del(elt);
 			kfree(region_node);
+		}
 	}
 	/* delete the master file */
 	pmem_unlock_data_and_mm(data, mm);
@@ -1140,7 +1548,9 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			if (has_allocation(file))
 				return -EINVAL;
 			data = (struct pmem_data *)file->private_data;
-			data->index = pmem_allocate(id, arg);
+			down_write(&pmem[id].bitmap_sem);
+			data->index = pmem_allocate_timed(id, arg);
+			up_write(&pmem[id].bitmap_sem);
 			break;
 		}
 	case PMEM_CONNECT:
@@ -1157,6 +1567,23 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			flush_pmem_file(file, region.offset, region.len);
 			break;
 		}
+	case PMEM_CACHE_DIRTY:
+	case PMEM_CLEAN_CACHES:
+	case PMEM_INV_CACHES:
+		{
+			struct pmem_region region;
+			DLOG("cache op %x\n", cmd);
+			if (copy_from_user(&region, (void __user *)arg,
+					   sizeof(struct pmem_region)))
+				return -EFAULT;
+			if (cmd == PMEM_CACHE_DIRTY)
+				return pmem_mark_dirty(file, region.offset,
+						       region.len);
+			if (cmd == PMEM_CLEAN_CACHES)
+				return clean_pmem_file(file, region.offset,
+						       region.len);
+			return inv_pmem_file(file, region.offset, region.len);
+		}
 	default:
 		if (pmem[id].ioctl)
 			return pmem[id].ioctl(file, cmd, arg);
@@ -1217,6 +1644,136 @@ static struct file_operations debug_fops = {
 };
 #endif
 
+static int stats_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static int stats_print(char *buf, int size, const char *name,
+		       struct pmem_op_stats *stats)
+{
+	u64 avg = 0;
+
+	if (stats->count)
+		avg = div_u64(stats->total_ns, stats->count);
+	return scnprintf(buf, size, "%-6s %10lu %12llu %12llu\n", name,
+			 stats->count, avg, stats->max_ns);
+}
+
+static ssize_t stats_read(struct file *file, char __user *buf, size_t count,
+			  loff_t *ppos)
+{
+	int id = (int)file->private_data;
+	struct pmem_op_stats alloc, map, remap;
+	char buffer[256];
+	int n;
+
+	spin_lock(&pmem[id].stats_lock);
+	alloc = pmem[id].alloc_stats;
+	map = pmem[id].map_stats;
+	remap = pmem[id].remap_stats;
+	spin_unlock(&pmem[id].stats_lock);
+
+	n = scnprintf(buffer, sizeof(buffer), "op          count       avg_ns"
+		      "       max_ns\n");
+	n += stats_print(buffer + n, sizeof(buffer) - n, "alloc", &alloc);
+	n += stats_print(buffer + n, sizeof(buffer) - n, "mmap", &map);
+	n += stats_print(buffer + n, sizeof(buffer) - n, "remap", &remap);
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, n);
+}
+
+static struct file_operations stats_fops = {
+	.read = stats_read,
+	.open = stats_open,
+};
+
+/* flush cost versus buffer size and the fraction of pages the cpu wrote:
+ * a full dmac_flush_range of the buffer against cleaning just the written
+ * pages, run on a scratch allocation taken from the device itself */
+static const unsigned long bench_sizes[] = {
+	64 << 10, 256 << 10, 1 << 20, 4 << 20,
+};
+static const unsigned int bench_pcts[] = { 1, 10, 50, 100 };
+
+static ssize_t bench_read(struct file *file, char __user *buf, size_t count,
+			  loff_t *ppos)
+{
+	int id = (int)file->private_data;
+	struct pmem_data bench;
+	unsigned long npages, i;
+	unsigned int p, step;
+	unsigned char *vaddr;
+	char *buffer;
+	int n, s, index;
+	u64 full_ns, lazy_ns;
+	ktime_t start;
+	ssize_t ret;
+
+	if (*ppos)
+		return 0;
+	if (!pmem[id].cached || pmem[id].no_allocator)
+		return -EINVAL;
+
+	buffer = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buffer)
+		return -ENOMEM;
+
+	n = scnprintf(buffer, PAGE_SIZE, "size      pct    full_ns    lazy_ns\n");
+	for (s = 0; s < ARRAY_SIZE(bench_sizes); s++) {
+		down_write(&pmem[id].bitmap_sem);
+		index = pmem_allocate(id, bench_sizes[s]);
+		up_write(&pmem[id].bitmap_sem);
+		if (index < 0)
+			break;
+
+		/* a private pmem_data standing for a client of the block */
+		memset(&bench, 0, sizeof(bench));
+		bench.index = index;
+		npages = bench_sizes[s] >> PAGE_SHIFT;
+		bench.dirty = kzalloc(BITS_TO_LONGS(npages) * sizeof(long),
+				      GFP_KERNEL);
+		vaddr = pmem_start_vaddr(id, &bench);
+
+		for (p = 0; bench.dirty && p < ARRAY_SIZE(bench_pcts); p++) {
+			step = 100 / bench_pcts[p];
+			for (i = 0; i < npages; i += step)
+				memset(vaddr + (i << PAGE_SHIFT), p, 64);
+			start = ktime_get();
+			dmac_flush_range(vaddr, vaddr + bench_sizes[s]);
+			full_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+			for (i = 0; i < npages; i += step) {
+				memset(vaddr + (i << PAGE_SHIFT), p, 64);
+				__set_bit(i, bench.dirty);
+			}
+			start = ktime_get();
+			pmem_clean_dirty(id, &bench, 0, bench_sizes[s]);
+			lazy_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+			n += scnprintf(buffer + n, PAGE_SIZE - n,
+				       "%-9lu %3u %10llu %10llu\n",
+				       bench_sizes[s], bench_pcts[p], full_ns,
+				       lazy_ns);
+		}
+		kfree(bench.dirty);
+
+		down_write(&pmem[id].bitmap_sem);
+		pmem_free(id, index);
+		up_write(&pmem[id].bitmap_sem);
+	}
+
+	ret = simple_read_from_buffer(buf, count, ppos, buffer, n);
+	kfree(buffer);
+	return ret;
+}
+
+static struct file_operations bench_fops = {
+	.read = bench_read,
+	.open = stats_open,
+};
+
 #if 0
 static struct miscdevice pmem_dev = {
 	.name = "pmem",
@@ -1231,6 +1788,7 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	int err = 0;
 	int i, index = 0;
 	int id = id_count;
+	char name[64];
 	id_count++;
 
 	pmem[id].no_allocator = pdata->no_allocator;
@@ -1241,6 +1799,7 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	pmem[id].ioctl = ioctl;
 	pmem[id].release = release;
 	init_rwsem(&pmem[id].bitmap_sem);
+	spin_lock_init(&pmem[id].stats_lock);
 	init_MUTEX(&pmem[id].data_list_sem);
 	INIT_LIST_HEAD(&pmem[id].data_list);
 	pmem[id].dev.name = pdata->name;
@@ -1263,9 +1822,17 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
 					  pmem[id].num_entries);
 
-	for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
+	pmem[id].free_links = kmalloc(pmem[id].num_entries *
+				      sizeof(struct list_head), GFP_KERNEL);
+	if (!pmem[id].free_links)
+		goto err_no_mem_for_free_links;
+	for (i = 0; i < PMEM_NUM_ORDERS; i++)
+		INIT_LIST_HEAD(&pmem[id].free_list[i]);
+
+	for (i = PMEM_NUM_ORDERS - 1; i >= 0; i--) {
 		if ((pmem[id].num_entries) &  1<<i) {
 			PMEM_ORDER(id, index) = i;
+			pmem_free_list_add(id, index);
 			index = PMEM_NEXT_INDEX(id, index);
 		}
 	}
@@ -1292,8 +1859,18 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	debugfs_create_file(pdata->name, S_IFREG | S_IRUGO, NULL, (void *)id,
 			    &debug_fops);
 #endif
+	snprintf(name, sizeof(name), "%s_stats", pdata->name);
+	debugfs_create_file(name, S_IFREG | S_IRUGO, NULL, (void *)id,
+			    &stats_fops);
+	if (pmem[id].cached && !pmem[id].no_allocator) {
+		snprintf(name, sizeof(name), "%s_flush_bench", pdata->name);
+		debugfs_create_file(name, S_IFREG | S_IRUSR, NULL, (void *)id,
+				    &bench_fops);
+	}
 	return 0;
 error_cant_remap:
+	kfree(pmem[id].free_links);
+err_no_mem_for_free_links:
 	kfree(pmem[id].bitmap);
 err_no_mem_for_metadata:
 	misc_deregister(&pmem[id].dev);
@@ -66,6 +66,9 @@
 #include <linux/init.h>
 #include <linux/uaccess.h>
 #include <linux/bitops.h>
+#include <linux/ktime.h>
+#include <linux/cpufreq.h>
+#include <linux/math64.h>
 
 #include <asm/system.h>
 
@@ -94,6 +97,12 @@
 #define CMDTAG 0x55
 #define DATATAG 0xAA
 
+/* bytes handed to the parser at a time by the loopback test */
+#define TS27010_TEST_CHUNK 512
+#define TS27010_TEST_DEFAULT_KB 4096
+/* writes in a row that find the ring full before the test gives up */
+#define TS27010_TEST_MAX_STALLS 100
+
 static const u8 tty2dlci[NR_MUXS] =
     { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
 static const u8 iscmdtty[NR_MUXS] =
@@ -124,22 +133,17 @@ static const struct dlci_tty dlci2tty[] = {
 	{15, 15},			/* DLCI 16 */
 };
 
-enum recv_state {
-	RECV_STATE_IDLE,
-	RECV_STATE_ADDR,
-	RECV_STATE_CONTROL,
-	RECV_STATE_LEN,
-	RECV_STATE_LEN2,
-	RECV_STATE_DATA,
-	RECV_STATE_END,
-};
-
 /* Bit number in flags of mux_send_struct */
 struct tty_struct *ts27010mux_tty;
 
 static u8 crctable[256];
 static struct ts0710_con ts0710_connection;
 
+/* frames parsed out of this buffer are counted, not delivered */
+static struct ts27010_ringbuf *ts27010_test_rbuf;
+static int ts27010_test_bytes;
+static DEFINE_MUTEX(ts27010_test_lock);
+
 #define DBG_DATA	(1<<0)
 #define DBG_CMD		(1<<1)
 #define DBG_VERBOSE	(1<<2)
@@ -293,6 +297,16 @@ static u8 ts0710_crc_calc(u8 fcs, u8 c)
 	return crctable[fcs ^ c];
 }
 
+static u8 ts0710_crc_span(u8 fcs, const u8 *data, int length)
+{
+	const u8 *table = crctable;
+
+	while (length--)
+		fcs = table[fcs ^ *data++];
+
+	return fcs;
+}
+
 static u8 ts0710_crc_end(u8 fcs)
 {
 	return 0xff - fcs;
@@ -305,12 +319,8 @@ static int ts0710_crc_check(u8 fcs)
 
 static u8 ts0710_crc_data(u8 *data, int length)
 {
-	u8 fcs = ts0710_crc_start();
-
-	while (length--)
-		fcs = ts0710_crc_calc(fcs, *data++);
-
-	return ts0710_crc_end(fcs);
+	return ts0710_crc_end(ts0710_crc_span(ts0710_crc_start(),
+					      data, length));
 }
 
 static void ts0710_pkt_set_header(u8 *data, int len, int addr_ea,
@@ -345,13 +355,13 @@ static void *ts0710_pkt_data(u8 *data)
 		return pkt->data+1;
 }
 
-static int ts0710_pkt_send(struct ts0710_con *ts0710, u8 *data)
+/* add the flags and FCS around a frame built by ts0710_pkt_set_header() */
+static int ts0710_pkt_finish(u8 *data)
 {
 	struct short_frame *pkt = (struct short_frame *)(data + 1);
 	u8 *d;
 	int len;
 	int header_len;
-	int res;
 
 	if (pkt->h.length.ea == 1) {
 		len = pkt->h.length.len;
@@ -369,6 +379,16 @@ static int ts0710_pkt_send(struct ts0710_con *ts0710, u8 *data)
 	d[len] = ts0710_crc_data(data+1, header_len);
 	d[len+1] = TS0710_BASIC_FLAG;
 
+	return len;
+}
+
+static int ts0710_pkt_send(struct ts0710_con *ts0710, u8 *data)
+{
+	int len;
+	int res;
+
+	len = ts0710_pkt_finish(data);
+
 	ts27010_debughex(DBG_VERBOSE, "ts27010: > ",
 			 data, TS0710_FRAME_SIZE(len));
 
@@ -979,6 +999,11 @@ static void ts27010_handle_uih(struct ts0710_con *ts0710, u8 control, int dlci,
 		break;
 	}
 
+	if (unlikely(rbuf == ts27010_test_rbuf)) {
+		ts27010_test_bytes += len;
+		return;
+	}
+
 	ts27010_tty_send_rbuf(tty_idx, rbuf, data_idx, len);
 }
 
@@ -1321,100 +1346,261 @@ int ts27010_mux_line_write_room(int line)
 }
 
 
+#define FLAG_ONES	(~0UL / 0xff)
+#define FLAG_WORD	(FLAG_ONES * TS0710_BASIC_FLAG)
+#define FLAG_HIGHS	(FLAG_ONES * 0x80)
+
+/*
+ * Offset of the first flag byte in data, or len if there is none.
+ * Compares a word at a time once data is aligned.
+ */
+static int ts0710_scan_flag(const u8 *data, int len)
+{
+	const u8 *p = data;
+	const u8 *end = data + len;
+	unsigned long v;
+
+	while (p < end && ((unsigned long)p & (sizeof(long) - 1))) {
+		if (*p == TS0710_BASIC_FLAG)
+			return p - data;
+		p++;
+	}
+
+	while (end - p >= sizeof(long)) {
+		/* a zero byte in v is a flag byte in the data */
+		v = *(const unsigned long *)p ^ FLAG_WORD;
+		if ((v - FLAG_ONES) & ~v & FLAG_HIGHS)
+			break;
+		p += sizeof(long);
+	}
+
+	while (p < end) {
+		if (*p == TS0710_BASIC_FLAG)
+			return p - data;
+		p++;
+	}
+
+	return len;
+}
+
+/* index of the first flag at or after i and before count, or -1 */
+static int ts27010_find_flag(struct ts27010_ringbuf *rbuf, int i, int count)
+{
+	const u8 *data;
+	int n;
+	int off;
+
+	while (i < count) {
+		n = ts27010_ringbuf_span(rbuf, i, count - i, &data);
+		off = ts0710_scan_flag(data, n);
+		if (off < n)
+			return i + off;
+		i += n;
+	}
+
+	return -1;
+}
+
+/*
+ * Parse complete frames out of rbuf. A frame is
+ *   flag, address, control, length (1 or 2 bytes), data, fcs, flag
+ * and the FCS covers only the address, control and length bytes, so
+ * after the header we jump straight to the end of the data. Whatever
+ * follows the last complete frame stays in the buffer for next time.
+ */
 void ts27010_mux_recv(struct ts27010_ringbuf *rbuf)
 {
 	int count;
-	int i;
-	u8 c;
-	int state = RECV_STATE_IDLE;
-	int consume_idx = -1;
-	int data_idx = 0;
-	u8 addr = 0;
-	u8 control = 0;
-	int len = 0;
-	u8 fcs = 0;
+	int i = 0;
+	int consumed = 0;
+	int data_idx;
+	int hdr_len;
+	int len;
+	u8 hdr[4];
+	u8 fcs;
 
 	count = ts27010_ringbuf_level(rbuf);
 
-	for (i = 0; i < count; i++) {
-		c = ts27010_ringbuf_peek(rbuf, i);
-
-		switch (state) {
-		case RECV_STATE_IDLE:
-			if (c == TS0710_BASIC_FLAG) {
-				fcs = ts0710_crc_start();
-				state = RECV_STATE_ADDR;
-			} else {
-				consume_idx = i;
-			}
+	while (i < count) {
+		i = ts27010_find_flag(rbuf, i, count);
+		if (i < 0) {
+			consumed = count;
 			break;
+		}
+		consumed = i;
+
+		/* only the last of a run of flags opens the frame */
+		if (i + 1 < count &&
+		    ts27010_ringbuf_peek(rbuf, i + 1) == TS0710_BASIC_FLAG) {
+			pr_warning("ts27010: RX wrong data. Drop msg.\n");
+			do {
+				i++;
+			} while (i + 1 < count &&
+				 ts27010_ringbuf_peek(rbuf, i + 1) ==
+				 TS0710_BASIC_FLAG);
+			consumed = i;
+		}
 
-		case RECV_STATE_ADDR:
-			if (c != TS0710_BASIC_FLAG) {
-				fcs = ts0710_crc_calc(fcs, c);
-				addr = c;
-				state = RECV_STATE_CONTROL;
-			} else {
-				pr_warning(
-					"ts27010: RX wrong data. Drop msg.\n");
-				consume_idx = i;
-			}
+		/* need the address, control and first length byte */
+		if (count - i - 1 < 3)
 			break;
 
-		case RECV_STATE_CONTROL:
-			fcs = ts0710_crc_calc(fcs, c);
-			control = c;
-			state = RECV_STATE_LEN;
-			break;
+		ts27010_ringbuf_read(rbuf, i + 1, hdr, 3);
+		hdr_len = 3;
+		len = hdr[2] >> 1;
+		if (!(hdr[2] & 0x1)) {
+			if (count - i - 1 < 4)
+				break;
+			hdr[3] = ts27010_ringbuf_peek(rbuf, i + 4);
+			hdr_len = 4;
+			len |= hdr[3] << 7;
+		}
+		data_idx = i + 1 + hdr_len;
 
-		case RECV_STATE_LEN:
-			fcs = ts0710_crc_calc(fcs, c);
-			len = c>>1;
-			if (c & 0x1) {
-				data_idx = i+1;
-				state = RECV_STATE_DATA;
-			} else {
-				state = RECV_STATE_LEN2;
-			}
-			break;
+		if (data_idx + len + 2 > rbuf->len - 1) {
+			pr_warning("ts27010: wrong length, Drop msg.\n");
+			i = data_idx;
+			consumed = i;
+			continue;
+		}
 
-		case RECV_STATE_LEN2:
-			fcs = ts0710_crc_calc(fcs, c);
-			len |= c<<7;
-			data_idx = i+1;
-			if (len + data_idx >= LDISC_BUFFER_SIZE) {
-				pr_warning(
-					"ts27010: wrong length, Drop msg.\n");
-				state = RECV_STATE_IDLE;
-				consume_idx = i;
-				break;
-			}
-			state = RECV_STATE_DATA;
+		/* wait for the rest of the frame */
+		if (data_idx + len + 2 > count)
 			break;
 
-		case RECV_STATE_DATA:
-			if (i == data_idx+len) {
-				/* FCS byte */
-				fcs = ts0710_crc_calc(fcs, c);
-				state = RECV_STATE_END;
-			}
-			break;
+		fcs = ts0710_crc_span(ts0710_crc_start(), hdr, hdr_len);
+		fcs = ts0710_crc_calc(fcs,
+				      ts27010_ringbuf_peek(rbuf, data_idx + len));
 
-		case RECV_STATE_END:
-			if (c == TS0710_BASIC_FLAG && ts0710_crc_check(fcs)) {
-				ts27010_handle_frame(rbuf, addr, control,
-						      data_idx, len);
-			} else {
-				pr_warning("ts27010: lost synchronization\n");
+		if (ts27010_ringbuf_peek(rbuf, data_idx + len + 1) ==
+		    TS0710_BASIC_FLAG && ts0710_crc_check(fcs)) {
+			ts27010_handle_frame(rbuf, hdr[0], hdr[1],
+					     data_idx, len);
+		} else {
+			pr_warning("ts27010: lost synchronization\n");
+		}
+
+		i = data_idx + len + 2;
+		consumed = i;
+	}
+
+	ts27010_ringbuf_consume(rbuf, consumed);
+}
+
+/*
+ * Loopback throughput test for TS0710MUX_IO_TEST_CMD. Feeds kbytes of
+ * payload, as full size UIH frames for the line's DLCI, through a private
+ * ring buffer and the receive parser in UART sized chunks. Frames are
+ * counted instead of being passed to the tty.
+ */
+int ts27010_mux_line_loopback_test(int line, int kbytes)
+{
+	struct ts0710_con *ts0710 = &ts0710_connection;
+	struct ts27010_ringbuf *rbuf;
+	int dlci = tty2dlci[line];
+	u8 *frame;
+	int payload;
+	int frame_len;
+	int off;
+	int n;
+	int stalls = 0;
+	s64 total;
+	s64 sent;
+	u64 ns;
+	u64 rate;
+	unsigned int khz;
+	ktime_t start;
+	int ret = 0;
+	int i;
+
+	if (kbytes <= 0)
+		kbytes = TS27010_TEST_DEFAULT_KB;
+	total = (s64)kbytes << 10;
+
+	if (ts0710->dlci[dlci].state != CONNECTED)
+		return -ENODEV;
+
+	payload = ts0710->dlci[dlci].mtu - 1;
+	frame = kmalloc(TS0710_FRAME_SIZE(payload + 1), GFP_KERNEL);
+	rbuf = ts27010_ringbuf_alloc(LDISC_BUFFER_SIZE);
+	if (frame == NULL || rbuf == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ts0710_pkt_set_header(frame, payload + 1, 1, MCC_CMD, dlci,
+			      CLR_PF(UIH));
+	/* the tag the line expects, or every frame logs a warning */
+	*(u8 *)ts0710_pkt_data(frame) = iscmdtty[line] ? CMDTAG : DATATAG;
+	for (i = 0; i < payload; i++)
+		((u8 *)ts0710_pkt_data(frame))[i + 1] = i;
+	frame_len = TS0710_FRAME_SIZE(ts0710_pkt_finish(frame));
+
+	mutex_lock(&ts27010_test_lock);
+	ts27010_test_rbuf = rbuf;
+	ts27010_test_bytes = 0;
+
+	start = ktime_get();
+	for (sent = 0, off = 0; sent < total; ) {
+		n = ts27010_ringbuf_write(rbuf, frame + off,
+				min(TS27010_TEST_CHUNK, frame_len - off));
+		if (n == 0) {
+			/* ring full: the parser is not consuming it */
+			if (++stalls > TS27010_TEST_MAX_STALLS) {
+				ret = -ETIMEDOUT;
+				break;
 			}
-			consume_idx = i;
-			state = RECV_STATE_IDLE;
-			break;
+			cond_resched();
+		} else {
+			stalls = 0;
+		}
+		off += n;
+		if (off == frame_len) {
+			off = 0;
+			sent += payload;
 		}
+		ts27010_mux_recv(rbuf);
 	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 
-	ts27010_ringbuf_consume(rbuf, consume_idx+1);
+	ts27010_test_rbuf = NULL;
+	n = ts27010_test_bytes;
+	mutex_unlock(&ts27010_test_lock);
+
+	if (ret) {
+		pr_err("ts27010: loopback stalled after %d bytes\n", n);
+		goto out;
+	}
+
+	if (!ns)
+		ns = 1;
+	/* bytes per ms is KB/s */
+	rate = div64_u64((u64)n * 1000000, ns);
+	khz = cpufreq_quick_get(0);
+
+	if (khz && n) {
+		/* hundredths of a cycle per byte */
+		u64 cpb = div64_u64(ns * khz, (u64)n * 10000);
+
+		pr_info("ts27010: loopback %d bytes in %llu us, %llu.%03llu MB/s, "
+			"%llu.%02llu cycles/byte at %u MHz\n",
+			n, div_u64(ns, 1000), div_u64(rate, 1000),
+			rate - div_u64(rate, 1000) * 1000,
+			div_u64(cpb, 100), cpb - div_u64(cpb, 100) * 100,
+			khz / 1000);
+	} else {
+		pr_info("ts27010: loopback %d bytes in %llu us, %llu.%03llu MB/s\n",
+			n, div_u64(ns, 1000), div_u64(rate, 1000),
+			rate - div_u64(rate, 1000) * 1000);
+	}
 
+	if (n != sent)
+		ret = -EIO;
+out:
+	if (rbuf)
+		ts27010_ringbuf_free(rbuf);
+	kfree(frame);
+	return ret;
 }
 
 static int __init mux_init(void)
@@ -31,7 +31,7 @@
 #define NUM_MUX_DATA_FILES 0
 #define NUM_MUX_FILES (NUM_MUX_CMD_FILES  +  NUM_MUX_DATA_FILES)
 
-#define LDISC_BUFFER_SIZE (4096 - sizeof(struct ts27010_ringbuf))
+#define LDISC_BUFFER_SIZE 4096	/* power of two */
 
 /* TODO: should use the IOCTLNUM macros */
 /* Special ioctl() upon a MUX device file for hanging up a call */
@@ -59,6 +59,7 @@ int ts27010_mux_line_write(int line, const unsigned char *buf, int count);
 int ts27010_mux_line_chars_in_buffer(int line);
 int ts27010_mux_line_write_room(int line);
 void ts27010_mux_recv(struct ts27010_ringbuf *rbuf);
+int ts27010_mux_line_loopback_test(int line, int kbytes);
 
 int ts27010_ldisc_init(void);
 void ts27010_ldisc_remove(void);
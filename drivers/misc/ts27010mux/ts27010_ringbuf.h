@@ -2,14 +2,19 @@
  * simple ring buffer
  *
  * supports a concurrent reader and writer without locking
+ *
+ * The size is a power of two so positions wrap with a mask, and data
+ * moves in and out with at most two memcpy()s.
  */
 
+#include <linux/log2.h>
 
 struct ts27010_ringbuf {
 	int len;
+	int mask;
 	int head;
 	int tail;
-	u8 buf[];
+	u8 *buf;
 };
 
 
@@ -17,11 +22,19 @@ static inline struct ts27010_ringbuf *ts27010_ringbuf_alloc(int len)
 {
 	struct ts27010_ringbuf *rbuf;
 
-	rbuf = kzalloc(sizeof(*rbuf) + len, GFP_KERNEL);
+	len = roundup_pow_of_two(len);
+	rbuf = kzalloc(sizeof(*rbuf), GFP_KERNEL);
 	if (rbuf == NULL)
 		return NULL;
 
+	rbuf->buf = kmalloc(len, GFP_KERNEL);
+	if (rbuf->buf == NULL) {
+		kfree(rbuf);
+		return NULL;
+	}
+
 	rbuf->len = len;
+	rbuf->mask = len - 1;
 	rbuf->head = 0;
 	rbuf->tail = 0;
 
@@ -30,17 +43,18 @@ static inline struct ts27010_ringbuf *ts27010_ringbuf_alloc(int len)
 
 static inline void ts27010_ringbuf_free(struct ts27010_ringbuf *rbuf)
 {
+	kfree(rbuf->buf);
 	kfree(rbuf);
 }
 
 static inline int ts27010_ringbuf_level(struct ts27010_ringbuf *rbuf)
 {
-	int level = rbuf->head - rbuf->tail;
+	int level = ACCESS_ONCE(rbuf->head) - ACCESS_ONCE(rbuf->tail);
 
-	if (level < 0)
-		level = rbuf->len + level;
+	/* see the data the writer published along with head */
+	smp_rmb();
 
-	return level;
+	return level & rbuf->mask;
 }
 
 static inline int ts27010_ringbuf_room(struct ts27010_ringbuf *rbuf)
@@ -50,40 +64,67 @@ static inline int ts27010_ringbuf_room(struct ts27010_ringbuf *rbuf)
 
 static inline u8 ts27010_ringbuf_peek(struct ts27010_ringbuf *rbuf, int i)
 {
-	return rbuf->buf[(rbuf->tail + i) % rbuf->len];
+	return rbuf->buf[(rbuf->tail + i) & rbuf->mask];
 }
 
-static inline int ts27010_ringbuf_consume(struct ts27010_ringbuf *rbuf,
-					  int count)
+/*
+ * Point *data at the bytes starting i bytes past the tail. Returns how
+ * many of the next len bytes are contiguous there.
+ */
+static inline int ts27010_ringbuf_span(struct ts27010_ringbuf *rbuf, int i,
+				       int len, const u8 **data)
 {
-	count = min(count, ts27010_ringbuf_level(rbuf));
+	int pos = (rbuf->tail + i) & rbuf->mask;
 
-	rbuf->tail = (rbuf->tail + count) % rbuf->len;
+	*data = &rbuf->buf[pos];
 
-	return count;
+	return min(len, rbuf->len - pos);
 }
 
-static inline int ts27010_ringbuf_push(struct ts27010_ringbuf *rbuf, u8 datum)
+/* copy len bytes starting i bytes past the tail, without consuming them */
+static inline void ts27010_ringbuf_read(struct ts27010_ringbuf *rbuf, int i,
+					u8 *data, int len)
 {
-	if (ts27010_ringbuf_room(rbuf) == 0)
-		return 0;
+	const u8 *p;
+	int n;
 
-	rbuf->buf[rbuf->head] = datum;
-	rbuf->head = (rbuf->head + 1) % rbuf->len;
+	n = ts27010_ringbuf_span(rbuf, i, len, &p);
+	memcpy(data, p, n);
+	memcpy(data + n, rbuf->buf, len - n);
+}
 
-	return 1;
+static inline int ts27010_ringbuf_consume(struct ts27010_ringbuf *rbuf,
+					  int count)
+{
+	count = min(count, ts27010_ringbuf_level(rbuf));
+
+	/* finish reading before the writer can reuse the space */
+	smp_mb();
+	rbuf->tail = (rbuf->tail + count) & rbuf->mask;
+
+	return count;
 }
 
 static inline int ts27010_ringbuf_write(struct ts27010_ringbuf *rbuf,
 					const u8 *data, int len)
 {
-	int count = 0;
-	int i;
+	int head = rbuf->head;
+	int n;
 
-	for (i = 0; i < len; i++)
-		count += ts27010_ringbuf_push(rbuf, data[i]);
+	len = min(len, ts27010_ringbuf_room(rbuf));
 
-	return count;
-}
+	n = min(len, rbuf->len - head);
+	memcpy(&rbuf->buf[head], data, n);
+	memcpy(rbuf->buf, data + n, len - n);
+
+	/* publish the data before the new head */
+	smp_wmb();
+	rbuf->head = (head + len) & rbuf->mask;
 
+	return len;
+}
 
+static inline int ts27010_ringbuf_push(struct ts27010_ringbuf *rbuf, u8 datum)
+{
+	return ts27010_ringbuf_write(rbuf, &datum, 1);
+}
@@ -45,6 +45,9 @@ int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 {
 	struct ts27010_tty_data *td = driver->driver_state;
 	struct tty_struct *tty = td->chan[line].tty;
+	const u8 *data;
+	int count = 0;
+	int n;
 
 	if (!tty) {
 		pr_info("ts27010: mux%d no open.  discarding %d bytes\n",
@@ -52,12 +55,17 @@ int ts27010_tty_send_rbuf(int line, struct ts27010_ringbuf *rbuf,
 		return 0;
 	}
 
-	while (len--) {
-		char c = ts27010_ringbuf_peek(rbuf, data_idx++);
-		tty_insert_flip_char(tty, c, TTY_NORMAL);
+	/* at most two contiguous pieces, either side of the wrap */
+	while (count < len) {
+		n = ts27010_ringbuf_span(rbuf, data_idx + count,
+					 len - count, &data);
+		n = tty_insert_flip_string(tty, data, n);
+		if (n == 0)
+			break;
+		count += n;
 	}
 	tty_flip_buffer_push(tty);
-	return len;
+	return count;
 }
 
 static int ts27010_tty_open(struct tty_struct *tty, struct file *filp)
@@ -163,8 +171,8 @@ static int ts27010_tty_ioctl(struct tty_struct *tty, struct file *file,
 		return 0;
 
 	case TS0710MUX_IO_TEST_CMD:
-		pr_warning("ts27010: ioctl msc_hangup not implemented\n");
-		return 0;
+		/* arg: KB of payload to push through the receive path */
+		return ts27010_mux_line_loopback_test(line, arg);
 
 	default:
 		break;
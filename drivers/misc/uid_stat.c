@@ -16,53 +16,92 @@
 #include <asm/atomic.h>
 
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
+#include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/stat.h>
 #include <linux/uid_stat.h>
 #include <net/activity_stats.h>
+#include <net/net_namespace.h>
 
+#define UID_HASH_BITS	7
+#define UID_HASH_SIZE	(1 << UID_HASH_BITS)
+
+/* Entries are only ever added, lookups walk the hash chains under RCU and
+ * uid_lock serializes insertion. */
 static DEFINE_SPINLOCK(uid_lock);
-static LIST_HEAD(uid_list);
+static struct hlist_head uid_hash[UID_HASH_SIZE];
 static struct proc_dir_entry *parent;
 
+/* Byte counters, one copy per cpu, summed when read. They wrap at 4GB like
+ * the atomic counters they replace. Updates run with bottom halves off, as
+ * tcp_read_sock() counts from softirq and would interrupt a process
+ * context update of the same copy. */
+struct uid_stat_counters {
+	unsigned int tcp_rcv;
+	unsigned int tcp_snd;
+};
+
 struct uid_stat {
-	struct list_head link;
+	struct hlist_node link;
 	uid_t uid;
-	atomic_t tcp_rcv;
-	atomic_t tcp_snd;
+	struct uid_stat_counters *counters;
 };
 
+static struct hlist_head *uid_hash_head(uid_t uid)
+{
+	return &uid_hash[hash_32(uid, UID_HASH_BITS)];
+}
+
 static struct uid_stat *find_uid_stat(uid_t uid) {
-	unsigned long flags;
 	struct uid_stat *entry;
+	struct hlist_node *node;
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_for_each_entry(entry, &uid_list, link) {
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(entry, node, uid_hash_head(uid), link) {
 		if (entry->uid == uid) {
-			spin_unlock_irqrestore(&uid_lock, flags);
+			rcu_read_unlock();
 			return entry;
 		}
 	}
-	spin_unlock_irqrestore(&uid_lock, flags);
+	rcu_read_unlock();
 	return NULL;
 }
 
+static void uid_stat_sum(struct uid_stat *entry, unsigned int *rcv,
+			 unsigned int *snd)
+{
+	struct uid_stat_counters *c;
+	int cpu;
+
+	*rcv = 0;
+	*snd = 0;
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(entry->counters, cpu);
+		*rcv += c->tcp_rcv;
+		*snd += c->tcp_snd;
+	}
+}
+
 static int tcp_snd_read_proc(char *page, char **start, off_t off,
 				int count, int *eof, void *data)
 {
 	int len;
-	unsigned int bytes;
+	unsigned int bytes, unused;
 	char *p = page;
 	struct uid_stat *uid_entry = (struct uid_stat *) data;
 	if (!data)
 		return 0;
 
-	bytes = (unsigned int) (atomic_read(&uid_entry->tcp_snd) + INT_MIN);
+	uid_stat_sum(uid_entry, &unused, &bytes);
 	p += sprintf(p, "%u\n", bytes);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -74,13 +113,13 @@ static int tcp_rcv_read_proc(char *page, char **start, off_t off,
 				int count, int *eof, void *data)
 {
 	int len;
-	unsigned int bytes;
+	unsigned int bytes, unused;
 	char *p = page;
 	struct uid_stat *uid_entry = (struct uid_stat *) data;
 	if (!data)
 		return 0;
 
-	bytes = (unsigned int) (atomic_read(&uid_entry->tcp_rcv) + INT_MIN);
+	uid_stat_sum(uid_entry, &bytes, &unused);
 	p += sprintf(p, "%u\n", bytes);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -92,20 +131,32 @@ static int tcp_rcv_read_proc(char *page, char **start, off_t off,
 static struct uid_stat *create_stat(uid_t uid) {
 	unsigned long flags;
 	char uid_s[32];
-	struct uid_stat *new_uid;
+	struct uid_stat *new_uid, *old_uid;
+	struct hlist_node *node;
 	struct proc_dir_entry *entry;
 
-	/* Create the uid stat struct and append it to the list. */
+	/* Create the uid stat struct and add it to the hash. */
 	if ((new_uid = kmalloc(sizeof(struct uid_stat), GFP_KERNEL)) == NULL)
 		return NULL;
 
 	new_uid->uid = uid;
-	/* Counters start at INT_MIN, so we can track 4GB of network traffic. */
-	atomic_set(&new_uid->tcp_rcv, INT_MIN);
-	atomic_set(&new_uid->tcp_snd, INT_MIN);
+	new_uid->counters = alloc_percpu(struct uid_stat_counters);
+	if (!new_uid->counters) {
+		kfree(new_uid);
+		return NULL;
+	}
 
 	spin_lock_irqsave(&uid_lock, flags);
-	list_add_tail(&new_uid->link, &uid_list);
+	/* Someone else may have raced us to create it. */
+	hlist_for_each_entry(old_uid, node, uid_hash_head(uid), link) {
+		if (old_uid->uid == uid) {
+			spin_unlock_irqrestore(&uid_lock, flags);
+			free_percpu(new_uid->counters);
+			kfree(new_uid);
+			return old_uid;
+		}
+	}
+	hlist_add_head_rcu(&new_uid->link, uid_hash_head(uid));
 	spin_unlock_irqrestore(&uid_lock, flags);
 
 	sprintf(uid_s, "%d", uid);
@@ -121,15 +172,26 @@ static struct uid_stat *create_stat(uid_t uid) {
 	return new_uid;
 }
 
+/* Creating an entry allocates and makes proc entries, which may sleep, so
+ * from softirq only uids that already have an entry are counted. */
+static struct uid_stat *get_uid_stat(uid_t uid)
+{
+	struct uid_stat *entry = find_uid_stat(uid);
+
+	if (entry == NULL && !in_interrupt())
+		entry = create_stat(uid);
+	return entry;
+}
+
 int update_tcp_snd(uid_t uid, int size)
 {
 	struct uid_stat *entry;
 	activity_stats_update();
-	if ((entry = find_uid_stat(uid)) == NULL &&
-		((entry = create_stat(uid)) == NULL)) {
-			return -1;
-	}
-	atomic_add(size, &entry->tcp_snd);
+	if ((entry = get_uid_stat(uid)) == NULL)
+		return -1;
+	local_bh_disable();
+	per_cpu_ptr(entry->counters, smp_processor_id())->tcp_snd += size;
+	local_bh_enable();
 	return 0;
 }
 
@@ -137,14 +199,47 @@ int update_tcp_rcv(uid_t uid, int size)
 {
 	struct uid_stat *entry;
 	activity_stats_update();
-	if ((entry = find_uid_stat(uid)) == NULL &&
-		((entry = create_stat(uid)) == NULL)) {
-			return -1;
+	if ((entry = get_uid_stat(uid)) == NULL)
+		return -1;
+	local_bh_disable();
+	per_cpu_ptr(entry->counters, smp_processor_id())->tcp_rcv += size;
+	local_bh_enable();
+	return 0;
+}
+
+/* /proc/net/stat/uid_stat: one "uid tcp_snd tcp_rcv" line per uid, so all
+ * counters can be collected with a single read. */
+static int uid_stat_all_show(struct seq_file *m, void *v)
+{
+	struct uid_stat *entry;
+	struct hlist_node *node;
+	unsigned int rcv, snd;
+	int i;
+
+	seq_puts(m, "uid tcp_snd tcp_rcv\n");
+	rcu_read_lock();
+	for (i = 0; i < UID_HASH_SIZE; i++) {
+		hlist_for_each_entry_rcu(entry, node, &uid_hash[i], link) {
+			uid_stat_sum(entry, &rcv, &snd);
+			seq_printf(m, "%u %u %u\n", entry->uid, snd, rcv);
+		}
 	}
-	atomic_add(size, &entry->tcp_rcv);
+	rcu_read_unlock();
 	return 0;
 }
 
+static int uid_stat_all_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_stat_all_show, NULL);
+}
+
+static const struct file_operations uid_stat_all_fops = {
+	.open		= uid_stat_all_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init uid_stat_init(void)
 {
 	parent = proc_mkdir("uid_stat", NULL);
@@ -152,6 +247,9 @@ static int __init uid_stat_init(void)
 		pr_err("uid_stat: failed to create proc entry\n");
 		return -1;
 	}
+	if (!proc_create("uid_stat", S_IRUGO, init_net.proc_net_stat,
+			 &uid_stat_all_fops))
+		pr_err("uid_stat: failed to create summary proc entry\n");
 	return 0;
 }
 
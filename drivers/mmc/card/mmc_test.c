@@ -15,6 +15,10 @@
 #include <linux/mmc/mmc.h>
 
 #include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/random.h>
+#include <linux/math64.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -24,6 +28,64 @@
 #define BUFFER_ORDER		2
 #define BUFFER_SIZE		(PAGE_SIZE << BUFFER_ORDER)
 
+/*
+ * Limits of the performance tests: largest request in the size sweep,
+ * smallest test area worth running with, time budget per measurement
+ * and number of log2 microsecond latency buckets.
+ */
+#define PERF_MAX_SIZE		(4 << 20)
+#define PERF_MIN_SIZE		(64 << 10)
+#define PERF_MAX_TIME_NS	(5ULL * NSEC_PER_SEC)
+#define PERF_LAT_BUCKETS	21
+
+static unsigned int perf_total_kb = 4096;
+module_param(perf_total_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(perf_total_kb, "Data moved per performance measurement");
+
+static unsigned int perf_max_sg;
+module_param(perf_max_sg, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(perf_max_sg, "Upper bound of the sg entry sweep (0: host limit)");
+
+/*
+ * A chunk of physically contiguous test memory
+ */
+struct mmc_test_pages {
+	struct page	*page;
+	unsigned int	order;
+};
+
+/*
+ * Memory and card region used by the performance tests
+ */
+struct mmc_test_area {
+	struct mmc_test_pages	*arr;
+	unsigned int		cnt;
+	unsigned long		mem_sz;		/* bytes of test memory */
+	unsigned long		max_tfr;	/* largest request in bytes */
+	unsigned int		max_segs;	/* sg entries per request */
+	unsigned int		dev_sectors;	/* card size in sectors */
+	struct scatterlist	*sg;
+};
+
+/*
+ * Outcome of one performance measurement, kept until the next run on
+ * the same card so that it can be read back through debugfs.
+ */
+struct mmc_test_perf_result {
+	struct list_head	link;
+	struct mmc_card		*card;
+	int			testcase;
+	int			random;
+	int			write;
+	unsigned int		size;
+	unsigned int		sg_len;
+	unsigned int		count;
+	u64			time_ns;
+	unsigned int		lat_min_us;
+	unsigned int		lat_max_us;
+	unsigned int		hist[PERF_LAT_BUCKETS];
+};
+
 struct mmc_test_card {
 	struct mmc_card	*card;
 
@@ -32,8 +94,12 @@ struct mmc_test_card {
 #ifdef CONFIG_HIGHMEM
 	struct page	*highmem;
 #endif
+	int			testcase;
+	struct mmc_test_area	area;
 };
 
+static LIST_HEAD(mmc_test_perf_results);
+
 /*******************************************************************/
 /*  General helper functions                                       */
 /*******************************************************************/
@@ -453,6 +519,306 @@ static int mmc_test_transfer(struct mmc_test_card *test,
 	return 0;
 }
 
+/*******************************************************************/
+/*  Performance test helpers                                       */
+/*******************************************************************/
+
+static unsigned int mmc_test_capacity(struct mmc_card *card)
+{
+	if (mmc_card_mmc(card) && mmc_card_blockaddr(card))
+		return card->ext_csd.sectors;
+
+	return card->csd.capacity << (card->csd.read_blkbits - 9);
+}
+
+static void mmc_test_free_area(struct mmc_test_area *t)
+{
+	while (t->cnt--)
+		__free_pages(t->arr[t->cnt].page, t->arr[t->cnt].order);
+	kfree(t->arr);
+	kfree(t->sg);
+	memset(t, 0, sizeof(struct mmc_test_area));
+}
+
+/*
+ * Allocate up to PERF_MAX_SIZE of test memory in the largest chunks the
+ * host can take in one sg entry, falling back to smaller orders when
+ * memory is fragmented.
+ */
+static int mmc_test_alloc_area(struct mmc_test_card *test)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_area *t = &test->area;
+	unsigned long max_sz = PERF_MAX_SIZE;
+	unsigned int max_order, order, max_cnt;
+	struct page *page;
+
+	max_sz = min_t(unsigned long, max_sz, host->max_req_size);
+	max_sz = min_t(unsigned long, max_sz, host->max_blk_count * 512);
+	max_sz = min_t(unsigned long, max_sz,
+		       (unsigned long)mmc_test_capacity(test->card) << 9);
+	max_sz &= ~511UL;
+
+	max_order = get_order(max_t(unsigned long, host->max_seg_size,
+				    PAGE_SIZE));
+	if (max_order >= MAX_ORDER)
+		max_order = MAX_ORDER - 1;
+
+	max_cnt = DIV_ROUND_UP(max_sz, PAGE_SIZE);
+	t->arr = kzalloc(sizeof(struct mmc_test_pages) * max_cnt, GFP_KERNEL);
+	if (!t->arr)
+		return -ENOMEM;
+
+	order = max_order;
+	while (t->mem_sz < max_sz) {
+		unsigned long left = max_sz - t->mem_sz;
+
+		while (order && (PAGE_SIZE << (order - 1)) >= left)
+			order--;
+
+		page = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+				   order);
+		if (!page) {
+			if (!order)
+				break;
+			order--;
+			continue;
+		}
+
+		t->arr[t->cnt].page = page;
+		t->arr[t->cnt].order = order;
+		t->cnt++;
+		t->mem_sz += PAGE_SIZE << order;
+	}
+
+	if (t->mem_sz < PERF_MIN_SIZE && t->mem_sz < max_sz)
+		goto out_free;
+
+	t->max_tfr = min(t->mem_sz, max_sz);
+	t->max_segs = min(host->max_hw_segs, host->max_phys_segs);
+	if (perf_max_sg && perf_max_sg < t->max_segs)
+		t->max_segs = perf_max_sg;
+	t->dev_sectors = mmc_test_capacity(test->card);
+
+	t->sg = kmalloc(sizeof(struct scatterlist) * t->max_segs, GFP_KERNEL);
+	if (!t->sg)
+		goto out_free;
+
+	return 0;
+
+out_free:
+	mmc_test_free_area(t);
+	return -ENOMEM;
+}
+
+/*
+ * Map the first "size" bytes of the test memory into at most "want"
+ * sg entries of equal length. Returns the number of entries used.
+ */
+static int mmc_test_map_sg(struct mmc_test_card *test, unsigned long size,
+	unsigned int want)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long seg_sz, len, off, chunk;
+	unsigned int i, n = 0;
+
+	seg_sz = ALIGN(DIV_ROUND_UP(size, want), 512);
+	seg_sz = min_t(unsigned long, seg_sz, test->card->host->max_seg_size);
+
+	sg_init_table(t->sg, t->max_segs);
+
+	for (i = 0; size && i < t->cnt; i++) {
+		chunk = PAGE_SIZE << t->arr[i].order;
+		for (off = 0; size && off < chunk; off += len) {
+			if (n >= t->max_segs)
+				return -EINVAL;
+			len = min(seg_sz, min(size, chunk - off));
+			sg_set_page(&t->sg[n++],
+				    t->arr[i].page + (off >> PAGE_SHIFT),
+				    len, off & ~PAGE_MASK);
+			size -= len;
+		}
+	}
+
+	if (size || !n)
+		return -EINVAL;
+
+	sg_mark_end(&t->sg[n - 1]);
+
+	return n;
+}
+
+static void mmc_test_free_perf_results(struct mmc_card *card)
+{
+	struct mmc_test_perf_result *r, *tmp;
+
+	list_for_each_entry_safe(r, tmp, &mmc_test_perf_results, link) {
+		if (card && r->card != card)
+			continue;
+		list_del(&r->link);
+		kfree(r);
+	}
+}
+
+/*
+ * Throughput in hundredths of MB/s (10^6 bytes per second)
+ */
+static u64 mmc_test_rate(struct mmc_test_perf_result *r)
+{
+	u64 us = div_u64(r->time_ns, NSEC_PER_USEC);
+
+	if (!us)
+		return 0;
+
+	return div64_u64((u64)r->size * r->count * 100, us);
+}
+
+static void mmc_test_print_perf(struct mmc_test_card *test,
+	struct mmc_test_perf_result *r)
+{
+	u64 secs, mbps;
+	u32 rem, frac;
+
+	secs = div_u64_rem(r->time_ns, NSEC_PER_SEC, &rem);
+	mbps = div_u64_rem(mmc_test_rate(r), 100, &frac);
+
+	printk(KERN_INFO "%s: %s %s of %u x %u bytes (%u SG) took "
+		"%llu.%09u seconds (%llu.%02u MB/s, latency %u-%u us)\n",
+		mmc_hostname(test->card->host),
+		r->random ? "Random" : "Sequential",
+		r->write ? "write" : "read", r->count, r->size, r->sg_len,
+		secs, rem, mbps, frac,
+		r->lat_min_us, r->lat_max_us);
+}
+
+/*
+ * Issue "count" requests of "size" bytes mapped into "sg_want" entries,
+ * either back to back or at random size aligned card addresses, and
+ * record throughput and per request latency.
+ */
+static int mmc_test_perf(struct mmc_test_card *test, int write, int random,
+	unsigned long size, unsigned int sg_want)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_test_perf_result *r;
+	struct timespec ts1, ts2;
+	unsigned int sectors = size >> 9;
+	unsigned int slots, dev_addr = 0;
+	unsigned long total;
+	int sg_len, ret = 0;
+	u64 lat_ns;
+	u32 lat_us;
+
+	if (!sectors || sectors > t->dev_sectors)
+		return RESULT_UNSUP_HOST;
+
+	sg_len = mmc_test_map_sg(test, size, sg_want);
+	if (sg_len < 0)
+		return RESULT_UNSUP_HOST;
+
+	r = kzalloc(sizeof(struct mmc_test_perf_result), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	r->card = test->card;
+	r->testcase = test->testcase;
+	r->random = random;
+	r->write = write;
+	r->size = size;
+	r->sg_len = sg_len;
+	r->lat_min_us = ~0U;
+
+	slots = t->dev_sectors / sectors;
+	total = max_t(unsigned long, (unsigned long)perf_total_kb << 10, size);
+
+	ret = mmc_test_set_blksize(test, 512);
+	if (ret)
+		goto out_free;
+
+	while (total >= size && r->time_ns < PERF_MAX_TIME_NS) {
+		unsigned int addr;
+
+		if (random)
+			dev_addr = (random32() % slots) * sectors;
+		else if (dev_addr + sectors > t->dev_sectors)
+			dev_addr = 0;
+
+		addr = dev_addr;
+		if (!mmc_card_blockaddr(test->card))
+			addr <<= 9;
+
+		getnstimeofday(&ts1);
+		ret = mmc_test_simple_transfer(test, t->sg, sg_len, addr,
+					       sectors, 512, write);
+		getnstimeofday(&ts2);
+		if (ret)
+			goto out_free;
+
+		ts2 = timespec_sub(ts2, ts1);
+		lat_ns = timespec_to_ns(&ts2);
+		lat_us = div_u64(lat_ns, NSEC_PER_USEC);
+
+		r->time_ns += lat_ns;
+		r->count++;
+		r->lat_min_us = min(r->lat_min_us, lat_us);
+		r->lat_max_us = max(r->lat_max_us, lat_us);
+		r->hist[min(fls(lat_us), PERF_LAT_BUCKETS - 1)]++;
+
+		dev_addr += sectors;
+		total -= size;
+	}
+
+	mmc_test_print_perf(test, r);
+	list_add_tail(&r->link, &mmc_test_perf_results);
+
+	return 0;
+
+out_free:
+	kfree(r);
+	return ret;
+}
+
+/*
+ * Run a measurement for each power of two request size from 512 bytes
+ * up to the largest transfer the host and test memory allow.
+ */
+static int mmc_test_perf_size_sweep(struct mmc_test_card *test, int write,
+	int random)
+{
+	unsigned long size;
+	int ret;
+
+	for (size = 512; size < test->area.max_tfr; size <<= 1) {
+		ret = mmc_test_perf(test, write, random, size,
+				    test->area.max_segs);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_perf(test, write, random, test->area.max_tfr,
+			     test->area.max_segs);
+}
+
+/*
+ * Run a measurement of the largest transfer split into 1, 2, 4, ...
+ * sg entries, up to the host or "perf_max_sg" limit.
+ */
+static int mmc_test_perf_sg_sweep(struct mmc_test_card *test, int write)
+{
+	unsigned int sg_want;
+	int ret;
+
+	for (sg_want = 1; sg_want < test->area.max_segs; sg_want <<= 1) {
+		ret = mmc_test_perf(test, write, 0, test->area.max_tfr,
+				    sg_want);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_perf(test, write, 0, test->area.max_tfr,
+			     test->area.max_segs);
+}
+
 /*******************************************************************/
 /*  Tests                                                          */
 /*******************************************************************/
@@ -891,6 +1257,47 @@ static int mmc_test_multi_read_high(struct mmc_test_card *test)
 
 #endif /* CONFIG_HIGHMEM */
 
+static int mmc_test_area_prepare(struct mmc_test_card *test)
+{
+	return mmc_test_alloc_area(test);
+}
+
+static int mmc_test_area_cleanup(struct mmc_test_card *test)
+{
+	mmc_test_free_area(&test->area);
+	return 0;
+}
+
+static int mmc_test_perf_seq_read(struct mmc_test_card *test)
+{
+	return mmc_test_perf_size_sweep(test, 0, 0);
+}
+
+static int mmc_test_perf_seq_write(struct mmc_test_card *test)
+{
+	return mmc_test_perf_size_sweep(test, 1, 0);
+}
+
+static int mmc_test_perf_rnd_read(struct mmc_test_card *test)
+{
+	return mmc_test_perf_size_sweep(test, 0, 1);
+}
+
+static int mmc_test_perf_rnd_write(struct mmc_test_card *test)
+{
+	return mmc_test_perf_size_sweep(test, 1, 1);
+}
+
+static int mmc_test_perf_sg_read(struct mmc_test_card *test)
+{
+	return mmc_test_perf_sg_sweep(test, 0);
+}
+
+static int mmc_test_perf_sg_write(struct mmc_test_card *test)
+{
+	return mmc_test_perf_sg_sweep(test, 1);
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -1038,6 +1445,48 @@ static const struct mmc_test_case mmc_test_cases[] = {
 
 #endif /* CONFIG_HIGHMEM */
 
+	{
+		.name = "Sequential read performance by request size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write performance by request size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance by request size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance by request size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read performance by sg length",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_sg_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write performance by sg length",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_sg_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -1059,6 +1508,8 @@ static void mmc_test_run(struct mmc_test_card *test, int testcase)
 			mmc_hostname(test->card->host), i + 1,
 			mmc_test_cases[i].name);
 
+		test->testcase = i + 1;
+
 		if (mmc_test_cases[i].prepare) {
 			ret = mmc_test_cases[i].prepare(test);
 			if (ret) {
@@ -1149,6 +1600,7 @@ static ssize_t mmc_test_store(struct device *dev,
 	if (test->buffer) {
 #endif
 		mutex_lock(&mmc_test_lock);
+		mmc_test_free_perf_results(card);
 		mmc_test_run(test, testcase);
 		mutex_unlock(&mmc_test_lock);
 	}
@@ -1164,6 +1616,116 @@ static ssize_t mmc_test_store(struct device *dev,
 
 static DEVICE_ATTR(test, S_IWUSR | S_IRUGO, mmc_test_show, mmc_test_store);
 
+/*
+ * Performance results of the last run, one line per measurement followed
+ * by the non-empty latency buckets. Bucket "<N" counts requests that
+ * completed in less than N microseconds.
+ */
+static int mmc_test_perf_show(struct seq_file *sf, void *data)
+{
+	struct mmc_card *card = sf->private;
+	struct mmc_test_perf_result *r;
+	u64 mbps;
+	u32 frac;
+	int i;
+
+	mutex_lock(&mmc_test_lock);
+
+	list_for_each_entry(r, &mmc_test_perf_results, link) {
+		if (r->card != card)
+			continue;
+
+		mbps = div_u64_rem(mmc_test_rate(r), 100, &frac);
+
+		seq_printf(sf, "%d: %s %s size %u sg %u count %u "
+			"time_ns %llu rate %llu.%02u MB/s "
+			"lat_us min %u avg %llu max %u\n",
+			r->testcase, r->random ? "rnd" : "seq",
+			r->write ? "write" : "read", r->size, r->sg_len,
+			r->count, r->time_ns, mbps, frac,
+			r->lat_min_us,
+			div_u64(div_u64(r->time_ns, NSEC_PER_USEC), r->count),
+			r->lat_max_us);
+
+		seq_printf(sf, "   hist");
+		for (i = 0; i < PERF_LAT_BUCKETS; i++) {
+			if (!r->hist[i])
+				continue;
+			if (i == PERF_LAT_BUCKETS - 1)
+				seq_printf(sf, " >=%u:%u", 1U << (i - 1),
+					   r->hist[i]);
+			else
+				seq_printf(sf, " <%u:%u", 1U << i, r->hist[i]);
+		}
+		seq_printf(sf, "\n");
+	}
+
+	mutex_unlock(&mmc_test_lock);
+
+	return 0;
+}
+
+static int mmc_test_perf_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_test_perf_show, inode->i_private);
+}
+
+static const struct file_operations mmc_test_perf_fops = {
+	.open		= mmc_test_perf_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+struct mmc_test_dbgfs_file {
+	struct list_head	link;
+	struct mmc_card		*card;
+	struct dentry		*file;
+};
+
+static LIST_HEAD(mmc_test_file_list);
+
+static void mmc_test_add_debugfs(struct mmc_card *card)
+{
+	struct mmc_test_dbgfs_file *df;
+
+	if (!card->debugfs_root)
+		return;
+
+	df = kzalloc(sizeof(struct mmc_test_dbgfs_file), GFP_KERNEL);
+	if (!df)
+		return;
+
+	df->card = card;
+	df->file = debugfs_create_file("perf_results", S_IRUSR,
+				       card->debugfs_root, card,
+				       &mmc_test_perf_fops);
+	if (IS_ERR(df->file) || !df->file) {
+		kfree(df);
+		return;
+	}
+
+	mutex_lock(&mmc_test_lock);
+	list_add(&df->link, &mmc_test_file_list);
+	mutex_unlock(&mmc_test_lock);
+}
+
+static void mmc_test_remove_debugfs(struct mmc_card *card)
+{
+	struct mmc_test_dbgfs_file *df, *tmp;
+
+	mutex_lock(&mmc_test_lock);
+	list_for_each_entry_safe(df, tmp, &mmc_test_file_list, link) {
+		if (df->card != card)
+			continue;
+		debugfs_remove(df->file);
+		list_del(&df->link);
+		kfree(df);
+	}
+	mmc_test_free_perf_results(card);
+	mutex_unlock(&mmc_test_lock);
+}
+
 static int mmc_test_probe(struct mmc_card *card)
 {
 	int ret;
@@ -1175,6 +1737,8 @@ static int mmc_test_probe(struct mmc_card *card)
 	if (ret)
 		return ret;
 
+	mmc_test_add_debugfs(card);
+
 	dev_info(&card->dev, "Card claimed for testing.\n");
 
 	return 0;
@@ -1182,6 +1746,7 @@ static int mmc_test_probe(struct mmc_card *card)
 
 static void mmc_test_remove(struct mmc_card *card)
 {
+	mmc_test_remove_debugfs(card);
 	device_remove_file(&card->dev, &dev_attr_test);
 }
 
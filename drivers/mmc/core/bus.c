@@ -255,6 +255,8 @@ int mmc_add_card(struct mmc_card *card)
 			type, card->rca);
 	}
 
+	/* ordered against its host by the parent link, nothing else */
+	device_enable_async_suspend(&card->dev);
 	ret = device_add(&card->dev);
 	if (ret)
 		return ret;
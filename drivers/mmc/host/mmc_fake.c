@@ -0,0 +1,357 @@
+/*
+ *  linux/drivers/mmc/host/mmc_fake.c
+ *
+ *  Software MMC host with a RAM backed SD card.
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The fake host answers the subset of the SD protocol the MMC core
+ * needs to initialise a standard capacity card, and serves block reads
+ * and writes out of a vmalloc'ed buffer. It lets mmc_test and the block
+ * driver be exercised on machines without a card slot.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/delay.h>
+#include <linux/vmalloc.h>
+#include <linux/scatterlist.h>
+#include <linux/platform_device.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
+#include <linux/mmc/sd.h>
+
+#define DRIVER_NAME		"mmc_fake"
+
+#define FAKE_RCA		0x1234
+#define FAKE_OCR		0x00ff8000
+#define FAKE_BLKBITS		9
+#define FAKE_MAX_CAPACITY	(1024 << 20)	/* CSD v1 limit at 512B blocks */
+
+static unsigned int capacity_mb = 64;
+module_param(capacity_mb, uint, S_IRUGO);
+MODULE_PARM_DESC(capacity_mb, "Size of the emulated card in MB");
+
+static unsigned int latency_us;
+module_param(latency_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(latency_us, "Simulated access time per data request");
+
+struct mmc_fake_host {
+	struct mmc_host		*mmc;
+	u8			*store;
+	unsigned long		size;
+	unsigned int		blksz;
+	int			app_cmd;
+	u32			csd[4];
+	u32			cid[4];
+};
+
+/*
+ * Build a version 1.0 CSD for a byte addressed card of the given size,
+ * with partial and 512 byte block accesses allowed.
+ */
+static void mmc_fake_build_csd(struct mmc_fake_host *host)
+{
+	u32 c_size = (host->size >> (FAKE_BLKBITS + 9)) - 1;
+	u32 *csd = host->csd;
+
+	memset(csd, 0, sizeof(host->csd));
+
+	csd[0] = (0x26 << 16) |			/* TAAC: 1ms */
+		 (0x32 << 0);			/* TRAN_SPEED: 25MHz */
+	csd[1] = (0x5b5 << 20) |		/* CCC */
+		 (FAKE_BLKBITS << 16) |		/* READ_BL_LEN */
+		 (1 << 15) |			/* READ_BL_PARTIAL */
+		 (c_size >> 2);			/* C_SIZE[11:2] */
+	csd[2] = ((c_size & 3) << 30) |		/* C_SIZE[1:0] */
+		 (7 << 15) |			/* C_SIZE_MULT: x512 */
+		 (1 << 14);			/* ERASE_BLK_EN */
+	csd[3] = (2 << 26) |			/* R2W_FACTOR */
+		 (FAKE_BLKBITS << 22) |		/* WRITE_BL_LEN */
+		 (1 << 21);			/* WRITE_BL_PARTIAL */
+}
+
+static void mmc_fake_build_cid(struct mmc_fake_host *host)
+{
+	host->cid[0] = 0x00464b00 | 'F';	/* MID, OID "FK", name[0] */
+	host->cid[1] = ('A' << 24) | ('K' << 16) | ('E' << 8) | '0';
+	host->cid[2] = 0x10000000;		/* PRV 1.0, serial hi */
+	host->cid[3] = 0x00000a40;		/* serial lo, MDT 2010/04 */
+}
+
+static u32 mmc_fake_status(struct mmc_fake_host *host)
+{
+	u32 status = R1_READY_FOR_DATA | (4 << 9);	/* state: tran */
+
+	if (host->app_cmd)
+		status |= R1_APP_CMD;
+	return status;
+}
+
+static int mmc_fake_copy(struct mmc_fake_host *host, struct mmc_data *data,
+	unsigned long offset, void *buf)
+{
+	unsigned int len = data->blocks * data->blksz;
+	unsigned long flags;
+	size_t copied;
+
+	if (buf == NULL) {
+		if (offset >= host->size || len > host->size - offset)
+			return -EILSEQ;
+		buf = host->store + offset;
+	}
+
+	local_irq_save(flags);
+	if (data->flags & MMC_DATA_WRITE)
+		copied = sg_copy_to_buffer(data->sg, data->sg_len, buf, len);
+	else
+		copied = sg_copy_from_buffer(data->sg, data->sg_len, buf, len);
+	local_irq_restore(flags);
+
+	if (copied != len)
+		return -EILSEQ;
+
+	data->bytes_xfered = len;
+	return 0;
+}
+
+static void mmc_fake_command(struct mmc_fake_host *host,
+	struct mmc_command *cmd, struct mmc_data *data)
+{
+	int app_cmd = host->app_cmd;
+	u8 scr[8];
+
+	host->app_cmd = 0;
+	cmd->error = 0;
+	memset(cmd->resp, 0, sizeof(cmd->resp));
+
+	if (app_cmd) {
+		switch (cmd->opcode) {
+		case SD_APP_OP_COND:
+			cmd->resp[0] = FAKE_OCR | MMC_CARD_BUSY |
+				(cmd->arg & (1 << 30));
+			return;
+		case SD_APP_SET_BUS_WIDTH:
+			cmd->resp[0] = mmc_fake_status(host);
+			return;
+		case SD_APP_SEND_SCR:
+			/* SCR v0, SD spec 1.0, 1 and 4 bit bus */
+			memset(scr, 0, sizeof(scr));
+			scr[1] = 0x05;
+			if (data)
+				data->error = mmc_fake_copy(host, data, 0, scr);
+			cmd->resp[0] = mmc_fake_status(host);
+			return;
+		}
+	}
+
+	switch (cmd->opcode) {
+	case MMC_GO_IDLE_STATE:
+		host->blksz = 1 << FAKE_BLKBITS;
+		break;
+	case SD_SEND_IF_COND:
+		cmd->resp[0] = cmd->arg & 0xfff;
+		break;
+	case MMC_APP_CMD:
+		host->app_cmd = 1;
+		cmd->resp[0] = mmc_fake_status(host);
+		break;
+	case MMC_ALL_SEND_CID:
+	case MMC_SEND_CID:
+		memcpy(cmd->resp, host->cid, sizeof(host->cid));
+		break;
+	case SD_SEND_RELATIVE_ADDR:
+		cmd->resp[0] = FAKE_RCA << 16;
+		break;
+	case MMC_SEND_CSD:
+		memcpy(cmd->resp, host->csd, sizeof(host->csd));
+		break;
+	case MMC_SELECT_CARD:
+	case MMC_SEND_STATUS:
+	case MMC_STOP_TRANSMISSION:
+		cmd->resp[0] = mmc_fake_status(host);
+		break;
+	case MMC_SET_BLOCKLEN:
+		if (!cmd->arg || cmd->arg > (1 << FAKE_BLKBITS)) {
+			cmd->error = -EINVAL;
+			break;
+		}
+		host->blksz = cmd->arg;
+		cmd->resp[0] = mmc_fake_status(host);
+		break;
+	case MMC_READ_SINGLE_BLOCK:
+	case MMC_READ_MULTIPLE_BLOCK:
+	case MMC_WRITE_BLOCK:
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		if (!data || data->blksz != host->blksz) {
+			cmd->error = -EINVAL;
+			break;
+		}
+		cmd->resp[0] = mmc_fake_status(host);
+		if (latency_us)
+			udelay(latency_us);
+		data->error = mmc_fake_copy(host, data, cmd->arg, NULL);
+		break;
+	default:
+		/* No SDIO or MMC personality, no CMD6 */
+		cmd->error = -ETIMEDOUT;
+		break;
+	}
+}
+
+static void mmc_fake_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct mmc_fake_host *host = mmc_priv(mmc);
+
+	if (mrq->data) {
+		mrq->data->error = 0;
+		mrq->data->bytes_xfered = 0;
+	}
+
+	mmc_fake_command(host, mrq->cmd, mrq->data);
+
+	if (mrq->data && mrq->cmd->error)
+		mrq->data->error = mrq->cmd->error;
+	if (mrq->stop)
+		mmc_fake_command(host, mrq->stop, NULL);
+
+	mmc_request_done(mmc, mrq);
+}
+
+static void mmc_fake_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
+{
+}
+
+static int mmc_fake_get_ro(struct mmc_host *mmc)
+{
+	return 0;
+}
+
+static int mmc_fake_get_cd(struct mmc_host *mmc)
+{
+	return 1;
+}
+
+static const struct mmc_host_ops mmc_fake_ops = {
+	.request	= mmc_fake_request,
+	.set_ios	= mmc_fake_set_ios,
+	.get_ro		= mmc_fake_get_ro,
+	.get_cd		= mmc_fake_get_cd,
+};
+
+static int __devinit mmc_fake_probe(struct platform_device *pdev)
+{
+	struct mmc_fake_host *host;
+	struct mmc_host *mmc;
+	unsigned long size;
+	int ret;
+
+	size = (unsigned long)capacity_mb << 20;
+	if (!size || size > FAKE_MAX_CAPACITY)
+		return -EINVAL;
+
+	mmc = mmc_alloc_host(sizeof(struct mmc_fake_host), &pdev->dev);
+	if (!mmc)
+		return -ENOMEM;
+
+	host = mmc_priv(mmc);
+	host->mmc = mmc;
+	host->size = size;
+	host->blksz = 1 << FAKE_BLKBITS;
+	host->store = vmalloc(size);
+	if (!host->store) {
+		ret = -ENOMEM;
+		goto err_free_host;
+	}
+	memset(host->store, 0, size);
+
+	mmc_fake_build_csd(host);
+	mmc_fake_build_cid(host);
+
+	mmc->ops = &mmc_fake_ops;
+	mmc->f_min = 400000;
+	mmc->f_max = 25000000;
+	mmc->ocr_avail = MMC_VDD_32_33 | MMC_VDD_33_34;
+	mmc->caps = MMC_CAP_4_BIT_DATA | MMC_CAP_NONREMOVABLE;
+
+	mmc->max_hw_segs = 128;
+	mmc->max_phys_segs = 128;
+	mmc->max_seg_size = 1 << 20;
+	mmc->max_blk_size = 1 << FAKE_BLKBITS;
+	mmc->max_blk_count = 0xffff;
+	mmc->max_req_size = 4 << 20;
+
+	platform_set_drvdata(pdev, host);
+
+	ret = mmc_add_host(mmc);
+	if (ret)
+		goto err_free_store;
+
+	dev_info(&pdev->dev, "%u MB RAM backed card\n", capacity_mb);
+
+	return 0;
+
+err_free_store:
+	platform_set_drvdata(pdev, NULL);
+	vfree(host->store);
+err_free_host:
+	mmc_free_host(mmc);
+	return ret;
+}
+
+static int __devexit mmc_fake_remove(struct platform_device *pdev)
+{
+	struct mmc_fake_host *host = platform_get_drvdata(pdev);
+
+	platform_set_drvdata(pdev, NULL);
+	mmc_remove_host(host->mmc);
+	vfree(host->store);
+	mmc_free_host(host->mmc);
+
+	return 0;
+}
+
+static struct platform_driver mmc_fake_driver = {
+	.probe		= mmc_fake_probe,
+	.remove		= __devexit_p(mmc_fake_remove),
+	.driver		= {
+		.name	= DRIVER_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static struct platform_device *mmc_fake_device;
+
+static int __init mmc_fake_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&mmc_fake_driver);
+	if (ret)
+		return ret;
+
+	mmc_fake_device = platform_device_register_simple(DRIVER_NAME, -1,
+							  NULL, 0);
+	if (IS_ERR(mmc_fake_device)) {
+		platform_driver_unregister(&mmc_fake_driver);
+		return PTR_ERR(mmc_fake_device);
+	}
+
+	return 0;
+}
+
+static void __exit mmc_fake_exit(void)
+{
+	platform_device_unregister(mmc_fake_device);
+	platform_driver_unregister(&mmc_fake_driver);
+}
+
+module_init(mmc_fake_init);
+module_exit(mmc_fake_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("RAM backed fake MMC/SD host");
@@ -46,6 +46,9 @@ netdev_tx_t lbs_hard_start_xmit(struct sk_buff *skb,
 int lbs_set_regiontable(struct lbs_private *priv, u8 region, u8 band);
 
 int lbs_process_rxed_packet(struct lbs_private *priv, struct sk_buff *);
+int lbs_queue_rxed_packet(struct lbs_private *priv, struct sk_buff *);
+void lbs_rxed_packets_done(struct lbs_private *priv);
+int lbs_poll(struct napi_struct *napi, int budget);
 
 void lbs_ps_sleep(struct lbs_private *priv, int wait_option);
 void lbs_ps_confirm_sleep(struct lbs_private *priv);
@@ -279,6 +279,9 @@ static inline void lbs_deb_hex(unsigned int grp, const char *prompt, u8 *buf, in
 	(ETH_FRAME_LEN + sizeof(struct rxpd) \
 	 + MRVDRV_SNAP_HEADER_LEN + EXTRA_LEN)
 
+/** Received data packets handed up per lbs_poll() */
+#define LBS_NAPI_WEIGHT	64
+
 #define	CMD_F_HOSTCMD		(1 << 0)
 #define FW_CAPINFO_WPA  	(1 << 0)
 #define FW_CAPINFO_PS  		(1 << 1)
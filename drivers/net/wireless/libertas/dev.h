@@ -167,6 +167,10 @@ struct lbs_private {
 
 	struct mutex lock;
 
+	/** Received data packets, handed to the stack by lbs_poll() */
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
+
 	/* TX packet ready to be sent... */
 	int tx_pending_len;		/* -1 while building packet */
 
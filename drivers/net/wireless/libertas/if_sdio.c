@@ -259,7 +259,7 @@ static int if_sdio_handle_data(struct if_sdio_card *card,
 
 	memcpy(data, buffer, size);
 
-	lbs_process_rxed_packet(card->priv, skb);
+	lbs_queue_rxed_packet(card->priv, skb);
 
 	ret = 0;
 
@@ -837,7 +837,7 @@ out:
 
 static void if_sdio_interrupt(struct sdio_func *func)
 {
-	int ret;
+	int ret, i;
 	struct if_sdio_card *card;
 	u8 cause;
 
@@ -845,25 +845,35 @@ static void if_sdio_interrupt(struct sdio_func *func)
 
 	card = sdio_get_drvdata(func);
 
-	cause = sdio_readb(card->func, IF_SDIO_H_INT_STATUS, &ret);
-	if (ret)
-		goto out;
+	/*
+	 * Keep fetching while the card has more packets ready, up to
+	 * IF_SDIO_RX_BATCH of them, and only then hand the data packets
+	 * up, so that GRO can merge the segments of a TCP stream.
+	 */
+	for (i = 0; i < IF_SDIO_RX_BATCH; i++) {
+		cause = sdio_readb(card->func, IF_SDIO_H_INT_STATUS, &ret);
+		if (ret)
+			goto out;
 
-	lbs_deb_sdio("interrupt: 0x%X\n", (unsigned)cause);
+		lbs_deb_sdio("interrupt: 0x%X\n", (unsigned)cause);
 
-	sdio_writeb(card->func, ~cause, IF_SDIO_H_INT_STATUS, &ret);
-	if (ret)
-		goto out;
+		if (i && !cause)
+			break;
 
-	/*
-	 * Ignore the define name, this really means the card has
-	 * successfully received the command.
-	 */
-	if (cause & IF_SDIO_H_INT_DNLD)
-		lbs_host_to_card_done(card->priv);
+		sdio_writeb(card->func, ~cause, IF_SDIO_H_INT_STATUS, &ret);
+		if (ret)
+			goto out;
 
+		/*
+		 * Ignore the define name, this really means the card has
+		 * successfully received the command.
+		 */
+		if (cause & IF_SDIO_H_INT_DNLD)
+			lbs_host_to_card_done(card->priv);
+
+		if (!(cause & IF_SDIO_H_INT_UPLD))
+			break;
 
-	if (cause & IF_SDIO_H_INT_UPLD) {
 		ret = if_sdio_card_to_host(card);
 		if (ret)
 			goto out;
@@ -872,6 +882,10 @@ static void if_sdio_interrupt(struct sdio_func *func)
 	ret = 0;
 
 out:
+	/* the interrupt is claimed before the card is added */
+	if (card->priv)
+		lbs_rxed_packets_done(card->priv);
+
 	lbs_deb_leave_args(LBS_DEB_SDIO, "ret %d", ret);
 }
 
@@ -52,4 +52,7 @@
 
 #define IF_SDIO_BLOCK_SIZE	256
 
+/* packets fetched per interrupt before they are handed up */
+#define IF_SDIO_RX_BATCH	16
+
 #endif
@@ -1200,6 +1200,11 @@ struct lbs_private *lbs_add_card(void *card, struct device *dmdev)
 	dev->wireless_handlers = &lbs_handler_def;
 #endif
 	dev->flags |= IFF_BROADCAST | IFF_MULTICAST;
+	dev->features |= NETIF_F_GRO;
+
+	skb_queue_head_init(&priv->rx_queue);
+	netif_napi_add(dev, &priv->napi, lbs_poll, LBS_NAPI_WEIGHT);
+	napi_enable(&priv->napi);
 
 	SET_NETDEV_DEV(dev, dmdev);
 
@@ -1247,6 +1252,10 @@ void lbs_remove_card(struct lbs_private *priv)
 
 	lbs_deb_enter(LBS_DEB_MAIN);
 
+	/* no more received packets for the interfaces going away */
+	napi_disable(&priv->napi);
+	skb_queue_purge(&priv->rx_queue);
+
 	lbs_remove_mesh(priv);
 	lbs_remove_rtap(priv);
 
@@ -1277,6 +1286,7 @@ void lbs_remove_card(struct lbs_private *priv)
 	kthread_stop(priv->main_thread);
 
 	lbs_free_adapter(priv);
+	skb_queue_purge(&priv->rx_queue);
 
 	priv->dev = NULL;
 	free_netdev(dev);
@@ -1461,6 +1471,7 @@ static int lbs_add_mesh(struct lbs_private *priv)
 	mesh_dev->wireless_handlers = (struct iw_handler_def *)&mesh_handler_def;
 #endif
 	mesh_dev->flags |= IFF_BROADCAST | IFF_MULTICAST;
+	mesh_dev->features |= NETIF_F_GRO;
 	/* Register virtual mesh interface */
 	ret = register_netdev(mesh_dev);
 	if (ret) {
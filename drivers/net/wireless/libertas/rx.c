@@ -139,6 +139,81 @@ static void lbs_compute_rssi(struct lbs_private *priv, struct rxpd *p_rx_pd)
  *  @return 	   0 or -1
  */
 int lbs_process_rxed_packet(struct lbs_private *priv, struct sk_buff *skb)
+{
+	int ret = lbs_queue_rxed_packet(priv, skb);
+
+	lbs_rxed_packets_done(priv);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lbs_process_rxed_packet);
+
+/**
+ *  @brief This function schedules lbs_poll() to hand the packets
+ *  queued by lbs_queue_rxed_packet() to the upper layer. Interface
+ *  drivers that can fetch several packets from the card in a row
+ *  queue them all first, so that GRO sees them as one batch.
+ *
+ *  @param priv    A pointer to struct lbs_private
+ */
+void lbs_rxed_packets_done(struct lbs_private *priv)
+{
+	if (skb_queue_empty(&priv->rx_queue))
+		return;
+
+	if (in_interrupt()) {
+		napi_schedule(&priv->napi);
+	} else {
+		/* the poll runs as soon as bottom halves are enabled */
+		local_bh_disable();
+		napi_schedule(&priv->napi);
+		local_bh_enable();
+	}
+}
+EXPORT_SYMBOL_GPL(lbs_rxed_packets_done);
+
+/**
+ *  @brief NAPI poll of the wlan device: hands the packets queued by
+ *  lbs_queue_rxed_packet() to the upper layer through GRO, at most
+ *  budget of them per call
+ *
+ *  @param napi    A pointer to the napi_struct of struct lbs_private
+ *  @param budget  The most packets to hand up
+ *  @return 	   The number of packets handed up
+ */
+int lbs_poll(struct napi_struct *napi, int budget)
+{
+	struct lbs_private *priv = container_of(napi, struct lbs_private, napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&priv->rx_queue);
+		if (!skb)
+			break;
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a packet may have been queued after the last dequeue
+		 * but before napi_complete() */
+		if (!skb_queue_empty(&priv->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
+/**
+ *  @brief This function processes received packet and queues it for
+ *  lbs_poll(), which runs once lbs_rxed_packets_done() is called
+ *
+ *  @param priv    A pointer to struct lbs_private
+ *  @param skb     A pointer to skb which includes the received packet
+ *  @return 	   0 or -1
+ */
+int lbs_queue_rxed_packet(struct lbs_private *priv, struct sk_buff *skb)
 {
 	int ret = 0;
 	struct net_device *dev = priv->dev;
@@ -245,17 +320,14 @@ int lbs_process_rxed_packet(struct lbs_private *priv, struct sk_buff *skb)
 	dev->stats.rx_packets++;
 
 	skb->protocol = eth_type_trans(skb, dev);
-	if (in_interrupt())
-		netif_rx(skb);
-	else
-		netif_rx_ni(skb);
+	skb_queue_tail(&priv->rx_queue, skb);
 
 	ret = 0;
 done:
 	lbs_deb_leave_args(LBS_DEB_RX, "ret %d", ret);
 	return ret;
 }
-EXPORT_SYMBOL_GPL(lbs_process_rxed_packet);
+EXPORT_SYMBOL_GPL(lbs_queue_rxed_packet);
 
 /**
  *  @brief This function converts Tx/Rx rates from the Marvell WLAN format
@@ -36,10 +36,23 @@
 #include "f_mot_android.h"
 #endif
 
-#define BULK_BUFFER_SIZE           4096
+#define BULK_BUFFER_SIZE           16384
 
-/* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+/* number of tx and rx requests to allocate */
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 4
+
+static unsigned int adb_buf_size = BULK_BUFFER_SIZE;
+module_param(adb_buf_size, uint, S_IRUGO);
+MODULE_PARM_DESC(adb_buf_size, "Size of each adb bulk request buffer");
+
+static unsigned int adb_tx_reqs = TX_REQ_MAX;
+module_param(adb_tx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(adb_tx_reqs, "Number of adb bulk in requests");
+
+static unsigned int adb_rx_reqs = RX_REQ_MAX;
+module_param(adb_rx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(adb_rx_reqs, "Number of adb bulk out requests");
 
 #ifdef CONFIG_USB_MOT_ANDROID
 #define STRING_INTERFACE        0
@@ -79,11 +92,18 @@ struct adb_dev {
 	atomic_t open_excl;
 
 	struct list_head tx_idle;
+	struct list_head rx_idle;
+	struct list_head rx_queued;
+	struct list_head rx_done;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
+
+	/* the completed rx request being read from, and how far */
 	struct usb_request *rx_req;
-	int rx_done;
+	unsigned rx_offset;
+
+	unsigned buf_size;
 	struct mutex adb_enable_mutex;
 };
 
@@ -235,14 +255,86 @@ static void adb_complete_in(struct usb_ep *ep, struct usb_request *req)
 static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
+	unsigned long flags;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	spin_lock_irqsave(&dev->lock, flags);
+	if (req->status != 0) {
 		dev->error = 1;
+		list_move_tail(&req->list, &dev->rx_idle);
+	} else {
+		list_move_tail(&req->list, &dev->rx_done);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
 
 	wake_up(&dev->read_wq);
 }
 
+/*
+ * Keep every idle rx request queued, so the host can stream ahead of the
+ * reader. Only readers queue requests; until adbd reads, the host waits.
+ */
+static int adb_queue_rx(struct adb_dev *dev)
+{
+	struct usb_request *req;
+	unsigned long flags;
+	int ret;
+
+	while (dev->online && (req = req_get(dev, &dev->rx_idle))) {
+		req->length = dev->buf_size;
+		/* before queueing: it may complete before usb_ep_queue returns */
+		req_put(dev, &dev->rx_queued, req);
+		ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+		if (ret < 0) {
+			DBG(dev->cdev, "adb: failed to queue req %p (%d)\n",
+			    req, ret);
+			dev->error = 1;
+			spin_lock_irqsave(&dev->lock, flags);
+			list_move_tail(&req->list, &dev->rx_idle);
+			spin_unlock_irqrestore(&dev->lock, flags);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* return completed but unread rx requests to the idle list */
+static void adb_flush_rx(struct adb_dev *dev)
+{
+	struct usb_request *req;
+
+	if (dev->rx_req) {
+		req_put(dev, &dev->rx_idle, dev->rx_req);
+		dev->rx_req = NULL;
+	}
+	while ((req = req_get(dev, &dev->rx_done)))
+		req_put(dev, &dev->rx_idle, req);
+	dev->rx_offset = 0;
+}
+
+/*
+ * Take back the rx requests still queued at the controller, so that
+ * what the host sends to a closed adbd is not read by the next one.
+ * Dequeueing completes them with an error, which moves them to rx_idle.
+ */
+static void adb_cancel_rx(struct adb_dev *dev)
+{
+	struct usb_request *req;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	while (!list_empty(&dev->rx_queued)) {
+		req = list_first_entry(&dev->rx_queued,
+				       struct usb_request, list);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		/* fails if it is completing already; then we are done */
+		if (usb_ep_dequeue(dev->ep_out, req) < 0)
+			return;
+		spin_lock_irqsave(&dev->lock, flags);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
 static int __init create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
@@ -272,15 +364,20 @@ static int __init create_bulk_endpoints(struct adb_dev *dev,
 	ep->driver_data = dev;		/* claim the endpoint */
 	dev->ep_out = ep;
 
+	/* requests are whole packets, at least the old 4 KB */
+	dev->buf_size = max(ALIGN(adb_buf_size, 512), 4096U);
+
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	for (i = 0; i < max(adb_rx_reqs, 2U); i++) {
+		req = adb_request_new(dev->ep_out, dev->buf_size);
+		if (!req)
+			goto fail;
+		req->complete = adb_complete_out;
+		req_put(dev, &dev->rx_idle, req);
+	}
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, BULK_BUFFER_SIZE);
+	for (i = 0; i < max(adb_tx_reqs, 1U); i++) {
+		req = adb_request_new(dev->ep_in, dev->buf_size);
 		if (!req)
 			goto fail;
 		req->complete = adb_complete_in;
@@ -300,14 +397,11 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 	struct adb_dev *dev = fp->private_data;
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
-	int r = count, xfer;
+	int r = 0, copied = 0, xfer;
 	int ret;
 
 	DBG(cdev, "adb_read(%d)\n", count);
 
-	if (count > BULK_BUFFER_SIZE)
-		return -EINVAL;
-
 	if (_lock(&dev->read_excl))
 		return -EBUSY;
 
@@ -321,47 +415,72 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 			return ret;
 		}
 	}
-	if (dev->error) {
-		r = -EIO;
-		goto done;
-	}
 
-requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		DBG(cdev, "adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		dev->error = 1;
-		goto done;
-	} else {
-		DBG(cdev, "rx %p queue\n", req);
-	}
+	/*
+	 * The rx requests stay queued and complete in order, so the data
+	 * is a stream: fill the caller's buffer from as many of them as it
+	 * takes, keeping the rest of a request for the next read. Data
+	 * copied before an error is returned, as a short read.
+	 */
+	while (count > 0) {
+		if (dev->error) {
+			/* what was received before the error is stale */
+			adb_flush_rx(dev);
+			r = -EIO;
+			break;
+		}
 
-	/* wait for a request to complete */
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
-	if (ret < 0) {
-		usb_ep_dequeue(dev->ep_out, req);
-		dev->error = 1;
-		r = ret;
-		goto done;
-	}
-	if (!dev->error) {
-		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
-			goto requeue_req;
-
-		DBG(cdev, "rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
+		if (adb_queue_rx(dev) < 0) {
+			r = -EIO;
+			break;
+		}
+
+		if (!dev->rx_req) {
+			/* wait for a request to complete */
+			req = 0;
+			ret = wait_event_interruptible(dev->read_wq,
+				((req = req_get(dev, &dev->rx_done)) ||
+				 dev->error));
+			if (req) {
+				dev->rx_req = req;
+				dev->rx_offset = 0;
+			}
+			if (ret < 0) {
+				r = ret;
+				break;
+			}
+			if (!req)
+				continue;
+
+			/* If we got a 0-len packet, throw it back. */
+			if (req->actual == 0) {
+				req_put(dev, &dev->rx_idle, req);
+				dev->rx_req = NULL;
+				continue;
+			}
+			DBG(cdev, "rx %p %d\n", req, req->actual);
+		}
+
+		req = dev->rx_req;
+		xfer = min_t(int, count, req->actual - dev->rx_offset);
+		if (copy_to_user(buf, req->buf + dev->rx_offset, xfer)) {
 			r = -EFAULT;
-	} else
-		r = -EIO;
+			break;
+		}
+
+		buf += xfer;
+		count -= xfer;
+		copied += xfer;
+		dev->rx_offset += xfer;
+
+		if (dev->rx_offset == req->actual) {
+			req_put(dev, &dev->rx_idle, req);
+			dev->rx_req = NULL;
+		}
+	}
+	if (copied)
+		r = copied;
 
-done:
 	_unlock(&dev->read_excl);
 	DBG(cdev, "adb_read returning %d\n", r);
 	return r;
@@ -399,8 +518,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE)
-				xfer = BULK_BUFFER_SIZE;
+			if (count > dev->buf_size)
+				xfer = dev->buf_size;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -450,6 +569,11 @@ static int adb_open(struct inode *ip, struct file *fp)
 static int adb_release(struct inode *ip, struct file *fp)
 {
 	printk(KERN_INFO "adb_release\n");
+
+	/* drop the read-ahead, the next adbd starts a new stream */
+	adb_cancel_rx(_adb_dev);
+	adb_flush_rx(_adb_dev);
+
 	_unlock(&_adb_dev->open_excl);
 	return 0;
 }
@@ -562,16 +686,15 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	struct adb_dev	*dev = func_to_dev(f);
 	struct usb_request *req;
 
-	spin_lock_irq(&dev->lock);
+	dev->online = 0;
+	dev->error = 1;
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	adb_flush_rx(dev);
+	while ((req = req_get(dev, &dev->rx_idle)))
+		adb_request_free(req, dev->ep_out);
 	while ((req = req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 
-	dev->online = 0;
-	dev->error = 1;
-	spin_unlock_irq(&dev->lock);
-
 	misc_deregister(&adb_device);
 	misc_deregister(&adb_enable_device);
 	kfree(_adb_dev);
@@ -652,6 +775,9 @@ static int adb_bind_config(struct usb_configuration *c)
 	mutex_init(&dev->adb_enable_mutex);
 
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->rx_idle);
+	INIT_LIST_HEAD(&dev->rx_queued);
+	INIT_LIST_HEAD(&dev->rx_done);
 
 #ifdef CONFIG_USB_MOT_ANDROID
 	status = usb_string_id(c->cdev);
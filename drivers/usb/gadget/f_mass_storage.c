@@ -59,11 +59,13 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/limits.h>
+#include <linux/mm.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/switch.h>
+#include <linux/uio.h>
 #include <linux/freezer.h>
 #include <linux/utsname.h>
 #include <linux/wakelock.h>
@@ -80,7 +82,7 @@
 #include "f_mot_android.h"
 #endif
 
-#define BULK_BUFFER_SIZE           4096
+#define BULK_BUFFER_SIZE           16384
 
 /*-------------------------------------------------------------------------*/
 
@@ -257,6 +259,13 @@ struct lun {
 	u32		sense_data_info;
 	u32		unit_attention_data;
 
+	/* Sequential stream tracking for read-ahead and write-behind */
+	loff_t		ra_next;	/* where a sequential READ continues */
+	loff_t		ra_end;		/* read-ahead issued up to here */
+	u32		ra_window;	/* current read-ahead size, bytes */
+	loff_t		wb_next;	/* where a sequential WRITE continues */
+	u32		wb_dirty;	/* bytes written since the last flush */
+
 	struct device	dev;
 };
 
@@ -277,6 +286,27 @@ static struct lun *dev_to_lun(struct device *dev)
 #else
 #define NUM_BUFFERS	2
 #endif
+#define MAX_BUFFERS	32
+
+/* The buffer ring and the read-ahead/write-behind windows are tunable.
+ * Buffer sizes are rounded up to a multiple of 512 bytes. */
+static unsigned int ums_buf_size = BULK_BUFFER_SIZE;
+module_param(ums_buf_size, uint, S_IRUGO);
+MODULE_PARM_DESC(ums_buf_size, "Size of each mass storage buffer");
+
+static unsigned int ums_buffers = NUM_BUFFERS;
+module_param(ums_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(ums_buffers, "Number of mass storage buffers (2 to 32)");
+
+static unsigned int ums_readahead_kb = 512;
+module_param(ums_readahead_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ums_readahead_kb,
+	"Largest read-ahead window for sequential READs, 0 to disable");
+
+static unsigned int ums_writebehind_kb = 1024;
+module_param(ums_writebehind_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ums_writebehind_kb,
+	"Start writeback after this much sequential WRITE data, 0 to disable");
 
 enum fsg_buffer_state {
 	BUF_STATE_EMPTY = 0,
@@ -360,7 +390,11 @@ struct fsg_dev {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[NUM_BUFFERS];
+	struct fsg_buffhd	buffhds[MAX_BUFFERS];
+	unsigned int		num_buffers;
+
+	/* Full buffers gathered into one vfs_writev() by do_write() */
+	struct iovec		write_iov[MAX_BUFFERS];
 
 	int			thread_wakeup_needed;
 	struct completion	thread_notifier;
@@ -806,6 +840,42 @@ static int sleep_thread(struct fsg_dev *fsg)
 
 /*-------------------------------------------------------------------------*/
 
+/* A READ that starts where the previous one ended continues a sequential
+ * stream.  Read the backing file ahead of such a stream so that its I/O is
+ * in flight while earlier data is still on the bus.  The window starts at
+ * the size of the command, doubles with each sequential READ up to
+ * ums_readahead_kb, and is dropped on a seek. */
+static void readahead_stream(struct lun *curlun, loff_t offset, u32 len)
+{
+	struct file	*filp = curlun->filp;
+	loff_t		end = offset + len;
+	loff_t		ra_start, ra_stop;
+	u32		max_window = ums_readahead_kb << 10;
+	pgoff_t		index;
+
+	if (offset != curlun->ra_next || max_window == 0) {
+		curlun->ra_next = curlun->ra_end = end;
+		curlun->ra_window = 0;
+		return;
+	}
+	curlun->ra_next = end;
+	curlun->ra_window = min(max(curlun->ra_window * 2, len), max_window);
+
+	/* Top the window up once half of it has been consumed */
+	if (curlun->ra_end - end >= curlun->ra_window / 2)
+		return;
+
+	ra_start = max(curlun->ra_end, offset);
+	ra_stop = min(end + curlun->ra_window, curlun->file_length);
+	if (ra_stop <= ra_start)
+		return;
+
+	index = ra_start >> PAGE_CACHE_SHIFT;
+	force_page_cache_readahead(filp->f_mapping, filp, index,
+			DIV_ROUND_UP(ra_stop, PAGE_CACHE_SIZE) - index);
+	curlun->ra_end = ra_stop;
+}
+
 static int do_read(struct fsg_dev *fsg)
 {
 	struct lun		*curlun = fsg->curlun;
@@ -844,6 +914,8 @@ static int do_read(struct fsg_dev *fsg)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	readahead_stream(curlun, file_offset, amount_left);
+
 	for (;;) {
 
 		/* Figure out how much we need to read:
@@ -932,6 +1004,26 @@ static int do_read(struct fsg_dev *fsg)
 
 /*-------------------------------------------------------------------------*/
 
+/* Sequential WRITEs leave a growing amount of dirty data in the page cache.
+ * Start writeback every ums_writebehind_kb of such a stream instead of
+ * letting it pile up until the writer gets throttled. */
+static void writebehind_stream(struct lun *curlun, loff_t offset, u32 len)
+{
+	u32		max_dirty = ums_writebehind_kb << 10;
+
+	if (max_dirty == 0)
+		return;
+	if (offset != curlun->wb_next)
+		curlun->wb_dirty = 0;
+	curlun->wb_next = offset + len;
+	curlun->wb_dirty += len;
+	if (curlun->wb_dirty < max_dirty)
+		return;
+
+	curlun->wb_dirty = 0;
+	filemap_flush(curlun->filp->f_mapping);
+}
+
 static int do_write(struct fsg_dev *fsg)
 {
 	struct lun		*curlun = fsg->curlun;
@@ -942,6 +1034,8 @@ static int do_write(struct fsg_dev *fsg)
 	loff_t			usb_offset, file_offset, file_offset_tmp;
 	unsigned int		amount;
 	unsigned int		partial_page;
+	unsigned int		nbufs, i, left;
+	int			short_packet;
 	ssize_t			nwritten;
 	int			rc;
 
@@ -1042,34 +1136,65 @@ static int do_write(struct fsg_dev *fsg)
 			break;			/* We stopped early */
 		if (bh->state == BUF_STATE_FULL) {
 			smp_rmb();
-			fsg->next_buffhd_to_drain = bh->next;
-			bh->state = BUF_STATE_EMPTY;
 
 			/* Did something go wrong with the transfer? */
 			if (bh->outreq->status != 0) {
+				fsg->next_buffhd_to_drain = bh->next;
+				bh->state = BUF_STATE_EMPTY;
 				curlun->sense_data = SS_COMMUNICATION_FAILURE;
 				curlun->sense_data_info = file_offset >> 9;
 				curlun->info_valid = 1;
 				break;
 			}
 
-			amount = bh->outreq->actual;
+			/* Gather this and the full buffers after it into one
+			 * write, stopping at a short or failed transfer */
+			nbufs = 0;
+			amount = 0;
+			short_packet = 0;
+			for (;;) {
+				fsg->write_iov[nbufs].iov_base = bh->buf;
+				fsg->write_iov[nbufs].iov_len =
+						bh->outreq->actual;
+				nbufs++;
+				amount += bh->outreq->actual;
+				bh->state = BUF_STATE_EMPTY;
+				if (bh->outreq->actual != bh->outreq->length)
+					short_packet = 1;
+				bh = bh->next;
+
+				if (short_packet || nbufs == fsg->num_buffers ||
+						bh->state != BUF_STATE_FULL)
+					break;
+				smp_rmb();
+				if (bh->outreq->status != 0)
+					break;
+			}
+			fsg->next_buffhd_to_drain = bh;
+
 			if (curlun->file_length - file_offset < amount) {
 				LERROR(curlun,
 	"write %u @ %llu beyond end %llu\n",
 	amount, (unsigned long long) file_offset,
 	(unsigned long long) curlun->file_length);
 				amount = curlun->file_length - file_offset;
+				left = amount;		/* Trim the iovec */
+				for (i = 0; i < nbufs; ++i) {
+					fsg->write_iov[i].iov_len = min_t(size_t,
+						fsg->write_iov[i].iov_len,
+						left);
+					left -= fsg->write_iov[i].iov_len;
+				}
 			}
 
 			/* Perform the write */
 			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					(char __user *) bh->buf,
-					amount, &file_offset_tmp);
-			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
-					(unsigned long long) file_offset,
-					(int) nwritten);
+			nwritten = vfs_writev(curlun->filp,
+					(struct iovec __user *) fsg->write_iov,
+					nbufs, &file_offset_tmp);
+			VLDBG(curlun, "file write %u @ %llu (%u bufs) -> %d\n",
+					amount, (unsigned long long) file_offset,
+					nbufs, (int) nwritten);
 			if (signal_pending(current))
 				return -EINTR;		/* Interrupted! */
 
@@ -1083,6 +1208,9 @@ static int do_write(struct fsg_dev *fsg)
 				nwritten -= (nwritten & 511);
 						/* Round down to a block */
 			}
+			if (nwritten > 0)
+				writebehind_stream(curlun, file_offset,
+						nwritten);
 			file_offset += nwritten;
 			amount_left_to_write -= nwritten;
 			fsg->residue -= nwritten;
@@ -1096,7 +1224,7 @@ static int do_write(struct fsg_dev *fsg)
 			}
 
 			/* Did the host decide to stop early? */
-			if (bh->outreq->actual != bh->outreq->length) {
+			if (short_packet) {
 				fsg->short_packet_received = 1;
 				break;
 			}
@@ -2552,7 +2680,7 @@ static void handle_exception(struct fsg_dev *fsg)
 	 * state, and the exception.  Then invoke the handler. */
 	spin_lock_irq(&fsg->lock);
 
-	for (i = 0; i < NUM_BUFFERS; ++i) {
+	for (i = 0; i < fsg->num_buffers; ++i) {
 		bh = &fsg->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
@@ -2778,6 +2906,10 @@ static int open_backing_file(struct fsg_dev *fsg, struct lun *curlun,
 	curlun->filp = filp;
 	curlun->file_length = size;
 	curlun->num_sectors = num_sectors;
+	curlun->ra_next = curlun->ra_end = -1;
+	curlun->ra_window = 0;
+	curlun->wb_next = -1;
+	curlun->wb_dirty = 0;
 	LDBG(curlun, "open backing file: %s size: %lld num_sectors: %lld\n",
 			filename, size, num_sectors);
 	rc = 0;
@@ -2968,7 +3100,7 @@ fsg_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	}
 
 	/* Deallocate the requests */
-	for (i = 0; i < NUM_BUFFERS; ++i) {
+	for (i = 0; i < fsg->num_buffers; ++i) {
 		struct fsg_buffhd *bh = &fsg->buffhds[i];
 		if (bh->inreq) {
 			usb_ep_free_request(fsg->bulk_in, bh->inreq);
@@ -2981,7 +3113,7 @@ fsg_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	}
 
 	/* Free the data buffers */
-	for (i = 0; i < NUM_BUFFERS; ++i)
+	for (i = 0; i < fsg->num_buffers; ++i)
 		kfree(fsg->buffhds[i].buf);
 	switch_dev_unregister(&fsg->sdev);
 }
@@ -3088,7 +3220,7 @@ fsg_function_bind(struct usb_configuration *c, struct usb_function *f)
 	}
 
 	/* Allocate the data buffers */
-	for (i = 0; i < NUM_BUFFERS; ++i) {
+	for (i = 0; i < fsg->num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &fsg->buffhds[i];
 
 		/* Allocate for the bulk-in endpoint.  We assume that
@@ -3099,10 +3231,10 @@ fsg_function_bind(struct usb_configuration *c, struct usb_function *f)
 			goto out;
 		bh->next = bh + 1;
 	}
-	fsg->buffhds[NUM_BUFFERS - 1].next = &fsg->buffhds[0];
+	fsg->buffhds[fsg->num_buffers - 1].next = &fsg->buffhds[0];
 
 	/* Allocate the requests */
-	for (i = 0; i < NUM_BUFFERS; ++i) {
+	for (i = 0; i < fsg->num_buffers; ++i) {
 		struct fsg_buffhd       *bh = &fsg->buffhds[i];
 
 		rc = alloc_request(fsg, fsg->bulk_in, &bh->inreq);
@@ -3250,7 +3382,9 @@ int mass_storage_bind_config(struct usb_configuration *c)
 	kref_init(&fsg->ref);
 	init_completion(&fsg->thread_notifier);
 
-	the_fsg->buf_size = BULK_BUFFER_SIZE;
+	the_fsg->buf_size = roundup(clamp_t(unsigned, ums_buf_size,
+			4096, 128 * 1024), 512);
+	the_fsg->num_buffers = clamp_t(unsigned, ums_buffers, 2, MAX_BUFFERS);
 	the_fsg->sdev.name = DRIVER_NAME;
 	the_fsg->sdev.print_name = print_switch_name;
 	the_fsg->sdev.print_state = print_switch_state;
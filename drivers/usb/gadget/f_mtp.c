@@ -32,6 +32,8 @@
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 #include <linux/proc_fs.h>
+#include <linux/file.h>
+#include <linux/fs.h>
 
 #include <linux/usb/ch9.h>
 #include <linux/usb/composite.h>
@@ -53,7 +55,7 @@
 #define mtp_debug(fmt, arg...)
 #endif
 
-#define BULK_BUFFER_SIZE    8192
+#define BULK_BUFFER_SIZE    16384
 #define MIN(a, b)	((a < b) ? a : b)
 
 /*
@@ -153,11 +155,23 @@ static struct usb_descriptor_header *hs_mtp_descs[] = {
 	NULL,
 };
 
-#define MAX_BULK_RX_REQ_NUM 8
-#define MAX_BULK_TX_REQ_NUM 4
+#define MAX_BULK_RX_REQ_NUM 32
+#define MAX_BULK_TX_REQ_NUM 32
 #define MAX_CTL_RX_REQ_NUM	8
 #define EHOSTRESET 0xFFFE
 
+static unsigned int mtp_buf_size = BULK_BUFFER_SIZE;
+module_param(mtp_buf_size, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_buf_size, "Size of each MTP bulk request buffer");
+
+static unsigned int mtp_rx_reqs = 16;
+module_param(mtp_rx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_rx_reqs, "Number of MTP bulk out requests");
+
+static unsigned int mtp_tx_reqs = 16;
+module_param(mtp_tx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_tx_reqs, "Number of MTP bulk in requests");
+
 /*---------------------------------------------------------------------------*/
 struct usb_mtp_context {
 	struct usb_function function;
@@ -196,6 +210,9 @@ struct usb_mtp_context {
 	unsigned char *read_buf;
 	/* available data length */
 	int data_len;
+
+	/* size of the bulk request buffers */
+	int buf_size;
 };
 
 static struct usb_mtp_context g_usb_mtp_context;
@@ -375,7 +392,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 			if (!req)
 				break;
 requeue_req:
-			req->length = BULK_BUFFER_SIZE;
+			req->length = g_usb_mtp_context.buf_size;
 			mtp_debug("rx %p queue\n", req);
 			ret = usb_ep_queue(g_usb_mtp_context.bulk_out,
 				req, GFP_ATOMIC);
@@ -501,8 +518,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE)
-				xfer = BULK_BUFFER_SIZE;
+			if (count > g_usb_mtp_context.buf_size)
+				xfer = g_usb_mtp_context.buf_size;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -547,6 +564,181 @@ struct mtp_event_data {
 #define MTP_IOC_GET_VENDOR_FLAG  _IOR(MTP_IOC_MAGIC, 4, int)
 #define MTP_IOC_CANCEL_IO        _IO(MTP_IOC_MAGIC, 5)
 #define MTP_IOC_DEVICE_RESET     _IO(MTP_IOC_MAGIC, 6)
+#define MTP_IOC_SEND_FILE        _IOW(MTP_IOC_MAGIC, 7, struct mtp_file_range)
+#define MTP_IOC_RECEIVE_FILE     _IOW(MTP_IOC_MAGIC, 8, struct mtp_file_range)
+
+/* a range of an open file to stream over the bulk endpoints */
+struct mtp_file_range {
+	int fd;
+	loff_t offset;
+	s64 length;
+};
+
+static void start_out_receive(void);
+
+/*
+ * Send length bytes of filp from offset on bulk in. The file is read
+ * straight into the tx requests, and while one is on the wire the next
+ * is being filled.
+ */
+static int mtp_send_file(struct file *filp, loff_t offset, s64 length)
+{
+	struct usb_request *req;
+	mm_segment_t old_fs;
+	ssize_t nread;
+	int xfer, ret;
+
+	while (length > 0) {
+		if (g_usb_mtp_context.error)
+			return -EIO;
+
+		req = 0;
+		ret = wait_event_interruptible(g_usb_mtp_context.tx_wq,
+			((req = req_get(&g_usb_mtp_context.tx_reqs))
+			 || g_usb_mtp_context.cancel
+			 || g_usb_mtp_context.error));
+		if (g_usb_mtp_context.cancel) {
+			mtp_debug("cancel return in mtp_send_file\n");
+			if (req != 0)
+				req_put(&g_usb_mtp_context.tx_reqs, req);
+			g_usb_mtp_context.cancel = 0;
+			return -EINVAL;
+		}
+		if (ret < 0) {
+			if (req != 0)
+				req_put(&g_usb_mtp_context.tx_reqs, req);
+			return ret;
+		}
+		if (!req)
+			continue;
+
+		xfer = min_t(s64, length, g_usb_mtp_context.buf_size);
+
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		nread = vfs_read(filp, (char __user *) req->buf, xfer, &offset);
+		set_fs(old_fs);
+		if (nread <= 0) {
+			req_put(&g_usb_mtp_context.tx_reqs, req);
+			return nread < 0 ? nread : -EIO;
+		}
+
+		req->length = nread;
+		req->zero = 0;
+		ret = usb_ep_queue(g_usb_mtp_context.bulk_in, req, GFP_KERNEL);
+		if (ret < 0) {
+			mtp_err("error %d\n", ret);
+			g_usb_mtp_context.error = 1;
+			req_put(&g_usb_mtp_context.tx_reqs, req);
+			return ret;
+		}
+
+		length -= nread;
+	}
+
+	return 0;
+}
+
+/*
+ * Write length bytes received on bulk out to filp from offset. The rx
+ * requests are written to the file directly, and are queued again as
+ * soon as they are drained so the host keeps streaming meanwhile.
+ */
+static int mtp_receive_file(struct file *filp, loff_t offset, s64 length)
+{
+	struct usb_request *req;
+	mm_segment_t old_fs;
+	ssize_t nwritten;
+	int xfer, ret;
+
+	while (length > 0) {
+		if (g_usb_mtp_context.error)
+			return -EIO;
+
+		start_out_receive();
+
+		if (g_usb_mtp_context.data_len == 0) {
+			req = 0;
+			ret = wait_event_interruptible(g_usb_mtp_context.rx_wq,
+				((req = req_get(&g_usb_mtp_context.rx_done_reqs))
+				 || g_usb_mtp_context.cancel
+				 || g_usb_mtp_context.error));
+			if (g_usb_mtp_context.cancel) {
+				mtp_debug("cancel return in mtp_receive_file\n");
+				if (req != 0)
+					req_put(&g_usb_mtp_context.rx_reqs, req);
+				g_usb_mtp_context.cancel = 0;
+				return -EINVAL;
+			}
+			if (req != 0 && req->actual == 0) {
+				req_put(&g_usb_mtp_context.rx_reqs, req);
+				req = 0;
+			}
+			if (req != 0) {
+				g_usb_mtp_context.cur_read_req = req;
+				g_usb_mtp_context.data_len = req->actual;
+				g_usb_mtp_context.read_buf = req->buf;
+			}
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+
+		xfer = min_t(s64, length, g_usb_mtp_context.data_len);
+
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		nwritten = vfs_write(filp,
+				     (char __user *) g_usb_mtp_context.read_buf,
+				     xfer, &offset);
+		set_fs(old_fs);
+		if (nwritten != xfer)
+			return nwritten < 0 ? nwritten : -EIO;
+
+		g_usb_mtp_context.read_buf += xfer;
+		g_usb_mtp_context.data_len -= xfer;
+		length -= xfer;
+
+		/* if we've emptied the buffer, release the request */
+		if (g_usb_mtp_context.data_len == 0) {
+			req_put(&g_usb_mtp_context.rx_reqs,
+					g_usb_mtp_context.cur_read_req);
+			g_usb_mtp_context.cur_read_req = 0;
+		}
+	}
+
+	return 0;
+}
+
+static int mtp_file_ioctl(unsigned int cmd, unsigned long arg)
+{
+	struct mtp_file_range range;
+	struct file *filp;
+	int ret;
+
+	if (copy_from_user(&range, (void __user *)arg, sizeof(range)))
+		return -EFAULT;
+	if (range.offset < 0 || range.length < 0)
+		return -EINVAL;
+
+	filp = fget(range.fd);
+	if (!filp)
+		return -EBADF;
+
+	if (cmd == MTP_IOC_SEND_FILE) {
+		ret = -EBADF;
+		if (filp->f_mode & FMODE_READ)
+			ret = mtp_send_file(filp, range.offset, range.length);
+	} else {
+		ret = -EBADF;
+		if (filp->f_mode & FMODE_WRITE)
+			ret = mtp_receive_file(filp, range.offset,
+					       range.length);
+	}
+
+	fput(filp);
+	return ret;
+}
 
 static int mtp_ioctl(struct inode *inode, struct file *file,
 		unsigned int cmd, unsigned long arg)
@@ -600,7 +792,7 @@ static int mtp_ioctl(struct inode *inode, struct file *file,
 		break;
 	case MTP_IOC_GET_EP_SIZE_IN:
 		/* get endpoint buffer size for bulk in */
-		len = BULK_BUFFER_SIZE;
+		len = g_usb_mtp_context.buf_size;
 		if (copy_to_user((void *)arg, &len, sizeof(int)))
 			return -EINVAL;
 		break;
@@ -627,6 +819,9 @@ static int mtp_ioctl(struct inode *inode, struct file *file,
 		wake_up(&g_usb_mtp_context.ctl_rx_wq);
 		wake_up(&g_usb_mtp_context.ctl_tx_wq);
 		break;
+	case MTP_IOC_SEND_FILE:
+	case MTP_IOC_RECEIVE_FILE:
+		return mtp_file_ioctl(cmd, arg);
 	}
 	return 0;
 }
@@ -876,7 +1071,7 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 static int
 mtp_function_bind(struct usb_configuration *c, struct usb_function *f)
 {
-	int n, rc, id;
+	int n, nreqs, rc, id;
 	struct usb_ep *ep;
 	struct usb_request *req;
 	struct proc_dir_entry *mtp_proc = NULL;
@@ -929,8 +1124,13 @@ mtp_function_bind(struct usb_configuration *c, struct usb_function *f)
 
 	rc = -ENOMEM;
 
-	for (n = 0; n < MAX_BULK_RX_REQ_NUM; n++) {
-		req = req_new(g_usb_mtp_context.bulk_out, BULK_BUFFER_SIZE);
+	/* whole packets, no smaller than the old 8 KB */
+	g_usb_mtp_context.buf_size = max(ALIGN(mtp_buf_size, 512), 8192U);
+
+	nreqs = clamp_t(unsigned, mtp_rx_reqs, 2, MAX_BULK_RX_REQ_NUM);
+	for (n = 0; n < nreqs; n++) {
+		req = req_new(g_usb_mtp_context.bulk_out,
+			      g_usb_mtp_context.buf_size);
 		if (!req)
 			goto autoconf_fail;
 
@@ -939,8 +1139,10 @@ mtp_function_bind(struct usb_configuration *c, struct usb_function *f)
 		req->complete = mtp_out_complete;
 		req_put(&g_usb_mtp_context.rx_reqs, req);
 	}
-	for (n = 0; n < MAX_BULK_TX_REQ_NUM; n++) {
-		req = req_new(g_usb_mtp_context.bulk_in, BULK_BUFFER_SIZE);
+	nreqs = clamp_t(unsigned, mtp_tx_reqs, 1, MAX_BULK_TX_REQ_NUM);
+	for (n = 0; n < nreqs; n++) {
+		req = req_new(g_usb_mtp_context.bulk_in,
+			      g_usb_mtp_context.buf_size);
 		if (!req)
 			goto autoconf_fail;
 
@@ -952,7 +1154,7 @@ mtp_function_bind(struct usb_configuration *c, struct usb_function *f)
 		ctl_req_put(&g_usb_mtp_context.ctl_rx_reqs, &ctl_reqs[n]);
 
 	g_usb_mtp_context.int_tx_req =
-		req_new(g_usb_mtp_context.intr_in, BULK_BUFFER_SIZE);
+		req_new(g_usb_mtp_context.intr_in, MTP_EVENT_SIZE);
 	if (!g_usb_mtp_context.int_tx_req)
 		goto autoconf_fail;
 	g_usb_mtp_context.intr_in_busy = 0;
@@ -1019,7 +1221,7 @@ static void start_out_receive(void)
 
 	/* if we have idle read requests, get them queued */
 	while ((req = req_get(&g_usb_mtp_context.rx_reqs))) {
-		req->length = BULK_BUFFER_SIZE;
+		req->length = g_usb_mtp_context.buf_size;
 		ret = usb_ep_queue(g_usb_mtp_context.bulk_out, req, GFP_ATOMIC);
 		if (ret < 0) {
 			mtp_err("error %d\n", ret);
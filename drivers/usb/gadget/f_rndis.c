@@ -98,6 +98,19 @@ struct f_rndis {
 	atomic_t			notify_count;
 };
 
+/* Packet messages per bulk transfer in each direction.  Device to host
+ * transfers are further limited by the MaxTransferSize the host sends
+ * in REMOTE_NDIS_INITIALIZE_MSG; 1 sends every frame on its own.
+ */
+static unsigned int rndis_dl_max_pkts = 4;
+module_param(rndis_dl_max_pkts, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_dl_max_pkts, "RNDIS packets per transfer to the host");
+
+static unsigned int rndis_ul_max_pkts = 4;
+module_param(rndis_ul_max_pkts, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_ul_max_pkts, "RNDIS packets per transfer the host "
+		 "may send");
+
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 {
 	return container_of(f, struct f_rndis, port.func);
@@ -360,14 +373,14 @@ static struct usb_ether_platform_data *rndis_pdata;
 static struct sk_buff *rndis_add_header(struct gether *port,
 					struct sk_buff *skb)
 {
-	struct sk_buff *skb2;
-
-	skb2 = skb_realloc_headroom(skb, sizeof(struct rndis_packet_msg_type));
-	if (skb2)
-		rndis_add_hdr(skb2);
-
-	dev_kfree_skb_any(skb);
-	return skb2;
+	/* the net_device asks the stack for this headroom, so this
+	 * normally only copies skbs whose header is shared */
+	if (skb_cow_head(skb, sizeof(struct rndis_packet_msg_type))) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+	rndis_add_hdr(skb);
+	return skb;
 }
 
 static void rndis_response_available(void *_rndis)
@@ -573,6 +586,10 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		/* Avoid ZLPs; they can be troublesome. */
 		rndis->port.is_zlp_ok = false;
 
+		/* one frame per transfer until the host says how much
+		 * it takes, in REMOTE_NDIS_INITIALIZE_MSG */
+		rndis->port.dl_max_xfer_size = 0;
+
 		/* RNDIS should be in the "RNDIS uninitialized" state,
 		 * either never activated or after rndis_uninit().
 		 *
@@ -787,6 +804,8 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
+	rndis_set_param_xfer(rndis->config, rndis->port.ul_max_pkts_per_xfer,
+			&rndis->port.dl_max_xfer_size);
 
 #ifdef CONFIG_USB_ANDROID_RNDIS
 	if (rndis_pdata) {
@@ -923,6 +942,8 @@ int __init rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.dl_max_pkts_per_xfer = max(rndis_dl_max_pkts, 1U);
+	rndis->port.ul_max_pkts_per_xfer = max(rndis_ul_max_pkts, 1U);
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
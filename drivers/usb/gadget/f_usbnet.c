@@ -53,9 +53,10 @@
 
 /* Linux Network Interface */
 #define USB_MTU                 1536
-#define MAX_BULK_TX_REQ_NUM	8
-#define MAX_BULK_RX_REQ_NUM	8
+#define MAX_BULK_TX_REQ_NUM	16
+#define MAX_BULK_RX_REQ_NUM	16
 #define MAX_INTR_RX_REQ_NUM	8
+#define USBNET_NAPI_WEIGHT	64
 
 struct usbnet_if_configuration {
 	u32 ip_addr;
@@ -80,6 +81,10 @@ struct usbnet_context {
 	struct list_head rx_reqs;
 	struct list_head tx_reqs;
 
+	/* received frames waiting for usbnet_poll() */
+	struct sk_buff_head rx_done;
+	struct napi_struct napi;
+
 	struct net_device_stats stats;
 };
 
@@ -325,15 +330,51 @@ static int usb_ether_xmit(struct sk_buff *skb, struct net_device *dev)
 static int usb_ether_open(struct net_device *dev)
 {
 	printk(KERN_DEBUG "%s\n", __func__);
+	napi_enable(&g_usbnet_context->napi);
 	return 0;
 }
 
 static int usb_ether_stop(struct net_device *dev)
 {
 	printk(KERN_DEBUG "%s\n", __func__);
+	napi_disable(&g_usbnet_context->napi);
+	skb_queue_purge(&g_usbnet_context->rx_done);
 	return 0;
 }
 
+/*
+ * Frames completed on bulk out are handed to the stack here, in softirq
+ * context and up to a budget at a time, rather than one netif_rx() per
+ * completion interrupt.  They go through GRO, which merges the segments
+ * of a TCP stream that arrive in one batch.
+ */
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&g_usbnet_context->rx_done);
+		if (!skb)
+			break;
+		skb->protocol = eth_type_trans(skb, g_usbnet_context->dev);
+		g_usbnet_context->stats.rx_packets++;
+		g_usbnet_context->stats.rx_bytes += skb->len + ETH_HLEN;
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a completion may have queued a frame after the last
+		 * dequeue but before napi_complete() */
+		if (!skb_queue_empty(&g_usbnet_context->rx_done))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
 static struct net_device_stats *usb_ether_get_stats(struct net_device *dev)
 {
 	return &g_usbnet_context->stats;
@@ -399,6 +440,9 @@ static void __init usb_ether_setup(struct net_device *dev)
 	g_usbnet_context = netdev_priv(dev);
 	INIT_LIST_HEAD(&g_usbnet_context->rx_reqs);
 	INIT_LIST_HEAD(&g_usbnet_context->tx_reqs);
+	skb_queue_head_init(&g_usbnet_context->rx_done);
+	netif_napi_add(dev, &g_usbnet_context->napi, usbnet_poll,
+		       USBNET_NAPI_WEIGHT);
 
 	spin_lock_init(&g_usbnet_context->lock);
 	g_usbnet_context->dev = dev;
@@ -408,6 +452,7 @@ static void __init usb_ether_setup(struct net_device *dev)
 	dev->watchdog_timeo = 20;
 
 	ether_setup(dev);
+	dev->features |= NETIF_F_GRO;
 
 	random_ether_addr(dev->dev_addr);
 }
@@ -481,10 +526,16 @@ static void ether_out_complete(struct usb_ep *ep, struct usb_request *req)
 		dmac_inv_range((void *)req->buf, (void *)(req->buf +
 					req->actual));
 		skb_put(skb, req->actual);
-		skb->protocol = eth_type_trans(skb, g_usbnet_context->dev);
-		g_usbnet_context->stats.rx_packets++;
-		g_usbnet_context->stats.rx_bytes += req->actual;
-		netif_rx(skb);
+		if (netif_running(g_usbnet_context->dev)) {
+			skb_queue_tail(&g_usbnet_context->rx_done, skb);
+			napi_schedule(&g_usbnet_context->napi);
+		} else {
+			skb->protocol = eth_type_trans(skb,
+						g_usbnet_context->dev);
+			g_usbnet_context->stats.rx_packets++;
+			g_usbnet_context->stats.rx_bytes += req->actual;
+			netif_rx(skb);
+		}
 	} else {
 		dev_kfree_skb_any(skb);
 		g_usbnet_context->stats.rx_errors++;
@@ -580,16 +580,26 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32 (1);
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (
+		max(params->max_pkt_per_xfer, 1U));
 	resp->MaxTransferSize = cpu_to_le32 (
-		  params->dev->mtu
+		max(params->max_pkt_per_xfer, 1U)
+		* (params->dev->mtu
 		+ sizeof (struct ethhdr)
 		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
-	resp->PacketAlignmentFactor = cpu_to_le32 (0);
+		+ 22));
+	/* Packed messages start on 4 byte boundaries, which keeps the IP
+	 * header of each one aligned like the first */
+	resp->PacketAlignmentFactor = cpu_to_le32 (
+		params->max_pkt_per_xfer > 1 ? 2 : 0);
 	resp->AFListOffset = cpu_to_le32 (0);
 	resp->AFListSize = cpu_to_le32 (0);
 
+	/* and the host tells us how much it takes in one transfer */
+	if (params->dl_max_xfer_size)
+		*params->dl_max_xfer_size =
+			get_unaligned_le32(&buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -954,6 +964,18 @@ int rndis_set_param_medium (u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+int rndis_set_param_xfer (u8 configNr, u32 max_pkt_per_xfer,
+			  u32 *dl_max_xfer_size)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params [configNr].max_pkt_per_xfer = max_pkt_per_xfer;
+	rndis_per_dev_params [configNr].dl_max_xfer_size = dl_max_xfer_size;
+
+	return 0;
+}
+
 void rndis_add_hdr (struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type	*header;
@@ -1022,30 +1044,59 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
+/*
+ * A transfer holds one or more packet messages.  All but the last frame
+ * are clones sharing the transfer's buffer, so nothing is copied.
+ * Anything after the last whole message is padding.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	struct sk_buff	*skb2;
+	__le32		*tmp;
+	u32		msg_len, data_offset, data_len;
+	int		frames = 0;
+
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		tmp = (void *) skb->data;
+
+		/* MessageType, MessageLength */
+		if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++))
+			break;
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+		if (msg_len > skb->len
+				|| data_offset > msg_len
+				|| data_len > msg_len - data_offset) {
+			dev_kfree_skb_any(skb);
+			return frames ? 0 : -EOVERFLOW;
+		}
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		if (msg_len == skb->len)
+			skb2 = skb;
+		else
+			skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2)
+			break;
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+		frames++;
+
+		if (skb2 == skb)
+			return 0;
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	dev_kfree_skb_any(skb);
+	return frames ? 0 : -EINVAL;
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
@@ -27,6 +27,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/if_vlan.h>
 
 #include "u_ether.h"
 
@@ -70,6 +71,13 @@ struct eth_dev {
 
 	struct sk_buff_head	rx_frames;
 
+	/* tx aggregation: tx_agg is a request being filled, held back
+	 * while other transfers are in flight (guarded by req_lock) */
+	size_t			tx_buf_size;	/* zero if not aggregating */
+	unsigned		tx_max_frame;
+	struct usb_request	*tx_agg;
+	unsigned		tx_agg_pkts;
+
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
 	int			(*unwrap)(struct gether *,
@@ -209,12 +217,15 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	int		retval = -ENOMEM;
 	size_t		size = 0;
 	struct usb_ep	*out;
+	unsigned	header_len = 0, pkts = 1;
 	unsigned long	flags;
 
 	spin_lock_irqsave(&dev->lock, flags);
-	if (dev->port_usb)
+	if (dev->port_usb) {
 		out = dev->port_usb->out_ep;
-	else
+		header_len = dev->port_usb->header_len;
+		pkts = max(dev->port_usb->ul_max_pkts_per_xfer, 1U);
+	} else
 		out = NULL;
 	spin_unlock_irqrestore(&dev->lock, flags);
 
@@ -233,9 +244,14 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 * pad to end-of-packet.  That's potentially nice for speed, but
 	 * means receivers can't recover lost synch on their own (because
 	 * new packets don't only start after a short RX).
+	 *
+	 * When the host may pack several frames into one transfer, make
+	 * room for that many, plus alignment padding between them.
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
-	size += dev->port_usb->header_len;
+	size += header_len;
+	if (pkts > 1)
+		size = (size + 4) * pkts;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -457,34 +473,166 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_agg_send(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, unsigned pkts);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
-
-	switch (req->status) {
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*held = NULL;
+	unsigned		held_pkts = 0;
+	int			status = req->status;
+
+	/* aggregated transfers have no skb; their frames were counted
+	 * as they were copied in */
+	switch (status) {
 	default:
 		dev->net->stats.tx_errors++;
-		VDBG(dev, "tx err %d\n", req->status);
+		VDBG(dev, "tx err %d\n", status);
 		/* FALLTHROUGH */
 	case -ECONNRESET:		/* unlink */
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	atomic_dec(&dev->tx_qlen);
+
+	/* the endpoint has room again: send what was held back */
+	if (dev->tx_agg && status != -ECONNRESET && status != -ESHUTDOWN) {
+		held = dev->tx_agg;
+		held_pkts = dev->tx_agg_pkts;
+		dev->tx_agg = NULL;
+	}
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb)
+		dev_kfree_skb_any(skb);
+
+	if (held)
+		tx_agg_send(dev, ep, held, held_pkts);
 
-	atomic_dec(&dev->tx_qlen);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+/*
+ * Aggregated tx: each request owns a buffer, and wrapped frames are
+ * copied into it back to back, which also takes care of fragmented and
+ * checksum offloaded skbs.  A request that still has room for a full
+ * sized frame is held back while earlier transfers are in flight; the
+ * next completion sends it, so frames only wait while the link is busy.
+ */
+static void tx_agg_send(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, unsigned pkts)
+{
+	unsigned long	flags;
+	int		retval;
+
+	req->context = NULL;
+	req->complete = tx_complete;
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;		/* the buffer has a spare byte */
+	req->no_interrupt = 0;
+
+	/* count it before the completion can run */
+	atomic_inc(&dev->tx_qlen);
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval == 0) {
+		dev->net->trans_start = jiffies;
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_dropped += pkts;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	atomic_dec(&dev->tx_qlen);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static netdev_tx_t tx_agg_xmit(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in, unsigned max_pkts, size_t max_xfer)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req = NULL;
+	unsigned		pkts = 0;
+	unsigned long		flags;
+	int			send;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (dev->tx_agg) {
+		req = dev->tx_agg;
+		pkts = dev->tx_agg_pkts;
+		dev->tx_agg = NULL;
+	} else if (!list_empty(&dev->tx_reqs)) {
+		req = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	/* see eth_start_xmit() */
+	if (!req)
+		return NETDEV_TX_BUSY;
+
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+	}
+
+	if (skb && skb->len <= dev->tx_max_frame) {
+		if (skb->ip_summed == CHECKSUM_PARTIAL)
+			skb_copy_and_csum_dev(skb, req->buf + req->length);
+		else
+			skb_copy_bits(skb, 0, req->buf + req->length,
+					skb->len);
+		req->length += skb->len;
+		pkts++;
+		net->stats.tx_packets++;
+		net->stats.tx_bytes += skb->len;
+	} else {
+		net->stats.tx_dropped++;
+	}
+	if (skb)
+		dev_kfree_skb_any(skb);
+
+	/* Send it now unless it can take another frame and the endpoint
+	 * is busy anyway.  tx_complete() checks tx_agg under the same lock
+	 * after it drops tx_qlen, so a held request is never stranded.
+	 */
+	spin_lock_irqsave(&dev->req_lock, flags);
+	send = pkts >= max_pkts
+		|| req->length + dev->tx_max_frame > max_xfer
+		|| atomic_read(&dev->tx_qlen) <= 0;
+	if (pkts == 0) {
+		list_add(&req->list, &dev->tx_reqs);
+		send = 0;
+	} else if (!send) {
+		dev->tx_agg = req;
+		dev->tx_agg_pkts = pkts;
+	}
+	if (list_empty(&dev->tx_reqs) && !dev->tx_agg)
+		netif_stop_queue(net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (send)
+		tx_agg_send(dev, in, req, pkts);
+	return NETDEV_TX_OK;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -500,11 +648,19 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	unsigned		max_pkts = 0;
+	size_t			max_xfer = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		if (dev->tx_buf_size) {
+			max_pkts = dev->port_usb->dl_max_pkts_per_xfer;
+			max_xfer = min_t(size_t,
+					dev->port_usb->dl_max_xfer_size,
+					dev->tx_buf_size - 1);
+		}
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -538,6 +694,16 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (max_pkts)
+		return tx_agg_xmit(dev, skb, in, max_pkts, max_xfer);
+
+	/* SG and checksum offload are only advertised while aggregating,
+	 * but a frame queued before the link changed may still need it */
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb))
+		goto drop_skb;
+	if (skb_linearize(skb))
+		goto drop_skb;
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -614,6 +780,48 @@ drop:
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 	}
 	return NETDEV_TX_OK;
+
+drop_skb:
+	dev_kfree_skb_any(skb);
+	dev->net->stats.tx_dropped++;
+	return NETDEV_TX_OK;
+}
+
+/* Give each tx request its own buffer when the link aggregates frames.
+ * If that memory can't be had, frames go out one per transfer.
+ */
+static void tx_agg_alloc(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req, *failed = NULL;
+	size_t			size;
+
+	dev->tx_buf_size = 0;
+	dev->tx_agg = NULL;
+	if (link->dl_max_pkts_per_xfer < 2)
+		return;
+
+	dev->tx_max_frame = link->header_len + VLAN_ETH_HLEN + dev->net->mtu;
+	size = link->dl_max_pkts_per_xfer * dev->tx_max_frame + 1;
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->buf = kmalloc(size, GFP_ATOMIC);
+		if (!req->buf) {
+			failed = req;
+			break;
+		}
+	}
+	if (failed) {
+		list_for_each_entry(req, &dev->tx_reqs, list) {
+			if (req == failed)
+				break;
+			kfree(req->buf);
+		}
+		DBG(dev, "no memory for tx aggregation\n");
+	} else {
+		dev->tx_buf_size = size;
+	}
+	spin_unlock(&dev->req_lock);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -895,6 +1103,15 @@ struct net_device *gether_connect(struct gether *link)
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
 
+		/* frames are copied when aggregating, so the stack need
+		 * not linearize or checksum them for us */
+		tx_agg_alloc(dev, link);
+		if (dev->tx_buf_size)
+			dev->net->features |= NETIF_F_SG | NETIF_F_HW_CSUM;
+		else
+			dev->net->features &= ~(NETIF_F_SG | NETIF_F_HW_CSUM);
+		dev->net->needed_headroom = link->header_len;
+
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
 		link->ioport = dev;
@@ -955,16 +1172,24 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg) {
+		list_add(&dev->tx_agg->list, &dev->tx_reqs);
+		dev->tx_agg = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_buf_size)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
 	spin_unlock(&dev->req_lock);
+	dev->tx_buf_size = 0;
+	dev->net->features &= ~(NETIF_F_SG | NETIF_F_HW_CSUM);
 	link->in_ep->driver_data = NULL;
 	link->in = NULL;
 
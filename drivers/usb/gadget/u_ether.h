@@ -68,6 +68,17 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* Several frames per transfer, when the framing allows it.  With
+	 * dl_max_pkts_per_xfer above one, wrapped frames are copied back
+	 * to back into transfers of up to dl_max_xfer_size bytes; that
+	 * size may change while connected, and zero means one frame per
+	 * transfer.  ul_max_pkts_per_xfer sizes the rx buffers for hosts
+	 * that pack frames the same way; unwrap() splits them.
+	 */
+	unsigned			dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+	unsigned			ul_max_pkts_per_xfer;
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -27,7 +27,9 @@
  *
  * This file implements a generic cache implementation used for both caches,
  * plus functions layered ontop of the generic cache implementation to
- * access the metadata and fragment caches.
+ * access the metadata and fragment caches.  Blocks are looked up through
+ * a hash of their disk location, and unused entries are reused least
+ * recently used first.
  *
  * To avoid out of memory and fragmentation isssues with vmalloc the cache
  * uses sequences of kmalloced PAGE_CACHE_SIZE buffers.
@@ -51,14 +53,38 @@
 #include <linux/sched.h>
 #include <linux/spinlock.h>
 #include <linux/wait.h>
-#include <linux/zlib.h>
 #include <linux/pagemap.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
 
+static inline struct hlist_head *squashfs_cache_hash(
+	struct squashfs_cache *cache, u64 block)
+{
+	return &cache->hash[hash_64(block, cache->hash_bits)];
+}
+
+
+static struct squashfs_cache_entry *squashfs_cache_lookup(
+	struct squashfs_cache *cache, u64 block)
+{
+	struct squashfs_cache_entry *entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(entry, node, squashfs_cache_hash(cache, block),
+			hash)
+		if (entry->block == block)
+			return entry;
+
+	return NULL;
+}
+
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -66,22 +92,20 @@
 struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 	struct squashfs_cache *cache, u64 block, int length)
 {
-	int i, n;
 	struct squashfs_cache_entry *entry;
 
 	spin_lock(&cache->lock);
 
 	while (1) {
-		for (i = 0; i < cache->entries; i++)
-			if (cache->entry[i].block == block)
-				break;
+		entry = squashfs_cache_lookup(cache, block);
 
-		if (i == cache->entries) {
+		if (entry == NULL) {
 			/*
 			 * Block not in cache, if all cache entries are used
 			 * go to sleep waiting for one to become available.
 			 */
 			if (cache->unused == 0) {
+				cache->waits++;
 				cache->num_waiters++;
 				spin_unlock(&cache->lock);
 				wait_event(cache->wait_queue, cache->unused);
@@ -91,19 +115,16 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			}
 
 			/*
-			 * At least one unused cache entry.  A simple
-			 * round-robin strategy is used to choose the entry to
-			 * be evicted from the cache.
+			 * At least one unused cache entry.  The least
+			 * recently used one is evicted.
 			 */
-			i = cache->next_blk;
-			for (n = 0; n < cache->entries; n++) {
-				if (cache->entry[i].refcount == 0)
-					break;
-				i = (i + 1) % cache->entries;
-			}
-
-			cache->next_blk = (i + 1) % cache->entries;
-			entry = &cache->entry[i];
+			entry = list_first_entry(&cache->lru,
+				struct squashfs_cache_entry, lru);
+			list_del_init(&entry->lru);
+			hlist_del_init(&entry->hash);
+			hlist_add_head(&entry->hash,
+				squashfs_cache_hash(cache, block));
+			cache->misses++;
 
 			/*
 			 * Initialise choosen cache entry, and fill it in from
@@ -148,9 +169,11 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		 * previously unused there's one less cache entry available
 		 * for reuse.
 		 */
-		entry = &cache->entry[i];
-		if (entry->refcount == 0)
+		cache->hits++;
+		if (entry->refcount == 0) {
 			cache->unused--;
+			list_del_init(&entry->lru);
+		}
 		entry->refcount++;
 
 		/*
@@ -169,7 +192,8 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 out:
 	TRACE("Got %s %d, start block %lld, refcount %d, error %d\n",
-		cache->name, i, entry->block, entry->refcount, entry->error);
+		cache->name, (int) (entry - cache->entry), entry->block,
+		entry->refcount, entry->error);
 
 	if (entry->error)
 		ERROR("Unable to read %s cache entry [%llx]\n", cache->name,
@@ -189,6 +213,17 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
 	entry->refcount--;
 	if (entry->refcount == 0) {
 		cache->unused++;
+		/*
+		 * Entries are reused least recently used first.  An entry
+		 * that failed to read is dropped from the hash and reused
+		 * before any other, so that the next lookup retries the read.
+		 */
+		if (entry->error) {
+			hlist_del_init(&entry->hash);
+			entry->block = SQUASHFS_INVALID_BLK;
+			list_add(&entry->lru, &cache->lru);
+		} else
+			list_add_tail(&entry->lru, &cache->lru);
 		/*
 		 * If there's any processes waiting for a block to become
 		 * available, wake one up.
@@ -202,6 +237,29 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
 	spin_unlock(&cache->lock);
 }
 
+
+/*
+ * Print the size and hit/miss statistics of the cache, for
+ * /proc/self/mountstats.
+ */
+void squashfs_cache_stats(struct seq_file *m, struct squashfs_cache *cache)
+{
+	unsigned long hits, misses, waits;
+
+	if (cache == NULL)
+		return;
+
+	spin_lock(&cache->lock);
+	hits = cache->hits;
+	misses = cache->misses;
+	waits = cache->waits;
+	spin_unlock(&cache->lock);
+
+	seq_printf(m, "\n\t%s cache: entries %d block %d hits %lu misses %lu "
+		"waits %lu", cache->name, cache->entries, cache->block_size,
+		hits, misses, waits);
+}
+
 /*
  * Delete cache reclaiming all kmalloced buffers.
  */
@@ -221,6 +279,7 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 	}
 
 	kfree(cache->entry);
+	kfree(cache->hash);
 	kfree(cache);
 }
 
@@ -247,7 +306,16 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		goto cleanup;
 	}
 
-	cache->next_blk = 0;
+	/* at least two buckets, and no more than one entry per bucket */
+	cache->hash_bits = ilog2(roundup_pow_of_two(entries)) + 1;
+	cache->hash = kcalloc(1 << cache->hash_bits, sizeof(*(cache->hash)),
+		GFP_KERNEL);
+	if (cache->hash == NULL) {
+		ERROR("Failed to allocate %s cache\n", name);
+		goto cleanup;
+	}
+
+	INIT_LIST_HEAD(&cache->lru);
 	cache->unused = entries;
 	cache->entries = entries;
 	cache->block_size = block_size;
@@ -264,6 +332,8 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		init_waitqueue_head(&cache->entry[i].wait_queue);
 		entry->cache = cache;
 		entry->block = SQUASHFS_INVALID_BLK;
+		INIT_HLIST_NODE(&entry->hash);
+		list_add_tail(&entry->lru, &cache->lru);
 		entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
 		if (entry->data == NULL) {
 			ERROR("Failed to allocate %s cache entry\n", name);
@@ -341,10 +411,15 @@ int squashfs_read_metadata(struct super_block *sb, void *buffer,
 
 	while (length) {
 		entry = squashfs_cache_get(sb, msblk->block_cache, *block, 0);
-		if (entry->error)
-			return entry->error;
-		else if (*offset >= entry->length)
+		if (entry->error) {
+			int error = entry->error;
+
+			squashfs_cache_put(entry);
+			return error;
+		} else if (*offset >= entry->length) {
+			squashfs_cache_put(entry);
 			return -EIO;
+		}
 
 		bytes = squashfs_copy_data(buffer, entry, *offset, length);
 		if (buffer)
@@ -38,6 +38,12 @@
  * Larger files use multiple slots, with 1.75 TiB files using all 8 slots.
  * The index cache is designed to be memory efficient, and by default uses
  * 16 KiB.
+ *
+ * Readahead is done a datablock at a time: squashfs_readpages() adds the
+ * pages of the readahead window to the page cache, grabs the rest of the
+ * pages covered by each datablock, and decompresses each datablock once
+ * into all of them.  The readahead window of each open file is set from
+ * the readahead mount option, which is rounded to whole datablocks.
  */
 
 #include <linux/fs.h>
@@ -47,7 +53,6 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
-#include <linux/zlib.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -372,76 +377,15 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
-static int squashfs_readpage(struct file *file, struct page *page)
+/* Copy data into page cache  */
+void squashfs_copy_cache(struct page *page, struct squashfs_cache_entry *buffer,
+	int bytes, int offset)
 {
 	struct inode *inode = page->mapping->host;
 	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-	int bytes, i, offset = 0, sparse = 0;
-	struct squashfs_cache_entry *buffer = NULL;
 	void *pageaddr;
-
-	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
-	int index = page->index >> (msblk->block_log - PAGE_CACHE_SHIFT);
-	int start_index = page->index & ~mask;
-	int end_index = start_index | mask;
-	int file_end = i_size_read(inode) >> msblk->block_log;
-
-	TRACE("Entered squashfs_readpage, page index %lx, start block %llx\n",
-				page->index, squashfs_i(inode)->start);
-
-	if (page->index >= ((i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
-					PAGE_CACHE_SHIFT))
-		goto out;
-
-	if (index < file_end || squashfs_i(inode)->fragment_block ==
-					SQUASHFS_INVALID_BLK) {
-		/*
-		 * Reading a datablock from disk.  Need to read block list
-		 * to get location and block size.
-		 */
-		u64 block = 0;
-		int bsize = read_blocklist(inode, index, &block);
-		if (bsize < 0)
-			goto error_out;
-
-		if (bsize == 0) { /* hole */
-			bytes = index == file_end ?
-				(i_size_read(inode) & (msblk->block_size - 1)) :
-				 msblk->block_size;
-			sparse = 1;
-		} else {
-			/*
-			 * Read and decompress datablock.
-			 */
-			buffer = squashfs_get_datablock(inode->i_sb,
-								block, bsize);
-			if (buffer->error) {
-				ERROR("Unable to read page, block %llx, size %x"
-					"\n", block, bsize);
-				squashfs_cache_put(buffer);
-				goto error_out;
-			}
-			bytes = buffer->length;
-		}
-	} else {
-		/*
-		 * Datablock is stored inside a fragment (tail-end packed
-		 * block).
-		 */
-		buffer = squashfs_get_fragment(inode->i_sb,
-				squashfs_i(inode)->fragment_block,
-				squashfs_i(inode)->fragment_size);
-
-		if (buffer->error) {
-			ERROR("Unable to read page, block %llx, size %x\n",
-				squashfs_i(inode)->fragment_block,
-				squashfs_i(inode)->fragment_size);
-			squashfs_cache_put(buffer);
-			goto error_out;
-		}
-		bytes = i_size_read(inode) & (msblk->block_size - 1);
-		offset = squashfs_i(inode)->fragment_offset;
-	}
+	int i, mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = page->index & ~mask, end_index = start_index | mask;
 
 	/*
 	 * Loop copying datablock into pages.  As the datablock likely covers
@@ -452,7 +396,7 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	for (i = start_index; i <= end_index && bytes > 0; i++,
 			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
 		struct page *push_page;
-		int avail = sparse ? 0 : min_t(int, bytes, PAGE_CACHE_SIZE);
+		int avail = buffer ? min_t(int, bytes, PAGE_CACHE_SIZE) : 0;
 
 		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
 
@@ -476,11 +420,179 @@ skip_page:
 		if (i != page->index)
 			page_cache_release(push_page);
 	}
+}
+
+
+/*
+ * Grab the page cache pages covered by the datablock starting at page
+ * start_index into page[], keeping any the caller has put there already.
+ * Pages another thread has locked, or which are uptodate already, are
+ * left NULL.  Returns the number of pages, which at the end of the file
+ * may be less than a whole datablock.
+ */
+int squashfs_grab_pages(struct inode *inode, struct page **page,
+	int start_index)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int pages = min(file_end - start_index + 1,
+		1 << (msblk->block_log - PAGE_CACHE_SHIFT));
+	int i;
+
+	for (i = 0; i < pages; i++) {
+		if (page[i])
+			continue;
+
+		page[i] = grab_cache_page_nowait(inode->i_mapping,
+			start_index + i);
+		if (page[i] && PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+		}
+	}
+
+	return pages;
+}
+
+
+/*
+ * Reading a datablock into page[] failed, mark the pages as errored,
+ * unlock and release them.  Target_page is dealt with by the caller.
+ */
+void squashfs_error_pages(struct page *target_page, struct page **page,
+	int pages)
+{
+	int i;
+
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL || page[i] == target_page)
+			continue;
+		flush_dcache_page(page[i]);
+		SetPageError(page[i]);
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+}
+
+
+/*
+ * Read datablock through the "data" cache and memcopy it into page[], as
+ * filled in by squashfs_grab_pages().  The pages are marked uptodate,
+ * unlocked and, except for target_page, released.
+ */
+int squashfs_read_cache_pages(struct inode *inode, struct page *target_page,
+	struct page **page, int pages, u64 block, int bsize)
+{
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(
+						inode->i_sb, block, bsize);
+	int bytes = buffer->length, res = buffer->error, n, offset = 0;
+	void *pageaddr;
+
+	if (res) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		squashfs_error_pages(target_page, page, pages);
+		goto out;
+	}
+
+	for (n = 0; n < pages; n++, bytes -= PAGE_CACHE_SIZE,
+			offset += PAGE_CACHE_SIZE) {
+		int avail = clamp_t(int, bytes, 0, PAGE_CACHE_SIZE);
+
+		if (page[n] == NULL)
+			continue;
+
+		pageaddr = kmap_atomic(page[n], KM_USER0);
+		squashfs_copy_data(pageaddr, buffer, offset, avail);
+		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+		kunmap_atomic(pageaddr, KM_USER0);
+		flush_dcache_page(page[n]);
+		SetPageUptodate(page[n]);
+		unlock_page(page[n]);
+		if (page[n] != target_page)
+			page_cache_release(page[n]);
+	}
+
+out:
+	squashfs_cache_put(buffer);
+	return res;
+}
 
-	if (!sparse)
-		squashfs_cache_put(buffer);
 
+/* Read datablock stored packed inside a fragment (tail-end packed block) */
+static int squashfs_readpage_fragment(struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	struct squashfs_cache_entry *buffer = squashfs_get_fragment(inode->i_sb,
+		squashfs_i(inode)->fragment_block,
+		squashfs_i(inode)->fragment_size);
+	int res = buffer->error;
+
+	if (res)
+		ERROR("Unable to read page, block %llx, size %x\n",
+			squashfs_i(inode)->fragment_block,
+			squashfs_i(inode)->fragment_size);
+	else
+		squashfs_copy_cache(page, buffer, i_size_read(inode) &
+			(msblk->block_size - 1),
+			squashfs_i(inode)->fragment_offset);
+
+	squashfs_cache_put(buffer);
+	return res;
+}
+
+
+static int squashfs_readpage_sparse(struct page *page, int index, int file_end)
+{
+	struct inode *inode = page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int bytes = index == file_end ?
+			(i_size_read(inode) & (msblk->block_size - 1)) :
+			 msblk->block_size;
+
+	squashfs_copy_cache(page, NULL, bytes, 0);
 	return 0;
+}
+
+
+static int squashfs_readpage(struct file *file, struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int index = page->index >> (msblk->block_log - PAGE_CACHE_SHIFT);
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int res;
+	void *pageaddr;
+
+	TRACE("Entered squashfs_readpage, page index %lx, start block %llx\n",
+				page->index, squashfs_i(inode)->start);
+
+	if (page->index >= ((i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+					PAGE_CACHE_SHIFT))
+		goto out;
+
+	if (index < file_end || squashfs_i(inode)->fragment_block ==
+					SQUASHFS_INVALID_BLK) {
+		/*
+		 * Reading a datablock from disk.  Need to read block list
+		 * to get location and block size.
+		 */
+		u64 block = 0;
+		int bsize = read_blocklist(inode, index, &block);
+		if (bsize < 0)
+			goto error_out;
+
+		if (bsize == 0) /* hole */
+			res = squashfs_readpage_sparse(page, index, file_end);
+		else
+			res = squashfs_readpage_block(page, block, bsize);
+	} else
+		res = squashfs_readpage_fragment(page);
+
+	if (!res)
+		return 0;
 
 error_out:
 	SetPageError(page);
@@ -497,6 +609,97 @@ out:
 }
 
 
+/*
+ * Read the pages of the readahead window a datablock at a time.  Pages
+ * in fragments or holes, and those of datablocks whose block list cannot
+ * be read, are left to squashfs_readpage().
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	struct page **page;
+
+	TRACE("Entered squashfs_readpages, %u pages, start block %llx\n",
+				nr_pages, squashfs_i(inode)->start);
+
+	page = kmalloc((1 << shift) * sizeof(*page), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
+
+	while (!list_empty(pages)) {
+		/* the list is in descending order, its tail is the lowest */
+		struct page *p = list_entry(pages->prev, struct page, lru);
+		int index = p->index >> shift, start_index = index << shift;
+		int i, n, bsize = 0;
+		u64 block = 0;
+
+		memset(page, 0, (1 << shift) * sizeof(*page));
+
+		/* Take the pages of the list within this datablock */
+		while (!list_empty(pages)) {
+			p = list_entry(pages->prev, struct page, lru);
+			if (p->index >> shift != index)
+				break;
+
+			list_del(&p->lru);
+			if (add_to_page_cache_lru(p, mapping, p->index,
+					GFP_KERNEL))
+				page_cache_release(p);
+			else
+				page[p->index - start_index] = p;
+		}
+
+		if (index < file_end || squashfs_i(inode)->fragment_block ==
+					SQUASHFS_INVALID_BLK)
+			bsize = read_blocklist(inode, index, &block);
+
+		if (bsize > 0) {
+			n = squashfs_grab_pages(inode, page, start_index);
+			squashfs_readpages_block(inode, NULL, page, n, block,
+				bsize);
+			continue;
+		}
+
+		for (i = 0; i < 1 << shift; i++) {
+			if (page[i] == NULL)
+				continue;
+			squashfs_readpage(file, page[i]);
+			page_cache_release(page[i]);
+		}
+	}
+
+	kfree(page);
+	return 0;
+}
+
+
+/*
+ * Start the readahead window of each open file at the size given by the
+ * readahead mount option.
+ */
+static int squashfs_file_open(struct inode *inode, struct file *file)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+
+	file->f_ra.ra_pages = msblk->ra_pages;
+	return 0;
+}
+
+
+const struct file_operations squashfs_file_ops = {
+	.llseek = generic_file_llseek,
+	.read = do_sync_read,
+	.aio_read = generic_file_aio_read,
+	.mmap = generic_file_readonly_mmap,
+	.splice_read = generic_file_splice_read,
+	.open = squashfs_file_open
+};
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readpages = squashfs_readpages
 };
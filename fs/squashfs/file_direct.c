@@ -0,0 +1,138 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * file_direct.c
+ */
+
+/*
+ * This file decompresses datablocks straight into the page cache pages
+ * they cover, rather than into the "data" cache and then copying each
+ * page out of it.  If any of those pages cannot be had (they are being
+ * read by another thread, or are uptodate already) or are in high
+ * memory, the datablock is read through the cache as in file_cache.c.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/pagemap.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int pages, res = -ENOMEM;
+	struct page **page;
+
+	page = kcalloc(mask + 1, sizeof(*page), GFP_KERNEL);
+	if (page == NULL)
+		return res;
+
+	/* Try to grab all the pages covered by the Squashfs block */
+	page[target_page->index - start_index] = target_page;
+	pages = squashfs_grab_pages(inode, page, start_index);
+
+	res = squashfs_readpages_block(inode, target_page, page, pages, block,
+		bsize);
+
+	kfree(page);
+	return res;
+}
+
+
+/*
+ * Decompress datablock directly into page[], as filled in by
+ * squashfs_grab_pages().  The pages are marked uptodate, unlocked and,
+ * except for target_page, released.
+ */
+int squashfs_readpages_block(struct inode *inode, struct page *target_page,
+	struct page **page, int pages, u64 block, int bsize)
+{
+	int i, missing_pages, res = -ENOMEM;
+	void **pageaddr;
+
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (pageaddr == NULL)
+		goto mark_errored;
+
+	for (missing_pages = 0, i = 0; i < pages; i++) {
+		/* the decompressors want all the pages mapped at once */
+		if (page[i] == NULL || PageHighMem(page[i]))
+			missing_pages++;
+		else
+			pageaddr[i] = page_address(page[i]);
+	}
+
+	if (missing_pages) {
+		/*
+		 * Couldn't get one or more pages, this page has either
+		 * been VM reclaimed, but others are still in the page cache
+		 * and uptodate, or we're racing with another thread in
+		 * squashfs_readpage also trying to grab them.  Fall back to
+		 * using an intermediate buffer.
+		 */
+		kfree(pageaddr);
+		return squashfs_read_cache_pages(inode, target_page, page,
+			pages, block, bsize);
+	}
+
+	/* Decompress directly into the page cache buffers */
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (res < 0)
+		goto mark_errored;
+
+	/* Zero whatever the block did not fill of the last pages */
+	for (i = res >> PAGE_CACHE_SHIFT; i < pages; i++) {
+		int bytes = max_t(int, res - (i << PAGE_CACHE_SHIFT), 0);
+
+		memset(pageaddr[i] + bytes, 0, PAGE_CACHE_SIZE - bytes);
+	}
+
+	/* Mark pages as uptodate, unlock and release */
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+
+	kfree(pageaddr);
+	return 0;
+
+mark_errored:
+	/*
+	 * Decompression failed, mark pages as errored.  Target_page is
+	 * dealt with by the caller
+	 */
+	squashfs_error_pages(target_page, page, pages);
+	kfree(pageaddr);
+	return res;
+}
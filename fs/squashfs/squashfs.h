@@ -36,12 +36,23 @@ static inline struct squashfs_inode_info *squashfs_i(struct inode *inode)
 extern int squashfs_read_data(struct super_block *, void **, u64, int, u64 *,
 				int, int);
 
+/* decompressor.c */
+extern const struct squashfs_decompressor *squashfs_lookup_decompressor(int);
+
+/* decompressor_xxx.c */
+extern void *squashfs_decompressor_create(struct squashfs_sb_info *);
+extern void squashfs_decompressor_destroy(struct squashfs_sb_info *);
+extern int squashfs_decompress(struct squashfs_sb_info *, void **,
+				struct buffer_head **, int, int, int, int, int);
+extern int squashfs_max_decompressors(void);
+
 /* cache.c */
 extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
 extern void squashfs_cache_delete(struct squashfs_cache *);
 extern struct squashfs_cache_entry *squashfs_cache_get(struct super_block *,
 				struct squashfs_cache *, u64, int);
 extern void squashfs_cache_put(struct squashfs_cache_entry *);
+extern void squashfs_cache_stats(struct seq_file *, struct squashfs_cache *);
 extern int squashfs_copy_data(void *, struct squashfs_cache_entry *, int, int);
 extern int squashfs_read_metadata(struct super_block *, void *, u64 *,
 				int *, int);
@@ -60,6 +71,19 @@ extern int squashfs_frag_lookup(struct super_block *, unsigned int, u64 *);
 extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 				u64, unsigned int);
 
+/* file.c */
+extern void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *,
+				int, int);
+extern int squashfs_grab_pages(struct inode *, struct page **, int);
+extern void squashfs_error_pages(struct page *, struct page **, int);
+extern int squashfs_read_cache_pages(struct inode *, struct page *,
+				struct page **, int, u64, int);
+
+/* file_xxx.c */
+extern int squashfs_readpage_block(struct page *, u64, int);
+extern int squashfs_readpages_block(struct inode *, struct page *,
+				struct page **, int, u64, int);
+
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
 extern __le64 *squashfs_read_id_index_table(struct super_block *, u64,
@@ -81,6 +105,7 @@ extern const struct file_operations squashfs_dir_ops;
 extern const struct export_operations squashfs_export_ops;
 
 /* file.c */
+extern const struct file_operations squashfs_file_ops;
 extern const struct address_space_operations squashfs_aops;
 
 /* namei.c */
@@ -88,3 +113,9 @@ extern const struct inode_operations squashfs_dir_inode_ops;
 
 /* symlink.c */
 extern const struct address_space_operations squashfs_symlink_aops;
+
+/* zlib_wrapper.c */
+extern const struct squashfs_decompressor squashfs_zlib_comp_ops;
+
+/* lzo_wrapper.c */
+extern const struct squashfs_decompressor squashfs_lzo_comp_ops;
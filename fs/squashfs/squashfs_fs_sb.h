@@ -28,7 +28,6 @@
 struct squashfs_cache {
 	char			*name;
 	int			entries;
-	int			next_blk;
 	int			num_waiters;
 	int			unused;
 	int			block_size;
@@ -36,6 +35,12 @@ struct squashfs_cache {
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
+	struct hlist_head	*hash;
+	int			hash_bits;
+	struct list_head	lru;
+	unsigned long		hits;
+	unsigned long		misses;
+	unsigned long		waits;
 };
 
 struct squashfs_cache_entry {
@@ -48,6 +53,8 @@ struct squashfs_cache_entry {
 	int			num_waiters;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache	*cache;
+	struct hlist_node	hash;
+	struct list_head	lru;
 	void			**data;
 };
 
@@ -61,10 +68,10 @@ struct squashfs_sb_info {
 	__le64			*id_table;
 	__le64			*fragment_index;
 	unsigned int		*fragment_index_2;
-	struct mutex		read_data_mutex;
 	struct mutex		meta_index_mutex;
 	struct meta_index	*meta_index;
-	z_stream		stream;
+	const struct squashfs_decompressor *decompressor;
+	void			*stream;
 	__le64			*inode_lookup_table;
 	u64			inode_table;
 	u64			directory_table;
@@ -72,5 +79,6 @@ struct squashfs_sb_info {
 	unsigned short		block_log;
 	long long		bytes_used;
 	unsigned int		inodes;
+	unsigned int		ra_pages;
 };
 #endif
@@ -35,34 +35,151 @@
 #include <linux/pagemap.h>
 #include <linux/init.h>
 #include <linux/module.h>
-#include <linux/zlib.h>
 #include <linux/magic.h>
+#include <linux/mount.h>
+#include <linux/parser.h>
+#include <linux/seq_file.h>
+#include <linux/blkdev.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "decompressor.h"
 
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
-static int supported_squashfs_filesystem(short major, short minor, short comp)
+enum { Opt_fragment_cache, Opt_data_cache, Opt_readahead, Opt_err };
+
+static const match_table_t tokens = {
+	{Opt_fragment_cache, "fragment_cache=%u"},
+	{Opt_data_cache, "data_cache=%u"},
+	{Opt_readahead, "readahead=%u"},
+	{Opt_err, NULL}
+};
+
+/*
+ * Upper bounds of the mount options.  A cache entry holds a whole block,
+ * up to 1 MiB, allocated at mount.
+ */
+#define SQUASHFS_MAX_CACHE_ENTRIES	32
+#define SQUASHFS_MAX_READAHEAD		4096	/* KiB */
+
+struct squashfs_mount_opts {
+	int fragment_cache;	/* fragment cache entries */
+	int data_cache;		/* "data" cache entries */
+	int readahead;		/* KiB, or -1 for the device's */
+};
+
+
+static int squashfs_clamp_option(const char *option, int n, int max)
 {
+	if (n <= max)
+		return n;
+	WARNING("Mount option \"%s\" limited to %d\n", option, max);
+	return max;
+}
+
+
+static int squashfs_parse_options(char *options,
+	struct squashfs_mount_opts *opts)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+	int n;
+
+	opts->fragment_cache = SQUASHFS_CACHED_FRAGMENTS;
+	opts->data_cache = squashfs_max_decompressors();
+	opts->readahead = -1;
+
+	if (options == NULL)
+		return 0;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		if (*p == '\0')
+			continue;
+
+		switch (match_token(p, tokens, args)) {
+		case Opt_fragment_cache:
+			if (match_int(&args[0], &n) || n < 1)
+				goto bad_value;
+			opts->fragment_cache = squashfs_clamp_option(p, n,
+				SQUASHFS_MAX_CACHE_ENTRIES);
+			break;
+		case Opt_data_cache:
+			if (match_int(&args[0], &n) || n < 1)
+				goto bad_value;
+			opts->data_cache = squashfs_clamp_option(p, n,
+				SQUASHFS_MAX_CACHE_ENTRIES);
+			break;
+		case Opt_readahead:
+			if (match_int(&args[0], &n) || n < 0)
+				goto bad_value;
+			opts->readahead = squashfs_clamp_option(p, n,
+				SQUASHFS_MAX_READAHEAD);
+			break;
+		default:
+			WARNING("Ignoring unrecognized mount option \"%s\"\n",
+				p);
+			break;
+		}
+	}
+
+	return 0;
+
+bad_value:
+	ERROR("Bad value in mount option \"%s\"\n", p);
+	return -EINVAL;
+}
+
+
+/*
+ * Readahead is done a datablock at a time, so round the window up to
+ * whole datablocks.  Unless set by the readahead mount option the window
+ * is that of the device, but at least one datablock.  Zero turns
+ * readahead off.
+ */
+static unsigned int squashfs_ra_pages(struct super_block *sb,
+	struct squashfs_mount_opts *opts)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	unsigned int block_pages = msblk->block_size >> PAGE_CACHE_SHIFT;
+	unsigned int ra_pages;
+
+	if (opts->readahead < 0)
+		ra_pages = max(blk_get_backing_dev_info(sb->s_bdev)->ra_pages,
+			1UL);
+	else
+		ra_pages = DIV_ROUND_UP(opts->readahead, PAGE_CACHE_SIZE >> 10);
+
+	return roundup(ra_pages, block_pages);
+}
+
+static const struct squashfs_decompressor *supported_squashfs_filesystem(short
+	major, short minor, short id)
+{
+	const struct squashfs_decompressor *decompressor;
+
 	if (major < SQUASHFS_MAJOR) {
 		ERROR("Major/Minor mismatch, older Squashfs %d.%d "
 			"filesystems are unsupported\n", major, minor);
-		return -EINVAL;
+		return NULL;
 	} else if (major > SQUASHFS_MAJOR || minor > SQUASHFS_MINOR) {
 		ERROR("Major/Minor mismatch, trying to mount newer "
 			"%d.%d filesystem\n", major, minor);
 		ERROR("Please update your kernel\n");
-		return -EINVAL;
+		return NULL;
 	}
 
-	if (comp != ZLIB_COMPRESSION)
-		return -EINVAL;
+	decompressor = squashfs_lookup_decompressor(id);
+	if (!decompressor->supported) {
+		ERROR("Filesystem uses \"%s\" compression. This is not "
+			"supported\n", decompressor->name);
+		return NULL;
+	}
 
-	return 0;
+	return decompressor;
 }
 
 
@@ -70,6 +187,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct squashfs_sb_info *msblk;
 	struct squashfs_super_block *sblk = NULL;
+	struct squashfs_mount_opts opts;
 	char b[BDEVNAME_SIZE];
 	struct inode *root;
 	long long root_inode;
@@ -80,6 +198,10 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	TRACE("Entered squashfs_fill_superblock\n");
 
+	err = squashfs_parse_options(data, &opts);
+	if (err)
+		return err;
+
 	sb->s_fs_info = kzalloc(sizeof(*msblk), GFP_KERNEL);
 	if (sb->s_fs_info == NULL) {
 		ERROR("Failed to allocate squashfs_sb_info\n");
@@ -87,13 +209,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	}
 	msblk = sb->s_fs_info;
 
-	msblk->stream.workspace = kmalloc(zlib_inflate_workspacesize(),
-		GFP_KERNEL);
-	if (msblk->stream.workspace == NULL) {
-		ERROR("Failed to allocate zlib workspace\n");
-		goto failure;
-	}
-
 	sblk = kzalloc(sizeof(*sblk), GFP_KERNEL);
 	if (sblk == NULL) {
 		ERROR("Failed to allocate squashfs_super_block\n");
@@ -103,7 +218,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, BLOCK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
 	/*
@@ -130,15 +244,16 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto failed_mount;
 	}
 
-	/* Check the MAJOR & MINOR versions and compression type */
-	err = supported_squashfs_filesystem(le16_to_cpu(sblk->s_major),
+	err = -EINVAL;
+
+	/* Check the MAJOR & MINOR versions and lookup compression type */
+	msblk->decompressor = supported_squashfs_filesystem(
+			le16_to_cpu(sblk->s_major),
 			le16_to_cpu(sblk->s_minor),
 			le16_to_cpu(sblk->compression));
-	if (err < 0)
+	if (msblk->decompressor == NULL)
 		goto failed_mount;
 
-	err = -EINVAL;
-
 	/*
 	 * Check if there's xattrs in the filesystem.  These are not
 	 * supported in this version, so warn that they will be ignored.
@@ -180,9 +295,11 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->inode_table = le64_to_cpu(sblk->inode_table_start);
 	msblk->directory_table = le64_to_cpu(sblk->directory_table_start);
 	msblk->inodes = le32_to_cpu(sblk->inodes);
+	msblk->ra_pages = squashfs_ra_pages(sb, &opts);
 	flags = le16_to_cpu(sblk->flags);
 
 	TRACE("Found valid superblock on %s\n", bdevname(sb->s_bdev, b));
+	TRACE("Compression is %s\n", msblk->decompressor->name);
 	TRACE("Inodes are %scompressed\n", SQUASHFS_UNCOMPRESSED_INODES(flags)
 				? "un" : "");
 	TRACE("Data is %scompressed\n", SQUASHFS_UNCOMPRESSED_DATA(flags)
@@ -190,6 +307,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	TRACE("Filesystem size %lld bytes\n", msblk->bytes_used);
 	TRACE("Block size %d\n", msblk->block_size);
 	TRACE("Number of inodes %d\n", msblk->inodes);
+	TRACE("Readahead %u pages\n", msblk->ra_pages);
 	TRACE("Number of fragments %d\n", le32_to_cpu(sblk->fragments));
 	TRACE("Number of ids %d\n", le16_to_cpu(sblk->no_ids));
 	TRACE("sblk->inode_table_start %llx\n", msblk->inode_table);
@@ -210,13 +328,24 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	/*
+	 * Allocate read_page blocks, by default one for each reader that can
+	 * decompress at the same time.
+	 */
+	msblk->read_page = squashfs_cache_init("data", opts.data_cache,
+		msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
 	}
 
+	msblk->stream = squashfs_decompressor_create(msblk);
+	if (IS_ERR(msblk->stream)) {
+		err = PTR_ERR(msblk->stream);
+		msblk->stream = NULL;
+		goto failed_mount;
+	}
+
 	/* Allocate and read id index table */
 	msblk->id_table = squashfs_read_id_index_table(sb,
 		le64_to_cpu(sblk->id_table_start), le16_to_cpu(sblk->no_ids));
@@ -231,7 +360,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto allocate_lookup_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		opts.fragment_cache, msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -292,17 +421,16 @@ failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
+	squashfs_decompressor_destroy(msblk);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
-	kfree(msblk->stream.workspace);
 	kfree(sb->s_fs_info);
 	sb->s_fs_info = NULL;
 	kfree(sblk);
 	return err;
 
 failure:
-	kfree(msblk->stream.workspace);
 	kfree(sb->s_fs_info);
 	sb->s_fs_info = NULL;
 	return -ENOMEM;
@@ -337,6 +465,32 @@ static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 }
 
 
+static int squashfs_show_options(struct seq_file *m, struct vfsmount *mnt)
+{
+	struct squashfs_sb_info *msblk = mnt->mnt_sb->s_fs_info;
+
+	if (msblk->fragment_cache)
+		seq_printf(m, ",fragment_cache=%d",
+			msblk->fragment_cache->entries);
+	seq_printf(m, ",data_cache=%d", msblk->read_page->entries);
+	seq_printf(m, ",readahead=%lu",
+		(unsigned long) msblk->ra_pages << (PAGE_CACHE_SHIFT - 10));
+	return 0;
+}
+
+
+/* Cache sizes and hit rates, for /proc/self/mountstats */
+static int squashfs_show_stats(struct seq_file *m, struct vfsmount *mnt)
+{
+	struct squashfs_sb_info *msblk = mnt->mnt_sb->s_fs_info;
+
+	squashfs_cache_stats(m, msblk->block_cache);
+	squashfs_cache_stats(m, msblk->fragment_cache);
+	squashfs_cache_stats(m, msblk->read_page);
+	return 0;
+}
+
+
 static void squashfs_put_super(struct super_block *sb)
 {
 	lock_kernel();
@@ -346,10 +500,10 @@ static void squashfs_put_super(struct super_block *sb)
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
+		squashfs_decompressor_destroy(sbi);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
-		kfree(sbi->stream.workspace);
 		kfree(sb->s_fs_info);
 		sb->s_fs_info = NULL;
 	}
@@ -449,7 +603,9 @@ static const struct super_operations squashfs_super_ops = {
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
 	.put_super = squashfs_put_super,
-	.remount_fs = squashfs_remount
+	.remount_fs = squashfs_remount,
+	.show_options = squashfs_show_options,
+	.show_stats = squashfs_show_stats
 };
 
 module_init(init_squashfs_fs);
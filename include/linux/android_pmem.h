@@ -34,6 +34,19 @@
  */
 #define PMEM_GET_TOTAL_SIZE	_IOW(PMEM_IOCTL_MAGIC, 7, unsigned int)
 #define PMEM_CACHE_FLUSH	_IOW(PMEM_IOCTL_MAGIC, 8, unsigned int)
+/* The following take a pmem_region relative to the start of the allocation,
+ * a len of 0 means the whole allocation.
+ * PMEM_CACHE_DIRTY records that the cpu wrote the range through a mapping
+ * pmem can't track (writes through the mmap of the allocating file are
+ * tracked automatically). PMEM_CLEAN_CACHES writes back only the dirty
+ * pages of the range before a device reads it, PMEM_INV_CACHES discards
+ * the range from the caches before the cpu reads what a device wrote.
+ * Once files are connected to an allocation with PMEM_CONNECT, the
+ * dirty pages can't be told apart and the whole range is cleaned.
+ */
+#define PMEM_CACHE_DIRTY	_IOW(PMEM_IOCTL_MAGIC, 9, unsigned int)
+#define PMEM_CLEAN_CACHES	_IOW(PMEM_IOCTL_MAGIC, 10, unsigned int)
+#define PMEM_INV_CACHES		_IOW(PMEM_IOCTL_MAGIC, 11, unsigned int)
 
 struct android_pmem_platform_data
 {
@@ -65,6 +78,8 @@ int get_pmem_user_addr(struct file *file, unsigned long *start,
 		       unsigned long *end);
 void put_pmem_file(struct file* file);
 void flush_pmem_file(struct file *file, unsigned long start, unsigned long len);
+int clean_pmem_file(struct file *file, unsigned long offset, unsigned long len);
+int inv_pmem_file(struct file *file, unsigned long offset, unsigned long len);
 int pmem_setup(struct android_pmem_platform_data *pdata,
 	       long (*ioctl)(struct file *, unsigned int, unsigned long),
 	       int (*release)(struct inode *, struct file *));
@@ -81,6 +96,10 @@ static inline int get_pmem_user_addr(struct file *file, unsigned long *start,
 static inline void put_pmem_file(struct file* file) { return; }
 static inline void flush_pmem_file(struct file *file, unsigned long start,
 				   unsigned long len) { return; }
+static inline int clean_pmem_file(struct file *file, unsigned long offset,
+				  unsigned long len) { return -ENOSYS; }
+static inline int inv_pmem_file(struct file *file, unsigned long offset,
+				unsigned long len) { return -ENOSYS; }
 static inline int pmem_setup(struct android_pmem_platform_data *pdata,
 	      long (*ioctl)(struct file *, unsigned int, unsigned long),
 	      int (*release)(struct inode *, struct file *)) { return -ENOSYS; }
@@ -13,6 +13,13 @@ extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
 
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)data, length)
 
+/*
+ * The Castagnoli CRC32c, with the same conventions as crc32_le(): most
+ * users want libcrc32c's crc32c(), which goes through the crypto API
+ * and so can use a hardware implementation.
+ */
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
 /*
  * Helpers for hash table generation of ethernet nics:
  *
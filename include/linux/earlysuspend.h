@@ -18,6 +18,7 @@
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/list.h>
+#include <linux/types.h>
 #endif
 
 /* The early_suspend structure defines suspend and resume hooks to be called
@@ -29,6 +30,9 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * A handler with async set does not depend on any other handler of its level
+ * and is run from the async code (kernel/async.c) concurrently with them. All
+ * handlers of a level have returned before the next level is started.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -39,8 +43,14 @@ struct early_suspend {
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	struct list_head link;
 	int level;
+	bool async;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	/* durations of the last and the longest call, in microseconds */
+	u32 suspend_us;
+	u32 max_suspend_us;
+	u32 resume_us;
+	u32 max_resume_us;
 #endif
 };
 
@@ -596,6 +596,33 @@ struct cpcap_adc_request {
 
 	/* Used in case of sync requests */
 	struct completion completion;
+
+	/* Requests sharing the same conversion, private to cpcap-adc */
+	struct cpcap_adc_request *next;
+};
+
+/*
+ * A client sampled every period_ms by the ADC driver's scheduler. A
+ * conversion of the same kind up to max_age_ms old is good enough.
+ * A deferrable client, such as battery housekeeping, may be sampled late
+ * rather than wake an idle system. The results are in req.result, the
+ * status in req.status.
+ */
+struct cpcap_adc_periodic {
+	enum cpcap_adc_format format;
+	enum cpcap_adc_timing timing;
+	enum cpcap_adc_type type;
+	unsigned int period_ms;
+	unsigned int max_age_ms;
+	int deferrable;
+	void (*callback)(struct cpcap_device *, struct cpcap_adc_periodic *);
+
+	/* Private to cpcap-adc */
+	struct cpcap_adc_request req;
+	struct list_head list;
+	unsigned long next;
+	int active;
+	int busy;
 };
 #endif
 
@@ -688,8 +715,23 @@ struct cpcap_regacc {
 	_IOW(0, CPCAP_IOCTL_NUM_UC_SET_TURBO_MODE, unsigned short)
 
 #ifdef __KERNEL__
+struct cpcap_regacc_data;
+
+/* Counters kept by the register access layer, see cpcap-regacc.c */
+struct cpcap_regacc_stats {
+	unsigned long reads;		/* registers read */
+	unsigned long read_hits;	/* of those, served from the cache */
+	unsigned long writes;		/* registers written to the chip */
+	unsigned long rbw_hits;		/* read-before-writes from the cache */
+	unsigned long async_writes;	/* cpcap_regacc_write_async() calls */
+	unsigned long async_merged;	/* of those, merged with a queued one */
+	unsigned long messages;		/* SPI messages */
+	unsigned long frames;		/* register frames in them */
+};
+
 struct cpcap_device {
 	struct spi_device	*spi;
+	struct cpcap_regacc_data *regacc;
 	enum cpcap_vendor       vendor;
 	enum cpcap_revision     revision;
 	void			*keydata;
@@ -717,8 +759,33 @@ int cpcap_regacc_write(struct cpcap_device *cpcap, enum cpcap_reg reg,
 int cpcap_regacc_read(struct cpcap_device *cpcap, enum cpcap_reg reg,
 		      unsigned short *value_ptr);
 
+int cpcap_regacc_read_multi(struct cpcap_device *cpcap,
+			    const enum cpcap_reg *regs,
+			    unsigned short *values, int n);
+
+int cpcap_regacc_write_multi(struct cpcap_device *cpcap,
+			     const struct cpcap_regacc *ops, int n);
+
+int cpcap_regacc_write_async(struct cpcap_device *cpcap, enum cpcap_reg reg,
+			     unsigned short value, unsigned short mask);
+
+int cpcap_regacc_flush(struct cpcap_device *cpcap);
+
+void cpcap_regacc_get_stats(struct cpcap_device *cpcap,
+			    struct cpcap_regacc_stats *stats);
+
+#ifdef CONFIG_MFD_CPCAP_SIM
+int cpcap_regacc_sim_peek(struct cpcap_device *cpcap, enum cpcap_reg reg,
+			  unsigned short *value_ptr);
+
+int cpcap_regacc_sim_poke(struct cpcap_device *cpcap, enum cpcap_reg reg,
+			  unsigned short value);
+#endif
+
 int cpcap_regacc_init(struct cpcap_device *cpcap);
 
+void cpcap_regacc_exit(struct cpcap_device *cpcap);
+
 void cpcap_broadcast_key_event(struct cpcap_device *cpcap,
 			       unsigned int code, int value);
 
@@ -751,6 +818,20 @@ int cpcap_adc_sync_read(struct cpcap_device *cpcap,
 int cpcap_adc_async_read(struct cpcap_device *cpcap,
 			 struct cpcap_adc_request *request);
 
+int cpcap_adc_sync_read_cached(struct cpcap_device *cpcap,
+			       struct cpcap_adc_request *request,
+			       unsigned int max_age_ms);
+
+int cpcap_adc_async_read_cached(struct cpcap_device *cpcap,
+				struct cpcap_adc_request *request,
+				unsigned int max_age_ms);
+
+int cpcap_adc_periodic_start(struct cpcap_device *cpcap,
+			     struct cpcap_adc_periodic *periodic);
+
+void cpcap_adc_periodic_stop(struct cpcap_device *cpcap,
+			     struct cpcap_adc_periodic *periodic);
+
 void cpcap_adc_phase(struct cpcap_device *cpcap, struct cpcap_adc_phase *phase);
 
 void cpcap_batt_set_ac_prop(struct cpcap_device *cpcap, int online);
@@ -174,6 +174,7 @@ struct tcp_md5sig {
 
 #include <linux/skbuff.h>
 #include <linux/dmaengine.h>
+#include <linux/hrtimer.h>
 #include <net/sock.h>
 #include <net/inet_connection_sock.h>
 #include <net/inet_timewait_sock.h>
@@ -399,6 +400,12 @@ struct tcp_sock {
 		u32		  probe_seq_end;
 	} mtu_probe;
 
+/* TCP Small Queues and pacing, see tcp_write_xmit() */
+	unsigned long	tsq_flags;
+	struct list_head tsq_node;	/* anchor in tsq_tasklet.head list */
+	struct hrtimer	pacing_timer;
+	ktime_t		pacing_next;	/* earliest time of the next packet */
+
 #ifdef CONFIG_TCP_MD5SIG
 /* TCP AF-Specific parts; only used by MD5 Signature support so far */
 	const struct tcp_sock_af_ops	*af_specific;
@@ -408,6 +415,12 @@ struct tcp_sock {
 #endif
 };
 
+enum tsq_flags {
+	TSQ_THROTTLED,	/* waits for its packets below TCP to be freed */
+	TSQ_QUEUED,	/* on a tsq_tasklet list */
+	TSQ_DEFERRED,	/* tcp_tasklet_func() found the socket owned */
+};
+
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
 {
 	return (struct tcp_sock *)sk;
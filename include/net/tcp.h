@@ -237,6 +237,8 @@ extern int sysctl_tcp_base_mss;
 extern int sysctl_tcp_workaround_signed_windows;
 extern int sysctl_tcp_slow_start_after_idle;
 extern int sysctl_tcp_max_ssthresh;
+extern int sysctl_tcp_limit_output_bytes;
+extern int sysctl_tcp_pacing;
 
 extern atomic_t tcp_memory_allocated;
 extern struct percpu_counter tcp_sockets_allocated;
@@ -484,6 +486,10 @@ extern int  tcp_send_synack(struct sock *);
 extern void tcp_push_one(struct sock *, unsigned int mss_now);
 extern void tcp_send_ack(struct sock *sk);
 extern void tcp_send_delayed_ack(struct sock *sk);
+extern void tcp_wfree(struct sk_buff *skb);
+extern void tcp_release_cb(struct sock *sk);
+extern enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer);
+extern void tcp_tasklet_init(void);
 
 /* tcp_input.c */
 extern void tcp_cwnd_application_limited(struct sock *sk);
@@ -492,6 +498,12 @@ extern void tcp_cwnd_application_limited(struct sock *sk);
 extern void tcp_init_xmit_timers(struct sock *);
 static inline void tcp_clear_xmit_timers(struct sock *sk)
 {
+	/* The pacing timer holds a reference, see tcp_pacing_wait().
+	 * Waiting for a running tcp_pace_kick() makes sure that it never
+	 * drops the last one.
+	 */
+	if (hrtimer_cancel(&tcp_sk(sk)->pacing_timer))
+		atomic_dec(&sk->sk_wmem_alloc);
 	inet_csk_clear_xmit_timers(sk);
 }
 
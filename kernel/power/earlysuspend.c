@@ -13,10 +13,14 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -43,6 +47,9 @@ enum {
 	SUSPEND_REQUESTED_AND_SUSPENDED = SUSPEND_REQUESTED | SUSPENDED,
 };
 static int state;
+static LIST_HEAD(early_suspend_domain);
+static u32 early_suspend_us;
+static u32 late_resume_us;
 
 void register_early_suspend(struct early_suspend *handler)
 {
@@ -70,11 +77,47 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void early_suspend_call(struct early_suspend *h)
+{
+	ktime_t start = ktime_get();
+	u32 us;
+
+	h->suspend(h);
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	h->suspend_us = us;
+	if (us > h->max_suspend_us)
+		h->max_suspend_us = us;
+}
+
+static void early_suspend_async(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data);
+}
+
+static void late_resume_call(struct early_suspend *h)
+{
+	ktime_t start = ktime_get();
+	u32 us;
+
+	h->resume(h);
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	h->resume_us = us;
+	if (us > h->max_resume_us)
+		h->max_resume_us = us;
+}
+
+static void late_resume_async(void *data, async_cookie_t cookie)
+{
+	late_resume_call(data);
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -93,14 +136,27 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL)
-			pos->suspend(pos);
+		/* a level starts once the one before it has finished */
+		if (pos->level != level) {
+			async_synchronize_full_domain(&early_suspend_domain);
+			level = pos->level;
+		}
+		if (pos->suspend == NULL)
+			continue;
+		if (pos->async)
+			async_schedule_domain(early_suspend_async, pos,
+					      &early_suspend_domain);
+		else
+			early_suspend_call(pos);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	early_suspend_us = ktime_to_us(ktime_sub(ktime_get(), start));
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("early_suspend: sync\n");
+		pr_info("early_suspend: done in %u us\n", early_suspend_us);
 
 abort:
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -114,6 +170,8 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -130,11 +188,24 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-		if (pos->resume != NULL)
-			pos->resume(pos);
+	start = ktime_get();
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
+		if (pos->level != level) {
+			async_synchronize_full_domain(&early_suspend_domain);
+			level = pos->level;
+		}
+		if (pos->resume == NULL)
+			continue;
+		if (pos->async)
+			async_schedule_domain(late_resume_async, pos,
+					      &early_suspend_domain);
+		else
+			late_resume_call(pos);
+	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	late_resume_us = ktime_to_us(ktime_sub(ktime_get(), start));
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %u us\n", late_resume_us);
 abort:
 	mutex_unlock(&early_suspend_lock);
 }
@@ -175,3 +246,43 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_timing_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(m, "early_suspend %u us, late_resume %u us\n",
+		   early_suspend_us, late_resume_us);
+	seq_puts(m, "level\tasync\tsuspend\tmax\tresume\tmax\thandler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(m, "%d\t%d\t%u\t%u\t%u\t%u\t%pf/%pf\n",
+			   pos->level, pos->async,
+			   pos->suspend_us, pos->max_suspend_us,
+			   pos->resume_us, pos->max_resume_us,
+			   pos->suspend, pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_timing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_timing_show, NULL);
+}
+
+static const struct file_operations early_suspend_timing_fops = {
+	.open = early_suspend_timing_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	debugfs_create_file("early_suspend_timing", S_IRUGO, NULL, NULL,
+			    &early_suspend_timing_fops);
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
+#endif
@@ -38,12 +38,25 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_INITIALIZED            (1U << 8)
 #define WAKE_LOCK_ACTIVE                 (1U << 9)
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
-#define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * Active wake locks without a timeout are only counted, in held_locks, so
+ * wake_lock() and wake_unlock() of such a lock take nothing but the lock's
+ * own state_lock. Locks with a timeout are kept in a tree per type ordered
+ * by expiry, with the first and last entries cached, under timed_lock.
+ * list_lock only protects the list of all wake locks, for /proc/wakelocks
+ * and debug output.
+ *
+ * Lock order: timed_lock, list_lock, then a wake lock's state_lock.
+ */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
-static int current_event_num;
+static LIST_HEAD(all_wake_locks);
+static DEFINE_SPINLOCK(timed_lock);
+static struct rb_root timed_locks[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *first_timed[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *last_timed[WAKE_LOCK_TYPE_COUNT];
+static atomic_t held_locks[WAKE_LOCK_TYPE_COUNT];
+static atomic_t current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
 suspend_state_t requested_suspend_state = PM_SUSPEND_MEM;
@@ -51,9 +64,54 @@ static struct wake_lock unknown_wakeup;
 
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * Total time main_wake_lock has been released. A suspend wake lock adds
+ * the growth of this clock while it is held to its sleep_time, so no
+ * list of active locks has to be walked when main_wake_lock changes.
+ */
+static DEFINE_SEQLOCK(sleep_wait_lock);
+static ktime_t sleep_wait_total;
+static ktime_t sleep_wait_since;
+static int sleep_waiting;
+
+static ktime_t sleep_wait_time(ktime_t now)
+{
+	unsigned long seq;
+	ktime_t total;
+
+	do {
+		seq = read_seqbegin(&sleep_wait_lock);
+		total = sleep_wait_total;
+		if (sleep_waiting && now.tv64 > sleep_wait_since.tv64)
+			total = ktime_add(total,
+					  ktime_sub(now, sleep_wait_since));
+	} while (read_seqretry(&sleep_wait_lock, seq));
+	return total;
+}
+
+static void update_sleep_wait(int waiting)
+{
+	unsigned long irqflags;
+	ktime_t now = ktime_get();
+
+	write_seqlock_irqsave(&sleep_wait_lock, irqflags);
+	if (sleep_waiting)
+		sleep_wait_total = ktime_add(sleep_wait_total,
+					     ktime_sub(now, sleep_wait_since));
+	sleep_waiting = waiting;
+	sleep_wait_since = now;
+	write_sequnlock_irqrestore(&sleep_wait_lock, irqflags);
+}
+
+static ktime_t prevent_suspend_add(struct wake_lock *lock, ktime_t now)
+{
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) != WAKE_LOCK_SUSPEND)
+		return ktime_set(0, 0);
+	return ktime_sub(sleep_wait_time(now), lock->stat.last_sleep_wait);
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -81,6 +139,7 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 }
 
 
+/* Caller must hold lock->state_lock */
 static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 {
 	int lock_count = lock->stat.count;
@@ -102,9 +161,8 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		else
 			expire_count++;
 		total_time = ktime_add(total_time, add_time);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
-			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+		prevent_suspend_time = ktime_add(prevent_suspend_time,
+				prevent_suspend_add(lock, now));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
@@ -123,22 +181,28 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	unsigned long irqflags;
 	struct wake_lock *lock;
 	int ret;
-	int type;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 
 	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
 			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
-	list_for_each_entry(lock, &inactive_locks, link)
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		spin_lock(&lock->state_lock);
 		ret = print_lock_stat(m, lock);
-	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
+		spin_unlock(&lock->state_lock);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
 }
 
+/* Caller must hold lock->state_lock */
+static void wake_lock_stat_start(struct wake_lock *lock)
+{
+	lock->stat.last_time = ktime_get();
+	lock->stat.last_sleep_wait = sleep_wait_time(lock->stat.last_time);
+}
+
+/* Caller must hold lock->state_lock */
 static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 {
 	ktime_t duration;
@@ -157,62 +221,79 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
 	lock->stat.last_time = ktime_get();
-	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
-		lock->stat.prevent_suspend_time = ktime_add(
-			lock->stat.prevent_suspend_time, duration);
-		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-	}
+	lock->stat.prevent_suspend_time = ktime_add(
+		lock->stat.prevent_suspend_time,
+		prevent_suspend_add(lock, now));
 }
+#endif
 
-static void update_sleep_wait_stats_locked(int done)
+static inline struct wake_lock *timed_entry(struct rb_node *node)
 {
-	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
-
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
+	return node ? rb_entry(node, struct wake_lock, node) : NULL;
+}
+
+/* Caller must hold timed_lock */
+static void timed_insert_locked(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &timed_locks[type].rb_node;
+	struct rb_node *parent = NULL;
+	int first = 1;
+	int last = 1;
+
+	while (*p) {
+		parent = *p;
+		if (time_before(lock->expires, timed_entry(parent)->expires)) {
+			p = &parent->rb_left;
+			last = 0;
+		} else {
+			p = &parent->rb_right;
+			first = 0;
 		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
 	}
-	last_sleep_time_update = now;
+	if (first)
+		first_timed[type] = lock;
+	if (last)
+		last_timed[type] = lock;
+	rb_link_node(&lock->node, parent, p);
+	rb_insert_color(&lock->node, &timed_locks[type]);
 }
-#endif
 
+/* Caller must hold timed_lock */
+static void timed_erase_locked(struct wake_lock *lock, int type)
+{
+	if (first_timed[type] == lock)
+		first_timed[type] = timed_entry(rb_next(&lock->node));
+	if (last_timed[type] == lock)
+		last_timed[type] = timed_entry(rb_prev(&lock->node));
+	rb_erase(&lock->node, &timed_locks[type]);
+}
 
-static void expire_wake_lock(struct wake_lock *lock)
+/* Caller must hold timed_lock */
+static void expire_wake_lock(struct wake_lock *lock, int type)
 {
+	spin_lock(&lock->state_lock);
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	timed_erase_locked(lock, type);
+	spin_unlock(&lock->state_lock);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
 
-/* Caller must acquire the list_lock spinlock */
 static void print_active_locks(int type)
 {
 	struct wake_lock *lock;
 	bool print_expired = true;
+	unsigned long irqflags;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) != type ||
+		    !(lock->flags & WAKE_LOCK_ACTIVE))
+			continue;
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
 			if (timeout > 0)
@@ -226,36 +307,39 @@ static void print_active_locks(int type)
 				print_expired = false;
 		}
 	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
+/* Caller must hold timed_lock */
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
-	}
-	return max_timeout;
+	if (atomic_read(&held_locks[type]))
+		return -1;
+	while ((lock = first_timed[type]) &&
+	       (long)(lock->expires - jiffies) <= 0)
+		expire_wake_lock(lock, type);
+	lock = last_timed[type];
+	return lock ? lock->expires - jiffies : 0;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
-	ret = has_wake_lock_locked(type);
+
+	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	if (atomic_read(&held_locks[type])) {
+		ret = -1;
+	} else {
+		spin_lock_irqsave(&timed_lock, irqflags);
+		ret = has_wake_lock_locked(type);
+		spin_unlock_irqrestore(&timed_lock, irqflags);
+	}
 	if (ret && (debug_mask & DEBUG_SUSPEND) && type == WAKE_LOCK_SUSPEND)
 		print_active_locks(type);
-	spin_unlock_irqrestore(&list_lock, irqflags);
 	return ret;
 }
 
@@ -270,7 +354,7 @@ static void suspend(struct work_struct *work)
 		return;
 	}
 
-	entry_event_num = current_event_num;
+	entry_event_num = atomic_read(&current_event_num);
 	sys_sync();
 	if (debug_mask & DEBUG_EXIT_SUSPEND)
 		pr_info("suspend: enter suspend\n");
@@ -285,7 +369,7 @@ static void suspend(struct work_struct *work)
 			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
 			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec);
 	}
-	if (current_event_num == entry_event_num) {
+	if (atomic_read(&current_event_num) == entry_event_num) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: pm_suspend returned with no event\n");
 		wake_lock_timeout(&unknown_wakeup, HZ / 2);
@@ -299,18 +383,37 @@ static void expire_wake_locks(unsigned long data)
 	unsigned long irqflags;
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: start\n");
-	spin_lock_irqsave(&list_lock, irqflags);
 	if (debug_mask & DEBUG_SUSPEND)
 		print_active_locks(WAKE_LOCK_SUSPEND);
+	spin_lock_irqsave(&timed_lock, irqflags);
 	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&timed_lock, irqflags);
 }
 static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
+/* Caller must hold timed_lock */
+static void update_expire_timer_locked(const char *func, struct wake_lock *lock)
+{
+	long has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
+	if (has_lock > 0) {
+		if (debug_mask & DEBUG_EXPIRE)
+			pr_info("%s: %s, start expire timer, %ld\n",
+				func, lock->name, has_lock);
+		mod_timer(&expire_timer, jiffies + has_lock);
+	} else {
+		if (del_timer(&expire_timer))
+			if (debug_mask & DEBUG_EXPIRE)
+				pr_info("%s: %s, stop expire timer\n",
+					func, lock->name);
+		if (has_lock == 0)
+			queue_work(suspend_work_queue, &suspend_work);
+	}
+}
+
 static int power_suspend_late(struct device *dev)
 {
 	int ret = has_wake_lock(WAKE_LOCK_SUSPEND) ? -EAGAIN : 0;
@@ -352,23 +455,40 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+	lock->stat.last_sleep_wait = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
+	spin_lock_init(&lock->state_lock);
 
 	INIT_LIST_HEAD(&lock->link);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &all_wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
 
 void wake_lock_destroy(struct wake_lock *lock)
 {
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	unsigned long irqflags;
+	int was_active;
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
-	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	spin_lock_irqsave(&timed_lock, irqflags);
+	spin_lock(&lock->state_lock);
+	was_active = lock->flags & WAKE_LOCK_ACTIVE;
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		timed_erase_locked(lock, type);
+	else if (was_active)
+		atomic_dec(&held_locks[type]);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
+	spin_unlock(&lock->state_lock);
+	if (was_active && type == WAKE_LOCK_SUSPEND)
+		update_expire_timer_locked("wake_lock_destroy", lock);
+	spin_unlock(&timed_lock);
+
+	spin_lock(&list_lock);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
@@ -389,37 +509,61 @@ void wake_lock_destroy(struct wake_lock *lock)
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
+/*
+ * Taking or dropping a lock without a timeout only needs its state_lock.
+ * A lock that has, or is given, a timeout has to move in the timed tree,
+ * so timed_lock is taken first.
+ */
+static int wake_lock_state_lock(struct wake_lock *lock, int timed)
+{
+	if (timed)
+		spin_lock(&timed_lock);
+	spin_lock(&lock->state_lock);
+	if (!timed && (lock->flags & WAKE_LOCK_AUTO_EXPIRE)) {
+		spin_unlock(&lock->state_lock);
+		spin_lock(&timed_lock);
+		spin_lock(&lock->state_lock);
+		timed = 1;
+	}
+	return timed;
+}
+
 static void wake_lock_internal(
 	struct wake_lock *lock, long timeout, int has_timeout)
 {
 	int type;
 	unsigned long irqflags;
-	long expire_in;
+	int timed;
+	int held;
 
-	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
+	local_irq_save(irqflags);
+	timed = wake_lock_state_lock(lock, has_timeout);
 #ifdef CONFIG_WAKELOCK_STAT
-	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
+	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup &&
+	    xchg(&wait_for_wakeup, 0)) {
 		if (debug_mask & DEBUG_WAKEUP)
 			pr_info("wakeup wake lock: %s\n", lock->name);
-		wait_for_wakeup = 0;
 		lock->stat.wakeup_count++;
 	}
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
 	    (long)(lock->expires - jiffies) <= 0) {
 		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
+		wake_lock_stat_start(lock);
 	}
 #endif
+	held = (lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) ==
+		WAKE_LOCK_ACTIVE;
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		timed_erase_locked(lock, type);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
+		wake_lock_stat_start(lock);
 #endif
 	}
-	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
@@ -427,44 +571,38 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		timed_insert_locked(lock, type);
+		if (held)
+			atomic_dec(&held_locks[type]);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
+		if (!held)
+			atomic_inc(&held_locks[type]);
 	}
 #ifdef CONFIG_PM_DEEPSLEEP
        lock->pid = current->tgid;
 #endif
+	spin_unlock(&lock->state_lock);
 	if (type == WAKE_LOCK_SUSPEND) {
-		current_event_num++;
+		atomic_inc(&current_event_num);
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
-		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait(0);
 #endif
-		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
-		else
-			expire_in = -1;
-		if (expire_in > 0) {
+		if (has_timeout) {
+			update_expire_timer_locked("wake_lock", lock);
+		} else if (del_timer(&expire_timer)) {
 			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_lock: %s, start expire timer, "
-					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_lock: %s, stop expire timer\n",
-						lock->name);
-			if (expire_in == 0)
-				queue_work(suspend_work_queue, &suspend_work);
+				pr_info("wake_lock: %s, stop expire timer\n",
+					lock->name);
 		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	if (timed)
+		spin_unlock(&timed_lock);
+	local_irq_restore(irqflags);
 }
 
 void wake_lock(struct wake_lock *lock)
@@ -483,40 +621,42 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	int timed;
+	int last = 0;
+
+	local_irq_save(irqflags);
+	timed = wake_lock_state_lock(lock, 0);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 0);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		timed_erase_locked(lock, type);
+	else if (lock->flags & WAKE_LOCK_ACTIVE)
+		last = atomic_dec_and_test(&held_locks[type]);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	spin_unlock(&lock->state_lock);
 	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
+		/* other locks without a timeout still block suspend */
+		if (timed || last) {
+			if (!timed)
+				spin_lock(&timed_lock);
+			timed = 1;
+			update_expire_timer_locked("wake_unlock", lock);
 		}
 		if (lock == &main_wake_lock) {
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks(WAKE_LOCK_SUSPEND);
 #ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait(1);
 #endif
 		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	if (timed)
+		spin_unlock(&timed_lock);
+	local_irq_restore(irqflags);
 }
 EXPORT_SYMBOL(wake_unlock);
 
@@ -543,8 +683,9 @@ ssize_t active_wake_lock_show(
 	char *end = buf + PAGE_SIZE;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND
+				&& !(lock->flags & WAKE_LOCK_AUTO_EXPIRE)
 				&& (lock->flags & WAKE_LOCK_ACTIVE)) {
 			s += scnprintf(s, end - s, "%s %d\n",
 					lock->name, lock->pid);
@@ -577,10 +718,6 @@ static const struct file_operations wakelock_stats_fops = {
 static int __init wakelocks_init(void)
 {
 	int ret;
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -0,0 +1,157 @@
+/* kernel/power/wakelock_bench.c
+ *
+ * Copyright (C) 2010 Motorola, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Loading the module starts one thread on every online cpu. Each thread
+ * takes and releases a wake lock in a loop for duration_ms, the way a
+ * network driver does per packet, and the pairs per second are printed:
+ *
+ *   insmod wakelock_bench.ko duration_ms=2000 shared=1 timeout=0
+ *   rmmod wakelock_bench
+ *
+ * With shared=0 every thread has its own lock, with shared=1 all of them
+ * use one. A non-zero timeout uses wake_lock_timeout() with that many
+ * jiffies instead of wake_lock(). Run it with the screen on, so the
+ * main wake lock is held and the system does not try to suspend each
+ * time the benchmark drops the last lock.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/wakelock.h>
+
+static unsigned int duration_ms = 1000;
+module_param(duration_ms, uint, S_IRUGO);
+MODULE_PARM_DESC(duration_ms, "How long each thread runs");
+
+static int shared;
+module_param(shared, bool, S_IRUGO);
+MODULE_PARM_DESC(shared, "All threads use the same wake lock");
+
+static unsigned int timeout;
+module_param(timeout, uint, S_IRUGO);
+MODULE_PARM_DESC(timeout, "Use wake_lock_timeout() with this many jiffies");
+
+#define BENCH_BATCH	256
+
+struct bench_thread {
+	struct wake_lock lock;
+	char name[24];
+	unsigned long pairs;
+	int started;
+	struct completion done;
+};
+
+static struct wake_lock shared_lock;
+static DECLARE_COMPLETION(bench_start);
+static unsigned long bench_end;
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	struct wake_lock *lock = shared ? &shared_lock : &t->lock;
+	unsigned long pairs = 0;
+	int i;
+
+	wait_for_completion(&bench_start);
+
+	while (time_before(jiffies, bench_end)) {
+		for (i = 0; i < BENCH_BATCH; i++) {
+			if (timeout)
+				wake_lock_timeout(lock, timeout);
+			else
+				wake_lock(lock);
+			wake_unlock(lock);
+		}
+		pairs += BENCH_BATCH;
+		cond_resched();
+	}
+
+	t->pairs = pairs;
+	complete_and_exit(&t->done, 0);
+}
+
+static int __init wakelock_bench_init(void)
+{
+	struct bench_thread *threads;
+	struct task_struct *task;
+	u64 total = 0;
+	int cpu;
+
+	if (!duration_ms)
+		return -EINVAL;
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	wake_lock_init(&shared_lock, WAKE_LOCK_SUSPEND, "wakelock_bench");
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[cpu];
+
+		snprintf(t->name, sizeof(t->name), "wakelock_bench%d", cpu);
+		wake_lock_init(&t->lock, WAKE_LOCK_SUSPEND, t->name);
+		init_completion(&t->done);
+
+		task = kthread_create(bench_thread_fn, t, "wakelock_bench/%d",
+				      cpu);
+		if (IS_ERR(task)) {
+			wake_lock_destroy(&t->lock);
+			continue;
+		}
+		kthread_bind(task, cpu);
+		wake_up_process(task);
+		t->started = 1;
+	}
+
+	bench_end = jiffies + msecs_to_jiffies(duration_ms);
+	complete_all(&bench_start);
+
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[cpu];
+
+		if (!t->started)
+			continue;
+		wait_for_completion(&t->done);
+		wake_lock_destroy(&t->lock);
+		pr_info("wakelock_bench: cpu %d: %lu pairs\n", cpu, t->pairs);
+		total += t->pairs;
+	}
+	put_online_cpus();
+
+	pr_info("wakelock_bench: %s lock%s, %u ms: %llu pairs/s\n",
+		shared ? "shared" : "per-cpu", timeout ? " with timeout" : "",
+		duration_ms, div_u64(total * 1000, duration_ms));
+
+	wake_lock_destroy(&shared_lock);
+	kfree(threads);
+
+	return 0;
+}
+
+static void __exit wakelock_bench_exit(void)
+{
+}
+
+module_init(wakelock_bench_init);
+module_exit(wakelock_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Wake lock lock/unlock microbenchmark");
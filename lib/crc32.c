@@ -29,12 +29,16 @@
 #include <linux/init.h>
 #include <asm/atomic.h>
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
-#define tole(x) __constant_cpu_to_le32(x)
-#define tobe(x) __constant_cpu_to_be32(x)
+#if CRC_LE_BITS > 8
+# define tole(x) ((__force u32) __constant_cpu_to_le32(x))
 #else
-#define tole(x) (x)
-#define tobe(x) (x)
+# define tole(x) (x)
+#endif
+
+#if CRC_BE_BITS > 8
+# define tobe(x) ((__force u32) __constant_cpu_to_be32(x))
+#else
+# define tobe(x) (x)
 #endif
 #include "crc32table.h"
 
@@ -42,101 +46,230 @@ MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Ethernet CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-/**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
- * @p: pointer to buffer over which CRC is run
- * @len: length of buffer @p
- */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
+#if CRC_LE_BITS > 8 || CRC_BE_BITS > 8
 
-#if CRC_LE_BITS == 1
 /*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
+ * Slicing-by-4 or slicing-by-8: the CRC of a word of data is the XOR of
+ * the CRCs of its bytes each followed by the right number of zero bytes,
+ * which the extra rows of the tables hold.  The crc is kept in the byte
+ * order of the data, so that the word loaded and the crc are XORed
+ * directly, and the tables were swapped to match when generated.
  */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
-{
-	int i;
-	while (len--) {
-		crc ^= *p++;
-		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
-	}
-	return crc;
-}
-#else				/* Table-based approach */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static inline u32
+crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 {
-# if CRC_LE_BITS == 8
-	const u32      *b =(u32 *)p;
-	const u32      *tab = crc32table_le;
-
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[ (crc ^ (x)) & 255 ] ^ (crc>>8)
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		   t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+#  define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		   t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[ ((crc >> 24) ^ (x)) & 255] ^ (crc<<8)
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		   t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+#  define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		   t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
 # endif
+	const u32 *b;
+	size_t rem_len;
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+# if CRC_LE_BITS == 64 || CRC_BE_BITS == 64
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+# endif
+	u32 q;
 
-	crc = __cpu_to_le32(crc);
 	/* Align it */
-	if(unlikely(((long)b)&3 && len)){
+	if (unlikely((long)buf & 3 && len)) {
 		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (void *)p;
-		} while ((--len) && ((long)b)&3 );
+			DO_CRC(*buf++);
+		} while ((--len) && ((long)buf) & 3);
 	}
-	if(likely(len >= 4)){
-		/* load data 32 bits wide, xor data 32 bits wide. */
-		size_t save_len = len & 3;
-	        len = len >> 2;
-		--b; /* use pre increment below(*++b) for speed */
-		do {
-			crc ^= *++b;
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-		} while (--len);
-		b++; /* point to next byte(s) */
-		len = save_len;
+
+# if CRC_LE_BITS == 32
+	rem_len = len & 3;
+	len = len >> 2;
+# else
+	rem_len = len & 7;
+	len = len >> 3;
+# endif
+
+	b = (const u32 *)buf;
+	for (--b; len; --len) {
+		q = crc ^ *++b; /* use pre increment for speed */
+# if CRC_LE_BITS == 32
+		crc = DO_CRC4;
+# else
+		crc = DO_CRC8;
+		q = *++b;
+		crc ^= DO_CRC4;
+# endif
 	}
+	len = rem_len;
 	/* And the last few bytes */
-	if(len){
+	if (len) {
+		u8 *p = (u8 *)(b + 1) - 1;
 		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (void *)p;
+			DO_CRC(*++p); /* use pre increment for speed */
 		} while (--len);
 	}
-
-	return __le32_to_cpu(crc);
-#undef ENDIAN_SHIFT
+	return crc;
 #undef DO_CRC
+#undef DO_CRC4
+#undef DO_CRC8
+}
+#endif
 
-# elif CRC_LE_BITS == 4
+/**
+ * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
+{
+#if CRC_LE_BITS == 1
+	int i;
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
 	}
-	return crc;
 # elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+	}
+# elif CRC_LE_BITS == 4
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+	}
+# elif CRC_LE_BITS == 8
+	/* aka Sarwate algorithm */
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 8) ^ tab[0][crc & 255];
 	}
+# else
+	crc = (__force u32) __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, tab);
+	crc = __le32_to_cpu((__force __le32)crc);
+#endif
 	return crc;
-# endif
 }
+
+#ifdef CONFIG_CRC32_NEON
+#if CRC_LE_BITS == 1
+# error "CONFIG_CRC32_NEON needs the CRC32 tables"
 #endif
+/*
+ * Long buffers are folded 16 bytes at a time by the NEON polynomial
+ * multiplies of arch/arm/lib/crc32-neon.S, which leave a remainder of
+ * 16 bytes to the tables.  Whether that beats slicing-by-8 depends on
+ * the core, so by default the shortest buffer worth folding is measured
+ * once the VFP support code has found NEON, and NEON is left unused if
+ * it never wins.  crc32.neon_min=0 on the command line, or in
+ * /sys/module/crc32/parameters, keeps to the tables.
+ */
+#include <linux/hardirq.h>
+#include <asm/neon.h>
+
+asmlinkage void crc32_neon_fold(u8 *rem, const u8 *p, unsigned int blocks,
+				const u64 *k);
+
+/* x^160 and x^96 modulo the polynomials, bit-reflected */
+static const u64 crc32_fold_k[2] = { 0x1751997d0ULL, 0x0ccaa009eULL };
+static const u64 crc32c_fold_k[2] = { 0x0f20c0dfeULL, 0x14cd00bd6ULL };
+
+static int neon_min = -1;
+module_param(neon_min, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(neon_min, "Shortest buffer folded with NEON, "
+		 "0 for none, -1 to measure at boot");
+
+/* a fold takes two blocks; the calls are split to bound the latency */
+#define NEON_FOLD_MIN	32
+#define NEON_CHUNK	4096
+
+static inline int crc32_neon_usable(size_t len)
+{
+	return neon_min > 0 && len >= neon_min && len >= NEON_FOLD_MIN &&
+		cpu_has_neon() && !in_interrupt() && !irqs_disabled();
+}
+
+static u32 __pure crc32_neon(u32 crc, unsigned char const *p, size_t len,
+			     const u32 (*tab)[256], u32 polynomial,
+			     const u64 *k)
+{
+	u32 rem[4];
+	size_t n;
+
+	while (len >= NEON_FOLD_MIN) {
+		n = min_t(size_t, len, NEON_CHUNK) & ~15;
+
+		/* CRC32_NEON is little endian only */
+		rem[0] = crc;
+		rem[1] = rem[2] = rem[3] = 0;
+
+		kernel_neon_begin();
+		crc32_neon_fold((u8 *)rem, p, n / 16 - 1, k);
+		kernel_neon_end();
+
+		crc = crc32_le_generic(0, (u8 *)rem, sizeof(rem), tab,
+				       polynomial);
+		p += n;
+		len -= n;
+	}
+	return crc32_le_generic(crc, p, len, tab, polynomial);
+}
+#else
+static inline int crc32_neon_usable(size_t len)
+{
+	return 0;
+}
+
+#define crc32_neon(crc, p, len, tab, polynomial, k)	(crc)
+#endif
+
+#if CRC_LE_BITS == 1
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
+}
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
+}
+#else
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (crc32_neon_usable(len))
+		return crc32_neon(crc, p, len,
+				  (const u32 (*)[256])crc32table_le,
+				  CRCPOLY_LE, crc32_fold_k);
+	return crc32_le_generic(crc, p, len,
+				(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
+}
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (crc32_neon_usable(len))
+		return crc32_neon(crc, p, len,
+				  (const u32 (*)[256])crc32ctable_le,
+				  CRC32C_POLY_LE, crc32c_fold_k);
+	return crc32_le_generic(crc, p, len,
+				(const u32 (*)[256])crc32ctable_le,
+				CRC32C_POLY_LE);
+}
+#endif
+EXPORT_SYMBOL(crc32_le);
+EXPORT_SYMBOL(__crc32c_le);
 
 /**
  * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
@@ -145,97 +278,58 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
  * @p: pointer to buffer over which CRC is run
  * @len: length of buffer @p
  */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_BE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+static inline u32 __pure crc32_be_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
 {
+#if CRC_BE_BITS == 1
 	int i;
 	while (len--) {
 		crc ^= *p++ << 24;
 		for (i = 0; i < 8; i++)
 			crc =
-			    (crc << 1) ^ ((crc & 0x80000000) ? CRCPOLY_BE :
+			    (crc << 1) ^ ((crc & 0x80000000) ? polynomial :
 					  0);
 	}
-	return crc;
-}
-
-#else				/* Table-based approach */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_BE_BITS == 8
-	const u32      *b =(u32 *)p;
-	const u32      *tab = crc32table_be;
-
-# ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[ (crc ^ (x)) & 255 ] ^ (crc>>8)
-# else
-#  define DO_CRC(x) crc = tab[ ((crc >> 24) ^ (x)) & 255] ^ (crc<<8)
-# endif
-
-	crc = __cpu_to_be32(crc);
-	/* Align it */
-	if(unlikely(((long)b)&3 && len)){
-		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (u32 *)p;
-		} while ((--len) && ((long)b)&3 );
-	}
-	if(likely(len >= 4)){
-		/* load data 32 bits wide, xor data 32 bits wide. */
-		size_t save_len = len & 3;
-	        len = len >> 2;
-		--b; /* use pre increment below(*++b) for speed */
-		do {
-			crc ^= *++b;
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-		} while (--len);
-		b++; /* point to next byte(s) */
-		len = save_len;
-	}
-	/* And the last few bytes */
-	if(len){
-		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (void *)p;
-		} while (--len);
+# elif CRC_BE_BITS == 2
+	while (len--) {
+		crc ^= *p++ << 24;
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+		crc = (crc << 2) ^ tab[0][crc >> 30];
 	}
-	return __be32_to_cpu(crc);
-#undef ENDIAN_SHIFT
-#undef DO_CRC
-
 # elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 4) ^ tab[0][crc >> 28];
+		crc = (crc << 4) ^ tab[0][crc >> 28];
 	}
-	return crc;
-# elif CRC_BE_BITS == 2
+# elif CRC_BE_BITS == 8
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 8) ^ tab[0][crc >> 24];
 	}
-	return crc;
+# else
+	crc = (__force u32) __cpu_to_be32(crc);
+	crc = crc32_body(crc, p, len, tab);
+	crc = __be32_to_cpu((__force __be32)crc);
 # endif
+	return crc;
 }
-#endif
 
-EXPORT_SYMBOL(crc32_le);
+#if CRC_BE_BITS == 1
+u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_be_generic(crc, p, len, NULL, CRCPOLY_BE);
+}
+#else
+u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_be_generic(crc, p, len,
+				(const u32 (*)[256])crc32table_be, CRCPOLY_BE);
+}
+#endif
 EXPORT_SYMBOL(crc32_be);
 
 /*
@@ -365,6 +459,314 @@ EXPORT_SYMBOL(crc32_be);
  * the same way on decoding, it doesn't make a difference.
  */
 
+#if defined(CONFIG_CRC32_NEON) || defined(CONFIG_CRC32_SELFTEST)
+#include <linux/hrtimer.h>
+
+typedef u32 (*crc32_fn)(u32 crc, unsigned char const *p, size_t len);
+
+/* the CRCs timed are stored here, so that they are computed */
+static volatile u32 crc32_sink;
+
+/* MB/s of fn over buffers of len bytes, for about total bytes */
+static unsigned int __init crc32_rate(crc32_fn fn, const u8 *buf,
+				      size_t len, size_t total)
+{
+	unsigned long loops = total / len ?: 1, i;
+	ktime_t start;
+	u32 crc = 0;
+	s64 us;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		crc = fn(crc, buf, len);
+	us = ktime_us_delta(ktime_get(), start);
+	crc32_sink = crc;
+
+	/* bytes per microsecond are MB/s */
+	return div_u64((u64)loops * len, max_t(s64, us, 1));
+}
+
+static void __init crc32_fill(u8 *p, size_t n)
+{
+	u32 x = 0x12345678;
+
+	while (n--) {
+		x = x * 1103515245 + 12345;
+		*p++ = x >> 16;
+	}
+}
+
+#if CRC_LE_BITS == 1
+/* the bitwise code has no tables, and takes none */
+# define crc32table_le	NULL
+# define crc32ctable_le	NULL
+#endif
+
+static u32 __init crc32_le_table(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+				(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
+}
+#endif
+
+#ifdef CONFIG_CRC32_NEON
+static u32 __init crc32_le_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon(crc, p, len, (const u32 (*)[256])crc32table_le,
+			  CRCPOLY_LE, crc32_fold_k);
+}
+
+#define CALIBRATE_MAX	4096
+
+/*
+ * Set neon_min to the shortest of these lengths from which on NEON
+ * folding is faster than the tables, or to 0 if it is nowhere.
+ */
+static const unsigned int neon_try[] __initconst = { 64, 256, 1024, 4096 };
+
+static void __init crc32_neon_calibrate(void)
+{
+	u8 *buf;
+	int i, min = 0;
+
+	if (neon_min >= 0)
+		return;
+	if (!cpu_has_neon()) {
+		neon_min = 0;
+		return;
+	}
+
+	buf = kmalloc(CALIBRATE_MAX, GFP_KERNEL);
+	if (!buf) {
+		neon_min = 0;
+		return;
+	}
+	crc32_fill(buf, CALIBRATE_MAX);
+
+	for (i = ARRAY_SIZE(neon_try) - 1; i >= 0; i--) {
+		size_t len = neon_try[i];
+
+		if (crc32_rate(crc32_le_neon, buf, len, 1 << 18) <=
+		    crc32_rate(crc32_le_table, buf, len, 1 << 18))
+			break;
+		min = len;
+	}
+	kfree(buf);
+
+	neon_min = min;
+	if (min)
+		printk(KERN_INFO "crc32: NEON folding from %d bytes\n", min);
+	else
+		printk(KERN_INFO "crc32: NEON folding slower than the "
+		       "tables, not used\n");
+}
+#endif
+
+#ifdef CONFIG_CRC32_SELFTEST
+static u32 __init crc32_le_bitwise(u32 crc, unsigned char const *p,
+				   size_t len, u32 polynomial)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+	}
+	return crc;
+}
+
+static u32 __init crc32_be_bitwise(u32 crc, unsigned char const *p,
+				   size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+static u32 __init crc32c_le_table(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+				(const u32 (*)[256])crc32ctable_le,
+				CRC32C_POLY_LE);
+}
+
+#ifdef CONFIG_CRC32_NEON
+static u32 __init crc32c_le_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon(crc, p, len, (const u32 (*)[256])crc32ctable_le,
+			  CRC32C_POLY_LE, crc32c_fold_k);
+}
+#endif
+
+#if CRC_LE_BITS > 8
+/* the first table on its own, a byte at a time */
+static u32 __init crc32_bytewise(u32 crc, unsigned char const *p, size_t len,
+				 const u32 (*tab)[256])
+{
+	crc = (__force u32) __cpu_to_le32(crc);
+	while (len--)
+# ifdef __LITTLE_ENDIAN
+		crc = tab[0][(crc ^ *p++) & 255] ^ (crc >> 8);
+# else
+		crc = tab[0][((crc >> 24) ^ *p++) & 255] ^ (crc << 8);
+# endif
+	return __le32_to_cpu((__force __le32)crc);
+}
+
+static u32 __init crc32_le_bytewise(u32 crc, unsigned char const *p,
+				    size_t len)
+{
+	return crc32_bytewise(crc, p, len, crc32table_le);
+}
+
+static u32 __init crc32c_le_bytewise(u32 crc, unsigned char const *p,
+				     size_t len)
+{
+	return crc32_bytewise(crc, p, len, crc32ctable_le);
+}
+#endif
+
+struct crc32_variant {
+	const char *name;
+	crc32_fn fn;
+	u32 polynomial;
+	int neon;
+};
+
+static const struct crc32_variant crc32_variants[] __initconst = {
+#if CRC_LE_BITS > 8
+	{ "crc32 bytewise",	crc32_le_bytewise,	CRCPOLY_LE },
+	{ "crc32c bytewise",	crc32c_le_bytewise,	CRC32C_POLY_LE },
+#endif
+	{ "crc32 tables",	crc32_le_table,		CRCPOLY_LE },
+	{ "crc32c tables",	crc32c_le_table,	CRC32C_POLY_LE },
+#ifdef CONFIG_CRC32_NEON
+	{ "crc32 neon",		crc32_le_neon,		CRCPOLY_LE, 1 },
+	{ "crc32c neon",	crc32c_le_neon,		CRC32C_POLY_LE, 1 },
+#endif
+};
+
+static inline int __init crc32_variant_usable(const struct crc32_variant *v)
+{
+#ifdef CONFIG_CRC32_NEON
+	return !v->neon || cpu_has_neon();
+#else
+	return 1;
+#endif
+}
+
+/* lengths checked: around the word, block and chunk sizes */
+static const unsigned int crc32_check_len[] __initconst = {
+	0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 48, 63,
+	64, 65, 100, 255, 256, 1000, 4095, 4096, 4097, 4096 + 48, 10000,
+};
+
+#define BENCH_MIN	64
+#define BENCH_MAX	65536
+#define BENCH_TOTAL	(1 << 20)
+
+/*
+ * Check crc32_le(), __crc32c_le() and crc32_be() against the usual check
+ * values, then each variant of the code against the bitwise CRC at all
+ * the lengths above and eight alignments, and time the variants on
+ * buffers of 64 bytes to 64KB.
+ */
+static int __init crc32_selftest(void)
+{
+	static const unsigned char check[] __initconst = "123456789";
+	const struct crc32_variant *v;
+	unsigned int size;
+	int i, j, off, errors = 0;
+	u8 *buf;
+
+	if ((crc32_le(~0, check, 9) ^ ~0) != 0xcbf43926 ||
+	    (__crc32c_le(~0, check, 9) ^ ~0) != 0xe3069283 ||
+	    (crc32_be(~0, check, 9) ^ ~0) != 0xfc891918) {
+		printk(KERN_ERR "crc32: wrong check values\n");
+		errors++;
+	}
+
+	buf = kmalloc(BENCH_MAX + 8, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	crc32_fill(buf, BENCH_MAX + 8);
+
+	for (i = 0; i < ARRAY_SIZE(crc32_check_len); i++) {
+		size_t len = crc32_check_len[i];
+
+		for (off = 0; off < 8; off++) {
+			u32 seed = off & 1 ? ~0 : off * 0x01010101;
+			const u8 *p = buf + off;
+			u32 expect;
+
+			for (j = 0; j < ARRAY_SIZE(crc32_variants); j++) {
+				v = &crc32_variants[j];
+				if (!crc32_variant_usable(v))
+					continue;
+				expect = crc32_le_bitwise(seed, p, len,
+							  v->polynomial);
+				if (v->fn(seed, p, len) != expect) {
+					printk(KERN_ERR "crc32: %s wrong at "
+					       "%zu+%d\n", v->name, len, off);
+					errors++;
+				}
+			}
+			if (crc32_be(seed, p, len) !=
+			    crc32_be_bitwise(seed, p, len)) {
+				printk(KERN_ERR "crc32: crc32_be wrong at "
+				       "%zu+%d\n", len, off);
+				errors++;
+			}
+		}
+	}
+
+	if (errors)
+		printk(KERN_ERR "crc32: self-test failed, %d errors\n",
+		       errors);
+	else
+		printk(KERN_INFO "crc32: self-test passed\n");
+
+	for (size = BENCH_MIN; size <= BENCH_MAX; size <<= 2)
+		for (j = 0; j < ARRAY_SIZE(crc32_variants); j++) {
+			v = &crc32_variants[j];
+			if (!crc32_variant_usable(v))
+				continue;
+			printk(KERN_INFO "crc32: %-16s %6u %6u MB/s\n",
+			       v->name, size,
+			       crc32_rate(v->fn, buf, size, BENCH_TOTAL));
+		}
+
+	kfree(buf);
+	return errors ? -EIO : 0;
+}
+#endif
+
+static int __init crc32_init(void)
+{
+#ifdef CONFIG_CRC32_NEON
+	crc32_neon_calibrate();
+#endif
+#ifdef CONFIG_CRC32_SELFTEST
+	crc32_selftest();
+#endif
+	return 0;
+}
+
+static void __exit crc32_exit(void)
+{
+}
+
+/* built in, this runs after vfp_init() has found NEON */
+late_initcall(crc32_init);
+module_exit(crc32_exit);
+
 #ifdef UNITTEST
 
 #include <stdlib.h>
@@ -10,25 +10,130 @@
 
 #ifndef ASMINF
 
-/* Allow machine dependent optimization for post-increment or pre-increment.
-   Based on testing to date,
-   Pre-increment preferred for:
-   - PowerPC G3 (Adler)
-   - MIPS R5000 (Randers-Pehrson)
-   Post-increment preferred for:
-   - none
-   No measurable difference:
-   - Pentium III (Anderson)
-   - M68060 (Nikl)
+#ifdef CONFIG_ZLIB_INFLATE_NEON
+#include <linux/hardirq.h>
+#include <linux/module.h>
+#include <asm/neon.h>
+
+/*
+ * Saving the VFP state of its last user costs about as much as producing
+ * a kilobyte of output, so small calls keep to the ARM copies.
  */
-#ifdef POSTINC
-#  define OFF 0
-#  define PUP(a) *(a)++
+static unsigned int neon_min = 2048;
+module_param(neon_min, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(neon_min, "Smallest output inflated with NEON copies, "
+		 "0 for none");
+#endif
+
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+#include <asm/unaligned.h>
+#  define WORD_CHUNK sizeof(unsigned long)
 #else
-#  define OFF 1
-#  define PUP(a) *++(a)
+#  define WORD_CHUNK 1
+#endif
+
+#ifndef __always_inline
+#  define __always_inline inline
 #endif
 
+/* bits in the bit buffer */
+#define HOLD_BITS (8 * sizeof(unsigned long))
+
+/*
+   Fill the bit buffer with whole bytes, to at least HOLD_BITS - 7 bits.
+   That is enough for a length code and its extra bits, or a distance
+   code, or with a 64-bit buffer for a whole length/distance pair, so
+   that most of the checks for enough bits go away.
+ */
+#define REFILL() \
+    do { \
+        while (bits <= HOLD_BITS - 8) { \
+            hold += (unsigned long)(*in++) << bits; \
+            bits += 8; \
+        } \
+    } while (0)
+
+/*
+   Match copies move chunk bytes at a time: 16 through the NEON registers,
+   a word where unaligned accesses are cheap, and otherwise one.
+ */
+static __always_inline void copy_chunk(unsigned char *out,
+                                       const unsigned char *from,
+                                       const unsigned chunk)
+{
+#ifdef CONFIG_ZLIB_INFLATE_NEON
+    if (chunk == 16) {
+        /* the kernel is built soft-float, so gcc leaves d0-d1 to us */
+        asm volatile(".fpu	neon\n\t"
+                     "vld1.8	{d0-d1}, [%1]\n\t"
+                     "vst1.8	{d0-d1}, [%0]"
+                     : : "r" (out), "r" (from) : "memory");
+        return;
+    }
+#endif
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+    if (chunk == sizeof(unsigned long)) {
+        put_unaligned(get_unaligned((const unsigned long *)from),
+                      (unsigned long *)out);
+        return;
+    }
+#endif
+    *out = *from;
+}
+
+/* copy len bytes from the window, reading none past from + len */
+static __always_inline unsigned char *copy_window(unsigned char *out,
+                                                  const unsigned char *from,
+                                                  unsigned len,
+                                                  const unsigned chunk)
+{
+    if (chunk > 1) {
+        for (; len >= chunk; len -= chunk) {
+            copy_chunk(out, from, chunk);
+            out += chunk;
+            from += chunk;
+        }
+    }
+    while (len > 2) {
+        *out++ = *from++;
+        *out++ = *from++;
+        *out++ = *from++;
+        len -= 3;
+    }
+    if (len) {
+        *out++ = *from++;
+        if (len > 1)
+            *out++ = *from++;
+    }
+    return out;
+}
+
+/*
+   Copy len bytes from dist bytes back in the output. When dist is at
+   least a chunk, each chunk read has been written already, and the last
+   one may store up to chunk - 1 bytes past the match, which
+   INFLATE_FAST_MIN_OUT leaves room for.
+ */
+static __always_inline unsigned char *copy_output(unsigned char *out,
+                                                  unsigned dist,
+                                                  unsigned len,
+                                                  const unsigned chunk)
+{
+    const unsigned char *from = out - dist;
+
+    if (chunk > 1 && dist >= chunk) {
+        unsigned char *end = out + len;
+
+        do {
+            copy_chunk(out, from, chunk);
+            out += chunk;
+            from += chunk;
+        } while (out < end);
+        return end;
+    }
+    return copy_window(out, from, len, 1);
+}
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -40,8 +145,8 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_IN
+        strm->avail_out >= INFLATE_FAST_MIN_OUT
         start >= strm->avail_out
         state->bits < 8
 
@@ -56,17 +161,20 @@
     - The maximum input bits used by a length/distance pair is 15 bits for the
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
-      Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      The bit buffer may also be filled up with as many bytes as it holds,
+      so if strm->avail_in >= 6 + sizeof(unsigned long), then there is
+      enough input to avoid checking for available input while decoding.
 
     - The maximum bytes that a single length/distance pair can output is 258
-      bytes, which is the maximum length that can be coded.  inflate_fast()
-      requires strm->avail_out >= 258 for each loop to avoid checking for
-      output space.
+      bytes, which is the maximum length that can be coded.  A chunked copy
+      may store up to a chunk less one byte more.  inflate_fast() requires
+      strm->avail_out >= 257 + INFLATE_FAST_CHUNK for each loop to avoid
+      checking for output space.
 
     - @start:	inflate()'s starting value for strm->avail_out
  */
-void inflate_fast(z_streamp strm, unsigned start)
+static __always_inline void inflate_fast_chunk(z_streamp strm, unsigned start,
+                                               const unsigned chunk)
 {
     struct inflate_state *state;
     const unsigned char *in;    /* local strm->next_in */
@@ -96,11 +204,11 @@ void inflate_fast(z_streamp strm, unsigned start)
 
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
-    in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    out = strm->next_out - OFF;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_IN - 1));
+    out = strm->next_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_OUT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -118,12 +226,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL();
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -131,26 +234,18 @@ void inflate_fast(z_streamp strm, unsigned start)
         bits -= op;
         op = (unsigned)(this.op);
         if (op == 0) {                          /* literal */
-            PUP(out) = (unsigned char)(this.val);
+            *out++ = (unsigned char)(this.val);
         }
         else if (op & 16) {                     /* length base */
             len = (unsigned)(this.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                }
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-            }
+            if (bits < 15)
+                REFILL();
             this = dcode[hold & dmask];
           dodist:
             op = (unsigned)(this.bits);
@@ -160,14 +255,8 @@ void inflate_fast(z_streamp strm, unsigned start)
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
-                        bits += 8;
-                    }
-                }
+                if (bits < op)
+                    REFILL();
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -186,14 +275,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                         state->mode = BAD;
                         break;
                     }
-                    from = window - OFF;
+                    from = window;
                     if (write == 0) {           /* very common case */
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = copy_window(out, from, op, chunk);
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -202,16 +289,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = window - OFF;
+                            out = copy_window(out, from, op, chunk);
+                            from = window;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
+                                out = copy_window(out, from, op, chunk);
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -220,37 +303,17 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            out = copy_window(out, from, op, chunk);
                             from = out - dist;  /* rest from output */
                         }
                     }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
+                    if (from == out - dist)
+                        out = copy_output(out, dist, len, chunk);
+                    else
+                        out = copy_window(out, from, len, chunk);
                 }
-                else {
-                    from = out - dist;          /* copy direct from output */
-                    do {                        /* minimum length is three */
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    } while (len > 2);
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
+                else {                          /* copy direct from output */
+                    out = copy_output(out, dist, len, chunk);
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -285,16 +348,33 @@ void inflate_fast(z_streamp strm, unsigned start)
     hold &= (1U << bits) - 1;
 
     /* update state and return */
-    strm->next_in = in + OFF;
-    strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
-    strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ? (INFLATE_FAST_MIN_IN - 1) +
+                                (last - in) :
+                                (INFLATE_FAST_MIN_IN - 1) - (in - last));
+    strm->avail_out = (unsigned)(out < end ? (INFLATE_FAST_MIN_OUT - 1) +
+                                 (end - out) :
+                                 (INFLATE_FAST_MIN_OUT - 1) - (out - end));
     state->hold = hold;
     state->bits = bits;
     return;
 }
 
+void inflate_fast(z_streamp strm, unsigned start)
+{
+#ifdef CONFIG_ZLIB_INFLATE_NEON
+    if (neon_min && strm->avail_out >= neon_min && cpu_has_neon() &&
+        !in_interrupt() && !irqs_disabled()) {
+        kernel_neon_begin();
+        inflate_fast_chunk(strm, start, 16);
+        kernel_neon_end();
+        return;
+    }
+#endif
+    inflate_fast_chunk(strm, start, WORD_CHUNK);
+}
+
 /*
    inflate_fast() speedups that turned out slower (on a PowerPC G3 750CXe):
    - Using bit fields for code structure
@@ -8,4 +8,20 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/*
+   Bytes a match copy may move at once: inflate_fast() can store up to
+   one less than that past the end of a match.
+ */
+#ifdef CONFIG_ZLIB_INFLATE_NEON
+#  define INFLATE_FAST_CHUNK 16
+#elif defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#  define INFLATE_FAST_CHUNK sizeof(unsigned long)
+#else
+#  define INFLATE_FAST_CHUNK 1
+#endif
+
+/* input and output inflate_fast() needs to decode without checking */
+#define INFLATE_FAST_MIN_IN (6 + sizeof(unsigned long))
+#define INFLATE_FAST_MIN_OUT (257 + INFLATE_FAST_CHUNK)
+
 void inflate_fast (z_streamp strm, unsigned start);
@@ -0,0 +1,260 @@
+/*
+ *  linux/lib/zlib_inflate/inflate_bench.c
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loading the module compresses a few kinds of data with zlib_deflate,
+ * checks that zlib_inflate gives them back, and times the inflating:
+ *
+ *   insmod inflate_bench.ko size=262144 megabytes=16 chunk=4096
+ *   rmmod inflate_bench
+ *
+ * The data is English-like text, the module's own code, mostly zero
+ * blocks, random bytes, and the start of the file given by file= if
+ * any. Each line gives the compressed size as a percentage and the
+ * output rate in MB/s. chunk sets how much output each zlib_inflate()
+ * call is given: a page, as for squashfs and cramfs, or 0 for all of it
+ * at once. With CONFIG_ZLIB_INFLATE_NEON,
+ * echo 0 > /sys/module/zlib_inflate/parameters/neon_min before loading
+ * the module times the ARM copies instead.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/err.h>
+#include <linux/hrtimer.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+
+static unsigned int size = 256 << 10;
+module_param(size, uint, S_IRUGO);
+MODULE_PARM_DESC(size, "Bytes of each kind of data");
+
+static unsigned int megabytes = 16;
+module_param(megabytes, uint, S_IRUGO);
+MODULE_PARM_DESC(megabytes, "Output inflated for each kind of data");
+
+static unsigned int chunk = PAGE_SIZE;
+module_param(chunk, uint, S_IRUGO);
+MODULE_PARM_DESC(chunk, "Output given to each zlib_inflate() call, "
+		 "0 for all");
+
+static char *file;
+module_param(file, charp, S_IRUGO);
+MODULE_PARM_DESC(file, "File whose start is also compressed and timed");
+
+static u32 seed;
+
+static u32 next_random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static const char * const words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"with", "was", "on", "be", "by", "this", "from", "at", "which",
+	"kernel", "memory", "page", "buffer", "device", "interrupt",
+	"driver", "return", "value", "function", "error", "data", "when",
+	"block", "file", "system", "cache", "time", "first", "would",
+};
+
+static void fill_text(u8 *p, unsigned int n)
+{
+	unsigned int len = 0, i;
+
+	seed = 1;
+	while (len < n) {
+		const char *w = words[next_random() % ARRAY_SIZE(words)];
+
+		for (i = 0; w[i] && len < n; i++)
+			p[len++] = w[i];
+		if (len < n)
+			p[len++] = next_random() % 13 ? ' ' : '\n';
+	}
+}
+
+static void fill_code(u8 *p, unsigned int n)
+{
+	const u8 *code = THIS_MODULE->module_core;
+	unsigned int len = THIS_MODULE->core_size, i;
+
+	for (i = 0; i < n; i += len)
+		memcpy(p + i, code, min(len, n - i));
+}
+
+static void fill_sparse(u8 *p, unsigned int n)
+{
+	unsigned int i;
+
+	seed = 2;
+	memset(p, 0, n);
+	for (i = 0; i + 512 <= n; i += 512)
+		if (next_random() % 4 == 0)
+			p[i + next_random() % 512] = next_random();
+}
+
+static void fill_random(u8 *p, unsigned int n)
+{
+	unsigned int i;
+
+	seed = 3;
+	for (i = 0; i < n; i++)
+		p[i] = next_random();
+}
+
+/* returns the bytes read, or a negative error */
+static int fill_file(u8 *p, unsigned int n)
+{
+	struct file *filp;
+	int ret;
+
+	filp = filp_open(file, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+	ret = kernel_read(filp, 0, (char *)p, n);
+	filp_close(filp, NULL);
+	return ret;
+}
+
+struct bench {
+	u8 *data;		/* uncompressed */
+	u8 *comp;		/* compressed */
+	u8 *out;		/* inflated */
+	unsigned int len;
+	unsigned int clen;
+	z_stream strm;
+};
+
+static int compress(struct bench *b)
+{
+	z_stream strm, *s = &strm;
+	int ret;
+
+	s->workspace = vmalloc(zlib_deflate_workspacesize());
+	if (!s->workspace)
+		return -ENOMEM;
+	ret = zlib_deflateInit(s, Z_DEFAULT_COMPRESSION);
+	if (ret == Z_OK) {
+		s->next_in = b->data;
+		s->avail_in = b->len;
+		s->next_out = b->comp;
+		s->avail_out = b->len + b->len / 8 + 64;
+		ret = zlib_deflate(s, Z_FINISH);
+		b->clen = s->total_out;
+		zlib_deflateEnd(s);
+	}
+	vfree(s->workspace);
+	return ret == Z_STREAM_END ? 0 : -EIO;
+}
+
+static int inflate_once(struct bench *b)
+{
+	z_stream *s = &b->strm;
+	unsigned int step = chunk ? chunk : b->len;
+	int ret;
+
+	if (zlib_inflateInit(s) != Z_OK)
+		return -EIO;
+	s->next_in = b->comp;
+	s->avail_in = b->clen;
+	s->next_out = b->out;
+	do {
+		s->avail_out = min(step, b->len - (unsigned int)s->total_out);
+		ret = zlib_inflate(s, Z_SYNC_FLUSH);
+	} while (ret == Z_OK && s->total_out < b->len);
+	if (ret == Z_OK)
+		ret = zlib_inflate(s, Z_FINISH);
+	zlib_inflateEnd(s);
+
+	return ret == Z_STREAM_END && s->total_out == b->len ? 0 : -EIO;
+}
+
+static void run(struct bench *b, const char *name)
+{
+	unsigned long loops, i;
+	ktime_t start;
+	s64 us;
+
+	if (compress(b)) {
+		printk(KERN_ERR "inflate_bench: %s: zlib_deflate failed\n",
+		       name);
+		return;
+	}
+
+	memset(b->out, 0, b->len);
+	if (inflate_once(b) || memcmp(b->out, b->data, b->len)) {
+		printk(KERN_ERR "inflate_bench: %s: inflated data differs\n",
+		       name);
+		return;
+	}
+
+	loops = div_u64((u64)megabytes << 20, b->len) ?: 1;
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		inflate_once(b);
+	us = ktime_us_delta(ktime_get(), start);
+
+	/* bytes per microsecond are MB/s */
+	printk(KERN_INFO "inflate_bench: %-8s %7u bytes %3u%% %5llu MB/s\n",
+	       name, b->len, (unsigned int)div_u64((u64)b->clen * 100, b->len),
+	       div_u64((u64)loops * b->len, max_t(s64, us, 1)));
+}
+
+static int __init inflate_bench_init(void)
+{
+	struct bench b;
+	int ret = -ENOMEM;
+
+	if (!size)
+		return -EINVAL;
+	b.len = size;
+	b.data = vmalloc(size);
+	b.comp = vmalloc(size + size / 8 + 64);
+	b.out = vmalloc(size);
+	b.strm.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!b.data || !b.comp || !b.out || !b.strm.workspace)
+		goto out;
+
+	fill_text(b.data, size);
+	run(&b, "text");
+	fill_code(b.data, size);
+	run(&b, "code");
+	fill_sparse(b.data, size);
+	run(&b, "sparse");
+	fill_random(b.data, size);
+	run(&b, "random");
+
+	if (file) {
+		ret = fill_file(b.data, size);
+		if (ret > 0) {
+			b.len = ret;
+			run(&b, "file");
+		} else {
+			printk(KERN_ERR "inflate_bench: cannot read %s: %d\n",
+			       file, ret);
+		}
+	}
+	ret = 0;
+out:
+	vfree(b.strm.workspace);
+	vfree(b.out);
+	vfree(b.comp);
+	vfree(b.data);
+	return ret;
+}
+
+static void __exit inflate_bench_exit(void)
+{
+}
+
+module_init(inflate_bench_init);
+module_exit(inflate_bench_exit);
+MODULE_DESCRIPTION("zlib_inflate benchmark");
+MODULE_LICENSE("GPL");
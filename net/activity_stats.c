@@ -15,6 +15,7 @@
  */
 
 #include <linux/proc_fs.h>
+#include <linux/seqlock.h>
 #include <linux/suspend.h>
 #include <net/net_namespace.h>
 
@@ -32,6 +33,21 @@ static unsigned long activity_stats[BUCKET_MAX];
 static ktime_t last_transmit;
 static ktime_t suspend_time;
 static DEFINE_SPINLOCK(activity_lock);
+/* lets the per-packet path read last_transmit without taking the lock */
+static seqcount_t last_transmit_seq = SEQCNT_ZERO;
+
+static s64 activity_delta(ktime_t now)
+{
+	unsigned seq;
+	ktime_t last;
+
+	do {
+		seq = read_seqcount_begin(&last_transmit_seq);
+		last = last_transmit;
+	} while (read_seqcount_retry(&last_transmit_seq, seq));
+
+	return ktime_to_ns(ktime_sub(now, last));
+}
 
 void activity_stats_update(void)
 {
@@ -40,8 +56,15 @@ void activity_stats_update(void)
 	ktime_t now;
 	s64 delta;
 
-	spin_lock_irqsave(&activity_lock, flags);
+	/*
+	 * Transmissions less than a second apart fall in no bucket, which is
+	 * the common case on a busy link; only take the lock otherwise.
+	 */
 	now = ktime_get();
+	if (activity_delta(now) < NSEC_PER_SEC)
+		return;
+
+	spin_lock_irqsave(&activity_lock, flags);
 	delta = ktime_to_ns(ktime_sub(now, last_transmit));
 
 	for (i = BUCKET_MAX - 1; i >= 0; i--) {
@@ -53,7 +76,9 @@ void activity_stats_update(void)
 			continue;
 
 		activity_stats[i]++;
+		write_seqcount_begin(&last_transmit_seq);
 		last_transmit = now;
+		write_seqcount_end(&last_transmit_seq);
 		break;
 	}
 	spin_unlock_irqrestore(&activity_lock, flags);
@@ -94,7 +119,11 @@ static int activity_stats_notifier(struct notifier_block *nb,
 
 		case PM_POST_SUSPEND:
 			suspend_time = ktime_sub(ktime_get_real(), suspend_time);
+			spin_lock_irq(&activity_lock);
+			write_seqcount_begin(&last_transmit_seq);
 			last_transmit = ktime_sub(last_transmit, suspend_time);
+			write_seqcount_end(&last_transmit_seq);
+			spin_unlock_irq(&activity_lock);
 	}
 
 	return 0;
@@ -2535,14 +2535,28 @@ EXPORT_SYMBOL(dev_gro_receive);
 static int __napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
 	struct sk_buff *p;
+	int ether = skb->dev->type == ARPHRD_ETHER;
+	unsigned int maclen = skb->dev->hard_header_len;
 
 	if (netpoll_rx_on(skb))
 		return GRO_NORMAL;
 
+	/*
+	 * Raw IP devices (rmnet) have no link header at all, so outside of
+	 * ethernet compare the hard_header_len bytes at the mac header, if
+	 * any, rather than an ethernet header.
+	 */
 	for (p = napi->gro_list; p; p = p->next) {
-		NAPI_GRO_CB(p)->same_flow = (p->dev == skb->dev)
-			&& !compare_ether_header(skb_mac_header(p),
-						 skb_gro_mac_header(skb));
+		int same_flow = p->dev == skb->dev;
+
+		if (same_flow && ether)
+			same_flow = !compare_ether_header(skb_mac_header(p),
+						skb_gro_mac_header(skb));
+		else if (same_flow && maclen)
+			same_flow = !memcmp(skb_mac_header(p),
+					skb_gro_mac_header(skb), maclen);
+
+		NAPI_GRO_CB(p)->same_flow = same_flow;
 		NAPI_GRO_CB(p)->flush = 0;
 	}
 
@@ -59,6 +59,15 @@ int sysctl_tcp_base_mss __read_mostly = 512;
 /* By default, RFC2861 behavior.  */
 int sysctl_tcp_slow_start_after_idle __read_mostly = 1;
 
+/* Bytes a socket may have in the qdisc and device queues, 0 for no
+ * limit.  Cellular uplinks are slow, so it is smaller than it would
+ * be for ethernet: 64KB are about 30 full sized packets.
+ */
+int sysctl_tcp_limit_output_bytes __read_mostly = 65536;
+
+/* Spread the packets of a window over the RTT.  Off by default. */
+int sysctl_tcp_pacing __read_mostly = 0;
+
 /* Account for new data that has been sent to the network. */
 static void tcp_event_new_data_sent(struct sock *sk, struct sk_buff *skb)
 {
@@ -657,7 +666,12 @@ static int tcp_transmit_skb(struct sock *sk, struct sk_buff *skb, int clone_it,
 
 	skb_push(skb, tcp_header_size);
 	skb_reset_transport_header(skb);
-	skb_set_owner_w(skb, sk);
+
+	/* skb_set_owner_w() with tcp_wfree() as the destructor */
+	skb_orphan(skb);
+	skb->sk = sk;
+	skb->destructor = tcp_wfree;
+	atomic_add(skb->truesize, &sk->sk_wmem_alloc);
 
 	/* Build TCP header and checksum it. */
 	th = tcp_hdr(skb);
@@ -1532,6 +1546,72 @@ static int tcp_mtu_probe(struct sock *sk)
 	return -1;
 }
 
+/* TCP Small Queues: sk_wmem_alloc counts the clones of the write queue
+ * that sit in the qdisc and the device.  Once they hold more than
+ * tcp_limit_output_bytes, stop sending, so that the queues below TCP
+ * stay short and other flows, pings or DNS, do not wait behind a bulk
+ * upload.  tcp_wfree() resumes the transmission when one of them is
+ * freed.
+ */
+static int tcp_small_queue_check(struct sock *sk)
+{
+	unsigned int limit = sysctl_tcp_limit_output_bytes;
+
+	if (!limit || atomic_read(&sk->sk_wmem_alloc) <= limit)
+		return 0;
+	set_bit(TSQ_THROTTLED, &tcp_sk(sk)->tsq_flags);
+	/* The queues may have drained before the flag was set */
+	smp_mb__after_clear_bit();
+	return atomic_read(&sk->sk_wmem_alloc) > limit;
+}
+
+/* Pacing sends the packets of a window at an even rate over the
+ * smoothed RTT, rather than in a burst as the acks open the window:
+ * TCP_PACING_SS_RATIO percent of cwnd per srtt in slow start, so that
+ * the window can still double, and TCP_PACING_CA_RATIO percent after.
+ * Until there is an RTT sample nothing is paced.
+ */
+#define TCP_PACING_SS_RATIO	200
+#define TCP_PACING_CA_RATIO	120
+
+static void tcp_pacing_update(struct sock *sk, unsigned int len)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	ktime_t now = ktime_get();
+	u32 ratio;
+	u64 ns;
+
+	if (!tp->srtt)
+		return;
+	ratio = tp->snd_cwnd < tp->snd_ssthresh ? TCP_PACING_SS_RATIO :
+						  TCP_PACING_CA_RATIO;
+
+	/* srtt is in jiffies << 3, and 125 * 8 usecs make 1000 ns */
+	ns = div64_u64((u64)len * jiffies_to_usecs(tp->srtt) * 125 * 100,
+		       (u64)ratio * tp->snd_cwnd * tp->mss_cache);
+
+	if (tp->pacing_next.tv64 < now.tv64)
+		tp->pacing_next = now;
+	tp->pacing_next = ktime_add_ns(tp->pacing_next, ns);
+}
+
+/* Returns 1 if the next packet must wait for the pacing timer */
+static int tcp_pacing_wait(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (!sysctl_tcp_pacing || tp->pacing_next.tv64 <= ktime_get().tv64)
+		return 0;
+
+	/* The timer holds a reference on the socket until tcp_pace_kick() */
+	if (!hrtimer_is_queued(&tp->pacing_timer)) {
+		atomic_inc(&sk->sk_wmem_alloc);
+		hrtimer_start(&tp->pacing_timer, tp->pacing_next,
+			      HRTIMER_MODE_ABS);
+	}
+	return 1;
+}
+
 /* This routine writes packets to the network.  It advances the
  * send_head.  This happens as incoming acks open up the remote
  * window for us.
@@ -1587,6 +1667,9 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 				break;
 		}
 
+		if (tcp_small_queue_check(sk) || tcp_pacing_wait(sk))
+			break;
+
 		limit = mss_now;
 		if (tso_segs > 1 && !tcp_urg_mode(tp))
 			limit = tcp_mss_split_point(sk, skb, mss_now,
@@ -1605,6 +1688,8 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 		 * This call will increment packets_out.
 		 */
 		tcp_event_new_data_sent(sk, skb);
+		if (sysctl_tcp_pacing)
+			tcp_pacing_update(sk, skb->len);
 
 		tcp_minshall_update(tp, mss_now, skb);
 		sent_pkts++;
@@ -1620,6 +1705,131 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 	return !tp->packets_out && tcp_send_head(sk);
 }
 
+/* Sockets stopped by TCP Small Queues or by pacing are sent from a
+ * tasklet on each cpu, or from tcp_release_cb() when the tasklet finds
+ * them owned by the user.  Each socket on a list holds a reference,
+ * one on sk_wmem_alloc as the skbs do, which is dropped by sk_free().
+ */
+struct tsq_tasklet {
+	struct tasklet_struct	tasklet;
+	struct list_head	head; /* queue of tcp sockets */
+};
+static DEFINE_PER_CPU(struct tsq_tasklet, tsq_tasklet);
+
+static void tcp_tsq_handler(struct sock *sk)
+{
+	if ((1 << sk->sk_state) &
+	    (TCPF_ESTABLISHED | TCPF_FIN_WAIT1 | TCPF_CLOSING |
+	     TCPF_CLOSE_WAIT  | TCPF_LAST_ACK))
+		tcp_write_xmit(sk, tcp_current_mss(sk), tcp_sk(sk)->nonagle,
+			       0, GFP_ATOMIC);
+}
+
+static void tcp_tasklet_func(unsigned long data)
+{
+	struct tsq_tasklet *tsq = (struct tsq_tasklet *)data;
+	LIST_HEAD(list);
+	unsigned long flags;
+	struct list_head *q, *n;
+	struct tcp_sock *tp;
+	struct sock *sk;
+
+	local_irq_save(flags);
+	list_splice_init(&tsq->head, &list);
+	local_irq_restore(flags);
+
+	list_for_each_safe(q, n, &list) {
+		tp = list_entry(q, struct tcp_sock, tsq_node);
+		list_del(&tp->tsq_node);
+		/* Before sending: a pacing timer armed or a throttle hit
+		 * while we send must be able to queue the socket again.
+		 */
+		clear_bit(TSQ_QUEUED, &tp->tsq_flags);
+
+		sk = (struct sock *)tp;
+		bh_lock_sock(sk);
+
+		if (!sock_owned_by_user(sk))
+			tcp_tsq_handler(sk);
+		else
+			set_bit(TSQ_DEFERRED, &tp->tsq_flags);
+		bh_unlock_sock(sk);
+
+		sk_free(sk);
+	}
+}
+
+/* Queues sk, with the reference the caller holds, for the tasklet */
+static void tcp_tsq_queue(struct sock *sk)
+{
+	struct tsq_tasklet *tsq;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	tsq = &__get_cpu_var(tsq_tasklet);
+	list_add(&tcp_sk(sk)->tsq_node, &tsq->head);
+	tasklet_schedule(&tsq->tasklet);
+	local_irq_restore(flags);
+}
+
+/* Called from release_sock() with the socket spinlock held */
+void tcp_release_cb(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (test_and_clear_bit(TSQ_DEFERRED, &tp->tsq_flags))
+		tcp_tsq_handler(sk);
+}
+EXPORT_SYMBOL(tcp_release_cb);
+
+void __init tcp_tasklet_init(void)
+{
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct tsq_tasklet *tsq = &per_cpu(tsq_tasklet, i);
+
+		INIT_LIST_HEAD(&tsq->head);
+		tasklet_init(&tsq->tasklet, tcp_tasklet_func,
+			     (unsigned long)tsq);
+	}
+}
+
+/* The destructor of the skbs sent by tcp_transmit_skb().  The first one
+ * freed after tcp_small_queue_check() stopped the socket queues it.
+ */
+void tcp_wfree(struct sk_buff *skb)
+{
+	struct sock *sk = skb->sk;
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (test_and_clear_bit(TSQ_THROTTLED, &tp->tsq_flags) &&
+	    !test_and_set_bit(TSQ_QUEUED, &tp->tsq_flags)) {
+		/* Keep a reference for the tasklet */
+		atomic_sub(skb->truesize - 1, &sk->sk_wmem_alloc);
+		tcp_tsq_queue(sk);
+	} else {
+		sock_wfree(skb);
+	}
+}
+
+/* The pacing timer, in hard interrupt context: hand its reference on
+ * the socket to the tasklet, or drop it if the socket is queued already,
+ * which holds another.
+ */
+enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
+{
+	struct tcp_sock *tp = container_of(timer, struct tcp_sock,
+					   pacing_timer);
+	struct sock *sk = (struct sock *)tp;
+
+	if (test_and_set_bit(TSQ_QUEUED, &tp->tsq_flags))
+		atomic_dec(&sk->sk_wmem_alloc);
+	else
+		tcp_tsq_queue(sk);
+	return HRTIMER_NORESTART;
+}
+
 /* Push out any pending frames which were held back due to
  * TCP_CORK or attempt at coalescing tiny packets.
  * The socket must be locked by the caller.
@@ -0,0 +1,868 @@
+/*
+ * net/sched/sch_fq_codel.c	Fair Queue Controlled Delay discipline.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ *  Copyright (C) 2010 Motorola, Inc.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/in.h>
+#include <linux/errno.h>
+#include <linux/init.h>
+#include <linux/ipv6.h>
+#include <linux/skbuff.h>
+#include <linux/jhash.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/reciprocal_div.h>
+#include <net/ip.h>
+#include <net/inet_ecn.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+
+/*	Fair Queue Controlled Delay.
+	============================
+
+	Packets are hashed on their addresses, protocol and ports into
+	one of a fixed number of flows, each a FIFO. The flows are served
+	by Deficit Round Robin with a quantum of bytes per round
+	(M. Shreedhar and G. Varghese, SIGCOMM 95). A flow that becomes
+	active goes to the new flows list, which is served before the
+	old flows list, so that sparse flows (pings, DNS, the acks of a
+	download) get out ahead of a bulk upload.
+
+	Each flow drops from its head with CoDel (K. Nichols and
+	V. Jacobson, "Controlling Queue Delay", ACM Queue, 2012): the
+	time a packet spent queued is its sojourn time. Once it has been
+	above the target for an interval, CoDel drops a packet, or marks
+	it with ECN, and then drops the following ones at intervals
+	shrinking with the inverse square root of the number of drops,
+	until the sojourn time falls below the target again.
+
+	Enqueue and dequeue take constant time. The flows are allocated
+	once, and the qdisc holds at most limit packets. Above it, the
+	flow with the largest backlog is found by a scan of the backlogs
+	and loses up to FQ_CODEL_DROP_BATCH packets from its head, up to
+	half of its bytes, so that the scan is paid once for a batch.  */
+
+#define FQ_CODEL_FLOWS		256
+#define FQ_CODEL_LIMIT		1000
+#define FQ_CODEL_DROP_BATCH	64
+
+/* CoDel times are in units of 1024 ns, and wrap every 73 minutes */
+typedef u32 codel_time_t;
+#define CODEL_SHIFT		10
+#define US2TIME(a)		((u32)(((u64)(a) * NSEC_PER_USEC) >> CODEL_SHIFT))
+#define TIME2US(a)		((u32)(((u64)(a) << CODEL_SHIFT) / NSEC_PER_USEC))
+
+#define codel_time_after(a, b)		((s32)((a) - (b)) > 0)
+#define codel_time_after_eq(a, b)	((s32)((a) - (b)) >= 0)
+#define codel_time_before(a, b)		((s32)((a) - (b)) < 0)
+
+/* 1/sqrt(count) is kept as a Q0.16 fraction, refined by a Newton step */
+#define REC_INV_SQRT_BITS	(8 * sizeof(u16))
+#define REC_INV_SQRT_SHIFT	(32 - REC_INV_SQRT_BITS)
+
+static inline codel_time_t codel_get_time(void)
+{
+	return ktime_to_ns(ktime_get()) >> CODEL_SHIFT;
+}
+
+struct codel_skb_cb {
+	codel_time_t enqueue_time;
+};
+
+static inline struct codel_skb_cb *get_codel_cb(struct sk_buff *skb)
+{
+	return (struct codel_skb_cb *)qdisc_skb_cb(skb)->data;
+}
+
+struct codel_vars {
+	u32		count;		/* drops since entering dropping */
+	u32		lastcount;	/* count when dropping last ended */
+	bool		dropping;
+	u16		rec_inv_sqrt;	/* 1/sqrt(count) */
+	codel_time_t	first_above_time; /* when the sojourn time must
+					   * have stayed above target to
+					   * start dropping, 0 if below */
+	codel_time_t	drop_next;	/* time of the next drop */
+	codel_time_t	ldelay;		/* sojourn time of the last packet */
+};
+
+struct fq_codel_flow {
+	struct sk_buff	*head;
+	struct sk_buff	*tail;
+	struct list_head flowchain;	/* on new_flows or old_flows */
+	int		deficit;
+	u32		dropped;	/* drops or marks since it was new */
+	struct codel_vars cvars;
+};
+
+struct fq_codel_sched_data {
+/* Parameters */
+	u32		limit;		/* packets */
+	u32		flows_cnt;
+	u32		quantum;	/* bytes per round of DRR */
+	codel_time_t	target;
+	codel_time_t	interval;
+	bool		ecn;
+
+/* Variables */
+	struct tcf_proto *filter_list;
+	struct fq_codel_flow *flows;	/* flows_cnt flows */
+	u32		*backlogs;	/* bytes queued per flow */
+	u32		perturbation;	/* hash seed */
+	struct list_head new_flows;
+	struct list_head old_flows;
+
+/* Statistics */
+	u32		maxpacket;	/* largest packet seen */
+	u32		drop_count;	/* CoDel drops not yet told to parents */
+	u32		drop_overlimit;
+	u32		ecn_mark;
+	u32		new_flow_count;
+};
+
+static inline int fq_codel_may_pull(struct sk_buff *skb, unsigned int len)
+{
+	return pskb_may_pull(skb, skb_network_offset(skb) + len);
+}
+
+static unsigned int fq_codel_hash(const struct fq_codel_sched_data *q,
+				  struct sk_buff *skb)
+{
+	u32 h, h2;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_IP):
+	{
+		const struct iphdr *iph;
+
+		if (!fq_codel_may_pull(skb, sizeof(*iph)))
+			goto other;
+		iph = ip_hdr(skb);
+		h = iph->daddr;
+		h2 = iph->saddr ^ iph->protocol;
+		if (!(iph->frag_off & htons(IP_MF | IP_OFFSET)) &&
+		    (iph->protocol == IPPROTO_TCP ||
+		     iph->protocol == IPPROTO_UDP ||
+		     iph->protocol == IPPROTO_UDPLITE ||
+		     iph->protocol == IPPROTO_SCTP ||
+		     iph->protocol == IPPROTO_DCCP ||
+		     iph->protocol == IPPROTO_ESP) &&
+		    fq_codel_may_pull(skb, iph->ihl * 4 + 4)) {
+			iph = ip_hdr(skb);
+			h2 ^= *(((u32 *)iph) + iph->ihl);
+		}
+		break;
+	}
+	case htons(ETH_P_IPV6):
+	{
+		const struct ipv6hdr *iph;
+
+		if (!fq_codel_may_pull(skb, sizeof(*iph)))
+			goto other;
+		iph = ipv6_hdr(skb);
+		h = iph->daddr.s6_addr32[3];
+		h2 = iph->saddr.s6_addr32[3] ^ iph->nexthdr;
+		if ((iph->nexthdr == IPPROTO_TCP ||
+		     iph->nexthdr == IPPROTO_UDP ||
+		     iph->nexthdr == IPPROTO_UDPLITE ||
+		     iph->nexthdr == IPPROTO_SCTP ||
+		     iph->nexthdr == IPPROTO_DCCP ||
+		     iph->nexthdr == IPPROTO_ESP) &&
+		    fq_codel_may_pull(skb, sizeof(*iph) + 4)) {
+			iph = ipv6_hdr(skb);
+			h2 ^= *(u32 *)&iph[1];
+		}
+		break;
+	}
+	default:
+other:
+		h = (unsigned long)skb_dst(skb) ^ skb->protocol;
+		h2 = (unsigned long)skb->sk;
+	}
+
+	return reciprocal_divide(jhash_2words(h, h2, q->perturbation),
+				 q->flows_cnt);
+}
+
+/* Returns the flow index plus one, or 0 if the packet is dropped */
+static unsigned int fq_codel_classify(struct sk_buff *skb, struct Qdisc *sch,
+				      int *qerr)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct tcf_result res;
+	int result;
+
+	if (TC_H_MAJ(skb->priority) == sch->handle &&
+	    TC_H_MIN(skb->priority) > 0 &&
+	    TC_H_MIN(skb->priority) <= q->flows_cnt)
+		return TC_H_MIN(skb->priority);
+
+	if (!q->filter_list)
+		return fq_codel_hash(q, skb) + 1;
+
+	*qerr = NET_XMIT_SUCCESS | __NET_XMIT_BYPASS;
+	result = tc_classify(skb, q->filter_list, &res);
+	if (result >= 0) {
+#ifdef CONFIG_NET_CLS_ACT
+		switch (result) {
+		case TC_ACT_STOLEN:
+		case TC_ACT_QUEUED:
+			*qerr = NET_XMIT_SUCCESS | __NET_XMIT_STOLEN;
+		case TC_ACT_SHOT:
+			return 0;
+		}
+#endif
+		if (TC_H_MIN(res.classid) <= q->flows_cnt)
+			return TC_H_MIN(res.classid);
+	}
+	return 0;
+}
+
+static inline u32 fq_codel_flow_idx(const struct fq_codel_sched_data *q,
+				    const struct fq_codel_flow *flow)
+{
+	return flow - q->flows;
+}
+
+static struct sk_buff *fq_codel_dequeue_head(struct Qdisc *sch,
+					     struct fq_codel_flow *flow)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *skb = flow->head;
+
+	if (skb) {
+		flow->head = skb->next;
+		skb->next = NULL;
+		q->backlogs[fq_codel_flow_idx(q, flow)] -= qdisc_pkt_len(skb);
+		sch->qstats.backlog -= qdisc_pkt_len(skb);
+		sch->q.qlen--;
+	}
+	return skb;
+}
+
+static inline void fq_codel_enqueue_tail(struct fq_codel_flow *flow,
+					 struct sk_buff *skb)
+{
+	if (flow->head == NULL)
+		flow->head = skb;
+	else
+		flow->tail->next = skb;
+	flow->tail = skb;
+	skb->next = NULL;
+}
+
+/* Drops from the head of the fattest flow, returns its index */
+static unsigned int fq_codel_drop_fattest(struct Qdisc *sch,
+					  unsigned int max_packets)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	unsigned int maxbacklog = 0, idx = 0, i, len, threshold;
+	struct fq_codel_flow *flow;
+	struct sk_buff *skb;
+
+	/* With 256 flows the scan reads 1KB of backlogs */
+	for (i = 0; i < q->flows_cnt; i++) {
+		if (q->backlogs[i] > maxbacklog) {
+			maxbacklog = q->backlogs[i];
+			idx = i;
+		}
+	}
+
+	flow = &q->flows[idx];
+	threshold = maxbacklog >> 1;
+	len = 0;
+	i = 0;
+	do {
+		skb = fq_codel_dequeue_head(sch, flow);
+		len += qdisc_pkt_len(skb);
+		kfree_skb(skb);
+	} while (++i < max_packets && len < threshold);
+
+	flow->dropped += i;
+	sch->qstats.drops += i;
+	return idx;
+}
+
+static unsigned int fq_codel_drop(struct Qdisc *sch)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	unsigned int prev_backlog = sch->qstats.backlog;
+
+	if (!sch->q.qlen)
+		return 0;
+	fq_codel_drop_fattest(sch, 1);
+	q->drop_overlimit++;
+	return prev_backlog - sch->qstats.backlog;
+}
+
+static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct fq_codel_flow *flow;
+	unsigned int idx, prev_qlen;
+	int uninitialized_var(ret);
+
+	idx = fq_codel_classify(skb, sch, &ret);
+	if (idx == 0) {
+		if (ret & __NET_XMIT_BYPASS)
+			sch->qstats.drops++;
+		kfree_skb(skb);
+		return ret;
+	}
+	idx--;
+
+	get_codel_cb(skb)->enqueue_time = codel_get_time();
+	flow = &q->flows[idx];
+	fq_codel_enqueue_tail(flow, skb);
+	q->backlogs[idx] += qdisc_pkt_len(skb);
+	sch->qstats.backlog += qdisc_pkt_len(skb);
+	__qdisc_update_bstats(sch, qdisc_pkt_len(skb));
+
+	if (list_empty(&flow->flowchain)) {
+		list_add_tail(&flow->flowchain, &q->new_flows);
+		q->new_flow_count++;
+		flow->deficit = q->quantum;
+		flow->dropped = 0;
+	}
+	if (++sch->q.qlen <= q->limit)
+		return NET_XMIT_SUCCESS;
+
+	prev_qlen = sch->q.qlen;
+	if (fq_codel_drop_fattest(sch, FQ_CODEL_DROP_BATCH) != idx)
+		idx = ~0U;
+	prev_qlen -= sch->q.qlen;
+	q->drop_overlimit += prev_qlen;
+
+	/* Congestion notification only if this packet's flow lost some,
+	 * and then the parents count one drop less: this packet's.
+	 */
+	if (idx != ~0U) {
+		qdisc_tree_decrease_qlen(sch, prev_qlen - 1);
+		return NET_XMIT_CN;
+	}
+	qdisc_tree_decrease_qlen(sch, prev_qlen);
+	return NET_XMIT_SUCCESS;
+}
+
+static inline void codel_Newton_step(struct codel_vars *vars)
+{
+	u32 invsqrt = ((u32)vars->rec_inv_sqrt) << REC_INV_SQRT_SHIFT;
+	u32 invsqrt2 = ((u64)invsqrt * invsqrt) >> 32;
+	u64 val = (3LL << 32) - ((u64)vars->count * invsqrt2);
+
+	val >>= 2; /* avoid overflow in the following multiply */
+	val = (val * invsqrt) >> (32 - 2 + 1);
+
+	vars->rec_inv_sqrt = val >> REC_INV_SQRT_SHIFT;
+}
+
+/* t + interval / sqrt(count) */
+static inline codel_time_t codel_control_law(codel_time_t t,
+					     codel_time_t interval,
+					     u32 rec_inv_sqrt)
+{
+	return t + reciprocal_divide(interval,
+				     rec_inv_sqrt << REC_INV_SQRT_SHIFT);
+}
+
+static bool codel_should_drop(struct fq_codel_sched_data *q,
+			      struct fq_codel_flow *flow,
+			      struct sk_buff *skb, codel_time_t now)
+{
+	struct codel_vars *vars = &flow->cvars;
+
+	if (!skb) {
+		vars->first_above_time = 0;
+		return false;
+	}
+
+	vars->ldelay = now - get_codel_cb(skb)->enqueue_time;
+	if (unlikely(qdisc_pkt_len(skb) > q->maxpacket))
+		q->maxpacket = qdisc_pkt_len(skb);
+
+	/* A single packet on a slow link may take longer than target */
+	if (codel_time_before(vars->ldelay, q->target) ||
+	    q->backlogs[fq_codel_flow_idx(q, flow)] <= q->maxpacket) {
+		vars->first_above_time = 0;
+		return false;
+	}
+	if (vars->first_above_time == 0) {
+		/* went above: drop if it stays above for an interval */
+		vars->first_above_time = (now + q->interval) ?: 1;
+		return false;
+	}
+	return codel_time_after(now, vars->first_above_time);
+}
+
+/* Drops or marks the packet, returns true if it can still be sent */
+static bool codel_mark_or_drop(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+
+	if (q->ecn && INET_ECN_set_ce(skb)) {
+		q->ecn_mark++;
+		return true;
+	}
+	qdisc_drop(skb, sch);
+	q->drop_count++;
+	return false;
+}
+
+static struct sk_buff *codel_dequeue(struct Qdisc *sch,
+				     struct fq_codel_flow *flow)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct codel_vars *vars = &flow->cvars;
+	struct sk_buff *skb = fq_codel_dequeue_head(sch, flow);
+	codel_time_t now;
+	bool drop;
+	u32 delta;
+
+	if (!skb) {
+		vars->dropping = false;
+		return NULL;
+	}
+	now = codel_get_time();
+	drop = codel_should_drop(q, flow, skb, now);
+
+	if (vars->dropping) {
+		if (!drop) {
+			/* sojourn time below target: leave dropping */
+			vars->dropping = false;
+			return skb;
+		}
+		/* A large backlog may call for several drops at once */
+		while (vars->dropping &&
+		       codel_time_after_eq(now, vars->drop_next)) {
+			vars->count++;
+			codel_Newton_step(vars);
+			vars->drop_next = codel_control_law(vars->drop_next,
+							    q->interval,
+							    vars->rec_inv_sqrt);
+			if (codel_mark_or_drop(sch, skb))
+				return skb;
+			skb = fq_codel_dequeue_head(sch, flow);
+			if (!codel_should_drop(q, flow, skb, now))
+				vars->dropping = false;
+		}
+		return skb;
+	}
+
+	if (!drop)
+		return skb;
+
+	if (!codel_mark_or_drop(sch, skb)) {
+		skb = fq_codel_dequeue_head(sch, flow);
+		codel_should_drop(q, flow, skb, now);
+	}
+	vars->dropping = true;
+
+	/* If the queue went above target again soon after dropping
+	 * last ended, resume near the drop rate that controlled it.
+	 */
+	delta = vars->count - vars->lastcount;
+	if (delta > 1 &&
+	    codel_time_before(now - vars->drop_next, 16 * q->interval)) {
+		vars->count = delta;
+		codel_Newton_step(vars);
+	} else {
+		vars->count = 1;
+		vars->rec_inv_sqrt = ~0U >> REC_INV_SQRT_SHIFT;
+	}
+	vars->lastcount = vars->count;
+	vars->drop_next = codel_control_law(now, q->interval,
+					    vars->rec_inv_sqrt);
+	return skb;
+}
+
+static struct sk_buff *fq_codel_dequeue(struct Qdisc *sch)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct fq_codel_flow *flow;
+	struct list_head *head;
+	struct sk_buff *skb;
+	u32 prev_drop_count, prev_ecn_mark;
+
+begin:
+	head = &q->new_flows;
+	if (list_empty(head)) {
+		head = &q->old_flows;
+		if (list_empty(head))
+			return NULL;
+	}
+	flow = list_first_entry(head, struct fq_codel_flow, flowchain);
+
+	if (flow->deficit <= 0) {
+		flow->deficit += q->quantum;
+		list_move_tail(&flow->flowchain, &q->old_flows);
+		goto begin;
+	}
+
+	prev_drop_count = q->drop_count;
+	prev_ecn_mark = q->ecn_mark;
+
+	skb = codel_dequeue(sch, flow);
+	flow->dropped += q->drop_count - prev_drop_count;
+	flow->dropped += q->ecn_mark - prev_ecn_mark;
+
+	if (!skb) {
+		/* A new flow that emptied goes through old_flows once, so
+		 * that it cannot starve the old ones by coming back new.
+		 */
+		if (head == &q->new_flows && !list_empty(&q->old_flows))
+			list_move_tail(&flow->flowchain, &q->old_flows);
+		else
+			list_del_init(&flow->flowchain);
+		goto begin;
+	}
+	flow->deficit -= qdisc_pkt_len(skb);
+
+	/* qdisc_tree_decrease_qlen() must not be called with qlen 0,
+	 * parents such as HTB would deactivate us; keep it for later.
+	 */
+	if (q->drop_count && sch->q.qlen) {
+		qdisc_tree_decrease_qlen(sch, q->drop_count);
+		q->drop_count = 0;
+	}
+	return skb;
+}
+
+static void fq_codel_reset(struct Qdisc *sch)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *skb;
+	unsigned int i;
+
+	for (i = 0; i < q->flows_cnt; i++) {
+		struct fq_codel_flow *flow = &q->flows[i];
+
+		while ((skb = fq_codel_dequeue_head(sch, flow)) != NULL)
+			kfree_skb(skb);
+		INIT_LIST_HEAD(&flow->flowchain);
+		memset(&flow->cvars, 0, sizeof(flow->cvars));
+	}
+	INIT_LIST_HEAD(&q->new_flows);
+	INIT_LIST_HEAD(&q->old_flows);
+	memset(q->backlogs, 0, q->flows_cnt * sizeof(u32));
+	sch->q.qlen = 0;
+	sch->qstats.backlog = 0;
+	q->drop_count = 0;
+}
+
+static const struct nla_policy fq_codel_policy[TCA_FQ_CODEL_MAX + 1] = {
+	[TCA_FQ_CODEL_TARGET]	= { .type = NLA_U32 },
+	[TCA_FQ_CODEL_LIMIT]	= { .type = NLA_U32 },
+	[TCA_FQ_CODEL_INTERVAL]	= { .type = NLA_U32 },
+	[TCA_FQ_CODEL_ECN]	= { .type = NLA_U32 },
+	[TCA_FQ_CODEL_FLOWS]	= { .type = NLA_U32 },
+	[TCA_FQ_CODEL_QUANTUM]	= { .type = NLA_U32 },
+};
+
+static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct nlattr *tb[TCA_FQ_CODEL_MAX + 1];
+	unsigned int qlen;
+	int err;
+
+	if (!opt)
+		return -EINVAL;
+
+	err = nla_parse_nested(tb, TCA_FQ_CODEL_MAX, opt, fq_codel_policy);
+	if (err < 0)
+		return err;
+
+	/* the flows are allocated once, by fq_codel_init() */
+	if (tb[TCA_FQ_CODEL_FLOWS]) {
+		if (q->flows)
+			return -EINVAL;
+		q->flows_cnt = nla_get_u32(tb[TCA_FQ_CODEL_FLOWS]);
+		if (!q->flows_cnt || q->flows_cnt > 65536)
+			return -EINVAL;
+	}
+
+	sch_tree_lock(sch);
+
+	if (tb[TCA_FQ_CODEL_TARGET])
+		q->target = US2TIME(nla_get_u32(tb[TCA_FQ_CODEL_TARGET]));
+
+	if (tb[TCA_FQ_CODEL_INTERVAL])
+		q->interval = US2TIME(nla_get_u32(tb[TCA_FQ_CODEL_INTERVAL]));
+
+	if (tb[TCA_FQ_CODEL_LIMIT])
+		q->limit = nla_get_u32(tb[TCA_FQ_CODEL_LIMIT]) ?: 1;
+
+	if (tb[TCA_FQ_CODEL_ECN])
+		q->ecn = !!nla_get_u32(tb[TCA_FQ_CODEL_ECN]);
+
+	if (tb[TCA_FQ_CODEL_QUANTUM])
+		q->quantum = max(256U, nla_get_u32(tb[TCA_FQ_CODEL_QUANTUM]));
+
+	if (q->flows) {
+		qlen = sch->q.qlen;
+		while (sch->q.qlen > q->limit)
+			fq_codel_drop(sch);
+		qdisc_tree_decrease_qlen(sch, qlen - sch->q.qlen);
+	}
+
+	sch_tree_unlock(sch);
+	return 0;
+}
+
+static void *fq_codel_zalloc(size_t sz)
+{
+	void *ptr = kzalloc(sz, GFP_KERNEL | __GFP_NOWARN);
+
+	if (!ptr) {
+		ptr = vmalloc(sz);
+		if (ptr)
+			memset(ptr, 0, sz);
+	}
+	return ptr;
+}
+
+static void fq_codel_free(void *addr)
+{
+	if (is_vmalloc_addr(addr))
+		vfree(addr);
+	else
+		kfree(addr);
+}
+
+static void fq_codel_destroy(struct Qdisc *sch)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+
+	tcf_destroy_chain(&q->filter_list);
+	fq_codel_free(q->backlogs);
+	fq_codel_free(q->flows);
+}
+
+static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	unsigned int i;
+
+	q->limit = FQ_CODEL_LIMIT;
+	q->flows_cnt = FQ_CODEL_FLOWS;
+	q->quantum = psched_mtu(qdisc_dev(sch));
+	q->target = US2TIME(5 * USEC_PER_MSEC);
+	q->interval = US2TIME(100 * USEC_PER_MSEC);
+	q->ecn = true;
+	q->perturbation = net_random();
+	INIT_LIST_HEAD(&q->new_flows);
+	INIT_LIST_HEAD(&q->old_flows);
+
+	if (opt) {
+		int err = fq_codel_change(sch, opt);
+
+		if (err)
+			return err;
+	}
+
+	q->flows = fq_codel_zalloc(q->flows_cnt * sizeof(struct fq_codel_flow));
+	q->backlogs = fq_codel_zalloc(q->flows_cnt * sizeof(u32));
+	if (!q->flows || !q->backlogs) {
+		fq_codel_free(q->backlogs);
+		fq_codel_free(q->flows);
+		q->backlogs = NULL;
+		q->flows = NULL;
+		return -ENOMEM;
+	}
+	for (i = 0; i < q->flows_cnt; i++)
+		INIT_LIST_HEAD(&q->flows[i].flowchain);
+
+	return 0;
+}
+
+static int fq_codel_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct nlattr *opts;
+
+	opts = nla_nest_start(skb, TCA_OPTIONS);
+	if (opts == NULL)
+		goto nla_put_failure;
+
+	NLA_PUT_U32(skb, TCA_FQ_CODEL_TARGET, TIME2US(q->target));
+	NLA_PUT_U32(skb, TCA_FQ_CODEL_LIMIT, q->limit);
+	NLA_PUT_U32(skb, TCA_FQ_CODEL_INTERVAL, TIME2US(q->interval));
+	NLA_PUT_U32(skb, TCA_FQ_CODEL_ECN, q->ecn);
+	NLA_PUT_U32(skb, TCA_FQ_CODEL_QUANTUM, q->quantum);
+	NLA_PUT_U32(skb, TCA_FQ_CODEL_FLOWS, q->flows_cnt);
+	return nla_nest_end(skb, opts);
+
+nla_put_failure:
+	nla_nest_cancel(skb, opts);
+	return -EMSGSIZE;
+}
+
+static int fq_codel_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct tc_fq_codel_xstats st = {
+		.type	= TCA_FQ_CODEL_XSTATS_QDISC,
+	};
+	struct list_head *pos;
+
+	st.qdisc_stats.maxpacket = q->maxpacket;
+	st.qdisc_stats.drop_overlimit = q->drop_overlimit;
+	st.qdisc_stats.ecn_mark = q->ecn_mark;
+	st.qdisc_stats.new_flow_count = q->new_flow_count;
+
+	list_for_each(pos, &q->new_flows)
+		st.qdisc_stats.new_flows_len++;
+	list_for_each(pos, &q->old_flows)
+		st.qdisc_stats.old_flows_len++;
+
+	return gnet_stats_copy_app(d, &st, sizeof(st));
+}
+
+static struct Qdisc *fq_codel_leaf(struct Qdisc *sch, unsigned long arg)
+{
+	return NULL;
+}
+
+static unsigned long fq_codel_get(struct Qdisc *sch, u32 classid)
+{
+	return 0;
+}
+
+static unsigned long fq_codel_bind(struct Qdisc *sch, unsigned long parent,
+				   u32 classid)
+{
+	return 0;
+}
+
+static void fq_codel_put(struct Qdisc *q, unsigned long cl)
+{
+}
+
+static struct tcf_proto **fq_codel_find_tcf(struct Qdisc *sch,
+					    unsigned long cl)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+
+	if (cl)
+		return NULL;
+	return &q->filter_list;
+}
+
+static int fq_codel_dump_class(struct Qdisc *sch, unsigned long cl,
+			       struct sk_buff *skb, struct tcmsg *tcm)
+{
+	tcm->tcm_handle |= TC_H_MIN(cl);
+	return 0;
+}
+
+static int fq_codel_dump_class_stats(struct Qdisc *sch, unsigned long cl,
+				     struct gnet_dump *d)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	u32 idx = cl - 1;
+	struct gnet_stats_queue qs = { 0 };
+	struct tc_fq_codel_xstats xstats;
+
+	memset(&xstats, 0, sizeof(xstats));
+	if (idx < q->flows_cnt) {
+		const struct fq_codel_flow *flow = &q->flows[idx];
+		const struct codel_vars *vars = &flow->cvars;
+		const struct sk_buff *skb;
+
+		xstats.type = TCA_FQ_CODEL_XSTATS_CLASS;
+		xstats.class_stats.deficit = flow->deficit;
+		xstats.class_stats.ldelay = TIME2US(vars->ldelay);
+		xstats.class_stats.count = vars->count;
+		xstats.class_stats.lastcount = vars->lastcount;
+		xstats.class_stats.dropping = vars->dropping;
+		if (vars->dropping) {
+			s32 delta = vars->drop_next - codel_get_time();
+
+			xstats.class_stats.drop_next = delta < 0 ?
+				-(s32)TIME2US(-delta) : TIME2US(delta);
+		}
+		for (skb = flow->head; skb; skb = skb->next)
+			qs.qlen++;
+		qs.backlog = q->backlogs[idx];
+		qs.drops = flow->dropped;
+	}
+	if (gnet_stats_copy_queue(d, &qs) < 0)
+		return -1;
+	if (idx < q->flows_cnt)
+		return gnet_stats_copy_app(d, &xstats, sizeof(xstats));
+	return 0;
+}
+
+static void fq_codel_walk(struct Qdisc *sch, struct qdisc_walker *arg)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	unsigned int i;
+
+	if (arg->stop)
+		return;
+
+	for (i = 0; i < q->flows_cnt; i++) {
+		if (list_empty(&q->flows[i].flowchain) ||
+		    arg->count < arg->skip) {
+			arg->count++;
+			continue;
+		}
+		if (arg->fn(sch, i + 1, arg) < 0) {
+			arg->stop = 1;
+			break;
+		}
+		arg->count++;
+	}
+}
+
+static const struct Qdisc_class_ops fq_codel_class_ops = {
+	.leaf		=	fq_codel_leaf,
+	.get		=	fq_codel_get,
+	.put		=	fq_codel_put,
+	.tcf_chain	=	fq_codel_find_tcf,
+	.bind_tcf	=	fq_codel_bind,
+	.unbind_tcf	=	fq_codel_put,
+	.dump		=	fq_codel_dump_class,
+	.dump_stats	=	fq_codel_dump_class_stats,
+	.walk		=	fq_codel_walk,
+};
+
+static struct Qdisc_ops fq_codel_qdisc_ops __read_mostly = {
+	.cl_ops		=	&fq_codel_class_ops,
+	.id		=	"fq_codel",
+	.priv_size	=	sizeof(struct fq_codel_sched_data),
+	.enqueue	=	fq_codel_enqueue,
+	.dequeue	=	fq_codel_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.drop		=	fq_codel_drop,
+	.init		=	fq_codel_init,
+	.reset		=	fq_codel_reset,
+	.destroy	=	fq_codel_destroy,
+	.change		=	fq_codel_change,
+	.dump		=	fq_codel_dump,
+	.dump_stats	=	fq_codel_dump_stats,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init fq_codel_module_init(void)
+{
+	return register_qdisc(&fq_codel_qdisc_ops);
+}
+static void __exit fq_codel_module_exit(void)
+{
+	unregister_qdisc(&fq_codel_qdisc_ops);
+}
+module_init(fq_codel_module_init)
+module_exit(fq_codel_module_exit)
+MODULE_LICENSE("GPL");